@@ -44,6 +44,9 @@ struct ROSCPP_DECL AdvertiseServiceOptions
 {
   AdvertiseServiceOptions()
   : callback_queue(0)
+  , max_concurrent_calls(0)
+  , max_backlog(100)
+  , priority(0)
   {
   }
 
@@ -137,6 +140,33 @@ struct ROSCPP_DECL AdvertiseServiceOptions
    */
   VoidConstPtr tracked_object;
 
+  /**
+   * \brief How many calls to this service may be in progress at once.
+   *
+   * 0 (the default) leaves this up to the callback queue: calls from different clients can run in parallel on a
+   * multi-threaded spinner, but each client connection is served one request at a time.  A value N > 0 caps the
+   * number of calls queued or running at N, and lets a persistent client's pipelined requests be handled in parallel
+   * too (responses are still sent back in request order).
+   */
+  uint32_t max_concurrent_calls;
+  /**
+   * \brief With max_concurrent_calls set, how many further requests may wait for a free slot.  Requests beyond that
+   * are answered straight away with an error saying the service is overloaded.  Defaults to 100, so that a flood of
+   * requests cannot grow the backlog without bound.  0 rejects every request that finds all slots busy.
+   */
+  uint32_t max_backlog;
+
+  /**
+   * \brief Priority of this service's callbacks, for callback queues that order by it (e.g. PriorityCallbackQueue).
+   * Higher is called first.
+   */
+  int32_t priority;
+  /**
+   * \brief How soon after a request is queued its callback should be called.  With PriorityCallbackQueue, callbacks of
+   * equal priority are called earliest deadline first.  Zero (the default) means no deadline.
+   */
+  ros::WallDuration deadline;
+
   /**
    * \brief Templated helper function for creating an AdvertiseServiceOptions with all of its options
    * \param service Service name to advertise on
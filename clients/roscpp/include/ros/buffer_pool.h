@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2009, Willow Garage, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the names of Willow Garage, Inc. nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef ROSCPP_BUFFER_POOL_H
+#define ROSCPP_BUFFER_POOL_H
+
+#include "common.h"
+
+#include <boost/shared_ptr.hpp>
+#include <boost/shared_array.hpp>
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <vector>
+
+namespace XmlRpc
+{
+class XmlRpcValue;
+}
+
+namespace ros
+{
+
+class BufferPool;
+typedef boost::shared_ptr<BufferPool> BufferPoolPtr;
+
+/**
+ * \brief Process-wide pool of size-classed byte buffers, used for incoming message data.
+ *
+ * Buffers are rounded up to the next power of two and handed out as shared_arrays whose deleter returns them to the
+ * pool once the last reference (usually a SerializedMessage sitting in a subscription queue) is dropped.  Buffers
+ * larger than the largest size class, or which would take the pool over its cached byte limit, are simply freed.
+ */
+class ROSCPP_DECL BufferPool : public boost::enable_shared_from_this<BufferPool>
+{
+public:
+  static const BufferPoolPtr& instance();
+
+  struct Stats
+  {
+    Stats()
+    : allocations_(0)
+    , pool_hits_(0)
+    , heap_allocations_(0)
+    , heap_bytes_(0)
+    , released_(0)
+    , discarded_(0)
+    , cached_bytes_(0)
+    {}
+
+    /// Total number of buffers handed out
+    uint64_t allocations_;
+    /// Number of buffers that were served from the pool
+    uint64_t pool_hits_;
+    /// Number of buffers that had to be allocated from the heap
+    uint64_t heap_allocations_;
+    /// Bytes allocated from the heap
+    uint64_t heap_bytes_;
+    /// Number of buffers returned to the pool
+    uint64_t released_;
+    /// Number of buffers freed instead of being returned to the pool
+    uint64_t discarded_;
+    /// Bytes currently held by the pool
+    uint64_t cached_bytes_;
+  };
+
+  BufferPool();
+  ~BufferPool();
+
+  /**
+   * \brief Returns a buffer of at least size bytes.  The contents are uninitialized.
+   */
+  boost::shared_array<uint8_t> allocate(uint32_t size);
+
+  /**
+   * \brief Set the maximum number of bytes the pool keeps around for reuse.  0 disables pooling.
+   */
+  void setMaxCachedBytes(uint32_t bytes);
+  /**
+   * \brief Free all cached buffers
+   */
+  void clear();
+
+  Stats getStats();
+  /**
+   * \brief Fills in the stats in the form reported through getBusStats:
+   * [allocations, pool_hits, heap_allocations, heap_bytes, released, discarded, cached_bytes]
+   * The counters are reported as doubles, since they outgrow an XML-RPC int on long-running nodes.
+   */
+  void getStats(XmlRpc::XmlRpcValue& stats);
+
+private:
+  struct Releaser;
+  void release(uint8_t* data, uint32_t size_class);
+
+  boost::mutex mutex_;
+  /// Free buffers, indexed by size class.  Buffers in class i are (64 << i) bytes.
+  std::vector<std::vector<uint8_t*> > free_;
+  uint32_t max_cached_bytes_;
+  Stats stats_;
+};
+
+}
+
+#endif
@@ -105,7 +105,7 @@ public:
    * this parameter does nothing.
    */
   //
-  CallOneResult callOne(ros::WallDuration timeout);
+  virtual CallOneResult callOne(ros::WallDuration timeout);
 
   /**
    * \brief Invoke all callbacks currently in the queue.  If a callback was not ready to be called, pushes it back onto the queue.
@@ -121,7 +121,7 @@ public:
    * \param timeout The amount of time to wait for at least one callback to be available.  If there is already at least one callback available,
    * this parameter does nothing.
    */
-  void callAvailable(ros::WallDuration timeout);
+  virtual void callAvailable(ros::WallDuration timeout);
 
   /**
    * \brief returns whether or not the queue is empty
@@ -131,25 +131,25 @@ public:
   /**
    * \brief returns whether or not the queue is empty
    */
-  bool isEmpty();
+  virtual bool isEmpty();
   /**
    * \brief Removes all callbacks from the queue.  Does \b not wait for calls currently in progress to finish.
    */
   //清空回调队列
-  void clear();
+  virtual void clear();
 
   /**
    * \brief Enable the queue (queue is enabled by default)
    */
-  void enable();
+  virtual void enable();
   /**
    * \brief Disable the queue, meaning any calls to addCallback() will have no effect
    */
-  void disable();
+  virtual void disable();
   /**
    * \brief Returns whether or not this queue is enabled
    */
-  bool isEnabled();
+  virtual bool isEnabled();
 
 protected:
   void setupTLS();
@@ -172,13 +172,32 @@ protected:
     CallbackInfo()
     : removal_id(0)
     , marked_for_removal(false)
+    , priority(0)
+    , sequence(0)
     {}
     CallbackInterfacePtr callback;
     uint64_t removal_id;
     bool marked_for_removal;
+
+    /// Ordering information, only filled in by queues that use it (see PriorityCallbackQueue)
+    int32_t priority;
+    /// Absolute deadline, zero if none
+    SteadyTime deadline;
+    uint64_t sequence;
   };
   typedef std::list<CallbackInfo> L_CallbackInfo;
   typedef std::deque<CallbackInfo> D_CallbackInfo;
+
+  /**
+   * \brief Put a callback that returned TryAgain back on the queue
+   */
+  virtual void requeueCallback(const CallbackInfo& info);
+  /**
+   * \brief Erase all queued callbacks with this removal id.  Called from removeByID() with the id's calling_rw_mutex
+   * held exclusively.
+   */
+  virtual void eraseQueuedCallbacks(uint64_t removal_id);
+
   D_CallbackInfo callbacks_;//所有的callback
   size_t calling_;
   boost::mutex mutex_;
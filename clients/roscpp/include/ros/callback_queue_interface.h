@@ -38,6 +38,7 @@
 #include <boost/shared_ptr.hpp>
 #include "common.h"
 #include "ros/types.h"
+#include "ros/time.h"
 
 namespace ros
 {
@@ -73,6 +74,17 @@ public:
    */
   //在调用call之前告知知否准备好
   virtual bool ready() { return true; }
+
+  /**
+   * \brief Priority of this callback.  Queues that order by priority (e.g. PriorityCallbackQueue) call higher values
+   * first; CallbackQueue ignores it.
+   */
+  virtual int32_t getPriority() { return 0; }
+  /**
+   * \brief How soon after being queued this callback should be called.  Among callbacks of equal priority,
+   * PriorityCallbackQueue calls the one with the earliest deadline first.  Zero (the default) means no deadline.
+   */
+  virtual WallDuration getDeadline() { return WallDuration(); }
 };
 typedef boost::shared_ptr<CallbackInterface> CallbackInterfacePtr;
 
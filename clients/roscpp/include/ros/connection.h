@@ -36,6 +36,7 @@
 #define ROSCPP_CONNECTION_H
 
 #include "ros/header.h"
+#include "ros/transport/transport.h"
 #include "common.h"
 
 #include <boost/signals2.hpp>
@@ -47,13 +48,14 @@
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/recursive_mutex.hpp>
 
+#include <utility>
+#include <vector>
+
 #define READ_BUFFER_SIZE (1024*64)
 
 namespace ros
 {
 
-class Transport;
-typedef boost::shared_ptr<Transport> TransportPtr;
 class Connection;
 typedef boost::shared_ptr<Connection> ConnectionPtr;
 
@@ -61,6 +63,10 @@ typedef boost::shared_ptr<Connection> ConnectionPtr;
 typedef boost::function<void(const ConnectionPtr&, const boost::shared_array<uint8_t>&, uint32_t, bool)> ReadFinishedFunc;
 typedef boost::function<void(const ConnectionPtr&)> WriteFinishedFunc;
 
+/// A buffer to be written, paired with its size in bytes
+typedef std::pair<boost::shared_array<uint8_t>, uint32_t> WriteBufferAndSize;
+typedef std::vector<WriteBufferAndSize> V_WriteBuffer;
+
 typedef boost::function<bool(const ConnectionPtr&, const Header&)> HeaderReceivedFunc;
 
 /**
@@ -145,6 +151,18 @@ public:
    * the data off to the server thread
    */
   void write(const boost::shared_array<uint8_t>& buffer, uint32_t size, const WriteFinishedFunc& finished_callback, bool immedate = true);
+  /**
+   * \brief Write several buffers of bytes back to back, calling a callback once all of them have been written
+   *
+   * Follows the same rules as write().  Transports that support vectored I/O (eg. TCPROS) will send as many of the
+   * buffers as possible with a single system call.
+   *
+   * \param buffers The buffers of data to write, each paired with its size in bytes
+   * \param finished_callback The function to call when the write has finished
+   * \param immediate Whether to immediately try to write as much data as possible to the socket or to pass
+   * the data off to the server thread
+   */
+  void writeBatch(const V_WriteBuffer& buffers, const WriteFinishedFunc& finished_callback, bool immediate = true);
 
   typedef boost::signals2::signal<void(const ConnectionPtr&, DropReason reason)> DropSignal;
   typedef boost::function<void(const ConnectionPtr&, DropReason reason)> DropFunc;
@@ -236,11 +254,17 @@ private:
   /// to ensure this is done atomically
   volatile uint32_t has_read_callback_;
 
-  /// Buffer to write from
-  boost::shared_array<uint8_t> write_buffer_;
-  /// Amount of data we've written from the write buffer
+  /// Buffers to write from
+  V_WriteBuffer write_buffers_;
+  /// Index of the first buffer in write_buffers_ that still has data to send
+  uint32_t write_index_;
+  /// Amount of data we've written from write_buffers_[write_index_]
+  uint32_t write_offset_;
+  /// Scratch list handed to Transport::writev(), kept around to avoid reallocating it on every write
+  std::vector<Transport::WriteBuffer> write_iov_;
+  /// Amount of data we've written from all of the write buffers
   uint32_t write_sent_;
-  /// Size of the write buffer
+  /// Total size of the write buffers
   uint32_t write_size_;
   /// Function to call when the current write is finished
   WriteFinishedFunc write_callback_;
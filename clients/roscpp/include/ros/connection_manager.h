@@ -37,6 +37,7 @@ namespace ros
 
 class PollManager;
 typedef boost::shared_ptr<PollManager> PollManagerPtr;
+class PollSet;
 
 class ConnectionManager;
 typedef boost::shared_ptr<ConnectionManager> ConnectionManagerPtr;
@@ -69,6 +70,13 @@ public:
 
   void udprosIncomingConnection(const TransportUDPPtr& transport, Header& header);
 
+  /** @brief Pick the poll set a new TCPROS connection should be serviced by
+   *
+   * With a single poll thread this is always the primary poll set.  With several, the poll set tracking the fewest
+   * sockets is chosen, with ties broken round-robin.
+   */
+  PollSet* selectPollSet();
+
   void start();
   void shutdown();
 
@@ -96,6 +104,10 @@ private:
 
   boost::signals2::connection poll_conn_;
 
+  // Round-robin cursor used by selectPollSet() to break ties between equally loaded poll sets
+  uint32_t next_poll_set_;
+  boost::mutex next_poll_set_mutex_;
+
   TransportTCPPtr tcpserver_transport_;
   TransportUDPPtr udpserver_transport_;
 
@@ -78,6 +78,8 @@ typedef std::set<SubscriptionPtr> S_Subscription;
 class PublisherLink;
 typedef boost::shared_ptr<PublisherLink> PublisherLinkPtr;
 typedef std::vector<PublisherLinkPtr> V_PublisherLink;
+class LinkStatistics;
+typedef boost::shared_ptr<LinkStatistics> LinkStatisticsPtr;
 class ServicePublication;
 typedef boost::shared_ptr<ServicePublication> ServicePublicationPtr;
 typedef std::list<ServicePublicationPtr> L_ServicePublication;
@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) 2009, Willow Garage, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the names of Willow Garage, Inc. nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef ROSCPP_HISTOGRAM_H
+#define ROSCPP_HISTOGRAM_H
+
+#include "common.h"
+
+#include <boost/shared_ptr.hpp>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+namespace XmlRpc
+{
+class XmlRpcValue;
+}
+
+namespace ros
+{
+
+/**
+ * \brief Lock-free histogram of unsigned values with logarithmic buckets, in the style of HdrHistogram.
+ *
+ * Each power of two is split into 8 linear sub-buckets, so any recorded value is reported with at most 12.5% error
+ * (values below 8 are exact).  Values of 2^41 and above all land in the last bucket, though the maximum is still
+ * tracked exactly.  record() is a handful of relaxed atomic increments and may be called from any number of threads;
+ * snapshots taken concurrently with recording may be off by the in-flight values, but are never torn.
+ */
+class ROSCPP_DECL Histogram
+{
+public:
+  static const uint32_t SUB_BUCKET_BITS = 3;
+  static const uint32_t SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+  static const uint32_t MAX_MAGNITUDE = 40;
+  static const uint32_t NUM_BUCKETS = (MAX_MAGNITUDE - SUB_BUCKET_BITS + 2) * SUB_BUCKETS;
+
+  struct Snapshot
+  {
+    Snapshot()
+    : count_(0)
+    , sum_(0)
+    , max_(0)
+    {}
+
+    /**
+     * \brief Returns the value below which the given fraction (0-1) of the recorded values fall, rounded up to the
+     * upper bound of its bucket.  Returns 0 if nothing has been recorded.
+     */
+    uint64_t getPercentile(double fraction) const;
+    double getMean() const;
+
+    /// Number of recorded values
+    uint64_t count_;
+    /// Sum of all recorded values
+    uint64_t sum_;
+    /// Largest recorded value
+    uint64_t max_;
+    /// Per-bucket counts, see Histogram::getBucketIndex()
+    std::vector<uint64_t> buckets_;
+  };
+
+  Histogram();
+
+  void record(uint64_t value);
+  void reset();
+
+  Snapshot getSnapshot() const;
+  /**
+   * \brief Fills in the stats in the form reported through getBusStats:
+   * [count, mean, p50, p90, p99, p99.9, max], all as doubles so the count doesn't overflow an XML-RPC int
+   */
+  void getStats(XmlRpc::XmlRpcValue& stats) const;
+
+  static uint32_t getBucketIndex(uint64_t value);
+  /**
+   * \brief Returns the largest value that maps to the given bucket
+   */
+  static uint64_t getBucketUpperBound(uint32_t index);
+
+private:
+  Histogram(const Histogram&);
+  Histogram& operator=(const Histogram&);
+
+  std::atomic<uint64_t> sum_;
+  std::atomic<uint64_t> max_;
+  std::atomic<uint64_t> buckets_[NUM_BUCKETS];
+};
+typedef boost::shared_ptr<Histogram> HistogramPtr;
+
+/**
+ * \brief Snapshot of the histograms of a single publisher or subscriber link
+ */
+struct ConnectionHistograms
+{
+  std::string topic_;
+  int connection_id_;
+  /// "o" for links to our subscribers, "i" for links to our publishers, as in getBusInfo
+  std::string direction_;
+  /// Caller id of the node at the other end of the link
+  std::string remote_caller_id_;
+  /// Publishers: time messages are queued before being written.  Subscribers: time messages wait for their callback.
+  /// Both in nanoseconds.
+  Histogram::Snapshot latency_;
+  /// Serialized message size, in bytes
+  Histogram::Snapshot size_;
+};
+typedef std::vector<ConnectionHistograms> V_ConnectionHistograms;
+
+}
+
+#endif // ROSCPP_HISTOGRAM_H
@@ -108,6 +108,9 @@
 	#define ROS_SOCKETS_ASYNCHRONOUS_CONNECT_RETURN EINPROGRESS
 #endif
 
+/* Upper bound on the number of events reported by one wait_for_socket_events() call */
+#define ROS_MAX_SOCKET_EVENTS 256
+
 /*****************************************************************************
 ** Namespaces
 *****************************************************************************/
@@ -156,7 +159,8 @@ ROSCPP_DECL int create_socket_watcher();
 ROSCPP_DECL void close_socket_watcher(int fd);
 ROSCPP_DECL void add_socket_to_watcher(int epfd, int fd);
 ROSCPP_DECL void del_socket_from_watcher(int epfd, int fd);
-ROSCPP_DECL void set_events_on_socket(int epfd, int fd, int events);
+ROSCPP_DECL void set_events_on_socket(int epfd, int fd, int events, bool edge_triggered = false);
+ROSCPP_DECL int wait_for_socket_events(int epfd, socket_pollfd *events, int max_events, int timeout);
 
 /*****************************************************************************
 ** Inlines - almost direct api replacements, should stay fast.
@@ -164,23 +168,27 @@ ROSCPP_DECL void set_events_on_socket(int epfd, int fd, int events);
 
 /**
  * Closes the signal pair - on windows we're using sockets (because windows
- * select() function cant handle pipes). On linux, we're just using the pipes.
+ * select() function cant handle pipes). On linux, we're using an eventfd (both
+ * ends are the same descriptor) or the pipes.
  * @param signal_pair : the signal pair type.
  */
 inline void close_signal_pair(signal_fd_t signal_pair[2]) {
 #ifdef WIN32 // use a socket pair
 	::closesocket(signal_pair[0]);
 	::closesocket(signal_pair[1]);
-#else // use a socket pair on mingw or pipe pair on linux, either way, close works
+#else // use a socket pair on mingw, eventfd or pipe pair on linux, either way, close works
 	::close(signal_pair[0]);
-	::close(signal_pair[1]);
+	if (signal_pair[1] != signal_pair[0]) {
+		::close(signal_pair[1]);
+	}
 #endif
 }
 
 /**
  * Write to a signal_fd_t device. On windows we're using sockets (because windows
  * select() function cant handle pipes) so we have to use socket functions.
- * On linux, we're just using the pipes.
+ * On linux, we're just using the eventfd or pipes.  An eventfd only accepts
+ * 8 byte writes, so always signal with a uint64_t.
  */
 #ifdef _MSC_VER
 	inline int write_signal(const signal_fd_t &signal, const char *buffer, const unsigned int &nbyte) {
@@ -197,7 +205,8 @@ inline void close_signal_pair(signal_fd_t signal_pair[2]) {
 /**
  * Read from a signal_fd_t device. On windows we're using sockets (because windows
  * select() function cant handle pipes) so we have to use socket functions.
- * On linux, we're just using the pipes.
+ * On linux, we're just using the eventfd or pipes.  Reads from an eventfd must
+ * be 8 bytes long.
  */
 #ifdef _MSC_VER
 	inline int read_signal(const signal_fd_t &signal, char *buffer, const unsigned int &nbyte) {
@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2009, Willow Garage, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the names of Willow Garage, Inc. nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef ROSCPP_LOCK_FREE_SUBSCRIPTION_QUEUE_H
+#define ROSCPP_LOCK_FREE_SUBSCRIPTION_QUEUE_H
+
+#include "subscription_queue.h"
+
+#include <boost/scoped_array.hpp>
+
+#include <atomic>
+#include <thread>
+
+namespace ros
+{
+
+/**
+ * \brief SubscriptionQueue backed by a bounded lock-free ring (multiple producers, multiple consumers).
+ *
+ * Keeps the drop-oldest behaviour of SubscriptionQueue: when the ring is full, push() discards the oldest message to
+ * make room.  Non-concurrent callbacks are serialized with an atomic owner instead of a mutex.  The ring needs a
+ * bound, so a queue_size of 0 (infinite) is not supported; Subscription falls back to SubscriptionQueue for it.
+ */
+class ROSCPP_DECL LockFreeSubscriptionQueue : public SubscriptionQueue
+{
+public:
+  LockFreeSubscriptionQueue(const std::string& topic, int32_t queue_size, bool allow_concurrent_callbacks);
+  virtual ~LockFreeSubscriptionQueue();
+
+  virtual void push(const SubscriptionCallbackHelperPtr& helper, const MessageDeserializerPtr& deserializer,
+                    bool has_tracked_object, const VoidConstWPtr& tracked_object, bool nonconst_need_copy,
+                    ros::Time receipt_time = ros::Time(), bool* was_full = 0,
+                    const HistogramPtr& latency_histogram = HistogramPtr());
+  /**
+   * \brief Discard all queued messages.  Like SubscriptionQueue::clear(), waits for a (non-concurrent) callback
+   * running in another thread to finish.
+   */
+  virtual void clear();
+
+  virtual CallbackInterface::CallResult call();
+  virtual bool full();
+
+private:
+  struct Cell
+  {
+    std::atomic<uint64_t> sequence;
+    Item item;
+  };
+
+  bool tryPush(const Item& item);
+  bool tryPop(Item& item);
+
+  uint32_t capacity_;
+  boost::scoped_array<Cell> cells_;
+
+  alignas(64) std::atomic<uint64_t> enqueue_pos_;
+  alignas(64) std::atomic<uint64_t> dequeue_pos_;
+
+  std::atomic<bool> full_;
+
+  /// Thread currently running a callback, when callbacks are not allowed to run concurrently
+  std::atomic<std::thread::id> calling_thread_;
+  /// Depth of recursive calls from calling_thread_.  Only touched by that thread.
+  uint32_t call_depth_;
+};
+
+}
+
+#endif // ROSCPP_LOCK_FREE_SUBSCRIPTION_QUEUE_H
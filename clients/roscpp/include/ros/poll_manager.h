@@ -36,6 +36,9 @@
 
 #include <boost/thread/recursive_mutex.hpp>
 #include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <vector>
 
 namespace ros
 {
@@ -53,7 +56,24 @@ public:
   PollManager();
   ~PollManager();
 
+  /**
+   * \brief Returns the primary poll set.  Poll thread listeners are always called from the thread servicing it.
+   */
   PollSet& getPollSet() { return poll_set_; }
+  /**
+   * \brief Returns the poll set with the given index, where index 0 is the primary poll set
+   */
+  PollSet& getPollSet(uint32_t index);
+  /**
+   * \brief Returns the number of poll sets (and therefore poll threads) in use
+   */
+  uint32_t getNumPollSets();
+
+  /**
+   * \brief Set the number of poll threads to run, each servicing its own PollSet.  Only takes effect if called
+   * before start().  Defaults to 1, which keeps all socket I/O on a single thread.
+   */
+  void setNumThreads(uint32_t num_threads);
 
   boost::signals2::connection addPollThreadListener(const VoidFunc& func);
   void removePollThreadListener(boost::signals2::connection c);
@@ -62,6 +82,7 @@ public:
   void shutdown();
 private:
   void threadFunc();
+  void shardThreadFunc(PollSet* poll_set);
 
   PollSet poll_set_;
   volatile bool shutting_down_;
@@ -70,6 +91,12 @@ private:
   boost::recursive_mutex signal_mutex_;
 
   boost::thread thread_;
+
+  uint32_t num_threads_;
+  /// Additional poll sets, each serviced by one of shard_threads_.  Never shrinks, so references stay valid.
+  std::vector<boost::shared_ptr<PollSet> > shards_;
+  boost::mutex shards_mutex_;
+  std::vector<boost::shared_ptr<boost::thread> > shard_threads_;
 };
 
 }
@@ -35,6 +35,7 @@
 #ifndef ROSCPP_POLL_SET_H
 #define ROSCPP_POLL_SET_H
 
+#include <atomic>
 #include <vector>
 #include "io.h"
 #include "common.h"
@@ -116,12 +117,22 @@ public:
    */
   void signal();
 
+  /**
+   * \brief Returns the number of sockets currently in this set (including its internal signal pipe)
+   */
+  size_t getNumSockets();
+
 private:
   /**
    * \brief Creates the native pollset for our sockets, if any have changed
    */
   void createNativePollset();
 
+  /**
+   * \brief Calls the update functions of the sockets that have events
+   */
+  void dispatchEvents(const socket_pollfd* fds, size_t count);
+
   /**
    * \brief Called when events have been triggered on our signal pipe
    */
@@ -144,8 +155,11 @@ private:
   V_int just_deleted_;
 
   std::vector<socket_pollfd> ufds_;
+  /// Reused buffer receiving the ready events from the socket watcher (epoll only)
+  std::vector<socket_pollfd> events_;
 
-  boost::mutex signal_mutex_;
+  /// Set while a signal has been written that onLocalPipeEvents() has not consumed yet, so signal() never needs more than one
+  std::atomic<bool> signal_pending_;
   signal_fd_t signal_pipe_[2];
 
   int epfd_;
@@ -0,0 +1,107 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2009, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage, Inc. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef ROSCPP_PREALLOCATED_CALLBACK_QUEUE_H
+#define ROSCPP_PREALLOCATED_CALLBACK_QUEUE_H
+
+#include "ros/callback_queue.h"
+
+#include <boost/circular_buffer.hpp>
+
+namespace ros
+{
+
+/**
+ * \brief CallbackQueue that keeps its callbacks in slots allocated up front, for real-time threads (see RTSpinner).
+ *
+ * Once every removal id in use has been seen, adding, popping and calling callbacks does not touch the heap, as long
+ * as no more than capacity callbacks are queued at once.  If that happens the queue grows, which allocates, and a
+ * warning is printed.  The callback objects themselves are still allocated by whoever adds them (e.g. one per timer
+ * expiry or incoming message), and freed when the last reference to them goes away.
+ *
+ * Callbacks are called in the order they were added, and removal semantics are the same as for CallbackQueue.
+ */
+class ROSCPP_DECL PreallocatedCallbackQueue : public CallbackQueue
+{
+public:
+  /**
+   * \param capacity Number of callback slots to allocate
+   */
+  PreallocatedCallbackQueue(uint32_t capacity = 1024, bool enabled = true);
+  virtual ~PreallocatedCallbackQueue();
+
+  virtual void addCallback(const CallbackInterfacePtr& callback, uint64_t removal_id = 0);
+
+  using CallbackQueue::callOne;
+  using CallbackQueue::callAvailable;
+  virtual CallOneResult callOne(ros::WallDuration timeout);
+  virtual void callAvailable(ros::WallDuration timeout);
+
+  virtual bool isEmpty();
+  virtual void clear();
+
+  /**
+   * \brief Returns the number of callback slots
+   */
+  uint32_t getCapacity();
+
+protected:
+  virtual void requeueCallback(const CallbackInfo& info);
+  virtual void eraseQueuedCallbacks(uint64_t removal_id);
+
+private:
+  /**
+   * \brief Add a callback to the slots, growing them if they're all in use.  Requires a lock on mutex_.
+   */
+  void push(const CallbackInfo& info);
+  /**
+   * \brief Erase a callback from the slots, leaving it pointing at the next one.  Requires a lock on mutex_.
+   */
+  void erase(boost::circular_buffer<CallbackInfo>::iterator& it);
+  /**
+   * \brief Pop the oldest callback that is ready to be called.  Requires a lock on mutex_.
+   */
+  bool popReady(CallbackInfo& info);
+  /**
+   * \brief Call a callback popped off the queue.  The caller must have counted it in calling_.
+   */
+  CallOneResult call(const CallbackInfo& info);
+
+  boost::circular_buffer<CallbackInfo> slots_;
+};
+typedef boost::shared_ptr<PreallocatedCallbackQueue> PreallocatedCallbackQueuePtr;
+
+}
+
+#endif
@@ -0,0 +1,100 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2009, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage, Inc. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef ROSCPP_PRIORITY_CALLBACK_QUEUE_H
+#define ROSCPP_PRIORITY_CALLBACK_QUEUE_H
+
+#include "ros/callback_queue.h"
+
+#include <set>
+
+namespace ros
+{
+
+/**
+ * \brief CallbackQueue that calls the most urgent callback first rather than the oldest one.
+ *
+ * Callbacks are ordered by CallbackInterface::getPriority() (highest first), then by deadline (earliest first,
+ * callbacks without a deadline after those with one), then in the order they were added.  The deadline is
+ * CallbackInterface::getDeadline() counted from when the callback was added.  A callback that returns TryAgain keeps
+ * its priority and deadline but goes behind the others that share them, as it would go to the back of a CallbackQueue.
+ *
+ * callAvailable() calls as many callbacks as were queued when it started, but picks each one as it goes, so an urgent
+ * callback added part way through still gets called ahead of the rest.  Removal semantics are the same as for
+ * CallbackQueue.
+ */
+class ROSCPP_DECL PriorityCallbackQueue : public CallbackQueue
+{
+public:
+  PriorityCallbackQueue(bool enabled = true);
+  virtual ~PriorityCallbackQueue();
+
+  virtual void addCallback(const CallbackInterfacePtr& callback, uint64_t removal_id = 0);
+
+  using CallbackQueue::callOne;
+  using CallbackQueue::callAvailable;
+  virtual CallOneResult callOne(ros::WallDuration timeout);
+  virtual void callAvailable(ros::WallDuration timeout);
+
+  virtual bool isEmpty();
+  virtual void clear();
+
+protected:
+  virtual void requeueCallback(const CallbackInfo& info);
+  virtual void eraseQueuedCallbacks(uint64_t removal_id);
+
+private:
+  struct CallbackInfoLess
+  {
+    bool operator()(const CallbackInfo& lhs, const CallbackInfo& rhs) const;
+  };
+  typedef std::set<CallbackInfo, CallbackInfoLess> S_CallbackInfo;
+
+  /**
+   * \brief Pop the most urgent callback that is ready to be called.  Requires a lock on mutex_.
+   */
+  bool popReady(CallbackInfo& info);
+  /**
+   * \brief Call a callback popped off the queue.  The caller must have counted it in calling_.
+   */
+  CallOneResult call(const CallbackInfo& info);
+
+  S_CallbackInfo queue_;
+  uint64_t next_sequence_;
+};
+typedef boost::shared_ptr<PriorityCallbackQueue> PriorityCallbackQueuePtr;
+
+}
+
+#endif
@@ -31,6 +31,7 @@
 #include "ros/forwards.h"
 #include "ros/advertise_options.h"
 #include "common.h"
+#include "ros/histogram.h"
 #include "xmlrpcpp/XmlRpc.h"
 
 #include <boost/thread/mutex.hpp>
@@ -83,6 +84,10 @@ public:
    */
   //获取累计状态
   XmlRpc::XmlRpcValue getStats();
+  /**
+   * \brief Append a snapshot of the latency and size histograms of each of our subscriber links
+   */
+  void getHistograms(V_ConnectionHistograms& histograms);
   /**
    * \brief Get the accumulated info for this publication
    */
@@ -155,7 +160,18 @@ public:
 
   bool isLatching() { return latch_; }
 
-  void publish(SerializedMessage& m);
+  /**
+   * \brief Hands \a m to intraprocess no-copy subscribers, and queues it for everyone else.  The queue is served by
+   * processPublishQueue() on the poll thread.
+   *
+   * If \a serfunc is given, \a m is not serialized yet; serfunc is called once from processPublishQueue() instead of
+   * on the publishing thread.  \a message must keep whatever serfunc refers to alive, and must not be modified
+   * after publishing (the same contract as publishing a shared_ptr).
+   *
+   * \return true if the publish queue was empty before, so the poll set needs a signal to get it processed
+   */
+  bool publish(SerializedMessage& m, const boost::function<SerializedMessage(void)>& serfunc = boost::function<SerializedMessage(void)>(),
+               const VoidConstPtr& message = VoidConstPtr());
   void processPublishQueue();
   //验证header
   bool validateHeader(const Header& h, std::string& error_msg);
@@ -196,9 +212,17 @@ private:
 
   uint32_t intraprocess_subscriber_count_;
 
-  typedef std::vector<SerializedMessage> V_SerializedMessage;
+  struct QueuedMessage
+  {
+    SerializedMessage m;
+    /// Set if m still needs to be serialized
+    boost::function<SerializedMessage(void)> serfunc;
+    /// Keeps the message serfunc refers to alive until then
+    VoidConstPtr message;
+  };
+  typedef std::vector<QueuedMessage> V_QueuedMessage;
   //存储了要发送的message
-  V_SerializedMessage publish_queue_;
+  V_QueuedMessage publish_queue_;
   boost::mutex publish_queue_mutex_;
 };
 
@@ -31,6 +31,7 @@
 #include "ros/common.h"
 #include "ros/transport_hints.h"
 #include "ros/header.h"
+#include "ros/histogram.h"
 #include "common.h"
 #include <boost/thread/mutex.hpp>
 #include <boost/shared_array.hpp>
@@ -69,6 +70,20 @@ public:
   virtual ~PublisherLink();
 
   const Stats &getStats() { return stats_; }
+  /**
+   * \brief Histogram of the time, in nanoseconds, messages received on this link wait in subscription queues before
+   * their callbacks are invoked
+   */
+  const HistogramPtr& getLatencyHistogram() { return latency_histogram_; }
+  /**
+   * \brief Histogram of the serialized size, in bytes, of the messages received on this link
+   */
+  const HistogramPtr& getSizeHistogram() { return size_histogram_; }
+  /**
+   * \brief Topic statistics (/enable_statistics) for this link, created on the first message if enabled
+   */
+  const LinkStatisticsPtr& getTopicStatistics() { return topic_statistics_; }
+  void setTopicStatistics(const LinkStatisticsPtr& stats) { topic_statistics_ = stats; }
   const std::string& getPublisherXMLRPCURI();
   int getConnectionID() const { return connection_id_; }
   const std::string& getCallerID() { return caller_id_; }
@@ -92,6 +107,9 @@ protected:
   std::string publisher_xmlrpc_uri_;
 
   Stats stats_;
+  HistogramPtr latency_histogram_;
+  HistogramPtr size_histogram_;
+  LinkStatisticsPtr topic_statistics_;
 
   TransportHints transport_hints_;
 
@@ -116,6 +116,8 @@ ROSCPP_DECL bool waitForService(const std::string& service_name, ros::Duration t
  * \param print_failure_reason Whether to print the reason for failure to the console (service not advertised vs.
  * could not connect to the advertised host)
  * \return true if the service is up and available, false otherwise
+ * \note The service's address may come from ServiceManager's lookup cache, so a service that was recently unadvertised
+ * by a node that is still running can be reported as available for a few seconds
  */
 ROSCPP_DECL bool exists(const std::string& service_name, bool print_failure_reason);
 
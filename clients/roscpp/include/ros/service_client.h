@@ -32,6 +32,12 @@
 #include "ros/common.h"
 #include "ros/service_traits.h"
 #include "ros/serialization.h"
+#include "ros/service_client_options.h"
+
+#include <boost/function.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/thread/future.hpp>
+#include <boost/thread/mutex.hpp>
 
 namespace ros
 {
@@ -42,14 +48,22 @@ namespace ros
 class ROSCPP_DECL ServiceClient
 {
 public:
+  /**
+   * \brief Completion function for the serialized form of callAsync()
+   */
+  typedef boost::function<void(bool, const SerializedMessage&)> SerializedCallFinishedFn;
+
   ServiceClient() {}
   ServiceClient(const std::string& service_name, bool persistent, const M_string& header_values, const std::string& service_md5sum);
+  explicit ServiceClient(const ServiceClientOptions& ops);
   ServiceClient(const ServiceClient& rhs);
   ~ServiceClient();
 
   /**
    * @brief Call the service aliased by this handle with the specified request/response messages.
    * @note The request/response message types must match the types specified in the templated call to NodeHandle::serviceClient()/service::createClient()
+   * @note If the server goes away before answering the connection's header, eg. because the cached address of a
+   * restarted server is stale, the call is made once more with the address looked up again from the master
    */
   template<class MReq, class MRes>
   bool call(MReq& req, MRes& res)
@@ -120,6 +134,73 @@ public:
 
   bool call(const SerializedMessage& req, SerializedMessage& resp, const std::string& service_md5sum);
 
+  /**
+   * @brief Call the service aliased by this handle without blocking for the response.
+   *
+   * Any number of calls may be in flight at once.  The returned future becomes ready with the result of the call once
+   * it has finished; \a res is filled in before then and must stay alive until it is.  On a persistent handle calls
+   * are answered in order over the one connection, otherwise each call gets its own connection.
+   * @note Looking up and connecting to the service still happens in the calling thread.  Unlike call(), a call whose
+   * server went away before answering the connection's header is not retried; it fails, and the next call looks the
+   * service up again.
+   */
+  template<class MReq, class MRes>
+  boost::shared_future<bool> callAsync(const MReq& req, MRes& res)
+  {
+    namespace st = service_traits;
+
+    boost::shared_ptr<boost::promise<bool> > promise(boost::make_shared<boost::promise<bool> >());
+    boost::shared_future<bool> future(promise->get_future());
+
+    if (strcmp(st::md5sum(req), st::md5sum(res)))
+    {
+      ROS_ERROR("The request and response parameters to the service "
+                 "call must be autogenerated from the same "
+                 "server definition file (.srv). your service call "
+                 "for %s appeared to use request/response types "
+                 "from different .srv files. (%s vs. %s)", getService().c_str(), st::md5sum(req), st::md5sum(res));
+      promise->set_value(false);
+      return future;
+    }
+
+    callAsync(serialization::serializeMessage(req), st::md5sum(req), boost::bind(&ServiceClient::finishFuture<MRes>, _1, _2, &res, promise));
+    return future;
+  }
+
+  /**
+   * @brief Call the service aliased by this handle with the specified service request/response, without blocking.
+   * \a service must stay alive until the returned future is ready.
+   */
+  template<class Service>
+  boost::shared_future<bool> callAsync(Service& service)
+  {
+    return callAsync(service.request, service.response);
+  }
+
+  /**
+   * @brief Call the service aliased by this handle without blocking, passing the result to \a callback.
+   *
+   * \a callback is called exactly once, with whether the call succeeded and the response, from \a callback_queue
+   * (the global callback queue if 0) so that it runs in the same threads as the node's other callbacks.
+   */
+  template<class Service>
+  void callAsync(const typename Service::Request& req, const boost::function<void(bool, const typename Service::Response&)>& callback,
+                 CallbackQueueInterface* callback_queue = 0)
+  {
+    namespace st = service_traits;
+    callAsync(serialization::serializeMessage(req), st::md5sum<Service>(), boost::bind(&ServiceClient::finishCallback<Service>, _1, _2, callback),
+              getCallbackQueue(callback_queue));
+  }
+
+  /**
+   * \brief Mostly for internal use, the templated versions of callAsync() call into this one.
+   *
+   * \a callback is called exactly once.  If \a callback_queue is 0 it is called directly from the thread that
+   * finishes the call (usually the poll thread, or this one if the call fails straight away), so it must not block.
+   */
+  void callAsync(const SerializedMessage& req, const std::string& service_md5sum, const SerializedCallFinishedFn& callback,
+                 CallbackQueueInterface* callback_queue = 0);
+
   /**
    * \brief Returns whether or not this handle is valid.  For a persistent service, this becomes false when the connection has dropped.
    * Non-persistent service handles are always valid.
@@ -180,11 +261,55 @@ private:
   // This works around a problem with the OSX linker that causes the static variable declared by
   // ROS_ERROR to error with missing symbols when it's used directly in the templated call() method above
   // This for some reason only showed up in the rxtools package
-  void deserializeFailed(const std::exception& e)
+  static void deserializeFailed(const std::exception& e)
   {
     ROS_ERROR("Exception thrown while while deserializing service call: %s", e.what());
   }
 
+  template<typename MRes>
+  static void finishFuture(bool success, const SerializedMessage& ser_resp, MRes* resp, const boost::shared_ptr<boost::promise<bool> >& promise)
+  {
+    if (success)
+    {
+      try
+      {
+        serialization::deserializeMessage(ser_resp, *resp);
+      }
+      catch (std::exception& e)
+      {
+        deserializeFailed(e);
+        success = false;
+      }
+    }
+
+    promise->set_value(success);
+  }
+
+  template<class Service>
+  static void finishCallback(bool success, const SerializedMessage& ser_resp, const boost::function<void(bool, const typename Service::Response&)>& callback)
+  {
+    typename Service::Response resp;
+    if (success)
+    {
+      try
+      {
+        serialization::deserializeMessage(ser_resp, resp);
+      }
+      catch (std::exception& e)
+      {
+        deserializeFailed(e);
+        success = false;
+      }
+    }
+
+    callback(success, resp);
+  }
+
+  /**
+   * \brief Returns \a queue, or the global callback queue if it is 0
+   */
+  static CallbackQueueInterface* getCallbackQueue(CallbackQueueInterface* queue);
+
   struct Impl
   {
     Impl();
@@ -193,9 +318,23 @@ private:
     void shutdown();
     bool isValid() const;
 
+    /**
+     * \brief Returns the link to make a call on: the persistent link (created if needed), a link borrowed from the
+     * pool, or a new non-persistent link.  Empty if the service could not be connected to.
+     */
+    ServiceServerLinkPtr acquireLink(const std::string& service_md5sum);
+    /**
+     * \brief Forgets the persistent link if it is still \a link, so the next acquireLink() reconnects
+     */
+    void resetLink(const ServiceServerLinkPtr& link);
+
     ServiceServerLinkPtr server_link_;
+    /// Guards server_link_, which calls from several threads may share, replace or reset
+    mutable boost::mutex server_link_mutex_;
     std::string name_;
     bool persistent_;
+    bool pooled_;
+    uint32_t pipeline_depth_;
     M_string header_values_;
     std::string service_md5sum_;
     bool is_shutdown_;
@@ -203,6 +342,8 @@ private:
   typedef boost::shared_ptr<Impl> ImplPtr;
   typedef boost::weak_ptr<Impl> ImplWPtr;
 
+  void init(const ServiceClientOptions& ops);
+
   ImplPtr impl_;
 
   friend class NodeHandle;
@@ -36,6 +36,7 @@
 #include <boost/signals2/connection.hpp>
 
 #include <queue>
+#include <map>
 
 namespace ros
 {
@@ -60,11 +61,13 @@ public:
   bool handleHeader(const Header& header);
 
   /**
-   * \brief Writes a response to the current request.
+   * \brief Writes a response to a request.  Responses are written in the order their requests were read, so one that
+   * finishes early waits for the ones before it.
    * \param ok Whether the callback was successful or not
    * \param resp The message response.  ServiceClientLink will delete this
+   * \param seq The sequence number the request was handed to ServicePublication::processRequest() with
    */
-  void processResponse(bool ok, const SerializedMessage& res);
+  void processResponse(bool ok, const SerializedMessage& res, uint32_t seq);
 
   const ConnectionPtr& getConnection() { return connection_; }
 
@@ -75,11 +78,27 @@ private:
   void onRequestLength(const ConnectionPtr& conn, const boost::shared_array<uint8_t>& buffer, uint32_t size, bool success);
   void onRequest(const ConnectionPtr& conn, const boost::shared_array<uint8_t>& buffer, uint32_t size, bool success);
   void onResponseWritten(const ConnectionPtr& conn);
+  /**
+   * \brief Writes the next response if it is ready and nothing else is being written, then reads the next request
+   * if fewer than max_outstanding_ are being handled
+   */
+  void processNextResponse();
 
   ConnectionPtr connection_;
   ServicePublicationWPtr parent_;
   bool persistent_;
   boost::signals2::connection dropped_conn_;
+
+  /// How many requests may be read before earlier ones have been answered.  1 unless the service allows concurrent calls
+  uint32_t max_outstanding_;
+  uint32_t outstanding_;
+  uint32_t next_request_seq_;
+  uint32_t next_response_seq_;
+  /// Responses that are ready but waiting for earlier ones to be written, by sequence number
+  std::map<uint32_t, SerializedMessage> ready_responses_;
+  bool reading_;
+  bool writing_;
+  boost::mutex responses_mutex_;
 };
 typedef boost::shared_ptr<ServiceClientLink> ServiceClientLinkPtr;
 
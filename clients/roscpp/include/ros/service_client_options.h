@@ -42,6 +42,8 @@ struct ROSCPP_DECL ServiceClientOptions
 {
   ServiceClientOptions()
   : persistent(false)
+  , pooled(false)
+  , pipeline_depth(1)
   {
   }
 
@@ -57,6 +59,8 @@ struct ROSCPP_DECL ServiceClientOptions
   , md5sum(_md5sum)
   , persistent(_persistent)
   , header(_header)
+  , pooled(false)
+  , pipeline_depth(1)
   {
   }
 
@@ -101,6 +105,17 @@ struct ROSCPP_DECL ServiceClientOptions
   std::string md5sum;                                                       ///< Service md5sum
   bool persistent;                                                          ///< Whether or not the connection should persist
   M_string header;                                                          ///< Extra key/value pairs to add to the connection header
+  /**
+   * \brief For non-persistent clients, whether to borrow keep-alive connections from a per-service pool instead of
+   * connecting for every call.  Idle pooled connections are closed after a while.
+   */
+  bool pooled;
+  /**
+   * \brief For persistent clients, how many requests may be sent before their responses have arrived.  Values above 1
+   * let concurrent calls (from several threads, or ServiceClient::callAsync()) share the connection without waiting
+   * for each other's round trips.
+   */
+  uint32_t pipeline_depth;
 };
 
 
@@ -36,6 +36,8 @@
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/recursive_mutex.hpp>
 
+#include <ros/time.h>
+
 namespace ros
 {
 
@@ -51,6 +53,39 @@ typedef boost::shared_ptr<XMLRPCManager> XMLRPCManagerPtr;
 class ConnectionManager;
 typedef boost::shared_ptr<ConnectionManager> ConnectionManagerPtr;
 
+/**
+ * \brief A keep-alive connection to a service, kept around so that non-persistent service clients can reuse it
+ */
+class ROSCPP_DECL CachedServiceServerLink
+{
+public:
+  CachedServiceServerLink(const ServiceServerLinkPtr& link)
+  : in_use_(false)
+  , link_(link)
+  {
+  }
+
+  bool in_use_;
+  ros::SteadyTime last_use_time_; // for reaping
+  ServiceServerLinkPtr link_;
+
+  static const ros::WallDuration s_zombie_time_; // how long an idle link is kept before it is dropped
+  static const uint32_t s_max_idle_per_service_; // how many idle links are kept for any one service
+};
+
+/**
+ * \brief A service URI looked up from the master, kept so that repeated calls to the same service don't each
+ * query the master
+ */
+struct CachedServiceURI
+{
+  std::string host_;
+  uint32_t port_;
+  ros::SteadyTime expires_;
+
+  static const ros::WallDuration s_ttl_; // how long a looked up URI is trusted before asking the master again
+};
+
 class ROSCPP_DECL ServiceManager
 {
 public:
@@ -85,6 +120,22 @@ public:
                                                 const std::string& request_md5sum, const std::string& response_md5sum,
                                                 const M_string& header_values);
 
+  /** @brief Borrow a keep-alive connection to a service from the pool, creating one if none is idle.
+   *
+   * The returned link is persistent as far as the service is concerned, and must be handed back with
+   * releaseServiceServerLink() once the call on it has finished.  Idle links are dropped after
+   * CachedServiceServerLink::s_zombie_time_.
+   *
+   * @returns Shared pointer to the ServiceServerLink, empty shared pointer if the service could not be connected to.
+   */
+  ServiceServerLinkPtr acquireServiceServerLink(const std::string& service,
+                                                const std::string& request_md5sum, const std::string& response_md5sum,
+                                                const M_string& header_values);
+
+  /** @brief Hand a link borrowed with acquireServiceServerLink() back to the pool
+   */
+  void releaseServiceServerLink(const ServiceServerLinkPtr& link);
+
   /** @brief Remove the specified service client from our list
    *
    * @param client The client to remove
@@ -92,12 +143,22 @@ public:
   void removeServiceServerLink(const ServiceServerLinkPtr& client);
 
   /** @brief Lookup the host/port of a service.
+   *
+   * Successful lookups are cached for CachedServiceURI::s_ttl_, or until invalidateServiceURI() is called for the
+   * service, so the master is only asked again once the cached URI is stale or has stopped working.
    *
    * @param name The name of the service
    * @param serv_host OUT -- The host of the service
    * @param serv_port OUT -- The port of the service
+   * @param use_cache Whether a cached URI may be returned, rather than always asking the master
    */
-  bool lookupService(const std::string& name, std::string& serv_host, uint32_t& serv_port);
+  bool lookupService(const std::string& name, std::string& serv_host, uint32_t& serv_port, bool use_cache = true);
+
+  /** @brief Forget the cached URI of a service, eg. because connecting to it failed
+   *
+   * @param name The name of the service
+   */
+  void invalidateServiceURI(const std::string& name);
 
   /** @brief Unadvertise a service.
    *
@@ -122,6 +183,7 @@ public:
 private:
 
   bool isServiceAdvertised(const std::string& serv_name);
+  bool lookupCachedServiceURI(const std::string& name, std::string& serv_host, uint32_t& serv_port);
   bool unregisterService(const std::string& service);
 
   bool isShuttingDown() { return shutting_down_; }
@@ -132,6 +194,14 @@ private:
   L_ServiceServerLink service_server_links_;
   boost::mutex service_server_links_mutex_;
 
+  typedef std::map<std::string, CachedServiceURI> M_CachedServiceURI;
+  M_CachedServiceURI service_uris_;
+  boost::mutex service_uris_mutex_;
+
+  typedef std::list<CachedServiceServerLink> L_CachedServiceServerLink;
+  L_CachedServiceServerLink pooled_links_;
+  boost::mutex pooled_links_mutex_;
+
   volatile bool shutting_down_;
   boost::recursive_mutex shutting_down_mutex_;
 
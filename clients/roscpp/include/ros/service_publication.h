@@ -41,6 +41,7 @@
 
 #include <vector>
 #include <queue>
+#include <deque>
 
 namespace ros
 {
@@ -63,13 +64,19 @@ class ROSCPP_DECL ServicePublication : public boost::enable_shared_from_this<Ser
 public:
   ServicePublication(const std::string& name, const std::string &md5sum, const std::string& data_type, const std::string& request_data_type,
                 const std::string& response_data_type, const ServiceCallbackHelperPtr& helper, CallbackQueueInterface* queue,
-                const VoidConstPtr& tracked_object);
+                const VoidConstPtr& tracked_object, uint32_t max_concurrent_calls = 0, uint32_t max_backlog = 100,
+                int32_t priority = 0, const WallDuration& deadline = WallDuration());
   ~ServicePublication();
 
   /**
    * \brief Adds a request to the queue if our thread pool size is not 0, otherwise immediately calls the callback
    */
-  void processRequest(boost::shared_array<uint8_t> buf, size_t num_bytes, const ServiceClientLinkPtr& link);
+  void processRequest(boost::shared_array<uint8_t> buf, size_t num_bytes, const ServiceClientLinkPtr& link, uint32_t seq);
+
+  /**
+   * \brief Called when a request has been handled, to free its slot for the next backlogged request
+   */
+  void callFinished();
 
   /**
    * \brief Adds a service link for us to manage
@@ -94,6 +101,7 @@ public:
   const std::string& getResponseDataType() { return response_data_type_; }
   const std::string& getDataType() { return data_type_; }
   const std::string& getName() { return name_; }
+  uint32_t getMaxConcurrentCalls() { return max_concurrent_calls_; }
 
 private:
   void dropAllConnections();
@@ -113,6 +121,16 @@ private:
   CallbackQueueInterface* callback_queue_;
   bool has_tracked_object_;
   VoidConstWPtr tracked_object_;
+
+  uint32_t max_concurrent_calls_;
+  uint32_t max_backlog_;
+  int32_t priority_;
+  WallDuration deadline_;
+  /// Requests queued on callback_queue_ or being handled, only counted when max_concurrent_calls_ is set
+  uint32_t active_calls_;
+  /// Requests waiting for one of the max_concurrent_calls_ slots
+  std::deque<CallbackInterfacePtr> backlog_;
+  boost::mutex calls_mutex_;
 };
 typedef boost::shared_ptr<ServicePublication> ServicePublicationPtr;
 
@@ -41,8 +41,10 @@
 #include <boost/shared_array.hpp>
 #include <boost/enable_shared_from_this.hpp>
 #include <boost/thread.hpp>
+#include <boost/function.hpp>
 
 #include <queue>
+#include <deque>
 
 namespace ros
 {
@@ -57,12 +59,22 @@ typedef boost::shared_ptr<Connection> ConnectionPtr;
  */
 class ROSCPP_DECL ServiceServerLink : public boost::enable_shared_from_this<ServiceServerLink>
 {
+public:
+  /**
+   * \brief Completion function for callAsync(), called with whether the call succeeded and the serialized response
+   */
+  typedef boost::function<void(bool, const SerializedMessage&)> CallFinishedFn;
+
 private:
   struct CallInfo
   {
     SerializedMessage req_;
     SerializedMessage* resp_;
 
+    /// Only set for asynchronous calls, which own their response (resp_ points at async_resp_)
+    CallFinishedFn callback_;
+    SerializedMessage async_resp_;
+
     bool finished_;
     boost::condition_variable finished_condition_;
     boost::mutex finished_mutex_;
@@ -88,6 +100,11 @@ public:
    * \brief Returns whether this client is still valid, ie. its connection has not been dropped
    */
   bool isValid() const;
+  /**
+   * \brief Returns whether the connection dropped before the service server's header arrived, eg. because the server
+   * is gone.  Requests are only written after that header, so a call that failed this way can be made again elsewhere.
+   */
+  bool droppedBeforeHeader() const { return dropped_ && !header_received_; }
   /**
    * \brief Returns whether this is a persistent connection
    */
@@ -98,6 +115,16 @@ public:
   const std::string& getServiceName() const { return service_name_; }
   const std::string& getRequestMD5Sum() const { return request_md5sum_; }
   const std::string& getResponseMD5Sum() const { return response_md5sum_; }
+  const M_string& getHeaderValues() const { return extra_outgoing_header_values_; }
+
+  /**
+   * \brief Sets how many requests may be written before their responses have been read.  Defaults to 1, ie. the
+   * next request is only sent once the previous response has arrived.
+   *
+   * Responses come back in request order, so deeper pipelines only help persistent links with several calls queued.
+   */
+  void setPipelineDepth(uint32_t depth);
+  uint32_t getPipelineDepth() const { return pipeline_depth_; }
 
   /**
    * \brief Blocking call the service this client is connected to
@@ -107,18 +134,27 @@ public:
    */
   bool call(const SerializedMessage& req, SerializedMessage& resp);
 
+  /**
+   * \brief Non-blocking call to the service this client is connected to
+   *
+   * The call is queued behind any others on this link and \a callback is invoked exactly once when it has finished,
+   * failed, or been cancelled because the connection dropped.  It is called from whichever thread finishes the call,
+   * usually the poll thread, and so must not block.
+   */
+  void callAsync(const SerializedMessage& req, const CallFinishedFn& callback);
+
 private:
   void onConnectionDropped(const ConnectionPtr& conn);
   bool onHeaderReceived(const ConnectionPtr& conn, const Header& header);
 
   /**
-   * \brief Called when the currently queued call has finished.  Clears out the current call, notifying it that it
-   * has finished, then calls processNextCall()
+   * \brief Called when the oldest in-flight call has finished.  Removes it, notifying it that it has finished, starts
+   * reading the next response if more calls are in flight, then calls processNextCall()
    */
   void callFinished();
   /**
-   * \brief Pops the next call off the queue if one is available.  If this is a non-persistent connection and the queue is empty
-   * it will also drop the connection.
+   * \brief Pops the next call off the queue and writes its request, if one is available and the pipeline has room.  If this
+   * is a non-persistent connection and there are no calls left at all it will also drop the connection.
    */
   void processNextCall();
   /**
@@ -129,6 +165,14 @@ private:
    * \brief Cancel a queued call, notifying it that it has failed
    */
   void cancelCall(const CallInfoPtr& info);
+  /**
+   * \brief Queues a call, processing it immediately if the link is idle.  Returns false if the connection has already dropped
+   */
+  bool enqueueCall(const CallInfoPtr& info);
+  /**
+   * \brief Invokes an asynchronous call's completion function, if it has not been invoked already
+   */
+  void finishAsyncCall(const CallInfoPtr& info, bool success);
 
   void onHeaderWritten(const ConnectionPtr& conn);
   void onRequestWritten(const ConnectionPtr& conn);
@@ -143,12 +187,18 @@ private:
 
   M_string extra_outgoing_header_values_;
   bool header_written_;
+  /// The server's header has arrived, though the calls queued before it may not have been started yet
+  bool header_received_;
   bool header_read_;
 
   Q_CallInfo call_queue_;
   boost::mutex call_queue_mutex_;
 
-  CallInfoPtr current_call_;
+  /// Calls whose requests have been or are being written, oldest first.  Their responses arrive in this order.
+  std::deque<CallInfoPtr> in_flight_;
+  uint32_t pipeline_depth_;
+  bool writing_;
+  bool reading_;
 
   bool dropped_;
 };
@@ -0,0 +1,130 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2009, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage, Inc. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef ROSCPP_SHARDED_CALLBACK_QUEUE_H
+#define ROSCPP_SHARDED_CALLBACK_QUEUE_H
+
+#include "ros/callback_queue.h"
+
+#include <boost/scoped_array.hpp>
+
+#include <atomic>
+
+namespace ros
+{
+
+/**
+ * \brief CallbackQueue that spreads its callbacks over several independently locked shards.
+ *
+ * Callbacks are sharded by removal id, so everything belonging to one subscription/timer/service lives in the same
+ * shard and removeByID() only touches that shard.  Each thread calling callOne() gets a home shard and steals from the
+ * others when its own is empty, and addCallback() wakes a single waiting thread rather than all of them.  Meant for
+ * queues drained by many spinner threads (e.g. MultiThreadedSpinner), where the single mutex of CallbackQueue is
+ * heavily contended.
+ *
+ * Ordering is only preserved between callbacks that share a removal id.  Removal semantics are the same as for
+ * CallbackQueue: removeByID() waits for in-progress calls for that id to finish.
+ */
+class ROSCPP_DECL ShardedCallbackQueue : public CallbackQueue
+{
+public:
+  /**
+   * \param shard_count Number of shards.  0 uses one per hardware thread.
+   */
+  ShardedCallbackQueue(uint32_t shard_count = 0, bool enabled = true);
+  virtual ~ShardedCallbackQueue();
+
+  virtual void addCallback(const CallbackInterfacePtr& callback, uint64_t removal_id = 0);
+
+  using CallbackQueue::callOne;
+  using CallbackQueue::callAvailable;
+  virtual CallOneResult callOne(ros::WallDuration timeout);
+  /**
+   * \brief Invoke all callbacks currently in the queue, starting with this thread's home shard.
+   */
+  virtual void callAvailable(ros::WallDuration timeout);
+
+  virtual bool isEmpty();
+  virtual void clear();
+
+  virtual void enable();
+  virtual void disable();
+  virtual bool isEnabled();
+
+  uint32_t getShardCount() const { return shard_count_; }
+
+protected:
+  virtual void requeueCallback(const CallbackInfo& info);
+  virtual void eraseQueuedCallbacks(uint64_t removal_id);
+
+private:
+  struct Shard
+  {
+    Shard()
+    : size(0)
+    {}
+
+    boost::mutex mutex;
+    D_CallbackInfo callbacks;
+    /// callbacks.size(), readable without taking the mutex
+    std::atomic<size_t> size;
+  };
+
+  Shard& getShard(uint64_t removal_id);
+  uint32_t getHomeShard();
+  void push(const CallbackInfo& info);
+  bool popReady(CallbackInfo& info);
+  void waitForCallbacks(ros::WallDuration timeout);
+
+  uint32_t shard_count_;
+  boost::scoped_array<Shard> shards_;
+
+  /// Callbacks sitting in the shards
+  std::atomic<size_t> queued_;
+  /// Callbacks sitting in the shards or currently being called
+  std::atomic<size_t> pending_;
+  std::atomic<bool> is_enabled_;
+
+  boost::mutex wait_mutex_;
+  boost::condition_variable wait_condition_;
+  std::atomic<uint32_t> waiters_;
+
+  std::atomic<uint32_t> next_home_shard_;
+  boost::thread_specific_ptr<uint32_t> home_shard_;
+};
+typedef boost::shared_ptr<ShardedCallbackQueue> ShardedCallbackQueuePtr;
+
+}
+
+#endif
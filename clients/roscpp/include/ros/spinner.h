@@ -33,6 +33,8 @@
 
 #include <boost/shared_ptr.hpp>
 
+#include <vector>
+
 namespace ros
 {
 class NodeHandle;
@@ -130,6 +132,54 @@ private:
   AsyncSpinnerImplPtr impl_;
 };
 
+/**
+ * \brief Options for RTSpinner
+ */
+struct ROSCPP_DECL RTSpinnerOptions
+{
+  RTSpinnerOptions()
+  : thread_count(1)
+  , priority(0)
+  {}
+
+  /// Number of threads to use for calling callbacks
+  uint32_t thread_count;
+  /// CPUs to pin the threads to.  Thread i runs only on cpus[i % cpus.size()].  Empty (the default) doesn't pin them.
+  std::vector<int> cpus;
+  /// SCHED_FIFO priority for the threads.  0 (the default) leaves them with the normal scheduling policy.
+  int32_t priority;
+};
+
+/**
+ * \brief AsyncSpinner for real-time callback threads.
+ *
+ * Works like AsyncSpinner, but each thread is pinned to a CPU and/or run with SCHED_FIFO priority before it calls any
+ * callbacks.  Use it with a PreallocatedCallbackQueue so that taking callbacks off the queue and calling them doesn't
+ * allocate.  Setting SCHED_FIFO usually needs CAP_SYS_NICE or an rtprio limit; if the scheduling or CPU affinity can't
+ * be set, start() throws std::runtime_error and no threads are left running.
+ */
+class ROSCPP_DECL RTSpinner
+{
+public:
+  /**
+   * \param ops Thread placement and scheduling
+   * \param queue The callback queue to operate on.  A null value means to use the global queue
+   */
+  RTSpinner(const RTSpinnerOptions& ops, CallbackQueue* queue = 0);
+
+  /**
+   * \brief Start this spinner spinning asynchronously
+   */
+  void start();
+  /**
+   * \brief Stop this spinner from running
+   */
+  void stop();
+
+private:
+  AsyncSpinnerImplPtr impl_;
+};
+
 }
 
 #endif // ROSCPP_SPIN_POLICY_H
@@ -34,11 +34,76 @@
 #include "publisher.h"
 #include <ros/time.h>
 #include "ros/subscription_callback_helper.h"
-#include <map>
+#include "ros/callback_queue_interface.h"
+
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/thread/mutex.hpp>
 
 namespace ros
 {
 
+/**
+ * \brief Topic statistics for a single publisher link.
+ *
+ * Each incoming message is folded into running aggregates for the current window in constant time, without
+ * allocating.  When a window closes it is pushed into a small preallocated ring and this object is queued on the
+ * internal callback queue, where the rosgraph_msgs/TopicStatistics message is built and published.  The thread
+ * delivering messages therefore never builds or publishes statistics itself.
+ */
+class ROSCPP_DECL LinkStatistics : public CallbackInterface, public boost::enable_shared_from_this<LinkStatistics>
+{
+public:
+  LinkStatistics(const std::string& topic, const std::string& callerid, const boost::shared_ptr<Publisher>& pub);
+
+  /**
+   * \brief Account for one received message.  Returns true if this closed the current window, in which case
+   * window_delivered is set to the number of messages it contained.  Not thread-safe; the caller serializes calls.
+   *
+   * \param stamp Header stamp of the message, or zero if it has none
+   * \param window_length Length of the current window, in seconds
+   */
+  bool update(const ros::Time& received_time, const ros::Time& stamp, uint64_t bytes_received, bool dropped,
+              double window_length, uint64_t& window_delivered);
+
+  /**
+   * \brief Publish all closed windows
+   */
+  virtual CallResult call();
+
+private:
+  struct Window
+  {
+    Window();
+
+    ros::Time start;
+    ros::Time stop;
+    ros::Time last_arrival;
+    uint64_t delivered;
+    uint64_t dropped;
+    uint64_t traffic;
+
+    // Running mean, sum of squared deviations (Welford) and maximum, in seconds
+    uint64_t num_periods;
+    double period_mean, period_m2, period_max;
+    uint64_t num_ages;
+    double age_mean, age_m2, age_max;
+  };
+
+  static const uint32_t RING_SIZE = 8;
+
+  std::string topic_;
+  std::string callerid_;
+  boost::shared_ptr<Publisher> pub_;
+
+  Window current_;
+  uint64_t bytes_last_;
+
+  boost::mutex ring_mutex_;
+  Window ring_[RING_SIZE];
+  uint32_t ring_head_;
+  uint32_t ring_size_;
+};
+
 /**
  * \brief This class logs statistics data about a ROS connection and
  * publishs them periodically on a common topic.
@@ -61,9 +126,9 @@ public:
   void init(const SubscriptionCallbackHelperPtr& helper);
 
   /**
-   * Callback function. Must be called for every message received.
+   * Callback function. Must be called for every message received, with calls for the same subscription serialized.
    */
-  void callback(const boost::shared_ptr<M_string>& connection_header, const std::string& topic, const std::string& callerid, const SerializedMessage& m, const uint64_t& bytes_sent, const ros::Time& received_time, bool dropped);
+  void callback(const PublisherLinkPtr& link, const std::string& topic, const SerializedMessage& m, const uint64_t& bytes_sent, const ros::Time& received_time, bool dropped);
 
 private:
 
@@ -83,26 +148,8 @@ private:
   // frequency to publish statistics
   double pub_frequency_;
 
-  // publisher for statistics data
-  ros::Publisher pub_;
-
-  struct StatData {
-    // last time, we published /statistics data
-    ros::Time last_publish;
-    // arrival times of all messages within the current window
-    std::list<ros::Time> arrival_time_list;
-    // age of all messages within the current window (if available)
-    std::list<ros::Duration> age_list;
-    // number of dropped messages
-    uint64_t dropped_msgs;
-    // latest sequence number observered (if available)
-    uint64_t last_seq;
-    // latest total traffic volume observed
-    uint64_t stat_bytes_last;
-  };
-
-  // storage for statistics data
-  std::map<std::string, struct StatData> map_;
+  // publisher for statistics data, shared with (and only used by) our LinkStatistics
+  boost::shared_ptr<Publisher> pub_;
 };
 
 }
@@ -51,6 +51,8 @@ struct ROSCPP_DECL SubscribeOptions
   : queue_size(1)
   , callback_queue(0)
   , allow_concurrent_callbacks(false)
+  , lock_free_queue(false)
+  , priority(0)
   {
   }
 
@@ -70,6 +72,8 @@ struct ROSCPP_DECL SubscribeOptions
   , datatype(_datatype)
   , callback_queue(0)
   , allow_concurrent_callbacks(false)
+  , lock_free_queue(false)
+  , priority(0)
   {}
 
   /**
@@ -128,6 +132,17 @@ struct ROSCPP_DECL SubscribeOptions
   /// time.  Setting this to true allows you to receive multiple messages on the same topic from multiple threads at the same time
   bool allow_concurrent_callbacks;
 
+  /// Use a lock-free ring for the incoming message queue instead of the mutex-protected one.  Cuts contention when
+  /// messages are pushed from several poll threads while spinner threads drain them.  Ignored if queue_size is 0.
+  bool lock_free_queue;
+
+  /// Priority of this subscription's callbacks, for callback queues that order by it (e.g. PriorityCallbackQueue).
+  /// Higher is called first.
+  int32_t priority;
+  /// How soon after a message is queued its callback should be called.  With PriorityCallbackQueue, callbacks of
+  /// equal priority are called earliest deadline first.  Zero (the default) means no deadline.
+  ros::WallDuration deadline;
+
   /**
    * \brief An object whose destruction will prevent the callback associated with this subscription
    *
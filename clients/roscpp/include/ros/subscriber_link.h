@@ -29,6 +29,7 @@
 #define ROSCPP_SUBSCRIBER_LINK_H
 
 #include "ros/common.h"
+#include "ros/histogram.h"
 
 #include <boost/thread/mutex.hpp>
 #include <boost/shared_array.hpp>
@@ -64,6 +65,15 @@ public:
 
   const std::string& getTopic() const { return topic_; }
   const Stats &getStats() { return stats_; }
+  /**
+   * \brief Histogram of the time, in nanoseconds, messages spend queued for this subscriber before they have been
+   * written to the transport
+   */
+  const HistogramPtr& getLatencyHistogram() { return latency_histogram_; }
+  /**
+   * \brief Histogram of the serialized size, in bytes, of the messages queued for this subscriber
+   */
+  const HistogramPtr& getSizeHistogram() { return size_histogram_; }
   const std::string &getDestinationCallerID() const { return destination_caller_id_; }
   int getConnectionID() const { return connection_id_; }
 
@@ -91,6 +101,8 @@ protected:
   unsigned int connection_id_;
   std::string destination_caller_id_;
   Stats stats_;
+  HistogramPtr latency_histogram_;
+  HistogramPtr size_histogram_;
   std::string topic_;
 };
 
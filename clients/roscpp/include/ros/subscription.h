@@ -35,6 +35,7 @@
 #include "ros/transport_hints.h"
 #include "ros/xmlrpc_manager.h"
 #include "ros/statistics.h"
+#include "ros/histogram.h"
 #include "xmlrpcpp/XmlRpc.h"
 
 #include <boost/thread.hpp>
@@ -94,9 +95,14 @@ public:
    */
   bool isDropped() { return dropped_; }
   XmlRpc::XmlRpcValue getStats();
+  /**
+   * \brief Append a snapshot of the latency and size histograms of each of our publisher links
+   */
+  void getHistograms(V_ConnectionHistograms& histograms);
   void getInfo(XmlRpc::XmlRpcValue& info);
 
-  bool addCallback(const SubscriptionCallbackHelperPtr& helper, const std::string& md5sum, CallbackQueueInterface* queue, int32_t queue_size, const VoidConstPtr& tracked_object, bool allow_concurrent_callbacks);
+  bool addCallback(const SubscriptionCallbackHelperPtr& helper, const std::string& md5sum, CallbackQueueInterface* queue, int32_t queue_size, const VoidConstPtr& tracked_object, bool allow_concurrent_callbacks, bool lock_free_queue = false,
+                   int32_t priority = 0, const WallDuration& deadline = WallDuration());
   void removeCallback(const SubscriptionCallbackHelperPtr& helper);
 
   typedef std::map<std::string, std::string> M_string;
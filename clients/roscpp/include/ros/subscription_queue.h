@@ -32,6 +32,7 @@
 #include "common.h"
 #include "ros/message_event.h"
 #include "callback_queue_interface.h"
+#include "histogram.h"
 
 #include <boost/thread/recursive_mutex.hpp>
 #include <boost/thread/mutex.hpp>
@@ -49,7 +50,7 @@ typedef boost::shared_ptr<SubscriptionCallbackHelper> SubscriptionCallbackHelper
 
 class ROSCPP_DECL SubscriptionQueue : public CallbackInterface, public boost::enable_shared_from_this<SubscriptionQueue>
 {
-private:
+protected:
   struct Item
   {
     SubscriptionCallbackHelperPtr helper;
@@ -60,32 +61,54 @@ private:
 
     bool nonconst_need_copy;
     ros::Time receipt_time;
+
+    /// If set, the time the item spent queued is recorded here when its callback is invoked
+    HistogramPtr latency_histogram;
+    SteadyTime push_time;
   };
   typedef std::deque<Item> D_Item;
 
 public:
   SubscriptionQueue(const std::string& topic, int32_t queue_size, bool allow_concurrent_callbacks);
-  ~SubscriptionQueue();
+  virtual ~SubscriptionQueue();
 
-  void push(const SubscriptionCallbackHelperPtr& helper, const MessageDeserializerPtr& deserializer, 
+  virtual void push(const SubscriptionCallbackHelperPtr& helper, const MessageDeserializerPtr& deserializer,
 	    bool has_tracked_object, const VoidConstWPtr& tracked_object, bool nonconst_need_copy, 
-	    ros::Time receipt_time = ros::Time(), bool* was_full = 0);
-  void clear();
+	    ros::Time receipt_time = ros::Time(), bool* was_full = 0, const HistogramPtr& latency_histogram = HistogramPtr());
+  virtual void clear();
 
   virtual CallbackInterface::CallResult call();
   virtual bool ready();
-  bool full();
+  virtual bool full();
+
+  virtual int32_t getPriority() { return priority_; }
+  virtual WallDuration getDeadline() { return deadline_; }
+  /**
+   * \brief Set the priority and deadline handed to the callback queue.  Must be called before the queue is first
+   * added to a callback queue.
+   */
+  void setPriority(int32_t priority, const WallDuration& deadline);
+
+protected:
+  /**
+   * \brief Deserializes the item's message and calls its callback.  The caller must hold a reference to this queue
+   * (if one exists), since the callback may drop the last one.
+   */
+  void callItem(Item& i);
 
-private:
-  bool fullNoLock();
   std::string topic_;
   int32_t size_;
+  bool allow_concurrent_callbacks_;
+  int32_t priority_;
+  WallDuration deadline_;
+
+private:
+  bool fullNoLock();
   bool full_;
 
   boost::mutex queue_mutex_;
   D_Item queue_;
   uint32_t queue_size_;
-  bool allow_concurrent_callbacks_;
 
   boost::recursive_mutex callback_mutex_;
 };
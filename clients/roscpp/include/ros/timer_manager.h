@@ -54,8 +54,9 @@
 #include "ros/assert.h"
 #include "ros/callback_queue_interface.h"
 
+#include <boost/unordered_map.hpp>
+
 #include <vector>
-#include <list>
 
 namespace ros
 {
@@ -91,20 +92,27 @@ private:
 
     bool oneshot;
 
+    /// Handed to the callback queue with each callback
+    int32_t priority;
+    WallDuration deadline;
+
+    /// Position in the waiting_ heap, or -1 if not waiting (e.g. while its callback is queued)
+    int32_t waiting_index;
+
     // debugging info
     uint32_t total_calls;
   };
   typedef boost::shared_ptr<TimerInfo> TimerInfoPtr;
   typedef boost::weak_ptr<TimerInfo> TimerInfoWPtr;
   typedef std::vector<TimerInfoPtr> V_TimerInfo;
-
-  typedef std::list<int32_t> L_int32;
+  typedef boost::unordered_map<int32_t, TimerInfoPtr> M_TimerInfo;
 
 public:
   TimerManager();
   ~TimerManager();
 
-  int32_t add(const D& period, const boost::function<void(const E&)>& callback, CallbackQueueInterface* callback_queue, const VoidConstPtr& tracked_object, bool oneshot);
+  int32_t add(const D& period, const boost::function<void(const E&)>& callback, CallbackQueueInterface* callback_queue, const VoidConstPtr& tracked_object, bool oneshot,
+              int32_t priority = 0, const WallDuration& deadline = WallDuration());
   void remove(int32_t handle);
 
   bool hasPending(int32_t handle);
@@ -119,18 +127,26 @@ public:
 private:
   void threadFunc();
 
-  bool waitingCompare(int32_t lhs, int32_t rhs);
   TimerInfoPtr findTimer(int32_t handle);
   void schedule(const TimerInfoPtr& info);
   void updateNext(const TimerInfoPtr& info, const T& current_time);
 
-  V_TimerInfo timers_;
+  // waiting_ is a binary min-heap on next_expected.  All of these require a lock on waiting_mutex_
+  bool waitingLess(const TimerInfoPtr& lhs, const TimerInfoPtr& rhs);
+  void waitingSwap(size_t a, size_t b);
+  void waitingSiftUp(size_t index);
+  void waitingSiftDown(size_t index);
+  void pushWaiting(const TimerInfoPtr& info);
+  void removeWaiting(const TimerInfoPtr& info);
+  void updateWaiting(const TimerInfoPtr& info);
+
+  M_TimerInfo timers_;
   boost::mutex timers_mutex_;
   boost::condition_variable timers_cond_;
   volatile bool new_timer_;
 
   boost::mutex waiting_mutex_;
-  L_int32 waiting_;
+  V_TimerInfo waiting_;
 
   uint32_t id_counter_;
   boost::mutex id_mutex_;
@@ -152,6 +168,8 @@ private:
     , current_expected_(current_expected)
     , last_expired_(last_expired)
     , current_expired_(current_expired)
+    , priority_(info->priority)
+    , deadline_(info->deadline)
     , called_(false)
     {
       boost::mutex::scoped_lock lock(info->waiting_mutex);
@@ -213,6 +231,9 @@ private:
       return Success;
     }
 
+    int32_t getPriority() { return priority_; }
+    WallDuration getDeadline() { return deadline_; }
+
   private:
     TimerManager<T, D, E>* parent_;
     TimerInfoWPtr info_;
@@ -221,6 +242,8 @@ private:
     T current_expected_;
     T last_expired_;
     T current_expired_;
+    int32_t priority_;
+    WallDuration deadline_;
 
     bool called_;
   };
@@ -248,32 +271,128 @@ TimerManager<T, D, E>::~TimerManager()
 }
 
 template<class T, class D, class E>
-bool TimerManager<T, D, E>::waitingCompare(int32_t lhs, int32_t rhs)
+typename TimerManager<T, D, E>::TimerInfoPtr TimerManager<T, D, E>::findTimer(int32_t handle)
 {
-  TimerInfoPtr infol = findTimer(lhs);
-  TimerInfoPtr infor = findTimer(rhs);
-  if (!infol || !infor)
+  typename M_TimerInfo::iterator it = timers_.find(handle);
+  if (it != timers_.end())
   {
-    return infol < infor;
+    return it->second;
   }
 
-  return infol->next_expected < infor->next_expected;
+  return TimerInfoPtr();
 }
 
 template<class T, class D, class E>
-typename TimerManager<T, D, E>::TimerInfoPtr TimerManager<T, D, E>::findTimer(int32_t handle)
+bool TimerManager<T, D, E>::waitingLess(const TimerInfoPtr& lhs, const TimerInfoPtr& rhs)
 {
-  typename V_TimerInfo::iterator it = timers_.begin();
-  typename V_TimerInfo::iterator end = timers_.end();
-  for (; it != end; ++it)
+  if (lhs->next_expected != rhs->next_expected)
   {
-    if ((*it)->handle == handle)
+    return lhs->next_expected < rhs->next_expected;
+  }
+
+  // Keep timers that expire together in the order they were created
+  return lhs->handle < rhs->handle;
+}
+
+template<class T, class D, class E>
+void TimerManager<T, D, E>::waitingSwap(size_t a, size_t b)
+{
+  waiting_[a].swap(waiting_[b]);
+  waiting_[a]->waiting_index = a;
+  waiting_[b]->waiting_index = b;
+}
+
+template<class T, class D, class E>
+void TimerManager<T, D, E>::waitingSiftUp(size_t index)
+{
+  while (index > 0)
+  {
+    size_t parent = (index - 1) / 2;
+    if (!waitingLess(waiting_[index], waiting_[parent]))
     {
-      return *it;
+      break;
     }
+
+    waitingSwap(index, parent);
+    index = parent;
   }
+}
 
-  return TimerInfoPtr();
+template<class T, class D, class E>
+void TimerManager<T, D, E>::waitingSiftDown(size_t index)
+{
+  size_t size = waiting_.size();
+  for (;;)
+  {
+    size_t smallest = index;
+    size_t left = 2 * index + 1;
+    size_t right = left + 1;
+    if (left < size && waitingLess(waiting_[left], waiting_[smallest]))
+    {
+      smallest = left;
+    }
+    if (right < size && waitingLess(waiting_[right], waiting_[smallest]))
+    {
+      smallest = right;
+    }
+
+    if (smallest == index)
+    {
+      break;
+    }
+
+    waitingSwap(index, smallest);
+    index = smallest;
+  }
+}
+
+template<class T, class D, class E>
+void TimerManager<T, D, E>::pushWaiting(const TimerInfoPtr& info)
+{
+  ROS_ASSERT(info->waiting_index < 0);
+
+  info->waiting_index = waiting_.size();
+  waiting_.push_back(info);
+  waitingSiftUp(info->waiting_index);
+}
+
+template<class T, class D, class E>
+void TimerManager<T, D, E>::removeWaiting(const TimerInfoPtr& info)
+{
+  if (info->waiting_index < 0)
+  {
+    return;
+  }
+
+  size_t index = info->waiting_index;
+  size_t last = waiting_.size() - 1;
+  if (index != last)
+  {
+    waitingSwap(index, last);
+  }
+
+  waiting_.pop_back();
+  info->waiting_index = -1;
+
+  if (index != last)
+  {
+    // The timer moved into the hole may belong either above or below it
+    TimerInfoPtr moved = waiting_[index];
+    waitingSiftUp(index);
+    waitingSiftDown(moved->waiting_index);
+  }
+}
+
+template<class T, class D, class E>
+void TimerManager<T, D, E>::updateWaiting(const TimerInfoPtr& info)
+{
+  if (info->waiting_index < 0)
+  {
+    return;
+  }
+
+  waitingSiftUp(info->waiting_index);
+  waitingSiftDown(info->waiting_index);
 }
 
 template<class T, class D, class E>
@@ -302,7 +421,7 @@ bool TimerManager<T, D, E>::hasPending(int32_t handle)
 
 template<class T, class D, class E>
 int32_t TimerManager<T, D, E>::add(const D& period, const boost::function<void(const E&)>& callback, CallbackQueueInterface* callback_queue,
-                                   const VoidConstPtr& tracked_object, bool oneshot)
+                                   const VoidConstPtr& tracked_object, bool oneshot, int32_t priority, const WallDuration& deadline)
 {
   TimerInfoPtr info(boost::make_shared<TimerInfo>());
   info->period = period;
@@ -315,6 +434,9 @@ int32_t TimerManager<T, D, E>::add(const D& period, const boost::function<void(c
   info->waiting_callbacks = 0;
   info->total_calls = 0;
   info->oneshot = oneshot;
+  info->priority = priority;
+  info->deadline = deadline;
+  info->waiting_index = -1;
   if (tracked_object)
   {
     info->tracked_object = tracked_object;
@@ -328,7 +450,7 @@ int32_t TimerManager<T, D, E>::add(const D& period, const boost::function<void(c
 
   {
     boost::mutex::scoped_lock lock(timers_mutex_);
-    timers_.push_back(info);
+    timers_.insert(std::make_pair(info->handle, info));
 
     if (!thread_started_)
     {
@@ -338,8 +460,7 @@ int32_t TimerManager<T, D, E>::add(const D& period, const boost::function<void(c
 
     {
       boost::mutex::scoped_lock lock(waiting_mutex_);
-      waiting_.push_back(info->handle);
-      waiting_.sort(boost::bind(&TimerManager::waitingCompare, this, _1, _2));
+      pushWaiting(info);
     }
 
     new_timer_ = true;
@@ -358,29 +479,21 @@ void TimerManager<T, D, E>::remove(int32_t handle)
   {
     boost::mutex::scoped_lock lock(timers_mutex_);
 
-    typename V_TimerInfo::iterator it = timers_.begin();
-    typename V_TimerInfo::iterator end = timers_.end();
-    for (; it != end; ++it)
+    typename M_TimerInfo::iterator it = timers_.find(handle);
+    if (it != timers_.end())
     {
-      const TimerInfoPtr& info = *it;
-      if (info->handle == handle)
-      {
-        info->removed = true;
-        callback_queue = info->callback_queue;
-        remove_id = (uint64_t)info.get();
-        timers_.erase(it);
-        break;
-      }
-    }
+      const TimerInfoPtr& info = it->second;
+      info->removed = true;
+      callback_queue = info->callback_queue;
+      remove_id = (uint64_t)info.get();
 
-    {
-      boost::mutex::scoped_lock lock2(waiting_mutex_);
-      // Remove from the waiting list if it's in it
-      L_int32::iterator it = std::find(waiting_.begin(), waiting_.end(), handle);
-      if (it != waiting_.end())
       {
-        waiting_.erase(it);
+        boost::mutex::scoped_lock lock2(waiting_mutex_);
+        // Remove from the waiting heap if it's in it
+        removeWaiting(info);
       }
+
+      timers_.erase(it);
     }
   }
 
@@ -404,9 +517,7 @@ void TimerManager<T, D, E>::schedule(const TimerInfoPtr& info)
   {
     boost::mutex::scoped_lock lock(waiting_mutex_);
 
-    waiting_.push_back(info->handle);
-    // waitingCompare requires a lock on the timers_mutex_
-    waiting_.sort(boost::bind(&TimerManager::waitingCompare, this, _1, _2));
+    pushWaiting(info);
   }
 
   new_timer_ = true;
@@ -480,7 +591,7 @@ void TimerManager<T, D, E>::setPeriod(int32_t handle, const D& period, bool rese
     // In this case, let next_expected be updated only in updateNext
     
     info->period = period;
-    waiting_.sort(boost::bind(&TimerManager::waitingCompare, this, _1, _2));
+    updateWaiting(info);
   }
 
   new_timer_ = true;
@@ -504,17 +615,20 @@ void TimerManager<T, D, E>::threadFunc()
 
       current = T::now();
 
-      typename V_TimerInfo::iterator it = timers_.begin();
-      typename V_TimerInfo::iterator end = timers_.end();
+      boost::mutex::scoped_lock waitlock(waiting_mutex_);
+
+      typename M_TimerInfo::iterator it = timers_.begin();
+      typename M_TimerInfo::iterator end = timers_.end();
       for (; it != end; ++it)
       {
-        const TimerInfoPtr& info = *it;
+        const TimerInfoPtr& info = it->second;
 
         // Timer may have been added after the time jump, so also check if time has jumped past its last call time
         if (current < info->last_expected)
         {
           info->last_expected = current;
           info->next_expected = current + info->period;
+          updateWaiting(info);
         }
       }
     }
@@ -530,9 +644,9 @@ void TimerManager<T, D, E>::threadFunc()
       }
       else
       {
-        TimerInfoPtr info = findTimer(waiting_.front());
+        TimerInfoPtr info = waiting_.front();
 
-        while (!waiting_.empty() && info && info->next_expected <= current)
+        while (info->next_expected <= current)
         {
           current = T::now();
 
@@ -540,14 +654,15 @@ void TimerManager<T, D, E>::threadFunc()
           CallbackInterfacePtr cb(boost::make_shared<TimerQueueCallback>(this, info, info->last_expected, info->last_real, info->next_expected, info->last_expired, current));
           info->callback_queue->addCallback(cb, (uint64_t)info.get());
 
-          waiting_.pop_front();
+          removeWaiting(info);
 
           if (waiting_.empty())
           {
+            info.reset();
             break;
           }
 
-          info = findTimer(waiting_.front());
+          info = waiting_.front();
         }
 
         if (info)
@@ -44,6 +44,7 @@ struct ROSCPP_DECL TimerOptions
     , callback_queue(0)
     , oneshot(false)
     , autostart(true)
+    , priority(0)
   { }
 
   /*
@@ -57,6 +58,7 @@ struct ROSCPP_DECL TimerOptions
     , callback_queue(_queue)
     , oneshot(oneshot)
     , autostart(autostart)
+    , priority(0)
   { }
 
   Duration period;                                                  ///< The period to call the callback at
@@ -76,6 +78,13 @@ struct ROSCPP_DECL TimerOptions
 
   bool oneshot;
   bool autostart;
+
+  /// Priority of the timer's callbacks, for callback queues that order by it (e.g. PriorityCallbackQueue).  Higher is
+  /// called first.
+  int32_t priority;
+  /// How soon after the timer fires its callback should be called.  With PriorityCallbackQueue, callbacks of equal
+  /// priority are called earliest deadline first.  Zero (the default) means no deadline.
+  WallDuration deadline;
 };
 
 
@@ -32,6 +32,7 @@
 #include "common.h"
 #include "ros/serialization.h"
 #include "rosout_appender.h"
+#include "histogram.h"
 
 #include "xmlrpcpp/XmlRpcValue.h"
 
@@ -142,6 +143,12 @@ public:
   void incrementSequence(const std::string &_topic);//??
   bool isLatched(const std::string& topic);
 
+  /**
+   * \brief Snapshot the per-connection latency and message size histograms of every publication and subscription.
+   * The same data is reported in summarized form through getBusStats.
+   */
+  void getConnectionHistograms(V_ConnectionHistograms& histograms);
+
 private:
   /** if it finds a pre-existing subscription to the same topic and of the
    *  same message type, it appends the Functor to the callback vector for
@@ -180,6 +187,10 @@ private:
    * This is the implementation of the xml-rpc getBusStats function;
    * it populates the XmlRpcValue object sent to it with various statistics
    * about the node's connectivity, bandwidth utilization, etc.
+   *
+   * As a roscpp extension, each connection entry carries two extra fields after the standard ones:
+   * latency and message size histograms, each as [count, mean, p50, p90, p99, p99.9, max].  Latencies are in
+   * nanoseconds: time queued before being written for publications, time waiting for the callback for subscriptions.
    */
   void getBusStats(XmlRpc::XmlRpcValue &stats);
 
@@ -73,6 +73,25 @@ public:
    */
   virtual int32_t write(uint8_t* buffer, uint32_t size) = 0;
 
+  /**
+   * \brief A region of memory handed to writev()
+   */
+  struct WriteBuffer
+  {
+    uint8_t* data;
+    uint32_t size;
+  };
+
+  /**
+   * \brief Write a list of buffers, in order, as if they were one contiguous buffer.  Not guaranteed to actually
+   * write all of the bytes.  The default implementation calls write() on each buffer in turn and stops at the first
+   * short write; transports that support vectored I/O should override it to write everything in one call.
+   * \param buffers Array of buffers to write from
+   * \param count Number of entries in buffers
+   * \return The number of bytes actually written, or -1 if there was an error
+   */
+  virtual int32_t writev(const WriteBuffer* buffers, uint32_t count);
+
   /**
    * \brief Enable writing on this transport.  Allows derived classes to, for example, enable write polling for asynchronous sockets
    */
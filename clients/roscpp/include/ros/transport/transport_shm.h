@@ -0,0 +1,141 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2008, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage, Inc. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef ROSCPP_TRANSPORT_SHM_H
+#define ROSCPP_TRANSPORT_SHM_H
+
+#include <ros/transport/transport_tcp.h>
+#include <ros/common.h>
+
+#include <string>
+
+namespace ros
+{
+
+class TransportSHM;
+typedef boost::shared_ptr<TransportSHM> TransportSHMPtr;
+
+/**
+ * \brief TCPROS-SHM transport: a TCPROS connection whose message data is moved through a shared memory ring.
+ *
+ * The connection starts out as plain TCPROS.  A subscriber on the same host creates a ring and passes its name in
+ * the connection header ("shm_segment"); if the publisher can map it, it answers with "shm: 1" and, from then on,
+ * message bytes go through the ring instead of the socket.  The socket stays open to carry one byte doorbells in
+ * either direction (data available / space available) and to detect the other side going away.  If either side
+ * can't set up the ring the connection simply stays TCPROS.
+ */
+class ROSCPP_DECL TransportSHM : public TransportTCP
+{
+public:
+  /// Size, in bytes, of the rings created by subscribers
+  static uint32_t s_ring_size_;
+
+  TransportSHM(PollSet* poll_set, int flags = 0);
+  virtual ~TransportSHM();
+
+  /**
+   * \brief Subscriber side: create a ring to offer to the publisher we are connected to.  Fails if the peer is not
+   * on this host, or if shared memory is unavailable.
+   */
+  bool createSegment();
+  /**
+   * \brief Returns the name of the ring created by createSegment() or attached by parseHeader()
+   */
+  const std::string& getSegmentName() { return segment_name_; }
+  /**
+   * \brief Publisher side: returns true if parseHeader() attached to the ring offered by the subscriber
+   */
+  bool isAttached() { return ring_ != 0; }
+  /**
+   * \brief Publisher side: start sending data through the ring.  Call once the reply header has been written.
+   */
+  void activate();
+  /**
+   * \brief Returns true once data is going through the ring
+   */
+  bool isActive() { return active_; }
+
+  // overrides from Transport
+  virtual int32_t read(uint8_t* buffer, uint32_t size);
+  virtual int32_t write(uint8_t* buffer, uint32_t size);
+  virtual int32_t writev(const WriteBuffer* buffers, uint32_t count);
+
+  virtual void enableWrite();
+  virtual void disableWrite();
+  virtual void enableRead();
+  virtual void disableRead();
+
+  virtual void close();
+
+  virtual std::string getTransportInfo();
+
+  virtual void parseHeader(const Header& header);
+
+  virtual const char* getType() { return active_ ? "TCPROS-SHM" : "TCPROS"; }
+
+protected:
+  virtual TransportTCPPtr createAcceptedTransport(PollSet* poll_set);
+  virtual void socketUpdate(int events);
+
+private:
+  struct Ring;
+
+  /**
+   * \brief Returns true if the peer address of our socket is one of ours
+   */
+  bool isPeerLocal();
+  bool attachSegment(const std::string& name);
+  void releaseSegment();
+  /**
+   * \brief Read and throw away any doorbell bytes waiting on the socket.  Returns false if the socket was closed.
+   */
+  bool drainDoorbell();
+  void ringDoorbell();
+
+  Ring* ring_;
+  uint8_t* ring_data_;
+  size_t mapped_size_;
+  std::string segment_name_;
+  /// True if we created the ring (subscriber side), and so are the one reading from it
+  bool owner_;
+  /// True while the ring we created still has a name
+  bool linked_;
+  volatile bool active_;
+  /// Whether Connection currently wants to be told about write space (publisher side)
+  volatile bool write_wanted_;
+};
+
+}
+
+#endif // ROSCPP_TRANSPORT_SHM_H
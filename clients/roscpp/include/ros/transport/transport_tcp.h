@@ -89,6 +89,13 @@ public:
    * \param accept_cb The function to call when a client socket has connected
    */
   bool listen(int port, int backlog, const AcceptCallback& accept_cb);
+
+  typedef boost::function<PollSet*()> PollSetSelector;
+  /**
+   * \brief Set the function used to pick the poll set for each accepted connection.  If unset, accepted
+   * connections share this transport's poll set.
+   */
+  void setAcceptPollSetSelector(const PollSetSelector& selector) { accept_poll_set_selector_ = selector; }
   /**
    * \brief Accept a connection on a server socket.  Blocks until a connection is available
    */
@@ -108,6 +115,7 @@ public:
   // overrides from Transport
   virtual int32_t read(uint8_t* buffer, uint32_t size);
   virtual int32_t write(uint8_t* buffer, uint32_t size);
+  virtual int32_t writev(const WriteBuffer* buffers, uint32_t count);
 
   virtual void enableWrite();
   virtual void disableWrite();
@@ -122,6 +130,22 @@ public:
 
   virtual const char* getType() { return "TCPROS"; }
 
+protected:
+  /**
+   * \brief Creates the transport that wraps a socket returned by accept().  Lets derived transports that listen
+   * for connections hand out transports of their own type.
+   */
+  virtual TransportTCPPtr createAcceptedTransport(PollSet* poll_set);
+
+  virtual void socketUpdate(int events);
+
+  socket_fd_t sock_;
+  bool closed_;
+  boost::recursive_mutex close_mutex_;
+
+  PollSet* poll_set_;
+  int flags_;
+
 private:
   /**
    * \brief Initializes the assigned socket -- sets it to non-blocking and enables reading
@@ -137,12 +161,6 @@ private:
    */
   bool setSocket(int sock);
 
-  void socketUpdate(int events);
-
-  socket_fd_t sock_;
-  bool closed_;
-  boost::recursive_mutex close_mutex_;
-
   bool expecting_read_;
   bool expecting_write_;
 
@@ -155,12 +173,10 @@ private:
   int server_port_;
   int local_port_;
   AcceptCallback accept_cb_;
+  PollSetSelector accept_poll_set_selector_;
 
   std::string cached_remote_host_;
 
-  PollSet* poll_set_;
-  int flags_;
-
   std::string connected_host_;
   int connected_port_;
 };
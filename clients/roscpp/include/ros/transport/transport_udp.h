@@ -42,6 +42,9 @@
 #include "ros/io.h"
 #include <ros/common.h>
 
+#include <vector>
+#include <deque>
+
 namespace ros
 {
 
@@ -54,6 +57,7 @@ class PollSet;
 #define ROS_UDP_DATAN 1
 #define ROS_UDP_PING 2
 #define ROS_UDP_ERR 3
+#define ROS_UDP_PARITY 4
 typedef struct TransportUDPHeader {
   uint32_t connection_id_;
   uint8_t op_;
@@ -67,6 +71,11 @@ typedef struct TransportUDPHeader {
 class ROSCPP_DECL TransportUDP : public Transport
 {
 public:
+  /// Most datagrams moved by a single recvmmsg()/sendmmsg() call
+  static int s_max_batch_datagrams_;
+  /// Whether to use UDP segmentation offload (UDP_SEGMENT) and receive offload (UDP_GRO) where the kernel supports them
+  static bool s_use_segmentation_offload_;
+
   enum Flags
   {
     SYNCHRONOUS = 1<<0,
@@ -105,6 +114,12 @@ public:
   // overrides from Transport
   virtual int32_t read(uint8_t* buffer, uint32_t size);
   virtual int32_t write(uint8_t* buffer, uint32_t size);
+  /**
+   * \brief Write a list of buffers.  Unlike the stream transports, each buffer is sent as its own UDPROS message, the
+   * same as if write() had been called on it; all of their datagrams are handed to the kernel in as few calls as
+   * possible.
+   */
+  virtual int32_t writev(const WriteBuffer* buffers, uint32_t count);
 
   virtual void enableWrite();
   virtual void disableWrite();
@@ -121,6 +136,29 @@ public:
 
   int getMaxDatagramSize() const {return max_datagram_size_;}
 
+  /**
+   * \brief Turn on forward error correction.  The fragments of each message are dealt round-robin into groups of up
+   * to group_blocks, and every group is followed by parity_blocks parity fragments, from which the receiver can
+   * rebuild up to parity_blocks lost fragments of that group.  Both ends have to agree on the parameters, see
+   * parseHeader().
+   * \param parity_blocks Parity fragments per group, at most 8.  0 turns error correction off.
+   * \param group_blocks Data fragments per group, at most 64
+   */
+  void setFec(uint32_t parity_blocks, uint32_t group_blocks);
+  /**
+   * \brief Returns the number of parity fragments per group, or 0 if error correction is off
+   */
+  uint32_t getFecParity() const {return fec_parity_;}
+  /**
+   * \brief Returns the number of data fragments per parity group
+   */
+  uint32_t getFecGroup() const {return fec_group_;}
+
+  /**
+   * \brief Picks up the error correction parameters ("fec_parity", "fec_group") from a UDPROS connection header
+   */
+  virtual void parseHeader(const Header& header);
+
 private:
   /**
    * \brief Initializes the assigned socket -- sets it to non-blocking and enables reading
@@ -136,6 +174,41 @@ private:
 
   void socketUpdate(int events);
 
+  /**
+   * \brief Pull as many datagrams as are waiting (up to one batch) off the socket and feed them to the reassembler
+   * \return The number of datagrams received, 0 if none were waiting, or -1 if the transport was closed
+   */
+  int32_t receiveDatagrams();
+  /**
+   * \brief Handle one received datagram, header included
+   * \return false if the datagram was malformed and the transport has been closed
+   */
+  bool processDatagram(const uint8_t* data, uint32_t size);
+  /**
+   * \brief Queue a complete message for read(), unless a newer one has already been delivered
+   * \param storage If non-null, owns data; it is swapped into the ready queue rather than copied
+   */
+  void deliverMessage(uint8_t message_id, const uint8_t* data, uint32_t size, std::vector<uint8_t>* storage);
+  /**
+   * \brief Fragment and send a list of messages
+   * \return The number of bytes of the messages that were sent, or -1 if the transport is closed
+   */
+  int32_t sendMessages(const WriteBuffer* buffers, uint32_t count);
+  /**
+   * \brief Returns the number of message bytes carried by each (full) data fragment
+   */
+  uint32_t payloadSize() const;
+  /**
+   * \brief Compute the parity fragments for a message of num_blocks fragments into parity_buffer_
+   * \return The number of parity fragments
+   */
+  uint32_t encodeParity(const uint8_t* buffer, uint32_t size, uint32_t num_blocks);
+  /**
+   * \brief Send a run of fragments, each one a header plus a slice of a message
+   * \return false if the transport was closed
+   */
+  bool sendFragments(const TransportUDPHeader* headers, uint8_t* const* payloads, const uint32_t* payload_sizes, uint32_t count);
+
   socket_fd_t sock_;
   bool closed_;
   boost::mutex close_mutex_;
@@ -156,19 +229,69 @@ private:
 
   uint32_t connection_id_;
   uint8_t current_message_id_;
-  uint16_t total_blocks_;
-  uint16_t last_block_;
 
   uint32_t max_datagram_size_;
 
-  uint8_t* data_buffer_;
-  uint8_t* data_start_;
-  uint32_t data_filled_;
+  /// Most fragments coalesced into one UDP_SEGMENT send; 1 when segmentation offload is off
+  uint32_t gso_segments_;
+  /// Whether the kernel may hand us several coalesced datagrams at once (UDP_GRO)
+  bool gro_;
+
+  /// Parity fragments per group, 0 when error correction is off
+  uint32_t fec_parity_;
+  /// Data fragments per parity group
+  uint32_t fec_group_;
+  /// Parity fragments (with their sub-header) for the message being sent
+  std::vector<uint8_t> parity_buffer_;
+
+  /// Landing area for recvmmsg(), recv_slots_ datagrams of recv_slot_size_ bytes each.  Allocated on first read.
+  std::vector<uint8_t> recv_buffer_;
+  uint32_t recv_slot_size_;
+  uint32_t recv_slots_;
+
+  /**
+   * \brief A message whose fragments are still arriving
+   */
+  struct PartialMessage
+  {
+    uint8_t message_id_;
+    /// Number of fragments, 0 until the DATA0 fragment has arrived
+    uint16_t total_blocks_;
+    uint16_t blocks_received_;
+    /// Payload size of each fragment, 0 for fragments not yet received
+    std::vector<uint32_t> block_sizes_;
+    /// Fragment N lands at N * payloadSize(), so fragments can arrive in any order
+    std::vector<uint8_t> data_;
+    /// Size of the last fragment, when known from a parity fragment
+    uint32_t last_block_size_;
+    uint16_t parity_received_;
+    /// Whether each parity fragment has arrived, and its contents
+    std::vector<uint8_t> parity_have_;
+    std::vector<uint8_t> parity_;
+  };
+  /**
+   * \brief Rebuild the missing fragments of partial from its parity fragments, if there are enough of them
+   */
+  bool recoverMessage(PartialMessage& partial);
+  /// Messages being reassembled, oldest first
+  std::vector<PartialMessage> partials_;
+
+  /**
+   * \brief A complete message waiting to be handed out by read()
+   */
+  struct ReadyMessage
+  {
+    const uint8_t* data_;
+    uint32_t size_;
+    /// Owns data_ for reassembled messages; empty when data_ points into recv_buffer_
+    std::vector<uint8_t> storage_;
+  };
+  std::deque<ReadyMessage> ready_;
+  /// How much of ready_.front() read() has already returned
+  uint32_t ready_offset_;
 
-  uint8_t* reorder_buffer_;
-  uint8_t* reorder_start_;
-  TransportUDPHeader reorder_header_;
-  uint32_t reorder_bytes_;
+  uint8_t last_delivered_id_;
+  bool delivered_any_;
 };
 
 }
@@ -33,6 +33,8 @@
 
 #include <boost/lexical_cast.hpp>
 
+#include <algorithm>
+
 namespace ros
 {
 
@@ -131,6 +133,51 @@ public:
     return boost::lexical_cast<int>(it->second);
   }
 
+  /**
+   * \brief If a UDP transport is used, asks the publisher to add forward error correction: every group of up to
+   * group_blocks fragments of a message is followed by parity_blocks parity fragments, so up to parity_blocks lost
+   * fragments per group can be rebuilt instead of the whole message being dropped.  Publishers that don't support it
+   * send without.
+   *
+   * \param parity_blocks Parity fragments per group, at most 8
+   * \param group_blocks Data fragments per group, at most 64
+   */
+  TransportHints& udpFec(int parity_blocks, int group_blocks = 16)
+  {
+    options_["udp_fec_parity"] = boost::lexical_cast<std::string>(parity_blocks);
+    options_["udp_fec_group"] = boost::lexical_cast<std::string>(group_blocks);
+    return *this;
+  }
+
+  /**
+   * \brief Returns the number of parity fragments per group asked for by udpFec(), or 0 if error correction was not
+   * asked for
+   */
+  int getUDPFecParity()
+  {
+    M_string::iterator it = options_.find("udp_fec_parity");
+    if (it == options_.end())
+    {
+      return 0;
+    }
+
+    return boost::lexical_cast<int>(it->second);
+  }
+
+  /**
+   * \brief Returns the number of data fragments per parity group asked for by udpFec()
+   */
+  int getUDPFecGroup()
+  {
+    M_string::iterator it = options_.find("udp_fec_group");
+    if (it == options_.end())
+    {
+      return 0;
+    }
+
+    return boost::lexical_cast<int>(it->second);
+  }
+
   /**
    * \brief Specifies an unreliable transport.  Currently this means UDP.
    */
@@ -150,6 +197,25 @@ public:
     return *this;
   }
 
+  /**
+   * \brief Asks for message data from publishers on the same host to be passed through shared memory (TCPROS-SHM).
+   * The connection is negotiated as TCPROS, and stays TCPROS if the publisher is on another host or doesn't support
+   * shared memory.
+   */
+  TransportHints& shm()
+  {
+    transports_.push_back("SHM");
+    return *this;
+  }
+
+  /**
+   * \brief Returns whether or not this TransportHints has asked for shared memory
+   */
+  bool getSHM()
+  {
+    return std::find(transports_.begin(), transports_.end(), "SHM") != transports_.end();
+  }
+
   /**
    * \brief Returns a vector of transports, ordered by preference
    */
@@ -29,6 +29,7 @@
 #define ROSCPP_TRANSPORT_SUBSCRIBER_LINK_H
 #include "common.h"
 #include "subscriber_link.h"
+#include "ros/time.h"
 
 #include <boost/signals2/connection.hpp>
 
@@ -40,6 +41,12 @@ namespace ros
  */
 class ROSCPP_DECL TransportSubscriberLink : public SubscriberLink
 {
+public:
+  /// Maximum number of queued messages handed to the connection in a single write (1 disables batching)
+  static int s_max_write_batch_count_;
+  /// Soft cap on the number of bytes in a single batched write.  A lone message larger than this is still sent.
+  static int s_max_write_batch_bytes_;
+
 public:
   TransportSubscriberLink();
   virtual ~TransportSubscriberLink();
@@ -68,8 +75,16 @@ private:
   ConnectionPtr connection_;
   boost::signals2::connection dropped_conn_;
 
-  std::queue<SerializedMessage> outbox_;
+  struct OutboxEntry
+  {
+    SerializedMessage message;
+    SteadyTime enqueue_time;
+  };
+
+  std::queue<OutboxEntry> outbox_;
   boost::mutex outbox_mutex_;
+  /// Enqueue times of the messages in the write currently in flight, recorded in the latency histogram once it completes
+  std::vector<SteadyTime> writing_enqueue_times_;
   bool queue_full_;
 };
 typedef boost::shared_ptr<TransportSubscriberLink> TransportSubscriberLinkPtr;
@@ -114,6 +114,8 @@ private:
     VoidConstWPtr tracked_object_;
     bool has_tracked_object_;
     bool oneshot_;
+    int32_t priority_;
+    WallDuration deadline_;
   };
   typedef boost::shared_ptr<Impl> ImplPtr;
   typedef boost::weak_ptr<Impl> ImplWPtr;
@@ -44,6 +44,7 @@ struct ROSCPP_DECL WallTimerOptions
   , callback_queue(0)
   , oneshot(false)
   , autostart(true)
+  , priority(0)
   {
   }
 
@@ -58,6 +59,7 @@ struct ROSCPP_DECL WallTimerOptions
   , callback_queue(_queue)
   , oneshot(oneshot)
   , autostart(autostart)
+  , priority(0)
   {}
 
   WallDuration period;                                              ///< The period to call the callback at
@@ -77,6 +79,13 @@ struct ROSCPP_DECL WallTimerOptions
 
   bool oneshot;
   bool autostart;
+
+  /// Priority of the timer's callbacks, for callback queues that order by it (e.g. PriorityCallbackQueue).  Higher is
+  /// called first.
+  int32_t priority;
+  /// How soon after the timer fires its callback should be called.  With PriorityCallbackQueue, callbacks of equal
+  /// priority are called earliest deadline first.  Zero (the default) means no deadline.
+  WallDuration deadline;
 };
 
 
@@ -0,0 +1,197 @@
+/*
+ * Copyright (C) 2009, Willow Garage, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the names of Willow Garage, Inc. nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "ros/buffer_pool.h"
+#include "ros/assert.h"
+
+#include "xmlrpcpp/XmlRpcValue.h"
+
+#include <boost/make_shared.hpp>
+
+namespace ros
+{
+
+// Smallest size class is 64 bytes, largest 64MB.  Anything bigger is allocated and freed directly.
+#define ROSCPP_BUFFER_POOL_MIN_SHIFT 6
+#define ROSCPP_BUFFER_POOL_NUM_CLASSES 21
+#define ROSCPP_BUFFER_POOL_DEFAULT_MAX_CACHED_BYTES (64 * 1024 * 1024)
+
+struct BufferPool::Releaser
+{
+  Releaser(const BufferPoolPtr& pool, uint32_t size_class)
+  : pool_(pool)
+  , size_class_(size_class)
+  {}
+
+  void operator()(uint8_t* data)
+  {
+    pool_->release(data, size_class_);
+  }
+
+  // Keeps the pool alive for as long as any of its buffers are in use
+  BufferPoolPtr pool_;
+  uint32_t size_class_;
+};
+
+const BufferPoolPtr& BufferPool::instance()
+{
+  static BufferPoolPtr buffer_pool = boost::make_shared<BufferPool>();
+  return buffer_pool;
+}
+
+BufferPool::BufferPool()
+: free_(ROSCPP_BUFFER_POOL_NUM_CLASSES)
+, max_cached_bytes_(ROSCPP_BUFFER_POOL_DEFAULT_MAX_CACHED_BYTES)
+{
+}
+
+BufferPool::~BufferPool()
+{
+  clear();
+}
+
+boost::shared_array<uint8_t> BufferPool::allocate(uint32_t size)
+{
+  uint32_t size_class = 0;
+  while (size_class < ROSCPP_BUFFER_POOL_NUM_CLASSES && ((uint64_t)1 << (size_class + ROSCPP_BUFFER_POOL_MIN_SHIFT)) < size)
+  {
+    ++size_class;
+  }
+
+  if (size_class == ROSCPP_BUFFER_POOL_NUM_CLASSES)
+  {
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      ++stats_.allocations_;
+      ++stats_.heap_allocations_;
+      stats_.heap_bytes_ += size;
+    }
+
+    return boost::shared_array<uint8_t>(new uint8_t[size]);
+  }
+
+  uint32_t class_size = 1 << (size_class + ROSCPP_BUFFER_POOL_MIN_SHIFT);
+  uint8_t* data = 0;
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    ++stats_.allocations_;
+
+    std::vector<uint8_t*>& free_list = free_[size_class];
+    if (!free_list.empty())
+    {
+      data = free_list.back();
+      free_list.pop_back();
+      stats_.cached_bytes_ -= class_size;
+      ++stats_.pool_hits_;
+    }
+    else
+    {
+      ++stats_.heap_allocations_;
+      stats_.heap_bytes_ += class_size;
+    }
+  }
+
+  if (!data)
+  {
+    data = new uint8_t[class_size];
+  }
+
+  return boost::shared_array<uint8_t>(data, Releaser(shared_from_this(), size_class));
+}
+
+void BufferPool::release(uint8_t* data, uint32_t size_class)
+{
+  uint32_t class_size = 1 << (size_class + ROSCPP_BUFFER_POOL_MIN_SHIFT);
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    if (stats_.cached_bytes_ + class_size <= max_cached_bytes_)
+    {
+      free_[size_class].push_back(data);
+      stats_.cached_bytes_ += class_size;
+      ++stats_.released_;
+      return;
+    }
+
+    ++stats_.discarded_;
+  }
+
+  delete [] data;
+}
+
+void BufferPool::setMaxCachedBytes(uint32_t bytes)
+{
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    max_cached_bytes_ = bytes;
+  }
+
+  // Only drops what is cached right now, buffers in use are returned (or freed) as usual
+  if (bytes == 0)
+  {
+    clear();
+  }
+}
+
+void BufferPool::clear()
+{
+  std::vector<std::vector<uint8_t*> > free_lists(ROSCPP_BUFFER_POOL_NUM_CLASSES);
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    free_lists.swap(free_);
+    stats_.cached_bytes_ = 0;
+  }
+
+  for (size_t i = 0; i < free_lists.size(); ++i)
+  {
+    for (size_t j = 0; j < free_lists[i].size(); ++j)
+    {
+      delete [] free_lists[i][j];
+    }
+  }
+}
+
+BufferPool::Stats BufferPool::getStats()
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  return stats_;
+}
+
+void BufferPool::getStats(XmlRpc::XmlRpcValue& stats)
+{
+  Stats s = getStats();
+  stats.setSize(0);
+  stats[0] = (double)s.allocations_;
+  stats[1] = (double)s.pool_hits_;
+  stats[2] = (double)s.heap_allocations_;
+  stats[3] = (double)s.heap_bytes_;
+  stats[4] = (double)s.released_;
+  stats[5] = (double)s.discarded_;
+  stats[6] = (double)s.cached_bytes_;
+}
+
+}
@@ -184,20 +184,7 @@ void CallbackQueue::removeByID(uint64_t removal_id)
 
     {
       boost::unique_lock<boost::shared_mutex> rw_lock(id_info->calling_rw_mutex);
-      boost::mutex::scoped_lock lock(mutex_);
-      D_CallbackInfo::iterator it = callbacks_.begin();
-      for (; it != callbacks_.end();)
-      {
-        CallbackInfo& info = *it;
-        if (info.removal_id == removal_id)
-        {
-          it = callbacks_.erase(it);
-        }
-        else
-        {
-          ++it;
-        }
-      }
+      eraseQueuedCallbacks(removal_id);
     }
 
     if (tls_->calling_in_this_thread == id_info->id)
@@ -227,6 +214,30 @@ void CallbackQueue::removeByID(uint64_t removal_id)
   }
 }
 
+void CallbackQueue::eraseQueuedCallbacks(uint64_t removal_id)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  D_CallbackInfo::iterator it = callbacks_.begin();
+  for (; it != callbacks_.end();)
+  {
+    CallbackInfo& info = *it;
+    if (info.removal_id == removal_id)
+    {
+      it = callbacks_.erase(it);
+    }
+    else
+    {
+      ++it;
+    }
+  }
+}
+
+void CallbackQueue::requeueCallback(const CallbackInfo& info)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  callbacks_.push_back(info);
+}
+
 //调用回调函数
 CallbackQueue::CallOneResult CallbackQueue::callOne(ros::WallDuration timeout)
 {
@@ -418,8 +429,7 @@ CallbackQueue::CallOneResult CallbackQueue::callOneCB(TLS* tls)
     // Push TryAgain callbacks to the back of the shared queue
     if (result == CallbackInterface::TryAgain && !info.marked_for_removal)
     {
-      boost::mutex::scoped_lock lock(mutex_);
-      callbacks_.push_back(info);
+      requeueCallback(info);
 
       return TryAgain;
     }
@@ -35,6 +35,7 @@
 #include "ros/connection.h"
 #include "ros/transport/transport.h"
 #include "ros/file_log.h"
+#include "ros/buffer_pool.h"
 
 #include <ros/assert.h>
 
@@ -51,6 +52,8 @@ Connection::Connection()
 , read_size_(0)
 , reading_(false)
 , has_read_callback_(0)
+, write_index_(0)
+, write_offset_(0)
 , write_sent_(0)
 , write_size_(0)
 , writing_(false)
@@ -205,7 +208,26 @@ void Connection::writeTransport()
   {
     uint32_t to_write = write_size_ - write_sent_;
     ROS_DEBUG_NAMED("superdebug", "Connection writing %d bytes", to_write);
-    int32_t bytes_sent = transport_->write(write_buffer_.get() + write_sent_, to_write);
+    int32_t bytes_sent;
+    if (write_index_ + 1 == write_buffers_.size())
+    {
+      bytes_sent = transport_->write(write_buffers_[write_index_].first.get() + write_offset_, to_write);
+    }
+    else
+    {
+      // Hand every outstanding buffer to the transport at once so it can batch them into one system call
+      write_iov_.clear();
+      for (uint32_t i = write_index_; i < write_buffers_.size(); ++i)
+      {
+        uint32_t offset = (i == write_index_) ? write_offset_ : 0;
+        Transport::WriteBuffer b;
+        b.data = write_buffers_[i].first.get() + offset;
+        b.size = write_buffers_[i].second - offset;
+        write_iov_.push_back(b);
+      }
+
+      bytes_sent = transport_->writev(&write_iov_[0], write_iov_.size());
+    }
     ROS_DEBUG_NAMED("superdebug", "Connection wrote %d bytes", bytes_sent);
 
     if (bytes_sent < 0)
@@ -216,6 +238,22 @@ void Connection::writeTransport()
 
     write_sent_ += bytes_sent;
 
+    // Advance past the buffers that have been fully written
+    uint32_t remaining = bytes_sent;
+    while (remaining > 0 && write_index_ < write_buffers_.size())
+    {
+      uint32_t left = write_buffers_[write_index_].second - write_offset_;
+      if (remaining < left)
+      {
+        write_offset_ += remaining;
+        break;
+      }
+
+      remaining -= left;
+      ++write_index_;
+      write_offset_ = 0;
+    }
+
     if (bytes_sent < (int)write_size_ - (int)write_sent_)
     {
       can_write_more = false;
@@ -231,7 +269,9 @@ void Connection::writeTransport()
         // Store off a copy of the callback in case another write() call happens in it
         callback = write_callback_;
         write_callback_ = WriteFinishedFunc();
-        write_buffer_ = boost::shared_array<uint8_t>();
+        write_buffers_.clear();
+        write_index_ = 0;
+        write_offset_ = 0;
         write_sent_ = 0;
         write_size_ = 0;
         has_write_callback_ = 0;
@@ -274,7 +314,7 @@ void Connection::read(uint32_t size, const ReadFinishedFunc& callback)
     ROS_ASSERT(!read_callback_);
 
     read_callback_ = callback;
-    read_buffer_ = boost::shared_array<uint8_t>(new uint8_t[size]);
+    read_buffer_ = BufferPool::instance()->allocate(size);
     read_size_ = size;
     read_filled_ = 0;
     has_read_callback_ = 1;
@@ -299,7 +339,10 @@ void Connection::write(const boost::shared_array<uint8_t>& buffer, uint32_t size
     ROS_ASSERT(!write_callback_);
 
     write_callback_ = callback;
-    write_buffer_ = buffer;
+    write_buffers_.clear();
+    write_buffers_.push_back(WriteBufferAndSize(buffer, size));
+    write_index_ = 0;
+    write_offset_ = 0;
     write_size_ = size;
     write_sent_ = 0;
     has_write_callback_ = 1;
@@ -314,6 +357,42 @@ void Connection::write(const boost::shared_array<uint8_t>& buffer, uint32_t size
   }
 }
 
+void Connection::writeBatch(const V_WriteBuffer& buffers, const WriteFinishedFunc& callback, bool immediate)
+{
+  if (dropped_ || sending_header_error_)
+  {
+    return;
+  }
+
+  ROS_ASSERT(!buffers.empty());
+
+  {
+    boost::mutex::scoped_lock lock(write_callback_mutex_);
+
+    ROS_ASSERT(!write_callback_);
+
+    write_callback_ = callback;
+    write_buffers_ = buffers;
+    write_index_ = 0;
+    write_offset_ = 0;
+    write_size_ = 0;
+    for (V_WriteBuffer::const_iterator it = buffers.begin(); it != buffers.end(); ++it)
+    {
+      write_size_ += it->second;
+    }
+    write_sent_ = 0;
+    has_write_callback_ = 1;
+  }
+
+  transport_->enableWrite();
+
+  if (immediate)
+  {
+    // write immediately if possible
+    writeTransport();
+  }
+}
+
 void Connection::onDisconnect(const TransportPtr& transport)
 {
   (void)transport;
@@ -27,11 +27,13 @@
 
 #include "ros/connection_manager.h"
 #include "ros/poll_manager.h"
+#include "ros/poll_set.h"
 #include "ros/connection.h"
 #include "ros/transport_subscriber_link.h"
 #include "ros/service_client_link.h"
 #include "ros/transport/transport_tcp.h"
 #include "ros/transport/transport_udp.h"
+#include "ros/transport/transport_shm.h"
 #include "ros/file_log.h"
 #include "ros/network.h"
 
@@ -48,6 +50,7 @@ const ConnectionManagerPtr& ConnectionManager::instance()
 
 ConnectionManager::ConnectionManager()
 : connection_id_counter_(0)
+, next_poll_set_(0)
 {
 }
 
@@ -63,7 +66,8 @@ void ConnectionManager::start()
 								this));
 
   // Bring up the TCP listener socket
-  tcpserver_transport_ = boost::make_shared<TransportTCP>(&poll_manager_->getPollSet());
+  // Accepted connections behave exactly like TCPROS unless a subscriber on this host asks for shared memory
+  tcpserver_transport_ = boost::make_shared<TransportSHM>(&poll_manager_->getPollSet());
   if (!tcpserver_transport_->listen(network::getTCPROSPort(), 
 				    MAX_TCPROS_CONN_QUEUE, 
 				    boost::bind(&ConnectionManager::tcprosAcceptConnection, this, _1)))
@@ -71,6 +75,7 @@ void ConnectionManager::start()
     ROS_FATAL("Listen on port [%d] failed", network::getTCPROSPort());
     ROS_BREAK();
   }
+  tcpserver_transport_->setAcceptPollSetSelector(boost::bind(&ConnectionManager::selectPollSet, this));
 
   // Bring up the UDP listener socket
   udpserver_transport_ = boost::make_shared<TransportUDP>(&poll_manager_->getPollSet());
@@ -170,6 +175,38 @@ void ConnectionManager::removeDroppedConnections()
   }
 }
 
+PollSet* ConnectionManager::selectPollSet()
+{
+  const PollManagerPtr& poll_manager = PollManager::instance();
+  uint32_t num_poll_sets = poll_manager->getNumPollSets();
+  if (num_poll_sets == 1)
+  {
+    return &poll_manager->getPollSet();
+  }
+
+  uint32_t start;
+  {
+    boost::mutex::scoped_lock lock(next_poll_set_mutex_);
+    start = next_poll_set_;
+    next_poll_set_ = (next_poll_set_ + 1) % num_poll_sets;
+  }
+
+  PollSet* best = NULL;
+  size_t best_size = 0;
+  for (uint32_t i = 0; i < num_poll_sets; ++i)
+  {
+    PollSet& poll_set = poll_manager->getPollSet((start + i) % num_poll_sets);
+    size_t size = poll_set.getNumSockets();
+    if (!best || size < best_size)
+    {
+      best = &poll_set;
+      best_size = size;
+    }
+  }
+
+  return best;
+}
+
 void ConnectionManager::udprosIncomingConnection(const TransportUDPPtr& transport, Header& header)
 {
   std::string client_uri = ""; // TODO: transport->getClientURI();
@@ -0,0 +1,178 @@
+/*
+ * Copyright (C) 2009, Willow Garage, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the names of Willow Garage, Inc. nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ros/histogram.h"
+
+#include "xmlrpcpp/XmlRpcValue.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace ros
+{
+
+namespace
+{
+
+uint32_t highestBit(uint64_t value)
+{
+#if defined(__GNUC__)
+  return 63 - __builtin_clzll(value);
+#else
+  uint32_t bit = 0;
+  while (value >>= 1)
+  {
+    ++bit;
+  }
+  return bit;
+#endif
+}
+
+}
+
+const uint32_t Histogram::SUB_BUCKET_BITS;
+const uint32_t Histogram::SUB_BUCKETS;
+const uint32_t Histogram::MAX_MAGNITUDE;
+const uint32_t Histogram::NUM_BUCKETS;
+
+Histogram::Histogram()
+{
+  reset();
+}
+
+void Histogram::record(uint64_t value)
+{
+  buckets_[getBucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+  sum_.fetch_add(value, std::memory_order_relaxed);
+
+  uint64_t max = max_.load(std::memory_order_relaxed);
+  while (value > max && !max_.compare_exchange_weak(max, value, std::memory_order_relaxed))
+  {
+  }
+}
+
+void Histogram::reset()
+{
+  sum_.store(0, std::memory_order_relaxed);
+  max_.store(0, std::memory_order_relaxed);
+  for (uint32_t i = 0; i < NUM_BUCKETS; ++i)
+  {
+    buckets_[i].store(0, std::memory_order_relaxed);
+  }
+}
+
+Histogram::Snapshot Histogram::getSnapshot() const
+{
+  Snapshot s;
+  s.buckets_.resize(NUM_BUCKETS);
+  for (uint32_t i = 0; i < NUM_BUCKETS; ++i)
+  {
+    s.buckets_[i] = buckets_[i].load(std::memory_order_relaxed);
+    s.count_ += s.buckets_[i];
+  }
+  s.sum_ = sum_.load(std::memory_order_relaxed);
+  s.max_ = max_.load(std::memory_order_relaxed);
+  return s;
+}
+
+void Histogram::getStats(XmlRpc::XmlRpcValue& stats) const
+{
+  Snapshot s = getSnapshot();
+  stats.setSize(0);
+  stats[0] = (double)s.count_;
+  stats[1] = s.getMean();
+  stats[2] = (double)s.getPercentile(0.5);
+  stats[3] = (double)s.getPercentile(0.9);
+  stats[4] = (double)s.getPercentile(0.99);
+  stats[5] = (double)s.getPercentile(0.999);
+  stats[6] = (double)s.max_;
+}
+
+uint32_t Histogram::getBucketIndex(uint64_t value)
+{
+  if (value < SUB_BUCKETS)
+  {
+    return (uint32_t)value;
+  }
+
+  uint32_t magnitude = highestBit(value);
+  if (magnitude > MAX_MAGNITUDE)
+  {
+    return NUM_BUCKETS - 1;
+  }
+
+  uint32_t shift = magnitude - SUB_BUCKET_BITS;
+  return (shift + 1) * SUB_BUCKETS + (uint32_t)((value >> shift) & (SUB_BUCKETS - 1));
+}
+
+uint64_t Histogram::getBucketUpperBound(uint32_t index)
+{
+  if (index < SUB_BUCKETS)
+  {
+    return index;
+  }
+
+  if (index >= NUM_BUCKETS - 1)
+  {
+    return std::numeric_limits<uint64_t>::max();
+  }
+
+  uint32_t shift = index / SUB_BUCKETS - 1;
+  uint64_t lower = (uint64_t)(SUB_BUCKETS + index % SUB_BUCKETS) << shift;
+  return lower + ((uint64_t)1 << shift) - 1;
+}
+
+uint64_t Histogram::Snapshot::getPercentile(double fraction) const
+{
+  if (count_ == 0)
+  {
+    return 0;
+  }
+
+  uint64_t rank = (uint64_t)std::ceil(fraction * count_);
+  rank = std::min(std::max(rank, (uint64_t)1), count_);
+
+  uint64_t seen = 0;
+  for (uint32_t i = 0; i < buckets_.size(); ++i)
+  {
+    seen += buckets_[i];
+    if (seen >= rank)
+    {
+      return std::min(Histogram::getBucketUpperBound(i), max_);
+    }
+  }
+
+  return max_;
+}
+
+double Histogram::Snapshot::getMean() const
+{
+  return count_ ? (double)sum_ / count_ : 0.0;
+}
+
+}
@@ -47,7 +47,11 @@
 #include "ros/rosout_appender.h"
 #include "ros/subscribe_options.h"
 #include "ros/transport/transport_tcp.h"
+#include "ros/transport/transport_shm.h"
+#include "ros/transport/transport_udp.h"
+#include "ros/transport_subscriber_link.h"
 #include "ros/internal_timer_manager.h"
+#include "ros/buffer_pool.h"
 #include "xmlrpcpp/XmlRpcSocket.h"
 
 #include "roscpp/GetLoggers.h"
@@ -317,6 +321,23 @@ void start()
   }
 
   param::param("/tcp_keepalive", TransportTCP::s_use_keepalive_, TransportTCP::s_use_keepalive_);
+  param::param("/tcpros_write_batch_count", TransportSubscriberLink::s_max_write_batch_count_, TransportSubscriberLink::s_max_write_batch_count_);
+  param::param("/tcpros_write_batch_bytes", TransportSubscriberLink::s_max_write_batch_bytes_, TransportSubscriberLink::s_max_write_batch_bytes_);
+
+  param::param("/udpros_batch_datagrams", TransportUDP::s_max_batch_datagrams_, TransportUDP::s_max_batch_datagrams_);
+  param::param("/udpros_segmentation_offload", TransportUDP::s_use_segmentation_offload_, TransportUDP::s_use_segmentation_offload_);
+
+  int shm_ring_size = TransportSHM::s_ring_size_;
+  param::param("/tcpros_shm_ring_size", shm_ring_size, shm_ring_size);
+  TransportSHM::s_ring_size_ = std::max(shm_ring_size, 0);
+
+  int read_buffer_pool_bytes = 64 * 1024 * 1024;
+  param::param("/tcpros_read_buffer_pool_bytes", read_buffer_pool_bytes, read_buffer_pool_bytes);
+  BufferPool::instance()->setMaxCachedBytes(std::max(read_buffer_pool_bytes, 0));
+
+  int poll_threads = 1;
+  param::param("/poll_threads", poll_threads, poll_threads);
+  PollManager::instance()->setNumThreads(std::max(poll_threads, 1));
 
   //注册一个关闭检测函数
   PollManager::instance()->addPollThreadListener(checkForShutdown);
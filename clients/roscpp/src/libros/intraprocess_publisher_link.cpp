@@ -113,6 +113,11 @@ void IntraProcessPublisherLink::handleMessage(const SerializedMessage& m, bool s
 
   stats_.bytes_received_ += m.num_bytes;
   stats_.messages_received_++;
+  if (ser)
+  {
+    // nocopy-only messages are never serialized, so there is no size to record
+    size_histogram_->record(m.num_bytes);
+  }
 
   SubscriptionPtr parent = parent_.lock();
 
@@ -40,6 +40,7 @@
 #include <ros/io.h>
 #include <ros/assert.h> // don't need if we dont call the pipe functions.
 #include <errno.h> // for EFAULT and co.
+#include <algorithm>
 #include <iostream>
 #include <sstream>
 #ifdef WIN32
@@ -52,6 +53,10 @@
   #include <sys/epoll.h>
 #endif
 
+#ifdef HAVE_EVENTFD
+  #include <sys/eventfd.h>
+#endif
+
 /*****************************************************************************
 ** Macros
 *****************************************************************************/
@@ -146,12 +151,16 @@ void del_socket_from_watcher(int epfd, int fd) {
 #endif
 }
 
-void set_events_on_socket(int epfd, int fd, int events) {
+void set_events_on_socket(int epfd, int fd, int events, bool edge_triggered) {
 #if defined(HAVE_EPOLL)
   struct epoll_event ev;
   bzero(&ev, sizeof(ev));
 
   ev.events = events;
+  if (edge_triggered)
+  {
+    ev.events |= EPOLLET;
+  }
   ev.data.fd = fd;
   if (::epoll_ctl(epfd, EPOLL_CTL_MOD, fd, &ev))
   {
@@ -161,6 +170,51 @@ void set_events_on_socket(int epfd, int fd, int events) {
   UNUSED(epfd);
   UNUSED(fd);
   UNUSED(events);
+  UNUSED(edge_triggered);
+#endif
+}
+
+/**
+ * @brief Wait for events on the sockets registered with a socket watcher.
+ *
+ * Unlike poll_sockets() this does not allocate: the events are written into the
+ * caller's array, which can be reused across calls.  Only available with epoll.
+ * @param epfd - the socket watcher to wait on.
+ * @param events - array receiving one entry (fd and revents) per ready socket.
+ * @param max_events - the size of the events array.
+ * @param timeout - timeout in milliseconds.
+ * @return int : the number of entries filled in (0 on timeout or interruption), -1 on error.
+ */
+int wait_for_socket_events(int epfd, socket_pollfd *events, int max_events, int timeout) {
+#if defined(HAVE_EPOLL)
+	struct epoll_event ev[ROS_MAX_SOCKET_EVENTS];
+	max_events = std::min(max_events, ROS_MAX_SOCKET_EVENTS);
+
+	int fd_cnt = ::epoll_wait(epfd, ev, max_events, timeout);
+	if (fd_cnt < 0)
+	{
+		// EINTR means that we got interrupted by a signal, and is not an error
+		if (errno == EINTR)
+		{
+			return 0;
+		}
+		ROS_ERROR("Error in epoll_wait! %s", strerror(errno));
+		return -1;
+	}
+
+	for (int i = 0; i < fd_cnt; i++)
+	{
+		events[i].fd = ev[i].data.fd;
+		events[i].events = 0;
+		events[i].revents = ev[i].events;
+	}
+	return fd_cnt;
+#else
+	UNUSED(epfd);
+	UNUSED(events);
+	UNUSED(max_events);
+	UNUSED(timeout);
+	return -1;
 #endif
 }
 
@@ -506,11 +560,22 @@ int create_signal_pair(signal_fd_t signal_pair[2]) {
 	**********************/
     ::closesocket(listen_socket);  // the listener has done its job.
     return 0;
-#else // use a pipe pair
+#else // use an eventfd if we have one, otherwise a pipe pair
 	// initialize
 	signal_pair[0] = -1;
 	signal_pair[1] = -1;
 
+#if defined(HAVE_EVENTFD)
+	// A single counter serves as both ends; it costs one fd instead of two and writes never fill it up
+	int efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (efd >= 0) {
+		signal_pair[0] = efd;
+		signal_pair[1] = efd;
+		return 0;
+	}
+	ROS_WARN("eventfd() failed, falling back to a pipe: %s", strerror(errno));
+#endif
+
 	if(pipe(signal_pair) != 0) {
 		ROS_FATAL( "pipe() failed");
 		return -1;
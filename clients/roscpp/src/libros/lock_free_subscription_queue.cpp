@@ -0,0 +1,266 @@
+/*
+ * Copyright (C) 2009, Willow Garage, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the names of Willow Garage, Inc. nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "ros/lock_free_subscription_queue.h"
+#include "ros/message_deserializer.h"
+#include "ros/subscription_callback_helper.h"
+
+#include <boost/thread/thread.hpp>
+
+namespace ros
+{
+
+LockFreeSubscriptionQueue::LockFreeSubscriptionQueue(const std::string& topic, int32_t queue_size, bool allow_concurrent_callbacks)
+: SubscriptionQueue(topic, queue_size, allow_concurrent_callbacks)
+, capacity_(std::max(queue_size, 1))
+, cells_(new Cell[capacity_])
+, enqueue_pos_(0)
+, dequeue_pos_(0)
+, full_(false)
+, calling_thread_(std::thread::id())
+, call_depth_(0)
+{
+  ROS_ASSERT_MSG(queue_size > 0, "LockFreeSubscriptionQueue needs a bounded queue size");
+
+  for (uint32_t i = 0; i < capacity_; ++i)
+  {
+    cells_[i].sequence.store(2 * (uint64_t)i, std::memory_order_relaxed);
+  }
+}
+
+LockFreeSubscriptionQueue::~LockFreeSubscriptionQueue()
+{
+}
+
+// Bounded MPMC ring after Dmitry Vyukov: each cell's sequence says whether it is ready to be written (== 2 * pos) or
+// read (== 2 * pos + 1) for the lap that position pos is on, so producers and consumers only contend on their own
+// index.  Positions are doubled so the two states stay distinct even with a capacity of 1.
+bool LockFreeSubscriptionQueue::tryPush(const Item& item)
+{
+  uint64_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+  Cell* cell;
+  for (;;)
+  {
+    cell = &cells_[pos % capacity_];
+    uint64_t seq = cell->sequence.load(std::memory_order_acquire);
+    int64_t diff = (int64_t)seq - (int64_t)(2 * pos);
+    if (diff == 0)
+    {
+      if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+      {
+        break;
+      }
+    }
+    else if (diff < 0)
+    {
+      // full
+      return false;
+    }
+    else
+    {
+      pos = enqueue_pos_.load(std::memory_order_relaxed);
+    }
+  }
+
+  cell->item = item;
+  cell->sequence.store(2 * pos + 1, std::memory_order_release);
+  return true;
+}
+
+bool LockFreeSubscriptionQueue::tryPop(Item& item)
+{
+  uint64_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+  Cell* cell;
+  for (;;)
+  {
+    cell = &cells_[pos % capacity_];
+    uint64_t seq = cell->sequence.load(std::memory_order_acquire);
+    int64_t diff = (int64_t)seq - (int64_t)(2 * pos + 1);
+    if (diff == 0)
+    {
+      if (dequeue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+      {
+        break;
+      }
+    }
+    else if (diff < 0)
+    {
+      // empty
+      return false;
+    }
+    else
+    {
+      pos = dequeue_pos_.load(std::memory_order_relaxed);
+    }
+  }
+
+  item = cell->item;
+  // Don't keep the message alive in the ring until the cell is reused
+  cell->item = Item();
+  cell->sequence.store(2 * (pos + capacity_), std::memory_order_release);
+  return true;
+}
+
+void LockFreeSubscriptionQueue::push(const SubscriptionCallbackHelperPtr& helper, const MessageDeserializerPtr& deserializer,
+                                     bool has_tracked_object, const VoidConstWPtr& tracked_object, bool nonconst_need_copy,
+                                     ros::Time receipt_time, bool* was_full,
+                                     const HistogramPtr& latency_histogram)
+{
+  Item i;
+  i.helper = helper;
+  i.deserializer = deserializer;
+  i.has_tracked_object = has_tracked_object;
+  i.tracked_object = tracked_object;
+  i.nonconst_need_copy = nonconst_need_copy;
+  i.receipt_time = receipt_time;
+  if (latency_histogram)
+  {
+    i.latency_histogram = latency_histogram;
+    i.push_time = SteadyTime::now();
+  }
+
+  bool dropped = false;
+  while (!tryPush(i))
+  {
+    // Full: throw away the oldest message to make room.  If a consumer beats us to it, just try again.
+    Item oldest;
+    if (tryPop(oldest))
+    {
+      dropped = true;
+    }
+  }
+
+  if (dropped)
+  {
+    if (!full_.exchange(true))
+    {
+      ROS_DEBUG("Incoming queue was full for topic \"%s\". Discarded oldest message (current queue size [%d])", topic_.c_str(), (int)capacity_);
+    }
+  }
+  else
+  {
+    full_.store(false, std::memory_order_relaxed);
+  }
+
+  if (was_full)
+  {
+    *was_full = dropped;
+  }
+}
+
+void LockFreeSubscriptionQueue::clear()
+{
+  Item i;
+  while (tryPop(i))
+  {
+  }
+
+  if (!allow_concurrent_callbacks_)
+  {
+    // Wait out a callback in progress on another thread, as SubscriptionQueue does by taking its callback mutex
+    std::thread::id self = std::this_thread::get_id();
+    for (;;)
+    {
+      std::thread::id caller = calling_thread_.load();
+      if (caller == std::thread::id() || caller == self)
+      {
+        break;
+      }
+
+      boost::this_thread::yield();
+    }
+  }
+}
+
+CallbackInterface::CallResult LockFreeSubscriptionQueue::call()
+{
+  // The callback may result in our own destruction.  Therefore, we may need to keep a reference to ourselves
+  // that outlasts our hold on calling_thread_
+  boost::shared_ptr<SubscriptionQueue> self;
+  std::thread::id this_thread = std::this_thread::get_id();
+  bool owner = false;
+
+  if (!allow_concurrent_callbacks_)
+  {
+    std::thread::id idle;
+    if (calling_thread_.compare_exchange_strong(idle, this_thread))
+    {
+      owner = true;
+    }
+    else if (idle != this_thread)
+    {
+      return CallbackInterface::TryAgain;
+    }
+
+    // Either we now own the queue, or this is a recursive call from inside one of our own callbacks
+    ++call_depth_;
+  }
+
+  CallbackInterface::CallResult result = CallbackInterface::Invalid;
+  Item i;
+  if (tryPop(i))
+  {
+    VoidConstPtr tracker;
+    if (i.has_tracked_object)
+    {
+      tracker = i.tracked_object.lock();
+    }
+
+    if (!i.has_tracked_object || tracker)
+    {
+      try
+      {
+        self = boost::static_pointer_cast<SubscriptionQueue>(shared_from_this());
+      }
+      catch (boost::bad_weak_ptr&) // For the tests, where we don't create a shared_ptr
+      {}
+
+      callItem(i);
+      result = CallbackInterface::Success;
+    }
+  }
+
+  if (!allow_concurrent_callbacks_)
+  {
+    --call_depth_;
+    if (owner)
+    {
+      ROS_ASSERT(call_depth_ == 0);
+      calling_thread_.store(std::thread::id());
+    }
+  }
+
+  return result;
+}
+
+bool LockFreeSubscriptionQueue::full()
+{
+  return enqueue_pos_.load() - dequeue_pos_.load() >= capacity_;
+}
+
+}
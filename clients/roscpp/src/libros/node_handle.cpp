@@ -378,7 +378,7 @@ ServiceServer NodeHandle::advertiseService(AdvertiseServiceOptions& ops)
 ServiceClient NodeHandle::serviceClient(ServiceClientOptions& ops)
 {
   ops.service = resolveName(ops.service);
-  ServiceClient client(ops.service, ops.persistent, ops.header, ops.md5sum);
+  ServiceClient client(ops);
 
   if (client)
   {
@@ -28,6 +28,10 @@
 #include "ros/poll_manager.h"
 #include "ros/common.h"
 
+#include <boost/bind.hpp>
+#include <boost/make_shared.hpp>
+
+#include <algorithm>
 #include <signal.h>
 
 namespace ros
@@ -42,6 +46,7 @@ const PollManagerPtr& PollManager::instance()
 
 PollManager::PollManager()
   : shutting_down_(false)
+  , num_threads_(1)
 {
 }
 
@@ -50,9 +55,46 @@ PollManager::~PollManager()
   shutdown();
 }
 
+void PollManager::setNumThreads(uint32_t num_threads)
+{
+  num_threads_ = std::max(num_threads, 1u);
+}
+
+PollSet& PollManager::getPollSet(uint32_t index)
+{
+  if (index == 0)
+  {
+    return poll_set_;
+  }
+
+  boost::mutex::scoped_lock lock(shards_mutex_);
+  ROS_ASSERT(index - 1 < shards_.size());
+  return *shards_[index - 1];
+}
+
+uint32_t PollManager::getNumPollSets()
+{
+  boost::mutex::scoped_lock lock(shards_mutex_);
+  return shards_.size() + 1;
+}
+
 void PollManager::start()
 {
   shutting_down_ = false;
+
+  {
+    boost::mutex::scoped_lock lock(shards_mutex_);
+    while (shards_.size() + 1 < num_threads_)
+    {
+      shards_.push_back(boost::make_shared<PollSet>());
+    }
+
+    for (size_t i = 0; i < shards_.size(); ++i)
+    {
+      shard_threads_.push_back(boost::make_shared<boost::thread>(&PollManager::shardThreadFunc, this, shards_[i].get()));
+    }
+  }
+
   thread_ = boost::thread(&PollManager::threadFunc, this);
 }
 
@@ -68,6 +110,15 @@ void PollManager::shutdown()
     thread_.join();
   }
 
+  for (size_t i = 0; i < shard_threads_.size(); ++i)
+  {
+    if (shard_threads_[i]->get_id() != boost::this_thread::get_id())
+    {
+      shard_threads_[i]->join();
+    }
+  }
+  shard_threads_.clear();
+
   boost::recursive_mutex::scoped_lock lock(signal_mutex_);
   poll_signal_.disconnect_all_slots();
 }
@@ -94,6 +145,17 @@ void PollManager::threadFunc()
   }
 }
 
+void PollManager::shardThreadFunc(PollSet* poll_set)
+{
+  disableAllSignalsInThisThread();
+
+  // Shards only service their sockets; poll thread listeners run exclusively on the primary thread
+  while (!shutting_down_)
+  {
+    poll_set->update(100);
+  }
+}
+
 boost::signals2::connection PollManager::addPollThreadListener(const VoidFunc& func)
 {
   boost::recursive_mutex::scoped_lock lock(signal_mutex_);
@@ -32,6 +32,8 @@
  *  POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include "config.h"
+
 #include "ros/poll_set.h"
 #include "ros/file_log.h"
 
@@ -47,7 +49,7 @@ namespace ros
 {
 
 PollSet::PollSet()
-    : sockets_changed_(false), epfd_(create_socket_watcher())
+    : sockets_changed_(false), signal_pending_(false), epfd_(create_socket_watcher())
 {
 	if ( create_signal_pair(signal_pipe_) != 0 ) {
         ROS_FATAL("create_signal_pair() failed");
@@ -55,6 +57,14 @@ PollSet::PollSet()
   }
   addSocket(signal_pipe_[0], boost::bind(&PollSet::onLocalPipeEvents, this, _1));
   addEvents(signal_pipe_[0], POLLIN);
+
+#if defined(HAVE_EPOLL)
+  // The signal pipe is always drained completely, so it is safe to only be told about new writes to it.  Transport
+  // sockets stay level-triggered: their handlers may stop reading early (eg. when a read callback is not re-armed,
+  // or a try-lock fails because another thread is already reading) and rely on being reported again.
+  set_events_on_socket(epfd_, signal_pipe_[0], POLLIN, true);
+  events_.resize(ROS_MAX_SOCKET_EVENTS);
+#endif
 }
 
 PollSet::~PollSet()
@@ -171,21 +181,42 @@ bool PollSet::delEvents(int sock, int events)
 
 void PollSet::signal()
 {
-  boost::mutex::scoped_try_lock lock(signal_mutex_);
-
-  if (lock.owns_lock())
+  // Never skip the write while another signal may be consumed concurrently: a wakeup that is dropped strands whatever
+  // the caller just queued until the next poll timeout.  Writing only when no signal is outstanding is still enough,
+  // since onLocalPipeEvents() clears the flag before draining, and the poll thread runs its listeners after that.
+  if (!signal_pending_.exchange(true))
   {
-    char b = 0;
-    if (write_signal(signal_pipe_[1], &b, 1) < 0)
+    // 8 bytes, as that's what an eventfd expects.  The value is what an eventfd adds to its counter.
+    uint64_t b = 1;
+    if (write_signal(signal_pipe_[1], (const char*)&b, sizeof(b)) < 0)
     {
-      // do nothing... this prevents warnings on gcc 4.3
+      // Nothing was written, so let the next signal() try again
+      signal_pending_.store(false);
     }
   }
 }
 
+size_t PollSet::getNumSockets()
+{
+  boost::mutex::scoped_lock lock(socket_info_mutex_);
+  return socket_info_.size();
+}
 
 void PollSet::update(int poll_timeout)
 {
+#if defined(HAVE_EPOLL)
+  // epoll keeps a persistent registration of our sockets (maintained by addSocket/delSocket/addEvents/delEvents),
+  // so there is no native pollset to rebuild, and the events land in a buffer we reuse on every call
+  int count = wait_for_socket_events(epfd_, &events_.front(), events_.size(), poll_timeout);
+  if (count < 0)
+  {
+    ROS_ERROR_STREAM("poll failed with error " << last_socket_error_string());
+  }
+  else
+  {
+    dispatchEvents(&events_.front(), count);
+  }
+#else
   //为了poll准备数据结构
   createNativePollset();
 
@@ -196,74 +227,90 @@ void PollSet::update(int poll_timeout)
   {
     ROS_ERROR_STREAM("poll failed with error " << last_socket_error_string());
   }
-  else
+  else if (!ofds->empty())
+  {
+    dispatchEvents(&ofds->front(), ofds->size());
+  }
+#endif
+
+  boost::mutex::scoped_lock lock(just_deleted_mutex_);
+  just_deleted_.clear();
+
+}
+
+void PollSet::dispatchEvents(const socket_pollfd* fds, size_t count)
+{
+  for (size_t i = 0; i < count; ++i)
   {
-    for (std::vector<socket_pollfd>::iterator it = ofds->begin() ; it != ofds->end(); ++it)
+    int fd = fds[i].fd;
+    int revents = fds[i].revents;
+    SocketUpdateFunc func;
+    TransportPtr transport;
+    int events = 0;
+
+    if (revents == 0)//没有需要处理的事件
+    {
+      continue;
+    }
+
+#if defined(HAVE_EPOLL)
+    // Wakeups are the most common event; handle them without going through the socket map
+    if (fd == signal_pipe_[0])
     {
-      int fd = it->fd;
-      int revents = it->revents;
-      SocketUpdateFunc func;
-      TransportPtr transport;
-      int events = 0;
+      onLocalPipeEvents(revents);
+      continue;
+    }
+#endif
 
-      if (revents == 0)//没有需要处理的事件
+    {
+      boost::mutex::scoped_lock lock(socket_info_mutex_);
+      //socket_info_存储了所有需要监控的文件描述符，由于在poll中使用的是另外一个数据结构，在poll的期间这个socket_info_可能有改动，多线程
+      M_SocketInfo::iterator it = socket_info_.find(fd);
+      // the socket has been entirely deleted
+      if (it == socket_info_.end())
       {
         continue;
       }
-      {
-        boost::mutex::scoped_lock lock(socket_info_mutex_);
-		//socket_info_存储了所有需要监控的文件描述符，由于在poll中使用的是另外一个数据结构，在poll的期间这个socket_info_可能有改动，多线程
-        M_SocketInfo::iterator it = socket_info_.find(fd);
-        // the socket has been entirely deleted
-        if (it == socket_info_.end())
-        {
-          continue;
-        }
 
-        const SocketInfo& info = it->second;
+      const SocketInfo& info = it->second;
 
-        // Store off the function and transport in case the socket is deleted from another thread
-		//这样复制出来可以减少锁区域，提高并发度
-        func = info.func_;
-        transport = info.transport_;
-        events = info.events_;
-      }
+      // Store off the function and transport in case the socket is deleted from another thread
+      //这样复制出来可以减少锁区域，提高并发度
+      func = info.func_;
+      transport = info.transport_;
+      events = info.events_;
+    }
 
-      // If these are registered events for this socket, OR the events are ERR/HUP/NVAL,
-      // call through to the registered function
-      if (func
-          && ((events & revents)
-              || (revents & POLLERR)
-              || (revents & POLLHUP)
-              || (revents & POLLNVAL)))
+    // If these are registered events for this socket, OR the events are ERR/HUP/NVAL,
+    // call through to the registered function
+    if (func
+        && ((events & revents)
+            || (revents & POLLERR)
+            || (revents & POLLHUP)
+            || (revents & POLLNVAL)))
+    {
+      bool skip = false;
+      if (revents & (POLLNVAL|POLLERR|POLLHUP))
       {
-        bool skip = false;
-        if (revents & (POLLNVAL|POLLERR|POLLHUP))
+        // If a socket was just closed and then the file descriptor immediately reused, we can
+        // get in here with what we think is a valid socket (since it was just re-added to our set)
+        // but which is actually referring to the previous fd with the same #.  If this is the case,
+        // we ignore the first instance of one of these errors.  If it's a real error we'll
+        // hit it again next time through.
+        //该socket有错误事件，并且不处在just_deleted_列表中
+        boost::mutex::scoped_lock lock(just_deleted_mutex_);
+        if (std::find(just_deleted_.begin(), just_deleted_.end(), fd) != just_deleted_.end())
         {
-          // If a socket was just closed and then the file descriptor immediately reused, we can
-          // get in here with what we think is a valid socket (since it was just re-added to our set)
-          // but which is actually referring to the previous fd with the same #.  If this is the case,
-          // we ignore the first instance of one of these errors.  If it's a real error we'll
-          // hit it again next time through.
-		  //该socket有错误事件，并且不处在just_deleted_列表中
-          boost::mutex::scoped_lock lock(just_deleted_mutex_);
-          if (std::find(just_deleted_.begin(), just_deleted_.end(), fd) != just_deleted_.end())
-          {
-            skip = true;
-          }
+          skip = true;
         }
+      }
 
-        if (!skip)//调用回调函数
-        {
-          func(revents & (events|POLLERR|POLLHUP|POLLNVAL));
-        }
+      if (!skip)//调用回调函数
+      {
+        func(revents & (events|POLLERR|POLLHUP|POLLNVAL));
       }
     }
   }
-
-  boost::mutex::scoped_lock lock(just_deleted_mutex_);
-  just_deleted_.clear();
-
 }
 
 void PollSet::createNativePollset()
@@ -294,8 +341,10 @@ void PollSet::onLocalPipeEvents(int events)
 {
   if(events & POLLIN)
   {
-    char b;
-    while(read_signal(signal_pipe_[0], &b, 1) > 0)
+    signal_pending_.store(false);
+
+    uint64_t b;
+    while(read_signal(signal_pipe_[0], (char*)&b, sizeof(b)) > 0)
     {
       //do nothing keep draining
     };
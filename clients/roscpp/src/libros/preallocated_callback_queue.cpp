@@ -0,0 +1,338 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2009, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage, Inc. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// Make sure we use CLOCK_MONOTONIC for the condition variable wait_for if not Apple.
+#ifndef __APPLE__
+#define BOOST_THREAD_HAS_CONDATTR_SET_CLOCK_MONOTONIC
+#endif
+
+#include "ros/preallocated_callback_queue.h"
+#include "ros/assert.h"
+#include "ros/console.h"
+
+#include <boost/scope_exit.hpp>
+
+namespace ros
+{
+
+PreallocatedCallbackQueue::PreallocatedCallbackQueue(uint32_t capacity, bool enabled)
+: CallbackQueue(enabled)
+, slots_(std::max(capacity, 1U))
+{
+}
+
+PreallocatedCallbackQueue::~PreallocatedCallbackQueue()
+{
+  disable();
+}
+
+void PreallocatedCallbackQueue::clear()
+{
+  boost::mutex::scoped_lock lock(mutex_);
+
+  slots_.clear();
+}
+
+bool PreallocatedCallbackQueue::isEmpty()
+{
+  boost::mutex::scoped_lock lock(mutex_);
+
+  return slots_.empty() && calling_ == 0;
+}
+
+uint32_t PreallocatedCallbackQueue::getCapacity()
+{
+  boost::mutex::scoped_lock lock(mutex_);
+
+  return slots_.capacity();
+}
+
+void PreallocatedCallbackQueue::push(const CallbackInfo& info)
+{
+  if (slots_.full())
+  {
+    ROS_WARN("PreallocatedCallbackQueue: all %u callback slots are in use, growing to %u.  Allocate more slots up front "
+             "to avoid this.", (uint32_t)slots_.capacity(), (uint32_t)slots_.capacity() * 2);
+    slots_.set_capacity(slots_.capacity() * 2);
+  }
+
+  slots_.push_back(info);
+}
+
+void PreallocatedCallbackQueue::addCallback(const CallbackInterfacePtr& callback, uint64_t removal_id)
+{
+  CallbackInfo info;
+  info.callback = callback;
+  info.removal_id = removal_id;
+
+  {
+    boost::mutex::scoped_lock lock(id_info_mutex_);
+
+    M_IDInfo::iterator it = id_info_.find(removal_id);
+    if (it == id_info_.end())
+    {
+      IDInfoPtr id_info(boost::make_shared<IDInfo>());
+      id_info->id = removal_id;
+      id_info_.insert(std::make_pair(removal_id, id_info));
+    }
+  }
+
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    if (!enabled_)
+    {
+      return;
+    }
+
+    push(info);
+  }
+
+  condition_.notify_one();
+}
+
+void PreallocatedCallbackQueue::requeueCallback(const CallbackInfo& info)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  push(info);
+}
+
+void PreallocatedCallbackQueue::eraseQueuedCallbacks(uint64_t removal_id)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+
+  // Compact in place, erase() would shift everything after each removed callback
+  boost::circular_buffer<CallbackInfo>::iterator out = slots_.begin();
+  boost::circular_buffer<CallbackInfo>::iterator it = slots_.begin();
+  for (; it != slots_.end(); ++it)
+  {
+    if (it->removal_id != removal_id)
+    {
+      if (out != it)
+      {
+        *out = *it;
+      }
+      ++out;
+    }
+  }
+
+  slots_.erase_end(slots_.end() - out);
+}
+
+void PreallocatedCallbackQueue::erase(boost::circular_buffer<CallbackInfo>::iterator& it)
+{
+  if (it == slots_.begin())
+  {
+    slots_.pop_front();
+    it = slots_.begin();
+  }
+  else
+  {
+    it = slots_.erase(it);
+  }
+}
+
+bool PreallocatedCallbackQueue::popReady(CallbackInfo& info)
+{
+  boost::circular_buffer<CallbackInfo>::iterator it = slots_.begin();
+  while (it != slots_.end())
+  {
+    if (it->marked_for_removal)
+    {
+      erase(it);
+      continue;
+    }
+
+    if (it->callback->ready())
+    {
+      info = *it;
+      erase(it);
+      return true;
+    }
+
+    ++it;
+  }
+
+  return false;
+}
+
+CallbackQueue::CallOneResult PreallocatedCallbackQueue::call(const CallbackInfo& info)
+{
+  TLS* tls = tls_.get();
+  CallOneResult res = Called;
+
+  if (tls->calling_in_this_thread != 0xffffffffffffffffULL || !tls->callbacks.empty())
+  {
+    // Recursive call (or callbacks left over from one): go through the thread-local list like CallbackQueue does, so
+    // removeByID() can see everything this thread has popped
+    bool was_empty = tls->callbacks.empty();
+    tls->callbacks.push_back(info);
+    if (was_empty)
+    {
+      tls->cb_it = tls->callbacks.begin();
+    }
+
+    res = callOneCB(tls);
+  }
+  else
+  {
+    // Nothing else is held by this thread, so call it straight away rather than through the list, which would
+    // allocate and free deque blocks as callbacks go through it
+    IDInfoPtr id_info = getIDInfo(info.removal_id);
+    if (id_info)
+    {
+      boost::shared_lock<boost::shared_mutex> rw_lock(id_info->calling_rw_mutex);
+
+      CallbackInterface::CallResult result = CallbackInterface::Invalid;
+      tls->calling_in_this_thread = id_info->id;
+      {
+        BOOST_SCOPE_EXIT(&tls)
+        {
+          tls->calling_in_this_thread = 0xffffffffffffffffULL;
+        }
+        BOOST_SCOPE_EXIT_END
+
+        result = info.callback->call();
+      }
+
+      if (result == CallbackInterface::TryAgain)
+      {
+        requeueCallback(info);
+        res = TryAgain;
+      }
+    }
+  }
+
+  if (res != Empty)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    --calling_;
+  }
+  return res;
+}
+
+CallbackQueue::CallOneResult PreallocatedCallbackQueue::callOne(ros::WallDuration timeout)
+{
+  setupTLS();
+
+  CallbackInfo cb_info;
+
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    if (!enabled_)
+    {
+      return Disabled;
+    }
+
+    if (slots_.empty())
+    {
+      if (!timeout.isZero())
+      {
+        condition_.wait_for(lock, boost::chrono::nanoseconds(timeout.toNSec()));
+      }
+
+      if (slots_.empty())
+      {
+        return Empty;
+      }
+
+      if (!enabled_)
+      {
+        return Disabled;
+      }
+    }
+
+    if (!popReady(cb_info))
+    {
+      return TryAgain;
+    }
+
+    ++calling_;
+  }
+
+  return call(cb_info);
+}
+
+void PreallocatedCallbackQueue::callAvailable(ros::WallDuration timeout)
+{
+  setupTLS();
+
+  size_t available = 0;
+
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    if (!enabled_)
+    {
+      return;
+    }
+
+    if (slots_.empty())
+    {
+      if (!timeout.isZero())
+      {
+        condition_.wait_for(lock, boost::chrono::nanoseconds(timeout.toNSec()));
+      }
+
+      if (slots_.empty() || !enabled_)
+      {
+        return;
+      }
+    }
+
+    available = slots_.size();
+  }
+
+  // One at a time, so nothing sits in the thread-local list
+  for (size_t i = 0; i < available; ++i)
+  {
+    CallbackInfo cb_info;
+
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+
+      if (!enabled_ || !popReady(cb_info))
+      {
+        return;
+      }
+
+      ++calling_;
+    }
+
+    call(cb_info);
+  }
+}
+
+}
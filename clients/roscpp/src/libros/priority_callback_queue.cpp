@@ -0,0 +1,301 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2009, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage, Inc. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// Make sure we use CLOCK_MONOTONIC for the condition variable wait_for if not Apple.
+#ifndef __APPLE__
+#define BOOST_THREAD_HAS_CONDATTR_SET_CLOCK_MONOTONIC
+#endif
+
+#include "ros/priority_callback_queue.h"
+#include "ros/assert.h"
+
+namespace ros
+{
+
+bool PriorityCallbackQueue::CallbackInfoLess::operator()(const CallbackInfo& lhs, const CallbackInfo& rhs) const
+{
+  if (lhs.priority != rhs.priority)
+  {
+    return lhs.priority > rhs.priority;
+  }
+
+  if (lhs.deadline != rhs.deadline)
+  {
+    // No deadline sorts after any deadline
+    if (lhs.deadline.isZero())
+    {
+      return false;
+    }
+    if (rhs.deadline.isZero())
+    {
+      return true;
+    }
+
+    return lhs.deadline < rhs.deadline;
+  }
+
+  return lhs.sequence < rhs.sequence;
+}
+
+PriorityCallbackQueue::PriorityCallbackQueue(bool enabled)
+: CallbackQueue(enabled)
+, next_sequence_(0)
+{
+}
+
+PriorityCallbackQueue::~PriorityCallbackQueue()
+{
+  disable();
+}
+
+void PriorityCallbackQueue::clear()
+{
+  boost::mutex::scoped_lock lock(mutex_);
+
+  queue_.clear();
+}
+
+bool PriorityCallbackQueue::isEmpty()
+{
+  boost::mutex::scoped_lock lock(mutex_);
+
+  return queue_.empty() && calling_ == 0;
+}
+
+void PriorityCallbackQueue::addCallback(const CallbackInterfacePtr& callback, uint64_t removal_id)
+{
+  CallbackInfo info;
+  info.callback = callback;
+  info.removal_id = removal_id;
+  info.priority = callback->getPriority();
+
+  WallDuration deadline = callback->getDeadline();
+  if (!deadline.isZero())
+  {
+    info.deadline = SteadyTime::now() + deadline;
+  }
+
+  {
+    boost::mutex::scoped_lock lock(id_info_mutex_);
+
+    M_IDInfo::iterator it = id_info_.find(removal_id);
+    if (it == id_info_.end())
+    {
+      IDInfoPtr id_info(boost::make_shared<IDInfo>());
+      id_info->id = removal_id;
+      id_info_.insert(std::make_pair(removal_id, id_info));
+    }
+  }
+
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    if (!enabled_)
+    {
+      return;
+    }
+
+    info.sequence = next_sequence_++;
+    queue_.insert(info);
+  }
+
+  condition_.notify_one();
+}
+
+void PriorityCallbackQueue::requeueCallback(const CallbackInfo& info)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+
+  CallbackInfo requeued = info;
+  requeued.sequence = next_sequence_++;
+  queue_.insert(requeued);
+}
+
+void PriorityCallbackQueue::eraseQueuedCallbacks(uint64_t removal_id)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+
+  S_CallbackInfo::iterator it = queue_.begin();
+  while (it != queue_.end())
+  {
+    if (it->removal_id == removal_id)
+    {
+      queue_.erase(it++);
+    }
+    else
+    {
+      ++it;
+    }
+  }
+}
+
+bool PriorityCallbackQueue::popReady(CallbackInfo& info)
+{
+  S_CallbackInfo::iterator it = queue_.begin();
+  while (it != queue_.end())
+  {
+    if (it->marked_for_removal)
+    {
+      queue_.erase(it++);
+      continue;
+    }
+
+    if (it->callback->ready())
+    {
+      info = *it;
+      queue_.erase(it);
+      return true;
+    }
+
+    ++it;
+  }
+
+  return false;
+}
+
+CallbackQueue::CallOneResult PriorityCallbackQueue::call(const CallbackInfo& info)
+{
+  TLS* tls = tls_.get();
+
+  bool was_empty = tls->callbacks.empty();
+  tls->callbacks.push_back(info);
+  if (was_empty)
+  {
+    tls->cb_it = tls->callbacks.begin();
+  }
+
+  CallOneResult res = callOneCB(tls);
+  if (res != Empty)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    --calling_;
+  }
+  return res;
+}
+
+CallbackQueue::CallOneResult PriorityCallbackQueue::callOne(ros::WallDuration timeout)
+{
+  setupTLS();
+
+  CallbackInfo cb_info;
+
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    if (!enabled_)
+    {
+      return Disabled;
+    }
+
+    if (queue_.empty())
+    {
+      if (!timeout.isZero())
+      {
+        condition_.wait_for(lock, boost::chrono::nanoseconds(timeout.toNSec()));
+      }
+
+      if (queue_.empty())
+      {
+        return Empty;
+      }
+
+      if (!enabled_)
+      {
+        return Disabled;
+      }
+    }
+
+    if (!popReady(cb_info))
+    {
+      return TryAgain;
+    }
+
+    ++calling_;
+  }
+
+  return call(cb_info);
+}
+
+void PriorityCallbackQueue::callAvailable(ros::WallDuration timeout)
+{
+  setupTLS();
+
+  size_t available = 0;
+
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    if (!enabled_)
+    {
+      return;
+    }
+
+    if (queue_.empty())
+    {
+      if (!timeout.isZero())
+      {
+        condition_.wait_for(lock, boost::chrono::nanoseconds(timeout.toNSec()));
+      }
+
+      if (queue_.empty() || !enabled_)
+      {
+        return;
+      }
+    }
+
+    available = queue_.size();
+  }
+
+  // Pop one at a time rather than taking the whole queue, so callbacks added while we're calling still get their turn
+  // by priority
+  for (size_t i = 0; i < available; ++i)
+  {
+    CallbackInfo cb_info;
+
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+
+      if (!enabled_ || !popReady(cb_info))
+      {
+        return;
+      }
+
+      ++calling_;
+    }
+
+    call(cb_info);
+  }
+}
+
+}
@@ -31,11 +31,13 @@
 #include "ros/callback_queue_interface.h"
 #include "ros/single_subscriber_publisher.h"
 #include "ros/serialization.h"
-#include <std_msgs/Header.h>
 
 namespace ros
 {
 
+/// Where std_msgs/Header::seq lives in a serialized message that starts with a header: right after the 4 byte length
+static const uint32_t HEADER_SEQ_OFFSET = 4;
+
 class PeerConnDisconnCallback : public CallbackInterface
 {
 public:
@@ -165,17 +167,13 @@ bool Publication::enqueueMessage(const SerializedMessage& m)
   ROS_ASSERT(m.buf);
 
   uint32_t seq = incrementSequence();
-  if (has_header_)
+  if (has_header_ && m.num_bytes >= HEADER_SEQ_OFFSET + sizeof(seq))
   {
-    // If we have a header, we know it's immediately after the message length
-    // Deserialize it, write the sequence, and then serialize it again.
+    // If we have a header, we know it's immediately after the message length, and seq is its first field.
+    // Write the sequence in place, the same buffer is shared by all subscriber links.
     namespace ser = ros::serialization;
-    std_msgs::Header header;
-    ser::IStream istream(m.buf.get() + 4, m.num_bytes - 4);
-    ser::deserialize(istream, header);
-    header.seq = seq;
-    ser::OStream ostream(m.buf.get() + 4, m.num_bytes - 4);
-    ser::serialize(ostream, header);
+    ser::OStream ostream(m.buf.get() + HEADER_SEQ_OFFSET, sizeof(seq));
+    ser::serialize(ostream, seq);
   }
 
   for(V_SubscriberLink::iterator i = subscriber_links_.begin();
@@ -276,12 +274,33 @@ XmlRpc::XmlRpcValue Publication::getStats()
     conn_data[cidx][2] = (int)s.message_data_sent_;
     conn_data[cidx][3] = (int)s.messages_sent_;
     conn_data[cidx][4] = 0; // not sure what is meant by connected
+    // roscpp extension: outbox latency (ns) and message size (bytes), see Histogram::getStats()
+    (*c)->getLatencyHistogram()->getStats(conn_data[cidx][5]);
+    (*c)->getSizeHistogram()->getStats(conn_data[cidx][6]);
   }
 
   stats[1] = conn_data;
   return stats;
 }
 
+void Publication::getHistograms(V_ConnectionHistograms& histograms)
+{
+  boost::mutex::scoped_lock lock(subscriber_links_mutex_);
+
+  for (V_SubscriberLink::iterator c = subscriber_links_.begin();
+       c != subscriber_links_.end(); ++c)
+  {
+    ConnectionHistograms h;
+    h.topic_ = name_;
+    h.connection_id_ = (*c)->getConnectionID();
+    h.direction_ = "o";
+    h.remote_caller_id_ = (*c)->getDestinationCallerID();
+    h.latency_ = (*c)->getLatencyHistogram()->getSnapshot();
+    h.size_ = (*c)->getSizeHistogram()->getSnapshot();
+    histograms.push_back(h);
+  }
+}
+
 // Publisher : [(connection_id, destination_caller_id, direction, transport, topic_name, connected, connection_info_string)*]
 // e.g. [(2, '/listener', 'o', 'TCPROS', '/chatter', 1, 'TCPROS connection on port 55878 to [127.0.0.1:44273 on socket 7]')]
 void Publication::getInfo(XmlRpc::XmlRpcValue& info)
@@ -400,7 +419,7 @@ bool Publication::hasSubscribers()
   return !subscriber_links_.empty();
 }
 
-void Publication::publish(SerializedMessage& m)
+bool Publication::publish(SerializedMessage& m, const boost::function<SerializedMessage(void)>& serfunc, const VoidConstPtr& message)
 {
   if (m.message)
   {
@@ -419,16 +438,29 @@ void Publication::publish(SerializedMessage& m)
     m.message.reset();
   }
 
-  if (m.buf)
+  if (m.buf || serfunc)
   {
     boost::mutex::scoped_lock lock(publish_queue_mutex_);
-    publish_queue_.push_back(m);
+    bool was_empty = publish_queue_.empty();
+
+    publish_queue_.push_back(QueuedMessage());
+    QueuedMessage& queued = publish_queue_.back();
+    queued.m = m;
+    if (!m.buf)
+    {
+      queued.serfunc = serfunc;
+      queued.message = message;
+    }
+
+    return was_empty;
   }
+
+  return false;
 }
 
 void Publication::processPublishQueue()
 {
-  V_SerializedMessage queue;
+  V_QueuedMessage queue;
   {
     boost::mutex::scoped_lock lock(publish_queue_mutex_);
 
@@ -437,8 +469,7 @@ void Publication::processPublishQueue()
       return;
     }
     //将成员变量内容拷贝到局部变量，防止锁阻塞
-    queue.insert(queue.end(), publish_queue_.begin(), publish_queue_.end());
-    publish_queue_.clear();
+    queue.swap(publish_queue_);
   }
 
   if (queue.empty())
@@ -446,11 +477,33 @@ void Publication::processPublishQueue()
     return;
   }
 
-  V_SerializedMessage::iterator it = queue.begin();
-  V_SerializedMessage::iterator end = queue.end();
+  V_QueuedMessage::iterator it = queue.begin();
+  V_QueuedMessage::iterator end = queue.end();
   for (; it != end; ++it)
   {
-    enqueueMessage(*it);
+    QueuedMessage& queued = *it;
+    if (queued.serfunc)
+    {
+      // Deferred from publish(), so the publishing thread doesn't pay for it
+      SerializedMessage m2;
+      try
+      {
+        m2 = queued.serfunc();
+      }
+      catch (std::exception& e)
+      {
+        ROS_ERROR("Failed to serialize message on topic [%s]: %s", name_.c_str(), e.what());
+        continue;
+      }
+
+      queued.m.buf = m2.buf;
+      queued.m.num_bytes = m2.num_bytes;
+      queued.m.message_start = m2.message_start;
+      queued.serfunc.clear();
+      queued.message.reset();
+    }
+
+    enqueueMessage(queued.m);
   }
 }
 
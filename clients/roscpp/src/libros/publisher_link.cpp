@@ -42,6 +42,7 @@
 #include "ros/file_log.h"
 
 #include <boost/bind.hpp>
+#include <boost/make_shared.hpp>
 
 #include <sstream>
 
@@ -53,6 +54,8 @@ PublisherLink::PublisherLink(const SubscriptionPtr& parent, const std::string& x
 : parent_(parent)
 , connection_id_(0)
 , publisher_xmlrpc_uri_(xmlrpc_uri)
+, latency_histogram_(boost::make_shared<Histogram>())
+, size_histogram_(boost::make_shared<Histogram>())
 , transport_hints_(transport_hints)
 , latched_(false)
 { }
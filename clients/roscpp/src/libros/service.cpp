@@ -67,6 +67,9 @@ bool service::exists(const std::string& service_name, bool print_failure_reason)
     }
     else
     {
+      // The URI may have been cached from before the service moved, so look it up again next time
+      ServiceManager::instance()->invalidateServiceURI(mapped_name);
+
       if (print_failure_reason)
       {
         ROS_INFO("waitForService: Service [%s] could not connect to host [%s:%d], waiting...", mapped_name.c_str(), host.c_str(), port);
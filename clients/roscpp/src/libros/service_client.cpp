@@ -30,12 +30,69 @@
 #include "ros/connection.h"
 #include "ros/service_manager.h"
 #include "ros/service.h"
+#include "ros/callback_queue.h"
+#include "ros/init.h"
 
 namespace ros
 {
 
+namespace
+{
+
+/**
+ * \brief Hands the result of an asynchronous service call to its completion function from a callback queue
+ */
+class ServiceCallFinishedCallback : public CallbackInterface
+{
+public:
+  ServiceCallFinishedCallback(const ServiceClient::SerializedCallFinishedFn& callback, bool success, const SerializedMessage& resp)
+  : callback_(callback)
+  , success_(success)
+  , resp_(resp)
+  {}
+
+  virtual CallResult call()
+  {
+    callback_(success_, resp_);
+    return Success;
+  }
+
+private:
+  ServiceClient::SerializedCallFinishedFn callback_;
+  bool success_;
+  SerializedMessage resp_;
+};
+
+void queueCallFinished(CallbackQueueInterface* queue, uint64_t removal_id, const ServiceClient::SerializedCallFinishedFn& callback,
+                       bool success, const SerializedMessage& resp)
+{
+  queue->addCallback(boost::make_shared<ServiceCallFinishedCallback>(callback, success, resp), removal_id);
+}
+
+// Hands a link borrowed from the pool back once the call on it has finished
+void releaseLink(const ServiceServerLinkPtr& link, bool pooled)
+{
+  if (pooled)
+  {
+    ServiceManager::instance()->releaseServiceServerLink(link);
+  }
+}
+
+// Holds a reference to the link until the call on it has finished, since for non-persistent services nothing else does
+void callOnLinkFinished(const ServiceServerLinkPtr& link, bool pooled, const ServiceClient::SerializedCallFinishedFn& callback,
+                        bool success, const SerializedMessage& resp)
+{
+  releaseLink(link, pooled);
+  callback(success, resp);
+}
+
+} // namespace
+
 ServiceClient::Impl::Impl() 
-  : is_shutdown_(false)
+  : persistent_(false)
+  , pooled_(false)
+  , pipeline_depth_(1)
+  , is_shutdown_(false)
 { }
 
 ServiceClient::Impl::~Impl()
@@ -52,10 +109,15 @@ void ServiceClient::Impl::shutdown()
       is_shutdown_ = true;
     }
 
-    if (server_link_)
+    ServiceServerLinkPtr link;
+    {
+      boost::mutex::scoped_lock lock(server_link_mutex_);
+      link.swap(server_link_);
+    }
+
+    if (link)
     {
-      server_link_->getConnection()->drop(Connection::Destructing);
-      server_link_.reset();
+      link->getConnection()->drop(Connection::Destructing);
     }
   }
 }
@@ -73,25 +135,80 @@ bool ServiceClient::Impl::isValid() const
     return false;
   }
 
-  if (!server_link_)
+  ServiceServerLinkPtr link;
+  {
+    boost::mutex::scoped_lock lock(server_link_mutex_);
+    link = server_link_;
+  }
+
+  if (!link)
   {
     return false;
   }
 
-  return server_link_->isValid();
+  return link->isValid();
+}
+
+ServiceServerLinkPtr ServiceClient::Impl::acquireLink(const std::string& service_md5sum)
+{
+  if (persistent_)
+  {
+    boost::mutex::scoped_lock lock(server_link_mutex_);
+    if (!server_link_)
+    {
+      server_link_ = ServiceManager::instance()->createServiceServerLink(name_, persistent_, service_md5sum, service_md5sum, header_values_);
+
+      if (server_link_)
+      {
+        server_link_->setPipelineDepth(pipeline_depth_);
+      }
+    }
+
+    return server_link_;
+  }
+
+  if (pooled_)
+  {
+    return ServiceManager::instance()->acquireServiceServerLink(name_, service_md5sum, service_md5sum, header_values_);
+  }
+
+  return ServiceManager::instance()->createServiceServerLink(name_, persistent_, service_md5sum, service_md5sum, header_values_);
+}
+
+void ServiceClient::Impl::resetLink(const ServiceServerLinkPtr& link)
+{
+  boost::mutex::scoped_lock lock(server_link_mutex_);
+  // Another call may already have replaced it with a working link
+  if (server_link_ == link)
+  {
+    server_link_.reset();
+  }
 }
 
 ServiceClient::ServiceClient(const std::string& service_name, bool persistent, const M_string& header_values, const std::string& service_md5sum)
-: impl_(new Impl)
 {
-  impl_->name_ = service_name;
-  impl_->persistent_ = persistent;
-  impl_->header_values_ = header_values;
-  impl_->service_md5sum_ = service_md5sum;
+  ServiceClientOptions ops(service_name, service_md5sum, persistent, header_values);
+  init(ops);
+}
+
+ServiceClient::ServiceClient(const ServiceClientOptions& ops)
+{
+  init(ops);
+}
+
+void ServiceClient::init(const ServiceClientOptions& ops)
+{
+  impl_.reset(new Impl);
+  impl_->name_ = ops.service;
+  impl_->persistent_ = ops.persistent;
+  impl_->pooled_ = ops.pooled;
+  impl_->pipeline_depth_ = ops.pipeline_depth;
+  impl_->header_values_ = ops.header;
+  impl_->service_md5sum_ = ops.md5sum;
 
-  if (persistent)
+  if (impl_->persistent_)
   {
-    impl_->server_link_ = ServiceManager::instance()->createServiceServerLink(impl_->name_, impl_->persistent_, impl_->service_md5sum_, impl_->service_md5sum_, impl_->header_values_);
+    impl_->acquireLink(impl_->service_md5sum_);
   }
 }
 
@@ -114,35 +231,34 @@ bool ServiceClient::call(const SerializedMessage& req, SerializedMessage& resp,
     return false;
   }
 
-  ServiceServerLinkPtr link;
-
-  if (impl_->persistent_)
+  ServiceServerLinkPtr link = impl_->acquireLink(service_md5sum);
+  if (!link)
   {
-    if (!impl_->server_link_)
-    {
-      impl_->server_link_ = ServiceManager::instance()->createServiceServerLink(impl_->name_, impl_->persistent_, service_md5sum, service_md5sum, impl_->header_values_);
+    return false;
+  }
 
-      if (!impl_->server_link_)
-      {
-        return false;
-      }
-    }
+  bool ret = link->call(req, resp);
+  bool retry = !ret && link->droppedBeforeHeader();
+  releaseLink(link, impl_->pooled_ && !impl_->persistent_);
 
-    link = impl_->server_link_;
-  }
-  else
+  // The server went away before it saw the request.  The connection is non-blocking, so this is also how a stale cached
+  // URI (eg. of a server restarted on another port) shows up; it has been invalidated, so try once more via the master
+  if (retry)
   {
-    link = ServiceManager::instance()->createServiceServerLink(impl_->name_, impl_->persistent_, service_md5sum, service_md5sum, impl_->header_values_);
+    if (impl_->persistent_)
+    {
+      impl_->resetLink(link);
+    }
 
-    if (!link)
+    link = impl_->acquireLink(service_md5sum);
+    if (link)
     {
-      return false;
+      ret = link->call(req, resp);
+      releaseLink(link, impl_->pooled_ && !impl_->persistent_);
+      link.reset();
     }
   }
 
-  bool ret = link->call(req, resp);
-  link.reset();
-
   // If we're shutting down but the node haven't finished yet, wait until we do
   while (ros::isShuttingDown() && ros::ok())
   {
@@ -152,6 +268,44 @@ bool ServiceClient::call(const SerializedMessage& req, SerializedMessage& resp,
   return ret;
 }
 
+void ServiceClient::callAsync(const SerializedMessage& req, const std::string& service_md5sum, const SerializedCallFinishedFn& callback,
+                              CallbackQueueInterface* callback_queue)
+{
+  SerializedCallFinishedFn finished = callback;
+  if (callback_queue)
+  {
+    finished = boost::bind(queueCallFinished, callback_queue, (uint64_t)impl_.get(), callback, _1, _2);
+  }
+
+  if (!isValid())
+  {
+    finished(false, SerializedMessage());
+    return;
+  }
+
+  if (service_md5sum != impl_->service_md5sum_)
+  {
+    ROS_ERROR("Call to service [%s] with md5sum [%s] does not match md5sum when the handle was created ([%s])", impl_->name_.c_str(), service_md5sum.c_str(), impl_->service_md5sum_.c_str());
+
+    finished(false, SerializedMessage());
+    return;
+  }
+
+  ServiceServerLinkPtr link = impl_->acquireLink(service_md5sum);
+  if (!link)
+  {
+    finished(false, SerializedMessage());
+    return;
+  }
+
+  link->callAsync(req, boost::bind(callOnLinkFinished, link, impl_->pooled_ && !impl_->persistent_, finished, _1, _2));
+}
+
+CallbackQueueInterface* ServiceClient::getCallbackQueue(CallbackQueueInterface* queue)
+{
+  return queue ? queue : getGlobalCallbackQueue();
+}
+
 bool ServiceClient::isValid() const
 {
   if (!impl_)
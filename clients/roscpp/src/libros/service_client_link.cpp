@@ -43,11 +43,19 @@
 
 #include <boost/bind.hpp>
 
+#include <algorithm>
+
 namespace ros
 {
 
 ServiceClientLink::ServiceClientLink()
 : persistent_(false)
+, max_outstanding_(1)
+, outstanding_(0)
+, next_request_seq_(0)
+, next_response_seq_(0)
+, reading_(false)
+, writing_(false)
 {
 }
 
@@ -144,6 +152,7 @@ bool ServiceClientLink::handleHeader(const Header& header)
   else
   {
     parent_ = ServicePublicationWPtr(ss);
+    max_outstanding_ = std::max(ss->getMaxConcurrentCalls(), 1U);
 
     // Send back a success, with info
     M_string m;
@@ -174,6 +183,11 @@ void ServiceClientLink::onConnectionDropped(const ConnectionPtr& conn)
 void ServiceClientLink::onHeaderWritten(const ConnectionPtr& conn)
 {
   (void)conn;
+  {
+    boost::mutex::scoped_lock lock(responses_mutex_);
+    reading_ = true;
+  }
+
   connection_->read(4, boost::bind(&ServiceClientLink::onRequestLength, this, _1, _2, _3, _4));
 }
 
@@ -209,14 +223,35 @@ void ServiceClientLink::onRequest(const ConnectionPtr& conn, const boost::shared
 
   ROS_ASSERT(conn == connection_);
 
+  uint32_t seq = 0;
+  bool read_next = false;
+  {
+    boost::mutex::scoped_lock lock(responses_mutex_);
+    reading_ = false;
+    seq = next_request_seq_++;
+    ++outstanding_;
+
+    // Read ahead while the service can take more of our requests at once
+    if (persistent_ && outstanding_ < max_outstanding_)
+    {
+      reading_ = true;
+      read_next = true;
+    }
+  }
+
   if (ServicePublicationPtr parent = parent_.lock())
   {
-    parent->processRequest(buffer, size, shared_from_this());
+    parent->processRequest(buffer, size, shared_from_this(), seq);
   }
   else
   {
     ROS_BREAK();
   }
+
+  if (read_next)
+  {
+    connection_->read(4, boost::bind(&ServiceClientLink::onRequestLength, this, _1, _2, _3, _4));
+  }
 }
 
 void ServiceClientLink::onResponseWritten(const ConnectionPtr& conn)
@@ -224,19 +259,67 @@ void ServiceClientLink::onResponseWritten(const ConnectionPtr& conn)
   (void)conn;
   ROS_ASSERT(conn == connection_);
 
-  if (persistent_)
+  if (!persistent_)
   {
-    connection_->read(4, boost::bind(&ServiceClientLink::onRequestLength, this, _1, _2, _3, _4));
+    connection_->drop(Connection::Destructing);
+    return;
   }
-  else
+
+  bool read_next = false;
   {
-    connection_->drop(Connection::Destructing);
+    boost::mutex::scoped_lock lock(responses_mutex_);
+    writing_ = false;
+    ++next_response_seq_;
+    --outstanding_;
+
+    if (!reading_ && outstanding_ < max_outstanding_)
+    {
+      reading_ = true;
+      read_next = true;
+    }
+  }
+
+  if (read_next)
+  {
+    connection_->read(4, boost::bind(&ServiceClientLink::onRequestLength, this, _1, _2, _3, _4));
   }
+
+  processNextResponse();
 }
 
-void ServiceClientLink::processResponse(bool ok, const SerializedMessage& res)
+void ServiceClientLink::processResponse(bool ok, const SerializedMessage& res, uint32_t seq)
 {
   (void)ok;
+  {
+    boost::mutex::scoped_lock lock(responses_mutex_);
+    ready_responses_[seq] = res;
+  }
+
+  processNextResponse();
+}
+
+void ServiceClientLink::processNextResponse()
+{
+  SerializedMessage res;
+  {
+    boost::mutex::scoped_lock lock(responses_mutex_);
+
+    if (writing_)
+    {
+      return;
+    }
+
+    std::map<uint32_t, SerializedMessage>::iterator it = ready_responses_.find(next_response_seq_);
+    if (it == ready_responses_.end())
+    {
+      return;
+    }
+
+    res = it->second;
+    ready_responses_.erase(it);
+    writing_ = true;
+  }
+
   connection_->write(res.buf, res.num_bytes, boost::bind(&ServiceClientLink::onResponseWritten, this, _1));
 }
 
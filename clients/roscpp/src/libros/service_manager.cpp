@@ -52,6 +52,10 @@ using namespace std; // sigh
 namespace ros
 {
 
+const ros::WallDuration CachedServiceServerLink::s_zombie_time_(30.0); // reap after 30 seconds
+const uint32_t CachedServiceServerLink::s_max_idle_per_service_ = 8;
+const ros::WallDuration CachedServiceURI::s_ttl_(10.0);
+
 const ServiceManagerPtr& ServiceManager::instance()
 {
   static ServiceManagerPtr service_manager = boost::make_shared<ServiceManager>();
@@ -102,6 +106,11 @@ void ServiceManager::shutdown()
     service_publications_.clear();
   }
 
+  {
+    boost::mutex::scoped_lock lock(pooled_links_mutex_);
+    pooled_links_.clear();
+  }
+
   L_ServiceServerLink local_service_clients;
   {
     boost::mutex::scoped_lock lock(service_server_links_mutex_);
@@ -138,7 +147,8 @@ bool ServiceManager::advertiseService(const AdvertiseServiceOptions& ops)
       return false;
     }
 
-    ServicePublicationPtr pub(boost::make_shared<ServicePublication>(ops.service, ops.md5sum, ops.datatype, ops.req_datatype, ops.res_datatype, ops.helper, ops.callback_queue, ops.tracked_object));
+    ServicePublicationPtr pub(boost::make_shared<ServicePublication>(ops.service, ops.md5sum, ops.datatype, ops.req_datatype, ops.res_datatype, ops.helper, ops.callback_queue, ops.tracked_object,
+                                                                     ops.max_concurrent_calls, ops.max_backlog, ops.priority, ops.deadline));
     service_publications_.push_back(pub);
   }
 
@@ -152,6 +162,8 @@ bool ServiceManager::advertiseService(const AdvertiseServiceOptions& ops)
   args[3] = xmlrpc_manager_->getServerURI();
   master::execute("registerService", args, result, payload, true);
 
+  invalidateServiceURI(ops.service);
+
   return true;
 }
 
@@ -202,6 +214,8 @@ bool ServiceManager::unregisterService(const std::string& service)
 
   master::execute("unregisterService", args, result, payload, false);
 
+  invalidateServiceURI(service);
+
   return true;
 }
 
@@ -247,36 +261,157 @@ ServiceServerLinkPtr ServiceManager::createServiceServerLink(const std::string&
 
   uint32_t serv_port;
   std::string serv_host;
-  if (!lookupService(service, serv_host, serv_port))
+  bool cached = lookupCachedServiceURI(service, serv_host, serv_port);
+  if (!cached && !lookupService(service, serv_host, serv_port, false))
   {
     return ServiceServerLinkPtr();
   }
 
-  TransportTCPPtr transport(boost::make_shared<TransportTCP>(&poll_manager_->getPollSet()));
+  while (true)
+  {
+    TransportTCPPtr transport(boost::make_shared<TransportTCP>(connection_manager_->selectPollSet()));
+
+    // Make sure to initialize the connection *before* transport->connect()
+    // is called, otherwise we might miss a connect error (see #434).
+    ConnectionPtr connection(boost::make_shared<Connection>());
+    connection_manager_->addConnection(connection);
+    connection->initialize(transport, false, HeaderReceivedFunc());
+
+    if (transport->connect(serv_host, serv_port))
+    {
+      ServiceServerLinkPtr client(boost::make_shared<ServiceServerLink>(service, persistent, request_md5sum, response_md5sum, header_values));
+
+      {
+        boost::mutex::scoped_lock lock(service_server_links_mutex_);
+        service_server_links_.push_back(client);
+      }
+
+      client->initialize(connection);
+
+      return client;
+    }
+
+    ROSCPP_LOG_DEBUG("Failed to connect to service [%s] (mapped=[%s]) at [%s:%d]", service.c_str(), service.c_str(), serv_host.c_str(), serv_port);
+    invalidateServiceURI(service);
 
-  // Make sure to initialize the connection *before* transport->connect()
-  // is called, otherwise we might miss a connect error (see #434).
-  ConnectionPtr connection(boost::make_shared<Connection>());
-  connection_manager_->addConnection(connection);
-  connection->initialize(transport, false, HeaderReceivedFunc());
+    // A cached URI may just be stale (eg. the server restarted on another port), so ask the master before giving up.
+    // Only failures connect() sees straight away end up here; the rest drop the link, which ServiceClient::call() retries
+    if (!cached || !lookupService(service, serv_host, serv_port, false))
+    {
+      return ServiceServerLinkPtr();
+    }
+
+    cached = false;
+  }
+}
 
-  if (transport->connect(serv_host, serv_port))
+ServiceServerLinkPtr ServiceManager::acquireServiceServerLink(const std::string& service,
+                                                           const std::string& request_md5sum, const std::string& response_md5sum,
+                                                           const M_string& header_values)
+{
+  L_CachedServiceServerLink toasted;
   {
-    ServiceServerLinkPtr client(boost::make_shared<ServiceServerLink>(service, persistent, request_md5sum, response_md5sum, header_values));
+    boost::mutex::scoped_lock lock(pooled_links_mutex_);
 
+    SteadyTime now = SteadyTime::now();
+    L_CachedServiceServerLink::iterator i = pooled_links_.begin();
+    while (i != pooled_links_.end())
     {
-      boost::mutex::scoped_lock lock(service_server_links_mutex_);
-      service_server_links_.push_back(client);
+      if (i->in_use_)
+      {
+        ++i;
+        continue;
+      }
+
+      const ServiceServerLinkPtr& link = i->link_;
+      if (!link->isValid() || i->last_use_time_ + CachedServiceServerLink::s_zombie_time_ < now)
+      {
+        // toast this guy. he's dead or nobody has reused him for a while.
+        L_CachedServiceServerLink::iterator dead = i++;
+        toasted.splice(toasted.end(), pooled_links_, dead);
+      }
+      else if (link->getServiceName() == service && link->getRequestMD5Sum() == request_md5sum
+               && link->getResponseMD5Sum() == response_md5sum && link->getHeaderValues() == header_values)
+      {
+        i->in_use_ = true;
+        i->last_use_time_ = now;
+        return link;
+      }
+      else
+      {
+        ++i;
+      }
     }
+  }
 
-    client->initialize(connection);
+  // Drop the connections outside the lock, since dropping calls back into removeServiceServerLink()
+  for (L_CachedServiceServerLink::iterator i = toasted.begin(); i != toasted.end(); ++i)
+  {
+    i->link_->getConnection()->drop(Connection::Destructing);
+  }
 
-    return client;
+  ServiceServerLinkPtr link = createServiceServerLink(service, true, request_md5sum, response_md5sum, header_values);
+  if (!link)
+  {
+    return link;
   }
 
-  ROSCPP_LOG_DEBUG("Failed to connect to service [%s] (mapped=[%s]) at [%s:%d]", service.c_str(), service.c_str(), serv_host.c_str(), serv_port);
+  CachedServiceServerLink cached(link);
+  cached.in_use_ = true;
+  cached.last_use_time_ = SteadyTime::now();
+
+  boost::mutex::scoped_lock lock(pooled_links_mutex_);
+  if (shutting_down_)
+  {
+    // shutdown() has already emptied the pool, so the caller is the only one left holding this link
+    return link;
+  }
+  pooled_links_.push_back(cached);
 
-  return ServiceServerLinkPtr();
+  return link;
+}
+
+void ServiceManager::releaseServiceServerLink(const ServiceServerLinkPtr& link)
+{
+  bool drop = false;
+  {
+    boost::mutex::scoped_lock lock(pooled_links_mutex_);
+
+    uint32_t idle = 0;
+    L_CachedServiceServerLink::iterator found = pooled_links_.end();
+    for (L_CachedServiceServerLink::iterator i = pooled_links_.begin(); i != pooled_links_.end(); ++i)
+    {
+      if (i->link_ == link)
+      {
+        found = i;
+      }
+      else if (!i->in_use_ && i->link_->getServiceName() == link->getServiceName())
+      {
+        ++idle;
+      }
+    }
+
+    if (found == pooled_links_.end())
+    {
+      return;
+    }
+
+    if (shutting_down_ || !link->isValid() || idle >= CachedServiceServerLink::s_max_idle_per_service_)
+    {
+      pooled_links_.erase(found);
+      drop = true;
+    }
+    else
+    {
+      found->in_use_ = false;
+      found->last_use_time_ = SteadyTime::now();
+    }
+  }
+
+  if (drop)
+  {
+    link->getConnection()->drop(Connection::Destructing);
+  }
 }
 
 void ServiceManager::removeServiceServerLink(const ServiceServerLinkPtr& client)
@@ -303,8 +438,34 @@ void ServiceManager::removeServiceServerLink(const ServiceServerLinkPtr& client)
   }
 }
 
-bool ServiceManager::lookupService(const string &name, string &serv_host, uint32_t &serv_port)
+bool ServiceManager::lookupCachedServiceURI(const std::string& name, std::string& serv_host, uint32_t& serv_port)
+{
+  boost::mutex::scoped_lock lock(service_uris_mutex_);
+
+  M_CachedServiceURI::iterator it = service_uris_.find(name);
+  if (it == service_uris_.end())
+  {
+    return false;
+  }
+
+  if (it->second.expires_ <= SteadyTime::now())
+  {
+    service_uris_.erase(it);
+    return false;
+  }
+
+  serv_host = it->second.host_;
+  serv_port = it->second.port_;
+  return true;
+}
+
+bool ServiceManager::lookupService(const string &name, string &serv_host, uint32_t &serv_port, bool use_cache)
 {
+  if (use_cache && lookupCachedServiceURI(name, serv_host, serv_port))
+  {
+    return true;
+  }
+
   XmlRpcValue args, result, payload;
   args[0] = this_node::getName();
   args[1] = name;
@@ -326,8 +487,22 @@ bool ServiceManager::lookupService(const string &name, string &serv_host, uint32
     return false;
   }
 
+  CachedServiceURI cached;
+  cached.host_ = serv_host;
+  cached.port_ = serv_port;
+  cached.expires_ = SteadyTime::now() + CachedServiceURI::s_ttl_;
+
+  boost::mutex::scoped_lock lock(service_uris_mutex_);
+  service_uris_[name] = cached;
+
   return true;
 }
 
+void ServiceManager::invalidateServiceURI(const std::string& name)
+{
+  boost::mutex::scoped_lock lock(service_uris_mutex_);
+  service_uris_.erase(name);
+}
+
 } // namespace ros
 
@@ -36,6 +36,7 @@
 #include "ros/service_client_link.h"
 #include "ros/connection.h"
 #include "ros/callback_queue_interface.h"
+#include "ros/file_log.h"
 
 #include <boost/bind.hpp>
 
@@ -46,7 +47,8 @@ namespace ros
 
 ServicePublication::ServicePublication(const std::string& name, const std::string &md5sum, const std::string& data_type, const std::string& request_data_type,
                              const std::string& response_data_type, const ServiceCallbackHelperPtr& helper, CallbackQueueInterface* callback_queue,
-                             const VoidConstPtr& tracked_object)
+                             const VoidConstPtr& tracked_object, uint32_t max_concurrent_calls, uint32_t max_backlog,
+                             int32_t priority, const WallDuration& deadline)
 : name_(name)
 , md5sum_(md5sum)
 , data_type_(data_type)
@@ -57,6 +59,11 @@ ServicePublication::ServicePublication(const std::string& name, const std::strin
 , callback_queue_(callback_queue)
 , has_tracked_object_(false)
 , tracked_object_(tracked_object)
+, max_concurrent_calls_(max_concurrent_calls)
+, max_backlog_(max_backlog)
+, priority_(priority)
+, deadline_(deadline)
+, active_calls_(0)
 {
   if (tracked_object)
   {
@@ -80,23 +87,65 @@ void ServicePublication::drop()
 
   dropAllConnections();
 
+  {
+    boost::mutex::scoped_lock lock(calls_mutex_);
+    backlog_.clear();
+  }
+
   callback_queue_->removeByID((uint64_t)this);
 }
 
 class ServiceCallback : public CallbackInterface
 {
 public:
-  ServiceCallback(const ServiceCallbackHelperPtr& helper, const boost::shared_array<uint8_t>& buf, size_t num_bytes, const ServiceClientLinkPtr& link, bool has_tracked_object, const VoidConstWPtr& tracked_object)
+  ServiceCallback(const ServiceCallbackHelperPtr& helper, const boost::shared_array<uint8_t>& buf, size_t num_bytes, const ServiceClientLinkPtr& link, uint32_t seq,
+                  bool has_tracked_object, const VoidConstWPtr& tracked_object, const ServicePublicationWPtr& limiter,
+                  int32_t priority, const WallDuration& deadline)
   : helper_(helper)
   , buffer_(buf)
   , num_bytes_(num_bytes)
   , link_(link)
+  , seq_(seq)
   , has_tracked_object_(has_tracked_object)
   , tracked_object_(tracked_object)
+  , limiter_(limiter)
+  , priority_(priority)
+  , deadline_(deadline)
   {
   }
 
   virtual CallResult call()
+  {
+    CallResult result = handleRequest();
+
+    // Requests that were never answered still hold their slot
+    releaseSlot();
+
+    return result;
+  }
+
+  virtual int32_t getPriority() { return priority_; }
+  virtual WallDuration getDeadline() { return deadline_; }
+
+private:
+  void releaseSlot()
+  {
+    if (ServicePublicationPtr limiter = limiter_.lock())
+    {
+      limiter_.reset();
+      limiter->callFinished();
+    }
+  }
+
+  // Free the slot before responding: writing the response can read the link's next request and hand it to
+  // processRequest() right away, which must not find the service still busy with this one
+  void respond(bool ok, const SerializedMessage& res)
+  {
+    releaseSlot();
+    link_->processResponse(ok, res, seq_);
+  }
+
+  CallResult handleRequest()
   {
     if (link_->getConnection()->isDropped())
     {
@@ -111,7 +160,7 @@ public:
       if (!tracker)
       {
         SerializedMessage res = serialization::serializeServiceResponse<uint32_t>(false, 0);
-        link_->processResponse(false, res);
+        respond(false, res);
         return Invalid;
       }
     }
@@ -125,12 +174,12 @@ public:
       bool ok = helper_->call(params);
       if (ok != 0)
       {
-        link_->processResponse(true, params.response);
+        respond(true, params.response);
       }
       else
       {
         SerializedMessage res = serialization::serializeServiceResponse<uint32_t>(false, 0);
-        link_->processResponse(false, res);
+        respond(false, res);
       }
     }
     catch (std::exception& e)
@@ -139,28 +188,88 @@ public:
       std_msgs::String error_string;
       error_string.data = e.what();
       SerializedMessage res = serialization::serializeServiceResponse(false, error_string);
-      link_->processResponse(false, res);
+      respond(false, res);
       return Invalid;
     }
 
     return Success;
   }
 
-private:
   ServiceCallbackHelperPtr helper_;
   boost::shared_array<uint8_t> buffer_;
   uint32_t num_bytes_;
   ServiceClientLinkPtr link_;
+  uint32_t seq_;
   bool has_tracked_object_;
   VoidConstWPtr tracked_object_;
+  /// Set when the publication limits concurrent calls, so the slot this call holds can be freed
+  ServicePublicationWPtr limiter_;
+  int32_t priority_;
+  WallDuration deadline_;
 };
 
-void ServicePublication::processRequest(boost::shared_array<uint8_t> buf, size_t num_bytes, const ServiceClientLinkPtr& link)
+void ServicePublication::processRequest(boost::shared_array<uint8_t> buf, size_t num_bytes, const ServiceClientLinkPtr& link, uint32_t seq)
 {
-  CallbackInterfacePtr cb(boost::make_shared<ServiceCallback>(helper_, buf, num_bytes, link, has_tracked_object_, tracked_object_));
+  if (max_concurrent_calls_ == 0)
+  {
+    CallbackInterfacePtr cb(boost::make_shared<ServiceCallback>(helper_, buf, num_bytes, link, seq, has_tracked_object_, tracked_object_, ServicePublicationWPtr(),
+                                                                priority_, deadline_));
+    callback_queue_->addCallback(cb, (uint64_t)this);
+    return;
+  }
+
+  CallbackInterfacePtr cb(boost::make_shared<ServiceCallback>(helper_, buf, num_bytes, link, seq, has_tracked_object_, tracked_object_, ServicePublicationWPtr(shared_from_this()),
+                                                              priority_, deadline_));
+  {
+    boost::mutex::scoped_lock lock(calls_mutex_);
+
+    if (active_calls_ < max_concurrent_calls_)
+    {
+      ++active_calls_;
+    }
+    else if (backlog_.size() < max_backlog_)
+    {
+      backlog_.push_back(cb);
+      return;
+    }
+    else
+    {
+      cb.reset();
+    }
+  }
+
+  if (!cb)
+  {
+    ROSCPP_LOG_DEBUG("Service [%s] is overloaded (%u calls in progress, %u waiting), rejecting request", name_.c_str(), max_concurrent_calls_, max_backlog_);
+    std_msgs::String error_string;
+    error_string.data = "service [" + name_ + "] is overloaded";
+    SerializedMessage res = serialization::serializeServiceResponse(false, error_string);
+    link->processResponse(false, res, seq);
+    return;
+  }
+
   callback_queue_->addCallback(cb, (uint64_t)this);
 }
 
+void ServicePublication::callFinished()
+{
+  CallbackInterfacePtr next;
+  {
+    boost::mutex::scoped_lock lock(calls_mutex_);
+
+    if (backlog_.empty())
+    {
+      --active_calls_;
+      return;
+    }
+
+    next = backlog_.front();
+    backlog_.pop_front();
+  }
+
+  callback_queue_->addCallback(next, (uint64_t)this);
+}
+
 void ServicePublication::addServiceClientLink(const ServiceClientLinkPtr& link)
 {
   boost::mutex::scoped_lock lock(client_links_mutex_);
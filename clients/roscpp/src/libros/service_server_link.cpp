@@ -43,6 +43,7 @@
 #include <boost/bind.hpp>
 
 #include <sstream>
+#include <algorithm>
 
 namespace ros
 {
@@ -55,7 +56,11 @@ ServiceServerLink::ServiceServerLink(const std::string& service_name, bool persi
 , response_md5sum_(response_md5sum)
 , extra_outgoing_header_values_(header_values)
 , header_written_(false)
+, header_received_(false)
 , header_read_(false)
+, pipeline_depth_(1)
+, writing_(false)
+, reading_(false)
 , dropped_(false)
 {
 }
@@ -76,6 +81,8 @@ void ServiceServerLink::cancelCall(const CallInfoPtr& info)
     local->finished_condition_.notify_all();
   }
 
+  finishAsyncCall(local, false);
+
   if (boost::this_thread::get_id() != info->caller_thread_id_)
   {
     while (!local->call_finished_)
@@ -87,28 +94,46 @@ void ServiceServerLink::cancelCall(const CallInfoPtr& info)
 
 void ServiceServerLink::clearCalls()
 {
-  CallInfoPtr local_current;
-
+  // Cancel outside the queue lock, since cancelling an asynchronous call runs its completion function
+  std::deque<CallInfoPtr> local_in_flight;
+  Q_CallInfo local_queue;
   {
     boost::mutex::scoped_lock lock(call_queue_mutex_);
-    local_current = current_call_;
+    local_in_flight = in_flight_;
+    local_queue.swap(call_queue_);
   }
 
-  if (local_current)
+  for (size_t i = 0; i < local_in_flight.size(); ++i)
   {
-    cancelCall(local_current);
+    cancelCall(local_in_flight[i]);
   }
 
-  boost::mutex::scoped_lock lock(call_queue_mutex_);
+  while (!local_queue.empty())
+  {
+    cancelCall(local_queue.front());
+    local_queue.pop();
+  }
+}
 
-  while (!call_queue_.empty())
+void ServiceServerLink::finishAsyncCall(const CallInfoPtr& info, bool success)
+{
+  CallFinishedFn callback;
   {
-    CallInfoPtr info = call_queue_.front();
+    boost::mutex::scoped_lock lock(info->finished_mutex_);
+    callback.swap(info->callback_);
+  }
 
-    cancelCall(info);
+  if (!callback)
+  {
+    return;
+  }
 
-    call_queue_.pop();
+  if (info->exception_string_.length() > 0)
+  {
+    ROS_ERROR("Service call failed: service [%s] responded with an error: %s", service_name_.c_str(), info->exception_string_.c_str());
   }
+
+  callback(success, info->async_resp_);
 }
 
 bool ServiceServerLink::initialize(const ConnectionPtr& connection)
@@ -138,6 +163,8 @@ void ServiceServerLink::onHeaderWritten(const ConnectionPtr& conn)
 bool ServiceServerLink::onHeaderReceived(const ConnectionPtr& conn, const Header& header)
 {
   (void)conn;
+  header_received_ = true;
+
   std::string md5sum, type;
   if (!header.getValue("md5sum", md5sum))
   {
@@ -172,16 +199,46 @@ void ServiceServerLink::onConnectionDropped(const ConnectionPtr& conn)
   ROSCPP_LOG_DEBUG("Service client from [%s] for [%s] dropped", conn->getRemoteString().c_str(), service_name_.c_str());
 
   dropped_ = true;
+
+  // Dropped before the service server answered our header: it has gone away, or no longer provides this service
+  if (!header_received_)
+  {
+    ServiceManager::instance()->invalidateServiceURI(service_name_);
+  }
+
   clearCalls();
 
   ServiceManager::instance()->removeServiceServerLink(shared_from_this());
 }
 
+void ServiceServerLink::setPipelineDepth(uint32_t depth)
+{
+  boost::mutex::scoped_lock lock(call_queue_mutex_);
+  pipeline_depth_ = std::max(depth, 1U);
+}
+
 void ServiceServerLink::onRequestWritten(const ConnectionPtr& conn)
 {
   (void)conn;
   //ros::WallDuration(0.1).sleep();
-  connection_->read(5, boost::bind(&ServiceServerLink::onResponseOkAndLength, this, _1, _2, _3, _4));
+  bool start_read = false;
+  {
+    boost::mutex::scoped_lock lock(call_queue_mutex_);
+    writing_ = false;
+
+    if (!reading_)
+    {
+      reading_ = true;
+      start_read = true;
+    }
+  }
+
+  if (start_read)
+  {
+    connection_->read(5, boost::bind(&ServiceServerLink::onResponseOkAndLength, this, _1, _2, _3, _4));
+  }
+
+  processNextCall();
 }
 
 void ServiceServerLink::onResponseOkAndLength(const ConnectionPtr& conn, const boost::shared_array<uint8_t>& buffer, uint32_t size, bool success)
@@ -210,9 +267,9 @@ void ServiceServerLink::onResponseOkAndLength(const ConnectionPtr& conn, const b
   {
     boost::mutex::scoped_lock lock(call_queue_mutex_);
     if ( ok != 0 ) {
-    	current_call_->success_ = true;
+    	in_flight_.front()->success_ = true;
     } else {
-    	current_call_->success_ = false;
+    	in_flight_.front()->success_ = false;
     }
   }
 
@@ -237,13 +294,14 @@ void ServiceServerLink::onResponse(const ConnectionPtr& conn, const boost::share
   {
     boost::mutex::scoped_lock queue_lock(call_queue_mutex_);
 
-    if (current_call_->success_)
+    const CallInfoPtr& call = in_flight_.front();
+    if (call->success_)
     {
-      *current_call_->resp_ = SerializedMessage(buffer, size);
+      *call->resp_ = SerializedMessage(buffer, size);
     }
     else
     {
-      current_call_->exception_string_ = std::string(reinterpret_cast<char*>(buffer.get()), size);
+      call->exception_string_ = std::string(reinterpret_cast<char*>(buffer.get()), size);
     }
   }
 
@@ -254,17 +312,22 @@ void ServiceServerLink::callFinished()
 {
   CallInfoPtr saved_call;
   ServiceServerLinkPtr self;
+  bool read_next = false;
   {
     boost::mutex::scoped_lock queue_lock(call_queue_mutex_);
-    boost::mutex::scoped_lock finished_lock(current_call_->finished_mutex_);
+    saved_call = in_flight_.front();
+    in_flight_.pop_front();
 
-    ROS_DEBUG_NAMED("superdebug", "Client to service [%s] call finished with success=[%s]", service_name_.c_str(), current_call_->success_ ? "true" : "false");
+    boost::mutex::scoped_lock finished_lock(saved_call->finished_mutex_);
 
-    current_call_->finished_ = true;
-    current_call_->finished_condition_.notify_all();
+    ROS_DEBUG_NAMED("superdebug", "Client to service [%s] call finished with success=[%s]", service_name_.c_str(), saved_call->success_ ? "true" : "false");
 
-    saved_call = current_call_;
-    current_call_ = CallInfoPtr();
+    saved_call->finished_ = true;
+    saved_call->finished_condition_.notify_all();
+
+    // The next response may already be on its way, even if its request is still being written
+    read_next = !in_flight_.empty();
+    reading_ = read_next;
 
     // If the call queue is empty here, we may be deleted as soon as we release these locks, so keep a shared pointer to ourselves until we return
     // ugly
@@ -272,18 +335,25 @@ void ServiceServerLink::callFinished()
     self = shared_from_this();
   }
 
+  finishAsyncCall(saved_call, saved_call->success_);
   saved_call = CallInfoPtr();
 
+  if (read_next)
+  {
+    connection_->read(5, boost::bind(&ServiceServerLink::onResponseOkAndLength, this, _1, _2, _3, _4));
+  }
+
   processNextCall();
 }
 
 void ServiceServerLink::processNextCall()
 {
   bool empty = false;
+  SerializedMessage request;
   {
     boost::mutex::scoped_lock lock(call_queue_mutex_);
 
-    if (current_call_)
+    if (writing_ || in_flight_.size() >= pipeline_depth_)
     {
       return;
     }
@@ -292,13 +362,19 @@ void ServiceServerLink::processNextCall()
     {
       ROS_DEBUG_NAMED("superdebug", "[%s] Client to service [%s] processing next service call", persistent_ ? "persistent" : "non-persistent", service_name_.c_str());
 
-      current_call_ = call_queue_.front();
+      in_flight_.push_back(call_queue_.front());
       call_queue_.pop();
+      writing_ = true;
+      request = in_flight_.back()->req_;
     }
-    else
+    else if (in_flight_.empty())
     {
       empty = true;
     }
+    else
+    {
+      return;
+    }
   }
 
   if (empty)
@@ -315,13 +391,6 @@ void ServiceServerLink::processNextCall()
   }
   else
   {
-    SerializedMessage request;
-
-    {
-      boost::mutex::scoped_lock lock(call_queue_mutex_);
-      request = current_call_->req_;
-    }
-
     connection_->write(request.buf, request.num_bytes, boost::bind(&ServiceServerLink::onRequestWritten, this, _1));
   }
 }
@@ -338,6 +407,51 @@ bool ServiceServerLink::call(const SerializedMessage& req, SerializedMessage& re
 
   //ros::WallDuration(0.1).sleep();
 
+  if (!enqueueCall(info))
+  {
+    info->call_finished_ = true;
+    return false;
+  }
+
+  {
+    boost::mutex::scoped_lock lock(info->finished_mutex_);
+
+    while (!info->finished_)
+    {
+      info->finished_condition_.wait(lock);
+    }
+  }
+
+  info->call_finished_ = true;
+
+  if (info->exception_string_.length() > 0)
+  {
+    ROS_ERROR("Service call failed: service [%s] responded with an error: %s", service_name_.c_str(), info->exception_string_.c_str());
+  }
+
+  return info->success_;
+}
+
+void ServiceServerLink::callAsync(const SerializedMessage& req, const CallFinishedFn& callback)
+{
+  CallInfoPtr info(boost::make_shared<CallInfo>());
+  info->req_ = req;
+  info->resp_ = &info->async_resp_;
+  info->callback_ = callback;
+  info->success_ = false;
+  info->finished_ = false;
+  // Nobody blocks on an asynchronous call, so there is no caller for cancelCall() to wait on
+  info->call_finished_ = true;
+  info->caller_thread_id_ = boost::this_thread::get_id();
+
+  if (!enqueueCall(info))
+  {
+    finishAsyncCall(info, false);
+  }
+}
+
+bool ServiceServerLink::enqueueCall(const CallInfoPtr& info)
+{
   bool immediate = false;
   {
     boost::mutex::scoped_lock lock(call_queue_mutex_);
@@ -345,7 +459,6 @@ bool ServiceServerLink::call(const SerializedMessage& req, SerializedMessage& re
     if (connection_->isDropped())
     {
       ROSCPP_LOG_DEBUG("ServiceServerLink::call called on dropped connection for service [%s]", service_name_.c_str());
-      info->call_finished_ = true;
       return false;
     }
 
@@ -362,23 +475,7 @@ bool ServiceServerLink::call(const SerializedMessage& req, SerializedMessage& re
     processNextCall();
   }
 
-  {
-    boost::mutex::scoped_lock lock(info->finished_mutex_);
-
-    while (!info->finished_)
-    {
-      info->finished_condition_.wait(lock);
-    }
-  }
-
-  info->call_finished_ = true;
-
-  if (info->exception_string_.length() > 0)
-  {
-    ROS_ERROR("Service call failed: service [%s] responded with an error: %s", service_name_.c_str(), info->exception_string_.c_str());
-  }
-
-  return info->success_;
+  return true;
 }
 
 bool ServiceServerLink::isValid() const
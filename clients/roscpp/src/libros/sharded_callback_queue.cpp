@@ -0,0 +1,368 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2009, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage, Inc. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// Make sure we use CLOCK_MONOTONIC for the condition variable wait_for if not Apple.
+#ifndef __APPLE__
+#define BOOST_THREAD_HAS_CONDATTR_SET_CLOCK_MONOTONIC
+#endif
+
+#include "ros/sharded_callback_queue.h"
+#include "ros/assert.h"
+
+#include <boost/thread/thread.hpp>
+
+namespace ros
+{
+
+ShardedCallbackQueue::ShardedCallbackQueue(uint32_t shard_count, bool enabled)
+: CallbackQueue(enabled)
+, shard_count_(shard_count ? shard_count : std::max(boost::thread::hardware_concurrency(), 1U))
+, shards_(new Shard[shard_count_])
+, queued_(0)
+, pending_(0)
+, is_enabled_(enabled)
+, waiters_(0)
+, next_home_shard_(0)
+{
+}
+
+ShardedCallbackQueue::~ShardedCallbackQueue()
+{
+  disable();
+}
+
+void ShardedCallbackQueue::enable()
+{
+  CallbackQueue::enable();
+  is_enabled_.store(true);
+
+  boost::mutex::scoped_lock lock(wait_mutex_);
+  wait_condition_.notify_all();
+}
+
+void ShardedCallbackQueue::disable()
+{
+  CallbackQueue::disable();
+  is_enabled_.store(false);
+
+  boost::mutex::scoped_lock lock(wait_mutex_);
+  wait_condition_.notify_all();
+}
+
+bool ShardedCallbackQueue::isEnabled()
+{
+  return is_enabled_.load();
+}
+
+bool ShardedCallbackQueue::isEmpty()
+{
+  return pending_.load() == 0;
+}
+
+void ShardedCallbackQueue::clear()
+{
+  for (uint32_t i = 0; i < shard_count_; ++i)
+  {
+    Shard& shard = shards_[i];
+    boost::mutex::scoped_lock lock(shard.mutex);
+
+    size_t count = shard.callbacks.size();
+    shard.callbacks.clear();
+    shard.size.store(0);
+    queued_ -= count;
+    pending_ -= count;
+  }
+}
+
+ShardedCallbackQueue::Shard& ShardedCallbackQueue::getShard(uint64_t removal_id)
+{
+  // Removal ids are usually addresses, so mix the bits before picking a shard
+  uint64_t hash = removal_id * 0x9E3779B97F4A7C15ULL;
+  return shards_[(hash >> 32) % shard_count_];
+}
+
+uint32_t ShardedCallbackQueue::getHomeShard()
+{
+  if (!home_shard_.get())
+  {
+    home_shard_.reset(new uint32_t(next_home_shard_++ % shard_count_));
+  }
+
+  return *home_shard_;
+}
+
+void ShardedCallbackQueue::push(const CallbackInfo& info)
+{
+  Shard& shard = getShard(info.removal_id);
+  {
+    boost::mutex::scoped_lock lock(shard.mutex);
+    shard.callbacks.push_back(info);
+    shard.size.store(shard.callbacks.size());
+    // pending_ first, so isEmpty() never sees a queued callback go missing
+    ++pending_;
+    ++queued_;
+  }
+
+  // A waiter increments waiters_ before checking queued_, so one of us always sees the other
+  if (waiters_.load() > 0)
+  {
+    boost::mutex::scoped_lock lock(wait_mutex_);
+    wait_condition_.notify_one();
+  }
+}
+
+void ShardedCallbackQueue::addCallback(const CallbackInterfacePtr& callback, uint64_t removal_id)
+{
+  CallbackInfo info;
+  info.callback = callback;
+  info.removal_id = removal_id;
+
+  {
+    boost::mutex::scoped_lock lock(id_info_mutex_);
+
+    M_IDInfo::iterator it = id_info_.find(removal_id);
+    if (it == id_info_.end())
+    {
+      IDInfoPtr id_info(boost::make_shared<IDInfo>());
+      id_info->id = removal_id;
+      id_info_.insert(std::make_pair(removal_id, id_info));
+    }
+  }
+
+  if (!is_enabled_.load())
+  {
+    return;
+  }
+
+  push(info);
+}
+
+void ShardedCallbackQueue::requeueCallback(const CallbackInfo& info)
+{
+  push(info);
+}
+
+void ShardedCallbackQueue::eraseQueuedCallbacks(uint64_t removal_id)
+{
+  Shard& shard = getShard(removal_id);
+  boost::mutex::scoped_lock lock(shard.mutex);
+
+  size_t erased = 0;
+  D_CallbackInfo::iterator it = shard.callbacks.begin();
+  for (; it != shard.callbacks.end();)
+  {
+    if (it->removal_id == removal_id)
+    {
+      it = shard.callbacks.erase(it);
+      ++erased;
+    }
+    else
+    {
+      ++it;
+    }
+  }
+
+  shard.size.store(shard.callbacks.size());
+  queued_ -= erased;
+  pending_ -= erased;
+}
+
+bool ShardedCallbackQueue::popReady(CallbackInfo& info)
+{
+  // Home shard first, then steal from the others
+  uint32_t home = getHomeShard();
+  for (uint32_t i = 0; i < shard_count_; ++i)
+  {
+    Shard& shard = shards_[(home + i) % shard_count_];
+    if (shard.size.load(std::memory_order_relaxed) == 0)
+    {
+      continue;
+    }
+
+    boost::mutex::scoped_lock lock(shard.mutex);
+    D_CallbackInfo::iterator it = shard.callbacks.begin();
+    for (; it != shard.callbacks.end();)
+    {
+      if (it->marked_for_removal)
+      {
+        it = shard.callbacks.erase(it);
+        shard.size.store(shard.callbacks.size());
+        --queued_;
+        --pending_;
+        continue;
+      }
+
+      if (it->callback->ready())
+      {
+        info = *it;
+        shard.callbacks.erase(it);
+        shard.size.store(shard.callbacks.size());
+        // Still counted in pending_ until it has been called
+        --queued_;
+        return true;
+      }
+
+      ++it;
+    }
+  }
+
+  return false;
+}
+
+void ShardedCallbackQueue::waitForCallbacks(ros::WallDuration timeout)
+{
+  boost::mutex::scoped_lock lock(wait_mutex_);
+  ++waiters_;
+
+  boost::chrono::steady_clock::time_point end = boost::chrono::steady_clock::now() + boost::chrono::nanoseconds(timeout.toNSec());
+  while (queued_.load() == 0 && is_enabled_.load())
+  {
+    if (wait_condition_.wait_until(lock, end) == boost::cv_status::timeout)
+    {
+      break;
+    }
+  }
+
+  --waiters_;
+}
+
+CallbackQueue::CallOneResult ShardedCallbackQueue::callOne(ros::WallDuration timeout)
+{
+  setupTLS();
+  TLS* tls = tls_.get();
+
+  if (!is_enabled_.load())
+  {
+    return Disabled;
+  }
+
+  CallbackInfo cb_info;
+  if (!popReady(cb_info))
+  {
+    if (queued_.load() != 0)
+    {
+      return TryAgain;
+    }
+
+    if (!timeout.isZero())
+    {
+      waitForCallbacks(timeout);
+    }
+
+    if (!is_enabled_.load())
+    {
+      return Disabled;
+    }
+
+    if (!popReady(cb_info))
+    {
+      return queued_.load() == 0 ? Empty : TryAgain;
+    }
+  }
+
+  bool was_empty = tls->callbacks.empty();
+  tls->callbacks.push_back(cb_info);
+  if (was_empty)
+  {
+    tls->cb_it = tls->callbacks.begin();
+  }
+
+  CallOneResult res = callOneCB(tls);
+  if (res != Empty)
+  {
+    --pending_;
+  }
+  return res;
+}
+
+void ShardedCallbackQueue::callAvailable(ros::WallDuration timeout)
+{
+  setupTLS();
+  TLS* tls = tls_.get();
+
+  if (!is_enabled_.load())
+  {
+    return;
+  }
+
+  if (queued_.load() == 0)
+  {
+    if (!timeout.isZero())
+    {
+      waitForCallbacks(timeout);
+    }
+
+    if (queued_.load() == 0 || !is_enabled_.load())
+    {
+      return;
+    }
+  }
+
+  bool was_empty = tls->callbacks.empty();
+
+  uint32_t home = getHomeShard();
+  for (uint32_t i = 0; i < shard_count_; ++i)
+  {
+    Shard& shard = shards_[(home + i) % shard_count_];
+    if (shard.size.load(std::memory_order_relaxed) == 0)
+    {
+      continue;
+    }
+
+    boost::mutex::scoped_lock lock(shard.mutex);
+    tls->callbacks.insert(tls->callbacks.end(), shard.callbacks.begin(), shard.callbacks.end());
+    queued_ -= shard.callbacks.size();
+    shard.callbacks.clear();
+    shard.size.store(0);
+  }
+
+  if (was_empty)
+  {
+    tls->cb_it = tls->callbacks.begin();
+  }
+
+  size_t called = 0;
+
+  while (!tls->callbacks.empty())
+  {
+    if (callOneCB(tls) != Empty)
+    {
+      ++called;
+    }
+  }
+
+  pending_ -= called;
+}
+
+}
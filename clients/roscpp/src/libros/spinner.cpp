@@ -32,6 +32,13 @@
 #include <boost/thread/thread.hpp>
 #include <boost/thread/mutex.hpp>
 
+#include <sstream>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
 namespace {
 
 /** class to monitor running single-threaded spinners.
@@ -160,6 +167,7 @@ class AsyncSpinnerImpl
 {
 public:
   AsyncSpinnerImpl(uint32_t thread_count, CallbackQueue* queue);
+  AsyncSpinnerImpl(const RTSpinnerOptions& rt_ops, CallbackQueue* queue);
   ~AsyncSpinnerImpl();
 
   bool canStart();
@@ -168,6 +176,10 @@ public:
 
 private:
   void threadFunc();
+  /**
+   * \brief Start thread number index, pinned and scheduled as rt_ops_ asks.  Throws std::runtime_error on failure.
+   */
+  void createRTThread(uint32_t index);
 
   boost::mutex mutex_;
   boost::thread_group threads_;
@@ -177,6 +189,9 @@ private:
 
   volatile bool continue_;
 
+  bool use_rt_ops_;
+  RTSpinnerOptions rt_ops_;
+
   ros::NodeHandle nh_;
 };
 
@@ -184,6 +199,7 @@ AsyncSpinnerImpl::AsyncSpinnerImpl(uint32_t thread_count, CallbackQueue* queue)
 : thread_count_(thread_count)
 , callback_queue_(queue)
 , continue_(false)
+, use_rt_ops_(false)
 {
   if (thread_count == 0)
   {
@@ -201,6 +217,19 @@ AsyncSpinnerImpl::AsyncSpinnerImpl(uint32_t thread_count, CallbackQueue* queue)
   }
 }
 
+AsyncSpinnerImpl::AsyncSpinnerImpl(const RTSpinnerOptions& rt_ops, CallbackQueue* queue)
+: thread_count_(std::max(rt_ops.thread_count, 1U))
+, callback_queue_(queue)
+, continue_(false)
+, use_rt_ops_(true)
+, rt_ops_(rt_ops)
+{
+  if (!queue)
+  {
+    callback_queue_ = getGlobalCallbackQueue();
+  }
+}
+
 AsyncSpinnerImpl::~AsyncSpinnerImpl()
 {
   stop();
@@ -229,10 +258,90 @@ void AsyncSpinnerImpl::start()
 
   for (uint32_t i = 0; i < thread_count_; ++i)
   {
-    threads_.create_thread(boost::bind(&AsyncSpinnerImpl::threadFunc, this));
+    if (!use_rt_ops_)
+    {
+      threads_.create_thread(boost::bind(&AsyncSpinnerImpl::threadFunc, this));
+      continue;
+    }
+
+    try
+    {
+      createRTThread(i);
+    }
+    catch (std::runtime_error& e)
+    {
+      // Don't leave some of the threads running
+      continue_ = false;
+      threads_.join_all();
+      spinner_monitor.remove(callback_queue_);
+
+      ROS_ERROR_STREAM(e.what());
+      throw;
+    }
   }
 }
 
+void AsyncSpinnerImpl::createRTThread(uint32_t index)
+{
+#if defined(__linux__)
+  // Set everything on the thread attributes, so the thread never runs a callback before it is pinned and scheduled
+  boost::thread::attributes attrs;
+  pthread_attr_t* native = attrs.native_handle();
+
+  if (!rt_ops_.cpus.empty())
+  {
+    int cpu = rt_ops_.cpus[index % rt_ops_.cpus.size()];
+    if (cpu < 0 || cpu >= CPU_SETSIZE)
+    {
+      std::stringstream ss;
+      ss << "RTSpinner: invalid CPU " << cpu;
+      throw std::runtime_error(ss.str());
+    }
+
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu, &cpus);
+    pthread_attr_setaffinity_np(native, sizeof(cpus), &cpus);
+  }
+
+  if (rt_ops_.priority > 0)
+  {
+    sched_param param;
+    param.sched_priority = rt_ops_.priority;
+    pthread_attr_setinheritsched(native, PTHREAD_EXPLICIT_SCHED);
+    pthread_attr_setschedpolicy(native, SCHED_FIFO);
+    pthread_attr_setschedparam(native, &param);
+  }
+
+  try
+  {
+    threads_.add_thread(new boost::thread(attrs, boost::bind(&AsyncSpinnerImpl::threadFunc, this)));
+  }
+  catch (boost::thread_resource_error& e)
+  {
+    std::stringstream ss;
+    ss << "RTSpinner: could not start thread " << index;
+    if (rt_ops_.priority > 0)
+    {
+      ss << " with SCHED_FIFO priority " << rt_ops_.priority;
+    }
+    if (!rt_ops_.cpus.empty())
+    {
+      ss << " on CPU " << rt_ops_.cpus[index % rt_ops_.cpus.size()];
+    }
+    ss << ": " << e.what();
+    throw std::runtime_error(ss.str());
+  }
+#else
+  if (!rt_ops_.cpus.empty() || rt_ops_.priority > 0)
+  {
+    throw std::runtime_error("RTSpinner: CPU pinning and SCHED_FIFO are only supported on Linux");
+  }
+
+  threads_.create_thread(boost::bind(&AsyncSpinnerImpl::threadFunc, this));
+#endif
+}
+
 void AsyncSpinnerImpl::stop()
 {
   boost::mutex::scoped_lock lock(mutex_);
@@ -291,4 +400,19 @@ void AsyncSpinner::stop()
   impl_->stop();
 }
 
+RTSpinner::RTSpinner(const RTSpinnerOptions& ops, CallbackQueue* queue)
+: impl_(new AsyncSpinnerImpl(ops, queue))
+{
+}
+
+void RTSpinner::start()
+{
+  impl_->start();
+}
+
+void RTSpinner::stop()
+{
+  impl_->stop();
+}
+
 }
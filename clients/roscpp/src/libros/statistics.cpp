@@ -30,131 +30,153 @@
 #include <rosgraph_msgs/TopicStatistics.h>
 #include "ros/this_node.h"
 #include "ros/message_traits.h"
-#include "std_msgs/Header.h"
 #include "ros/param.h"
+#include "ros/publisher_link.h"
+#include "ros/callback_queue.h"
+
+#include <boost/make_shared.hpp>
+
+#include <cmath>
+#include <cstring>
 
 namespace ros
 {
 
-StatisticsLogger::StatisticsLogger()
-: pub_frequency_(1.0)
+CallbackQueuePtr getInternalCallbackQueue();
+
+namespace
+{
+
+// A serialized std_msgs/Header starts with uint32 seq, uint32 stamp.sec, uint32 stamp.nsec
+const uint32_t s_header_stamp_offset = 4;
+const uint32_t s_header_stamp_end = 12;
+
+void accumulate(double value, uint64_t& count, double& mean, double& m2, double& max)
 {
+  ++count;
+  double delta = value - mean;
+  mean += delta / count;
+  m2 += delta * (value - mean);
+  if (value > max)
+  {
+    max = value;
+  }
 }
 
-void StatisticsLogger::init(const SubscriptionCallbackHelperPtr& helper) {
-  hasHeader_ = helper->hasHeader();
-  param::param("/enable_statistics", enable_statistics, false);
-  param::param("/statistics_window_min_elements", min_elements, 10);
-  param::param("/statistics_window_max_elements", max_elements, 100);
-  param::param("/statistics_window_min_size", min_window, 4);
-  param::param("/statistics_window_max_size", max_window, 64);
 }
 
-void StatisticsLogger::callback(const boost::shared_ptr<M_string>& connection_header,
-                                const std::string& topic, const std::string& callerid, const SerializedMessage& m, const uint64_t& bytes_sent,
-                                const ros::Time& received_time, bool dropped)
+LinkStatistics::Window::Window()
+: delivered(0)
+, dropped(0)
+, traffic(0)
+, num_periods(0)
+, period_mean(0.0)
+, period_m2(0.0)
+, period_max(0.0)
+, num_ages(0)
+, age_mean(0.0)
+, age_m2(0.0)
+, age_max(0.0)
 {
-  (void)connection_header;
-  struct StatData stats;
+}
 
-  if (!enable_statistics)
-  {
-    return;
-  }
+LinkStatistics::LinkStatistics(const std::string& topic, const std::string& callerid, const boost::shared_ptr<Publisher>& pub)
+: topic_(topic)
+, callerid_(callerid)
+, pub_(pub)
+, bytes_last_(0)
+, ring_head_(0)
+, ring_size_(0)
+{
+  current_.start = ros::Time::now();
+}
 
-  // ignore /clock for safety and /statistics to reduce noise
-  if (topic == "/statistics" || topic == "/clock")
+bool LinkStatistics::update(const ros::Time& received_time, const ros::Time& stamp, uint64_t bytes_received, bool dropped,
+                            double window_length, uint64_t& window_delivered)
+{
+  if (current_.delivered > 0)
   {
-    return;
+    accumulate((received_time - current_.last_arrival).toSec(), current_.num_periods, current_.period_mean, current_.period_m2, current_.period_max);
   }
+  current_.last_arrival = received_time;
+  ++current_.delivered;
 
-  // callerid identifies the connection
-  std::map<std::string, struct StatData>::iterator stats_it = map_.find(callerid);
-  if (stats_it == map_.end())
+  if (dropped)
   {
-    // this is the first time, we received something on this connection
-    stats.stat_bytes_last = 0;
-    stats.dropped_msgs = 0;
-    stats.last_seq = 0;
-    stats.last_publish = ros::Time::now();
-    map_[callerid] = stats;
+    ++current_.dropped;
   }
-  else
+
+  if (!stamp.isZero())
   {
-    stats = map_[callerid];
+    accumulate((received_time - stamp).toSec(), current_.num_ages, current_.age_mean, current_.age_m2, current_.age_max);
   }
 
-  stats.arrival_time_list.push_back(received_time);
-
-  if (dropped)
+  // should publish new statistics?
+  if (current_.start + ros::Duration(window_length) >= received_time)
   {
-    stats.dropped_msgs++;
+    return false;
   }
 
-  // try to extract header, if the message has one. this fails sometimes,
-  // therefore the try-catch
-  if (hasHeader_)
+  current_.stop = received_time;
+  current_.traffic = bytes_received - bytes_last_;
+  bytes_last_ = bytes_received;
+  window_delivered = current_.delivered;
+
   {
-    try
+    boost::mutex::scoped_lock lock(ring_mutex_);
+    if (ring_size_ < RING_SIZE)
     {
-      std_msgs::Header header;
-      ros::serialization::IStream stream(m.message_start, m.num_bytes - (m.message_start - m.buf.get()));
-      ros::serialization::deserialize(stream, header);
-      if (!header.stamp.isZero())
-      {
-        stats.age_list.push_back(received_time - header.stamp);
-      }
+      ring_[(ring_head_ + ring_size_) % RING_SIZE] = current_;
+      ++ring_size_;
     }
-    catch (ros::serialization::StreamOverrunException& e)
+    else
     {
-      ROS_DEBUG("Error during header extraction for statistics (topic=%s, message_length=%li)", topic.c_str(), m.num_bytes - (m.message_start - m.buf.get()));
-      hasHeader_ = false;
+      ROS_DEBUG("Statistics for topic [%s] from [%s] are not being published fast enough, dropping a window", topic_.c_str(), callerid_.c_str());
     }
   }
 
-  // should publish new statistics?
-  if (stats.last_publish + ros::Duration(pub_frequency_) < received_time)
+  current_ = Window();
+  current_.start = received_time;
+
+  getInternalCallbackQueue()->addCallback(shared_from_this(), (uint64_t)this);
+  return true;
+}
+
+CallbackInterface::CallResult LinkStatistics::call()
+{
+  while (true)
   {
-    ros::Time window_start = stats.last_publish;
-    stats.last_publish = received_time;
+    Window w;
+    {
+      boost::mutex::scoped_lock lock(ring_mutex_);
+      if (ring_size_ == 0)
+      {
+        break;
+      }
+
+      w = ring_[ring_head_];
+      ring_head_ = (ring_head_ + 1) % RING_SIZE;
+      --ring_size_;
+    }
 
     // fill the message with the aggregated data
     rosgraph_msgs::TopicStatistics msg;
-    msg.topic = topic;
-    msg.node_pub = callerid;
+    msg.topic = topic_;
+    msg.node_pub = callerid_;
     msg.node_sub = ros::this_node::getName();
-    msg.window_start = window_start;
-    msg.window_stop = received_time;
-    msg.delivered_msgs = stats.arrival_time_list.size();
-    msg.dropped_msgs = stats.dropped_msgs;
-    msg.traffic = bytes_sent - stats.stat_bytes_last;
+    msg.window_start = w.start;
+    msg.window_stop = w.stop;
+    msg.delivered_msgs = w.delivered;
+    msg.dropped_msgs = w.dropped;
+    msg.traffic = w.traffic;
 
     // not all message types have this
-    if (stats.age_list.size() > 0)
+    if (w.num_ages > 0)
     {
-      msg.stamp_age_mean = ros::Duration(0);
-      msg.stamp_age_max = ros::Duration(0);
+      msg.stamp_age_mean = ros::Duration(w.age_mean);
+      msg.stamp_age_max = ros::Duration(w.age_max);
 
-      for(std::list<ros::Duration>::iterator it = stats.age_list.begin(); it != stats.age_list.end(); it++)
-      {
-        ros::Duration age = *it;
-        msg.stamp_age_mean += age;
-
-        if (age > msg.stamp_age_max)
-        {
-            msg.stamp_age_max = age;
-        }
-      }
-
-      msg.stamp_age_mean *= 1.0 / stats.age_list.size();
-
-      double stamp_age_variance = 0.0;
-      for(std::list<ros::Duration>::iterator it = stats.age_list.begin(); it != stats.age_list.end(); it++)
-      {
-        ros::Duration t = msg.stamp_age_mean - *it;
-        stamp_age_variance += t.toSec() * t.toSec();
-      }
-      double stamp_age_stddev = sqrt(stamp_age_variance / stats.age_list.size());
+      double stamp_age_stddev = sqrt(w.age_m2 / w.num_ages);
       try
       {
         msg.stamp_age_stddev = ros::Duration(stamp_age_stddev);
@@ -162,13 +184,12 @@ void StatisticsLogger::callback(const boost::shared_ptr<M_string>& connection_he
       catch(std::runtime_error& e)
       {
         msg.stamp_age_stddev = ros::Duration(0);
-        ROS_WARN_STREAM("Error updating stamp_age_stddev for topic [" << topic << "]"
-          << " from node [" << callerid << "],"
+        ROS_WARN_STREAM("Error updating stamp_age_stddev for topic [" << topic_ << "]"
+          << " from node [" << callerid_ << "],"
           << " likely due to the time between the mean stamp age and this message being exceptionally large."
           << " Exception was: " << e.what());
         ROS_DEBUG_STREAM("Mean stamp age was: " << msg.stamp_age_mean << " - std_dev of: " << stamp_age_stddev);
       }
-
     }
     else
     {
@@ -178,45 +199,12 @@ void StatisticsLogger::callback(const boost::shared_ptr<M_string>& connection_he
       msg.stamp_age_max = ros::Duration(0);
     }
 
-    // first, calculate the mean period between messages in this connection
-    // we need at least two messages in the window for this.
-    if (stats.arrival_time_list.size() > 1)
+    // the period between messages needs at least two messages in the window
+    if (w.num_periods > 0)
     {
-      msg.period_mean = ros::Duration(0);
-      msg.period_max = ros::Duration(0);
-
-      ros::Time prev;
-      for(std::list<ros::Time>::iterator it = stats.arrival_time_list.begin(); it != stats.arrival_time_list.end(); it++) {
-
-        if (it == stats.arrival_time_list.begin()) {
-          prev = *it;
-          continue;
-        }
-
-        ros::Duration period = *it - prev;
-        msg.period_mean += period;
-        if (period > msg.period_max)
-            msg.period_max = period;
-        prev = *it;
-      }
-      msg.period_mean *= 1.0 / (stats.arrival_time_list.size() - 1);
-
-      // then, calc the stddev
-      double period_variance = 0.0;
-      for(std::list<ros::Time>::iterator it = stats.arrival_time_list.begin(); it != stats.arrival_time_list.end(); it++)
-      {
-        if (it == stats.arrival_time_list.begin())
-        {
-          prev = *it;
-          continue;
-        }
-        ros::Duration period = *it - prev;
-        ros::Duration t = msg.period_mean - period;
-        period_variance += t.toSec() * t.toSec();
-        prev = *it;
-      }
-      double period_stddev = sqrt(period_variance / (stats.arrival_time_list.size() - 1));
-      msg.period_stddev = ros::Duration(period_stddev);
+      msg.period_mean = ros::Duration(w.period_mean);
+      msg.period_stddev = ros::Duration(sqrt(w.period_m2 / w.num_periods));
+      msg.period_max = ros::Duration(w.period_max);
     }
     else
     {
@@ -226,34 +214,90 @@ void StatisticsLogger::callback(const boost::shared_ptr<M_string>& connection_he
       msg.period_max = ros::Duration(0);
     }
 
-    if (!pub_.getTopic().length())
+    if (!pub_->getTopic().length())
     {
       ros::NodeHandle n("~");
       // creating the publisher in the constructor results in a deadlock. so do it here.
-      pub_ = n.advertise<rosgraph_msgs::TopicStatistics>("/statistics", 1);
+      *pub_ = n.advertise<rosgraph_msgs::TopicStatistics>("/statistics", 1);
     }
 
-    pub_.publish(msg);
+    pub_->publish(msg);
+  }
+
+  return Success;
+}
+
+StatisticsLogger::StatisticsLogger()
+: pub_frequency_(1.0)
+, pub_(boost::make_shared<Publisher>())
+{
+}
+
+void StatisticsLogger::init(const SubscriptionCallbackHelperPtr& helper) {
+  hasHeader_ = helper->hasHeader();
+  param::param("/enable_statistics", enable_statistics, false);
+  param::param("/statistics_window_min_elements", min_elements, 10);
+  param::param("/statistics_window_max_elements", max_elements, 100);
+  param::param("/statistics_window_min_size", min_window, 4);
+  param::param("/statistics_window_max_size", max_window, 64);
+}
+
+void StatisticsLogger::callback(const PublisherLinkPtr& link, const std::string& topic, const SerializedMessage& m,
+                                const uint64_t& bytes_sent, const ros::Time& received_time, bool dropped)
+{
+  if (!enable_statistics)
+  {
+    return;
+  }
+
+  // ignore /clock for safety and /statistics to reduce noise
+  if (topic == "/statistics" || topic == "/clock")
+  {
+    return;
+  }
 
+  LinkStatisticsPtr stats = link->getTopicStatistics();
+  if (!stats)
+  {
+    // this is the first time, we received something on this connection
+    stats = boost::make_shared<LinkStatistics>(topic, link->getCallerID(), pub_);
+    link->setTopicStatistics(stats);
+  }
+
+  // pick the stamp straight out of the serialized header rather than deserializing it
+  ros::Time stamp;
+  if (hasHeader_)
+  {
+    uint32_t length = m.num_bytes - (m.message_start - m.buf.get());
+    if (length >= s_header_stamp_end)
+    {
+      uint32_t sec_nsec[2];
+      memcpy(sec_nsec, m.message_start + s_header_stamp_offset, sizeof(sec_nsec));
+      if (sec_nsec[1] < 1000000000)
+      {
+        stamp = ros::Time(sec_nsec[0], sec_nsec[1]);
+      }
+    }
+    else
+    {
+      ROS_DEBUG("Error during header extraction for statistics (topic=%s, message_length=%u)", topic.c_str(), length);
+      hasHeader_ = false;
+    }
+  }
+
+  uint64_t window_delivered = 0;
+  if (stats->update(received_time, stamp, bytes_sent, dropped, pub_frequency_, window_delivered))
+  {
     // dynamic window resizing
-    if (stats.arrival_time_list.size() > static_cast<size_t>(max_elements) && pub_frequency_ * 2 <= max_window)
+    if (window_delivered > static_cast<uint64_t>(max_elements) && pub_frequency_ * 2 <= max_window)
     {
       pub_frequency_ *= 2;
     }
-    if (stats.arrival_time_list.size() < static_cast<size_t>(min_elements) && pub_frequency_ / 2 >= min_window)
+    if (window_delivered < static_cast<uint64_t>(min_elements) && pub_frequency_ / 2 >= min_window)
     {
       pub_frequency_ /= 2;
     }
-
-    // clear the window
-    stats.age_list.clear();
-    stats.arrival_time_list.clear();
-    stats.dropped_msgs = 0;
-    stats.stat_bytes_last = bytes_sent;
-
   }
-  // store the stats for this connection
-  map_[callerid] = stats;
 }
 
 
@@ -67,9 +67,9 @@ void TimerManager<SteadyTime, WallDuration, SteadyTimerEvent>::threadFunc()
       }
       else
       {
-        TimerInfoPtr info = findTimer(waiting_.front());
+        TimerInfoPtr info = waiting_.front();
 
-        while (!waiting_.empty() && info && info->next_expected <= current)
+        while (info->next_expected <= current)
         {
           current = SteadyTime::now();
 
@@ -77,14 +77,15 @@ void TimerManager<SteadyTime, WallDuration, SteadyTimerEvent>::threadFunc()
           CallbackInterfacePtr cb(boost::make_shared<TimerQueueCallback>(this, info, info->last_expected, info->last_real, info->next_expected, info->last_expired, current));
           info->callback_queue->addCallback(cb, (uint64_t)info.get());
 
-          waiting_.pop_front();
+          removeWaiting(info);
 
           if (waiting_.empty())
           {
+            info.reset();
             break;
           }
 
-          info = findTimer(waiting_.front());
+          info = waiting_.front();
         }
 
         if (info)
@@ -117,6 +118,7 @@ void TimerManager<SteadyTime, WallDuration, SteadyTimerEvent>::threadFunc()
 SteadyTimer::Impl::Impl()
   : started_(false)
   , timer_handle_(-1)
+  , priority_(0)
 { }
 
 SteadyTimer::Impl::~Impl()
@@ -134,7 +136,8 @@ void SteadyTimer::Impl::start()
     {
       tracked_object = tracked_object_.lock();
     }
-    timer_handle_ = TimerManager<SteadyTime, WallDuration, SteadyTimerEvent>::global().add(period_, callback_, callback_queue_, tracked_object, oneshot_);
+    timer_handle_ = TimerManager<SteadyTime, WallDuration, SteadyTimerEvent>::global().add(period_, callback_, callback_queue_, tracked_object, oneshot_,
+                                                                                           priority_, deadline_);
     started_ = true;
   }
 }
@@ -180,6 +183,8 @@ SteadyTimer::SteadyTimer(const SteadyTimerOptions& ops)
   impl_->tracked_object_ = ops.tracked_object;
   impl_->has_tracked_object_ = (ops.tracked_object != NULL);
   impl_->oneshot_ = ops.oneshot;
+  impl_->priority_ = ops.priority;
+  impl_->deadline_ = ops.deadline;
 }
 
 SteadyTimer::SteadyTimer(const SteadyTimer& rhs)
@@ -29,12 +29,15 @@
 #include "ros/publication.h"
 
 #include <boost/bind.hpp>
+#include <boost/make_shared.hpp>
 
 namespace ros
 {
 
 SubscriberLink::SubscriberLink()
   : connection_id_(0)
+  , latency_histogram_(boost::make_shared<Histogram>())
+  , size_histogram_(boost::make_shared<Histogram>())
 {
 
 }
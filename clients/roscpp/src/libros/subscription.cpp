@@ -48,6 +48,7 @@
 #include "ros/connection.h"
 #include "ros/transport/transport_tcp.h"
 #include "ros/transport/transport_udp.h"
+#include "ros/transport/transport_shm.h"
 #include "ros/callback_queue_interface.h"
 #include "ros/this_node.h"
 #include "ros/network.h"
@@ -55,6 +56,7 @@
 #include "ros/connection_manager.h"
 #include "ros/message_deserializer.h"
 #include "ros/subscription_queue.h"
+#include "ros/lock_free_subscription_queue.h"
 #include "ros/file_log.h"
 #include "ros/transport_hints.h"
 #include "ros/subscription_callback_helper.h"
@@ -104,7 +106,7 @@ XmlRpcValue Subscription::getStats()
 
   uint32_t cidx = 0;
   for (V_PublisherLink::iterator c = publisher_links_.begin();
-       c != publisher_links_.end(); ++c)
+       c != publisher_links_.end(); ++c, cidx++)
   {
     const PublisherLink::Stats& s = (*c)->getStats();
     conn_data[cidx][0] = (*c)->getConnectionID();
@@ -112,12 +114,33 @@ XmlRpcValue Subscription::getStats()
     conn_data[cidx][2] = (int)s.messages_received_;
     conn_data[cidx][3] = (int)s.drops_;
     conn_data[cidx][4] = 0; // figure out something for this. not sure.
+    // roscpp extension: receive-to-callback latency (ns) and message size (bytes), see Histogram::getStats()
+    (*c)->getLatencyHistogram()->getStats(conn_data[cidx][5]);
+    (*c)->getSizeHistogram()->getStats(conn_data[cidx][6]);
   }
 
   stats[1] = conn_data;
   return stats;
 }
 
+void Subscription::getHistograms(V_ConnectionHistograms& histograms)
+{
+  boost::mutex::scoped_lock lock(publisher_links_mutex_);
+
+  for (V_PublisherLink::iterator c = publisher_links_.begin();
+       c != publisher_links_.end(); ++c)
+  {
+    ConnectionHistograms h;
+    h.topic_ = name_;
+    h.connection_id_ = (*c)->getConnectionID();
+    h.direction_ = "i";
+    h.remote_caller_id_ = (*c)->getCallerID();
+    h.latency_ = (*c)->getLatencyHistogram()->getSnapshot();
+    h.size_ = (*c)->getSizeHistogram()->getSnapshot();
+    histograms.push_back(h);
+  }
+}
+
 // [(connection_id, publisher_xmlrpc_uri, direction, transport, topic_name, connected, connection_info_string)*]
 // e.g. [(1, 'http://host:54893/', 'i', 'TCPROS', '/chatter', 1, 'TCPROS connection on port 59746 to [host:34318 on socket 11]')]
 void Subscription::getInfo(XmlRpc::XmlRpcValue& info)
@@ -345,6 +368,7 @@ bool Subscription::negotiateConnection(const std::string& xmlrpc_uri)
   XmlRpcValue udpros_array;
   TransportUDPPtr udp_transport;
   int protos = 0;
+  bool tcpros_requested = false;
   V_string transports = transport_hints_.getTransports();
   if (transports.empty())
   {
@@ -357,10 +381,10 @@ bool Subscription::negotiateConnection(const std::string& xmlrpc_uri)
   {
     if (*it == "UDP")
     {
+      // The publisher fragments to the size we ask for, and reassembly relies on knowing it
       int max_datagram_size = transport_hints_.getMaxDatagramSize();
-      udp_transport = boost::make_shared<TransportUDP>(&PollManager::instance()->getPollSet());
-      if (!max_datagram_size)
-        max_datagram_size = udp_transport->getMaxDatagramSize();
+      udp_transport = boost::make_shared<TransportUDP>(&PollManager::instance()->getPollSet(), 0, max_datagram_size);
+      max_datagram_size = udp_transport->getMaxDatagramSize();
       udp_transport->createIncoming(0, false);
       udpros_array[0] = "UDPROS";
       M_string m;
@@ -368,6 +392,12 @@ bool Subscription::negotiateConnection(const std::string& xmlrpc_uri)
       m["md5sum"] = md5sum();
       m["callerid"] = this_node::getName();
       m["type"] = datatype();
+      if (transport_hints_.getUDPFecParity() > 0)
+      {
+        // Offered here, switched on once the publisher echoes it back (see TransportUDP::parseHeader)
+        m["fec_parity"] = boost::lexical_cast<std::string>(transport_hints_.getUDPFecParity());
+        m["fec_group"] = boost::lexical_cast<std::string>(std::max(transport_hints_.getUDPFecGroup(), 1));
+      }
       boost::shared_array<uint8_t> buffer;
       uint32_t len;
       Header::write(m, buffer, len);
@@ -379,10 +409,15 @@ bool Subscription::negotiateConnection(const std::string& xmlrpc_uri)
 
       protos_array[protos++] = udpros_array;
     }
-    else if (*it == "TCP")
+    else if (*it == "TCP" || *it == "SHM")
     {
-      tcpros_array[0] = std::string("TCPROS");
-      protos_array[protos++] = tcpros_array;
+      // Shared memory is negotiated in the TCPROS connection header, see TransportSHM
+      if (!tcpros_requested)
+      {
+        tcpros_array[0] = std::string("TCPROS");
+        protos_array[protos++] = tcpros_array;
+        tcpros_requested = true;
+      }
     }
     else
     {
@@ -508,7 +543,16 @@ void Subscription::pendingConnectionDone(const PendingConnectionPtr& conn, XmlRp
     int pub_port = proto[2];
     ROSCPP_CONN_LOG_DEBUG("Connecting via tcpros to topic [%s] at host [%s:%d]", name_.c_str(), pub_host.c_str(), pub_port);
 
-    TransportTCPPtr transport(boost::make_shared<TransportTCP>(&PollManager::instance()->getPollSet()));
+    TransportTCPPtr transport;
+    if (transport_hints_.getSHM())
+    {
+      transport = boost::make_shared<TransportSHM>(ConnectionManager::instance()->selectPollSet());
+    }
+    else
+    {
+      transport = boost::make_shared<TransportTCP>(ConnectionManager::instance()->selectPollSet());
+    }
+
     if (transport->connect(pub_host, pub_port))
     {
       ConnectionPtr connection(boost::make_shared<Connection>());
@@ -568,6 +612,9 @@ void Subscription::pendingConnectionDone(const PendingConnectionPtr& conn, XmlRp
       return;
     }
 
+    // Nothing is read off the socket until the connection is initialized, so this takes effect from the first message
+    udp_transport->parseHeader(h);
+
     TransportPublisherLinkPtr pub_link(boost::make_shared<TransportPublisherLink>(shared_from_this(), xmlrpc_uri, transport_hints_));
     if (pub_link->setHeader(h))
     {
@@ -646,7 +693,7 @@ uint32_t Subscription::handleMessage(const SerializedMessage& m, bool ser, bool
         nonconst_need_copy = true;
       }
 
-      info->subscription_queue_->push(info->helper_, deserializer, info->has_tracked_object_, info->tracked_object_, nonconst_need_copy, receipt_time, &was_full);
+      info->subscription_queue_->push(info->helper_, deserializer, info->has_tracked_object_, info->tracked_object_, nonconst_need_copy, receipt_time, &was_full, link->getLatencyHistogram());
 
       if (was_full)
       {
@@ -660,7 +707,7 @@ uint32_t Subscription::handleMessage(const SerializedMessage& m, bool ser, bool
   }
 
   // measure statistics
-  statistics_.callback(connection_header, name_, link->getCallerID(), m, link->getStats().bytes_received_, receipt_time, drops > 0);
+  statistics_.callback(link, name_, m, link->getStats().bytes_received_, receipt_time, drops > 0);
 
   // If this link is latched, store off the message so we can immediately pass it to new subscribers later
   if (link->isLatched())
@@ -678,7 +725,8 @@ uint32_t Subscription::handleMessage(const SerializedMessage& m, bool ser, bool
   return drops;
 }
 
-bool Subscription::addCallback(const SubscriptionCallbackHelperPtr& helper, const std::string& md5sum, CallbackQueueInterface* queue, int32_t queue_size, const VoidConstPtr& tracked_object, bool allow_concurrent_callbacks)
+bool Subscription::addCallback(const SubscriptionCallbackHelperPtr& helper, const std::string& md5sum, CallbackQueueInterface* queue, int32_t queue_size, const VoidConstPtr& tracked_object, bool allow_concurrent_callbacks, bool lock_free_queue,
+                               int32_t priority, const WallDuration& deadline)
 {
   ROS_ASSERT(helper);
   ROS_ASSERT(queue);
@@ -706,7 +754,15 @@ bool Subscription::addCallback(const SubscriptionCallbackHelperPtr& helper, cons
     CallbackInfoPtr info(boost::make_shared<CallbackInfo>());
     info->helper_ = helper;
     info->callback_queue_ = queue;
-    info->subscription_queue_ = boost::make_shared<SubscriptionQueue>(name_, queue_size, allow_concurrent_callbacks);
+    if (lock_free_queue && queue_size > 0)
+    {
+      info->subscription_queue_ = boost::make_shared<LockFreeSubscriptionQueue>(name_, queue_size, allow_concurrent_callbacks);
+    }
+    else
+    {
+      info->subscription_queue_ = boost::make_shared<SubscriptionQueue>(name_, queue_size, allow_concurrent_callbacks);
+    }
+    info->subscription_queue_->setPriority(priority, deadline);
     info->tracked_object_ = tracked_object;
     info->has_tracked_object_ = false;
     if (tracked_object)
@@ -36,9 +36,10 @@ namespace ros
 SubscriptionQueue::SubscriptionQueue(const std::string& topic, int32_t queue_size, bool allow_concurrent_callbacks)
 : topic_(topic)
 , size_(queue_size)
+, allow_concurrent_callbacks_(allow_concurrent_callbacks)
+, priority_(0)
 , full_(false)
 , queue_size_(0)
-, allow_concurrent_callbacks_(allow_concurrent_callbacks)
 {}
 
 SubscriptionQueue::~SubscriptionQueue()
@@ -48,7 +49,8 @@ SubscriptionQueue::~SubscriptionQueue()
 
 void SubscriptionQueue::push(const SubscriptionCallbackHelperPtr& helper, const MessageDeserializerPtr& deserializer,
                                  bool has_tracked_object, const VoidConstWPtr& tracked_object, bool nonconst_need_copy,
-                                 ros::Time receipt_time, bool* was_full)
+                                 ros::Time receipt_time, bool* was_full,
+                                 const HistogramPtr& latency_histogram)
 {
   boost::mutex::scoped_lock lock(queue_mutex_);
 
@@ -86,6 +88,11 @@ void SubscriptionQueue::push(const SubscriptionCallbackHelperPtr& helper, const
   i.tracked_object = tracked_object;
   i.nonconst_need_copy = nonconst_need_copy;
   i.receipt_time = receipt_time;
+  if (latency_histogram)
+  {
+    i.latency_histogram = latency_histogram;
+    i.push_time = SteadyTime::now();
+  }
   queue_.push_back(i);
   ++queue_size_;
 }
@@ -147,24 +154,34 @@ CallbackInterface::CallResult SubscriptionQueue::call()
     --queue_size_;
   }
 
+  try
+  {
+    self = shared_from_this();
+  }
+  catch (boost::bad_weak_ptr&) // For the tests, where we don't create a shared_ptr
+  {}
+
+  callItem(i);
+
+  return CallbackInterface::Success;
+}
+
+void SubscriptionQueue::callItem(Item& i)
+{
+  if (i.latency_histogram)
+  {
+    i.latency_histogram->record((SteadyTime::now() - i.push_time).toNSec());
+  }
+
   VoidConstPtr msg = i.deserializer->deserialize();
 
   // msg can be null here if deserialization failed
   if (msg)
   {
-    try
-    {
-      self = shared_from_this();
-    }
-    catch (boost::bad_weak_ptr&) // For the tests, where we don't create a shared_ptr
-    {}
-
     SubscriptionCallbackHelperCallParams params;
     params.event = MessageEvent<void const>(msg, i.deserializer->getConnectionHeader(), i.receipt_time, i.nonconst_need_copy, MessageEvent<void const>::CreateFunction());
     i.helper->call(params);
   }
-
-  return CallbackInterface::Success;
 }
 
 bool SubscriptionQueue::ready()
@@ -172,6 +189,12 @@ bool SubscriptionQueue::ready()
   return true;
 }
 
+void SubscriptionQueue::setPriority(int32_t priority, const WallDuration& deadline)
+{
+  priority_ = priority;
+  deadline_ = deadline;
+}
+
 bool SubscriptionQueue::full()
 {
   boost::mutex::scoped_lock lock(queue_mutex_);
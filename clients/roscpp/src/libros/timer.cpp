@@ -34,6 +34,7 @@ namespace ros
 Timer::Impl::Impl()
   : started_(false)
   , timer_handle_(-1)
+  , priority_(0)
 { }
 
 Timer::Impl::~Impl()
@@ -62,7 +63,8 @@ void Timer::Impl::start()
       tracked_object = tracked_object_.lock();
     }
 
-    timer_handle_ = TimerManager<Time, Duration, TimerEvent>::global().add(period_, callback_, callback_queue_, tracked_object, oneshot_);
+    timer_handle_ = TimerManager<Time, Duration, TimerEvent>::global().add(period_, callback_, callback_queue_, tracked_object, oneshot_,
+                                                                           priority_, deadline_);
     started_ = true;
   }
 }
@@ -102,6 +104,8 @@ Timer::Timer(const TimerOptions& ops)
   impl_->tracked_object_ = ops.tracked_object;
   impl_->has_tracked_object_ = (ops.tracked_object != NULL);
   impl_->oneshot_ = ops.oneshot;
+  impl_->priority_ = ops.priority;
+  impl_->deadline_ = ops.deadline;
 }
 
 Timer::Timer(const Timer& rhs)
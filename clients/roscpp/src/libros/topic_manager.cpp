@@ -40,11 +40,14 @@
 #include "ros/init.h"
 #include "ros/file_log.h"
 #include "ros/subscribe_options.h"
+#include "ros/buffer_pool.h"
 
 #include "xmlrpcpp/XmlRpc.h"
 
 #include <ros/console.h>
 
+#include <boost/lexical_cast.hpp>
+
 using namespace XmlRpc; // A battle to be fought later
 using namespace std; // sigh
 
@@ -238,7 +241,8 @@ bool TopicManager::addSubCallback(const SubscribeOptions& ops)
   }
   else if (found)
   {
-    if (!sub->addCallback(ops.helper, ops.md5sum, ops.callback_queue, ops.queue_size, ops.tracked_object, ops.allow_concurrent_callbacks))
+    if (!sub->addCallback(ops.helper, ops.md5sum, ops.callback_queue, ops.queue_size, ops.tracked_object, ops.allow_concurrent_callbacks, ops.lock_free_queue,
+                        ops.priority, ops.deadline))
     {
       return false;
     }
@@ -281,7 +285,8 @@ bool TopicManager::subscribe(const SubscribeOptions& ops)
   std::string datatype = ops.datatype;
 
   SubscriptionPtr s(boost::make_shared<Subscription>(ops.topic, md5sum, datatype, ops.transport_hints));
-  s->addCallback(ops.helper, ops.md5sum, ops.callback_queue, ops.queue_size, ops.tracked_object, ops.allow_concurrent_callbacks);
+  s->addCallback(ops.helper, ops.md5sum, ops.callback_queue, ops.queue_size, ops.tracked_object, ops.allow_concurrent_callbacks, ops.lock_free_queue,
+                 ops.priority, ops.deadline);
 
   if (!registerSubscriber(s, ops.datatype))
   {
@@ -670,6 +675,8 @@ bool TopicManager::requestTopic(const string &topic,
         ROSCPP_LOG_DEBUG("Error creating outgoing transport for [%s:%d]", host.c_str(), port);
         return false;
       }
+      // Picks up the subscriber's error correction request before anything is sent
+      transport->parseHeader(h);
       connection_manager_->udprosIncomingConnection(transport, h);
 
       XmlRpcValue udpros_params;
@@ -683,6 +690,11 @@ bool TopicManager::requestTopic(const string &topic,
       m["type"] = pub_ptr->getDataType();
       m["callerid"] = this_node::getName();
       m["message_definition"] = pub_ptr->getMessageDefinition();
+      if (transport->getFecParity())
+      {
+        m["fec_parity"] = boost::lexical_cast<std::string>(transport->getFecParity());
+        m["fec_group"] = boost::lexical_cast<std::string>(transport->getFecGroup());
+      }
       boost::shared_array<uint8_t> msg_def_buffer;
       uint32_t len;
       Header::write(m, msg_def_buffer, len);
@@ -735,25 +747,35 @@ void TopicManager::publish(const std::string& topic, const boost::function<Seria
       serialize = true;
     }
 
+    // A message published as a shared_ptr may not be modified afterwards, so it can be serialized later, once, on
+    // the poll thread.  Hold on to it until then.
+    VoidConstPtr message = m.message;
+
     if (!nocopy)
     {
       m.message.reset();
       m.type_info = 0;
     }
 
+    boost::function<SerializedMessage(void)> lazy_serfunc;
     if (serialize || p->isLatching())
     {
-      SerializedMessage m2 = serfunc();
-      m.buf = m2.buf;
-      m.num_bytes = m2.num_bytes;
-      m.message_start = m2.message_start;
+      if (message)
+      {
+        lazy_serfunc = serfunc;
+      }
+      else
+      {
+        SerializedMessage m2 = serfunc();
+        m.buf = m2.buf;
+        m.num_bytes = m2.num_bytes;
+        m.message_start = m2.message_start;
+      }
     }
 
-    p->publish(m);
-
-    // If we're not doing a serialized publish we don't need to signal the pollset.  The write()
-    // call inside signal() is actually relatively expensive when doing a nocopy publish.
-    if (serialize)
+    // Only signal the pollset if nothing was queued yet: the poll thread drains the whole queue when it wakes up, and
+    // nocopy-only publishes don't queue anything at all
+    if (p->publish(m, lazy_serfunc, message))
     {
       poll_manager_->getPollSet().signal();
     }
@@ -908,7 +930,7 @@ size_t TopicManager::getNumPublishers(const std::string &topic)
 
 void TopicManager::getBusStats(XmlRpcValue &stats)
 {
-  XmlRpcValue publish_stats, subscribe_stats, service_stats;
+  XmlRpcValue publish_stats, subscribe_stats, service_stats, buffer_pool_stats;
   // force these guys to be arrays, even if we don't populate them
   publish_stats.setSize(0);
   subscribe_stats.setSize(0);
@@ -937,6 +959,30 @@ void TopicManager::getBusStats(XmlRpcValue &stats)
   stats[0] = publish_stats;
   stats[1] = subscribe_stats;
   stats[2] = service_stats;
+
+  // roscpp extension: read buffer pool stats, see BufferPool::getStats()
+  BufferPool::instance()->getStats(buffer_pool_stats);
+  stats[3] = buffer_pool_stats;
+}
+
+void TopicManager::getConnectionHistograms(V_ConnectionHistograms& histograms)
+{
+  {
+    boost::recursive_mutex::scoped_lock lock(advertised_topics_mutex_);
+    for (V_Publication::iterator t = advertised_topics_.begin();
+         t != advertised_topics_.end(); ++t)
+    {
+      (*t)->getHistograms(histograms);
+    }
+  }
+
+  {
+    boost::mutex::scoped_lock lock(subs_mutex_);
+    for (L_Subscription::iterator t = subscriptions_.begin(); t != subscriptions_.end(); ++t)
+    {
+      (*t)->getHistograms(histograms);
+    }
+  }
 }
 
 void TopicManager::getBusInfo(XmlRpcValue &info)
@@ -108,6 +108,33 @@ Transport::Transport()
 #endif
 }
 
+int32_t Transport::writev(const WriteBuffer* buffers, uint32_t count)
+{
+  int32_t total = 0;
+  for (uint32_t i = 0; i < count; ++i)
+  {
+    if (buffers[i].size == 0)
+    {
+      continue;
+    }
+
+    int32_t bytes_sent = write(buffers[i].data, buffers[i].size);
+    if (bytes_sent < 0)
+    {
+      return total > 0 ? total : bytes_sent;
+    }
+
+    total += bytes_sent;
+
+    if ((uint32_t)bytes_sent < buffers[i].size)
+    {
+      break;
+    }
+  }
+
+  return total;
+}
+
 bool Transport::isHostAllowed(const std::string &host) const
 {
   if (!only_localhost_allowed_)
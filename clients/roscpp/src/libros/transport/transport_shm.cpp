@@ -0,0 +1,599 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2008, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage, Inc. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "config.h"
+
+#include "ros/io.h"
+#include "ros/transport/transport_shm.h"
+#include "ros/poll_set.h"
+#include "ros/header.h"
+#include "ros/file_log.h"
+#include <ros/assert.h>
+#include <ros/time.h>
+
+#include <boost/make_shared.hpp>
+
+#include <atomic>
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <sstream>
+
+#if defined(HAVE_SHM_OPEN)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#define ROSCPP_SHM_MAGIC 0x524f5348
+#define ROSCPP_SHM_VERSION 1
+/// Smallest ring we will create, in bytes
+#define ROSCPP_SHM_MIN_RING_SIZE (64 * 1024)
+
+namespace ros
+{
+
+uint32_t TransportSHM::s_ring_size_ = 16 * 1024 * 1024;
+
+/**
+ * \brief Lives at the start of the shared memory segment and is followed by the ring data.  head and tail are
+ * free-running byte counts: only the writer (publisher) moves head and only the reader (subscriber) moves tail.
+ */
+struct TransportSHM::Ring
+{
+  uint32_t magic;
+  uint32_t version;
+  uint64_t capacity;
+
+  alignas(64) std::atomic<uint64_t> head;
+  alignas(64) std::atomic<uint64_t> tail;
+
+  /// Set by the writer when it sends a data doorbell, cleared by the reader before it waits for the next one
+  alignas(64) std::atomic<uint32_t> data_signalled;
+  /// Set by the writer when the ring is full, cleared by the reader when it sends the space doorbell
+  std::atomic<uint32_t> writer_waiting;
+};
+
+TransportSHM::TransportSHM(PollSet* poll_set, int flags)
+: TransportTCP(poll_set, flags)
+, ring_(0)
+, ring_data_(0)
+, mapped_size_(0)
+, owner_(false)
+, linked_(false)
+, active_(false)
+, write_wanted_(false)
+{
+}
+
+TransportSHM::~TransportSHM()
+{
+  // The mapping is only released here, so a read or write racing with close() never touches unmapped memory
+  releaseSegment();
+}
+
+TransportTCPPtr TransportSHM::createAcceptedTransport(PollSet* poll_set)
+{
+  return boost::make_shared<TransportSHM>(poll_set, flags_);
+}
+
+bool TransportSHM::isPeerLocal()
+{
+  sockaddr_storage peer, local;
+  socklen_t peer_len = sizeof(peer);
+  socklen_t local_len = sizeof(local);
+  if (getpeername(sock_, (sockaddr*)&peer, &peer_len) != 0 || getsockname(sock_, (sockaddr*)&local, &local_len) != 0)
+  {
+    return false;
+  }
+
+  if (peer.ss_family != local.ss_family)
+  {
+    return false;
+  }
+
+  switch (peer.ss_family)
+  {
+    case AF_INET:
+    {
+      const in_addr& addr = ((sockaddr_in*)&peer)->sin_addr;
+      return (ntohl(addr.s_addr) >> 24) == 127 || addr.s_addr == ((sockaddr_in*)&local)->sin_addr.s_addr;
+    }
+    case AF_INET6:
+    {
+      const in6_addr& addr = ((sockaddr_in6*)&peer)->sin6_addr;
+      return IN6_IS_ADDR_LOOPBACK(&addr) || memcmp(&addr, &((sockaddr_in6*)&local)->sin6_addr, sizeof(addr)) == 0;
+    }
+  }
+
+  return false;
+}
+
+bool TransportSHM::createSegment()
+{
+  // Doorbells rely on non-blocking sockets
+  if (ring_ || (flags_ & SYNCHRONOUS) || !isPeerLocal())
+  {
+    return false;
+  }
+
+#if defined(HAVE_SHM_OPEN)
+  static std::atomic<uint32_t> segment_count(0);
+
+  // The nonce keeps us from picking up an unrelated segment with the same name, eg. from a process in another
+  // container that happens to have our pid
+  uint64_t nonce = WallTime::now().toNSec() ^ (uint64_t)(uintptr_t)this;
+  std::stringstream ss;
+  ss << "/roscpp_shm_" << getpid() << "_" << segment_count++ << "_" << std::hex << nonce;
+  std::string name = ss.str();
+
+  uint64_t capacity = ROSCPP_SHM_MIN_RING_SIZE;
+  while (capacity < s_ring_size_)
+  {
+    capacity <<= 1;
+  }
+
+  size_t size = sizeof(Ring) + capacity;
+  int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+  if (fd < 0)
+  {
+    ROSCPP_LOG_DEBUG("shm_open() failed for [%s]: [%s]", name.c_str(), strerror(errno));
+    return false;
+  }
+
+  if (ftruncate(fd, size) != 0)
+  {
+    ROSCPP_LOG_DEBUG("ftruncate() failed for [%s]: [%s]", name.c_str(), strerror(errno));
+    ::close(fd);
+    shm_unlink(name.c_str());
+    return false;
+  }
+
+  void* mem = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (mem == MAP_FAILED)
+  {
+    ROSCPP_LOG_DEBUG("mmap() failed for [%s]: [%s]", name.c_str(), strerror(errno));
+    shm_unlink(name.c_str());
+    return false;
+  }
+
+  Ring* ring = new (mem) Ring;
+  ring->magic = ROSCPP_SHM_MAGIC;
+  ring->version = ROSCPP_SHM_VERSION;
+  ring->capacity = capacity;
+  ring->head = 0;
+  ring->tail = 0;
+  ring->data_signalled = 0;
+  ring->writer_waiting = 0;
+
+  ring_ = ring;
+  ring_data_ = (uint8_t*)mem + sizeof(Ring);
+  mapped_size_ = size;
+  segment_name_ = name;
+  owner_ = true;
+  linked_ = true;
+
+  ROSCPP_LOG_DEBUG("Created shared memory ring [%s] of %u bytes on socket [%d]", name.c_str(), (uint32_t)capacity, sock_);
+
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool TransportSHM::attachSegment(const std::string& name)
+{
+  if (ring_ || name.empty() || (flags_ & SYNCHRONOUS) || !isPeerLocal())
+  {
+    return false;
+  }
+
+#if defined(HAVE_SHM_OPEN)
+  int fd = shm_open(name.c_str(), O_RDWR, 0);
+  if (fd < 0)
+  {
+    ROSCPP_LOG_DEBUG("shm_open() failed for [%s]: [%s]", name.c_str(), strerror(errno));
+    return false;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(Ring))
+  {
+    ::close(fd);
+    return false;
+  }
+
+  size_t size = st.st_size;
+  void* mem = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (mem == MAP_FAILED)
+  {
+    ROSCPP_LOG_DEBUG("mmap() failed for [%s]: [%s]", name.c_str(), strerror(errno));
+    return false;
+  }
+
+  Ring* ring = (Ring*)mem;
+  if (ring->magic != ROSCPP_SHM_MAGIC || ring->version != ROSCPP_SHM_VERSION || sizeof(Ring) + ring->capacity != size
+      || (ring->capacity & (ring->capacity - 1)) != 0)
+  {
+    ROSCPP_LOG_DEBUG("Shared memory segment [%s] is not a TCPROS-SHM ring", name.c_str());
+    munmap(mem, size);
+    return false;
+  }
+
+  ring_ = ring;
+  ring_data_ = (uint8_t*)mem + sizeof(Ring);
+  mapped_size_ = size;
+  segment_name_ = name;
+  owner_ = false;
+
+  return true;
+#else
+  return false;
+#endif
+}
+
+void TransportSHM::releaseSegment()
+{
+#if defined(HAVE_SHM_OPEN)
+  if (linked_)
+  {
+    shm_unlink(segment_name_.c_str());
+    linked_ = false;
+  }
+
+  if (ring_)
+  {
+    munmap(ring_, mapped_size_);
+  }
+#endif
+
+  ring_ = 0;
+  ring_data_ = 0;
+  mapped_size_ = 0;
+  active_ = false;
+}
+
+void TransportSHM::parseHeader(const Header& header)
+{
+  TransportTCP::parseHeader(header);
+
+  if (owner_)
+  {
+    // We offered a ring, this is the publisher's answer
+    std::string shm;
+    if (ring_ && header.getValue("shm", shm) && shm == "1")
+    {
+#if defined(HAVE_SHM_OPEN)
+      // Both sides have it mapped now, so the name is no longer needed
+      shm_unlink(segment_name_.c_str());
+      linked_ = false;
+#endif
+      setNoDelay(true);
+      active_ = true;
+
+      ROSCPP_LOG_DEBUG("Socket [%d] switched to shared memory ring [%s]", sock_, segment_name_.c_str());
+    }
+    else
+    {
+      releaseSegment();
+    }
+  }
+  else
+  {
+    std::string name;
+    if (header.getValue("shm_segment", name))
+    {
+      attachSegment(name);
+    }
+  }
+}
+
+void TransportSHM::activate()
+{
+  if (!ring_ || owner_ || active_)
+  {
+    return;
+  }
+
+  setNoDelay(true);
+  active_ = true;
+
+  // From now on the socket only carries space doorbells (and hangups) from the reader, so always watch it
+  if (!(flags_ & SYNCHRONOUS))
+  {
+    TransportTCP::enableRead();
+  }
+
+  ROSCPP_LOG_DEBUG("Socket [%d] switched to shared memory ring [%s]", sock_, segment_name_.c_str());
+}
+
+bool TransportSHM::drainDoorbell()
+{
+  uint8_t buf[64];
+  int32_t bytes_read = 0;
+  do
+  {
+    bytes_read = TransportTCP::read(buf, sizeof(buf));
+  } while (bytes_read == (int32_t)sizeof(buf));
+
+  return bytes_read >= 0;
+}
+
+void TransportSHM::ringDoorbell()
+{
+  // If the socket is full of doorbells already, the other side has plenty of reasons to wake up
+  uint8_t b = 0;
+  TransportTCP::write(&b, 1);
+}
+
+int32_t TransportSHM::read(uint8_t* buffer, uint32_t size)
+{
+  if (!active_ || !owner_)
+  {
+    return TransportTCP::read(buffer, size);
+  }
+
+  {
+    boost::recursive_mutex::scoped_lock lock(close_mutex_);
+
+    if (closed_)
+    {
+      ROSCPP_LOG_DEBUG("Tried to read on a closed socket [%d]", sock_);
+      return -1;
+    }
+  }
+
+  ROS_ASSERT(size > 0);
+
+  uint32_t read_size = std::min(size, static_cast<uint32_t>(INT_MAX));
+  uint64_t mask = ring_->capacity - 1;
+  uint64_t tail = ring_->tail.load(std::memory_order_relaxed);
+  uint64_t available = ring_->head.load() - tail;
+  if (available == 0)
+  {
+    // Nothing left, so re-arm the doorbell before looking again.  Data that shows up after this will ring it.
+    ring_->data_signalled = 0;
+    if (!drainDoorbell())
+    {
+      return -1;
+    }
+
+    available = ring_->head.load() - tail;
+    if (available == 0)
+    {
+      return 0;
+    }
+  }
+
+  uint32_t num_bytes = (uint32_t)std::min<uint64_t>(read_size, available);
+  uint64_t offset = tail & mask;
+  uint32_t first = (uint32_t)std::min<uint64_t>(num_bytes, ring_->capacity - offset);
+  memcpy(buffer, ring_data_ + offset, first);
+  memcpy(buffer + first, ring_data_, num_bytes - first);
+  ring_->tail = tail + num_bytes;
+
+  if (ring_->writer_waiting.load() && ring_->writer_waiting.exchange(0))
+  {
+    ringDoorbell();
+  }
+
+  return num_bytes;
+}
+
+int32_t TransportSHM::write(uint8_t* buffer, uint32_t size)
+{
+  if (!active_ || owner_)
+  {
+    return TransportTCP::write(buffer, size);
+  }
+
+  WriteBuffer b;
+  b.data = buffer;
+  b.size = size;
+  return writev(&b, 1);
+}
+
+int32_t TransportSHM::writev(const WriteBuffer* buffers, uint32_t count)
+{
+  if (!active_ || owner_)
+  {
+    return TransportTCP::writev(buffers, count);
+  }
+
+  {
+    boost::recursive_mutex::scoped_lock lock(close_mutex_);
+
+    if (closed_)
+    {
+      ROSCPP_LOG_DEBUG("Tried to write on a closed socket [%d]", sock_);
+      return -1;
+    }
+  }
+
+  uint64_t mask = ring_->capacity - 1;
+  uint64_t head = ring_->head.load(std::memory_order_relaxed);
+  uint32_t total = 0;
+  bool waited = false;
+  bool blocked = false;
+  for (uint32_t i = 0; i < count && total < (uint32_t)INT_MAX; ++i)
+  {
+    const uint8_t* data = buffers[i].data;
+    uint32_t left = std::min(buffers[i].size, (uint32_t)INT_MAX - total);
+    while (left > 0)
+    {
+      uint64_t space = ring_->capacity - (head - ring_->tail.load());
+      if (space == 0)
+      {
+        if (waited)
+        {
+          blocked = true;
+          break;
+        }
+
+        // Stop polling for write space on the socket, and ask the reader to ring once it has made some.  Check again
+        // afterwards in case it already did before seeing the request.
+        TransportTCP::disableWrite();
+        ring_->writer_waiting = 1;
+        waited = true;
+        continue;
+      }
+
+      uint32_t num_bytes = (uint32_t)std::min<uint64_t>(left, space);
+      uint64_t offset = head & mask;
+      uint32_t first = (uint32_t)std::min<uint64_t>(num_bytes, ring_->capacity - offset);
+      memcpy(ring_data_ + offset, data, first);
+      memcpy(ring_data_, data + first, num_bytes - first);
+
+      head += num_bytes;
+      ring_->head = head;
+
+      data += num_bytes;
+      left -= num_bytes;
+      total += num_bytes;
+    }
+
+    if (left > 0)
+    {
+      break;
+    }
+  }
+
+  if (waited && !blocked && write_wanted_)
+  {
+    // The reader made space while we were asking for it
+    TransportTCP::enableWrite();
+  }
+
+  if (total > 0 && ring_->data_signalled.exchange(1) == 0)
+  {
+    ringDoorbell();
+  }
+
+  return total;
+}
+
+void TransportSHM::enableWrite()
+{
+  if (active_ && !owner_)
+  {
+    write_wanted_ = true;
+  }
+
+  TransportTCP::enableWrite();
+}
+
+void TransportSHM::disableWrite()
+{
+  if (active_ && !owner_)
+  {
+    write_wanted_ = false;
+  }
+
+  TransportTCP::disableWrite();
+}
+
+void TransportSHM::enableRead()
+{
+  // The writing side keeps reading enabled for doorbells
+  if (active_ && !owner_)
+  {
+    return;
+  }
+
+  TransportTCP::enableRead();
+}
+
+void TransportSHM::disableRead()
+{
+  if (active_ && !owner_)
+  {
+    return;
+  }
+
+  TransportTCP::disableRead();
+}
+
+void TransportSHM::socketUpdate(int events)
+{
+  if (active_ && !owner_ && (events & POLLIN))
+  {
+    // The reader has made space (or gone away)
+    if (!drainDoorbell())
+    {
+      return;
+    }
+
+    if (write_wanted_)
+    {
+      TransportTCP::enableWrite();
+    }
+
+    events &= ~POLLIN;
+  }
+
+  TransportTCP::socketUpdate(events);
+}
+
+void TransportSHM::close()
+{
+#if defined(HAVE_SHM_OPEN)
+  {
+    boost::recursive_mutex::scoped_lock lock(close_mutex_);
+    if (linked_)
+    {
+      shm_unlink(segment_name_.c_str());
+      linked_ = false;
+    }
+  }
+#endif
+
+  TransportTCP::close();
+}
+
+std::string TransportSHM::getTransportInfo()
+{
+  if (!active_)
+  {
+    return TransportTCP::getTransportInfo();
+  }
+
+  std::stringstream str;
+  str << "TCPROS-SHM ring [" << segment_name_ << "] signalled over " << TransportTCP::getTransportInfo();
+  return str.str();
+}
+
+}
@@ -42,6 +42,13 @@
 #include <boost/bind.hpp>
 #include <fcntl.h>
 #include <errno.h>
+#ifndef WIN32
+#include <sys/uio.h>
+#endif
+
+/// Upper bound on the number of buffers handed to a single writev() call
+#define ROSCPP_TCP_MAX_IOVECS 64
+
 namespace ros
 {
 
@@ -51,13 +58,13 @@ bool TransportTCP::s_use_ipv6_ = false;
 TransportTCP::TransportTCP(PollSet* poll_set, int flags)
 : sock_(ROS_INVALID_SOCKET)
 , closed_(false)
+, poll_set_(poll_set)
+, flags_(flags)
 , expecting_read_(false)
 , expecting_write_(false)
 , is_server_(false)
 , server_port_(-1)
 , local_port_(-1)
-, poll_set_(poll_set)
-, flags_(flags)
 {
 
 }
@@ -464,6 +471,7 @@ void TransportTCP::close()
         read_cb_ = Callback();
         write_cb_ = Callback();
         accept_cb_ = AcceptCallback();
+        accept_poll_set_selector_ = PollSetSelector();
       }
     }
   }
@@ -546,6 +554,65 @@ int32_t TransportTCP::write(uint8_t* buffer, uint32_t size)
   return num_bytes;
 }
 
+int32_t TransportTCP::writev(const WriteBuffer* buffers, uint32_t count)
+{
+#if defined(WIN32)
+  return Transport::writev(buffers, count);
+#else
+  {
+    boost::recursive_mutex::scoped_lock lock(close_mutex_);
+
+    if (closed_)
+    {
+      ROSCPP_LOG_DEBUG("Tried to write on a closed socket [%d]", sock_);
+      return -1;
+    }
+  }
+
+  // Callers are allowed to get back a short write, so anything past our fixed iovec array (or past INT_MAX bytes)
+  // simply goes out on the next call
+  struct iovec iov[ROSCPP_TCP_MAX_IOVECS];
+  int iov_count = 0;
+  uint32_t total = 0;
+  for (uint32_t i = 0; i < count && iov_count < ROSCPP_TCP_MAX_IOVECS; ++i)
+  {
+    if (buffers[i].size == 0)
+    {
+      continue;
+    }
+
+    uint32_t size = std::min(buffers[i].size, static_cast<uint32_t>(INT_MAX) - total);
+    if (size == 0)
+    {
+      break;
+    }
+
+    iov[iov_count].iov_base = buffers[i].data;
+    iov[iov_count].iov_len = size;
+    ++iov_count;
+    total += size;
+  }
+
+  ROS_ASSERT(total > 0);
+
+  ssize_t num_bytes = ::writev(sock_, iov, iov_count);
+  if (num_bytes < 0)
+  {
+    if ( !last_socket_error_is_would_block() )
+    {
+      ROSCPP_LOG_DEBUG("writev() on socket [%d] failed with error [%s]", sock_, last_socket_error_string());
+      close();
+    }
+    else
+    {
+      num_bytes = 0;
+    }
+  }
+
+  return static_cast<int32_t>(num_bytes);
+#endif
+}
+
 void TransportTCP::enableRead()
 {
   ROS_ASSERT(!(flags_ & SYNCHRONOUS));
@@ -637,7 +704,8 @@ TransportTCPPtr TransportTCP::accept()
   {
     ROSCPP_LOG_DEBUG("Accepted connection on socket [%d], new socket [%d]", sock_, new_sock);
 
-    TransportTCPPtr transport(boost::make_shared<TransportTCP>(poll_set_, flags_));
+    PollSet* poll_set = accept_poll_set_selector_ ? accept_poll_set_selector_() : poll_set_;
+    TransportTCPPtr transport = createAcceptedTransport(poll_set);
     if (!transport->setSocket(new_sock))
     {
       ROS_ERROR("Failed to set socket on transport for socket %d", new_sock);
@@ -653,6 +721,11 @@ TransportTCPPtr TransportTCP::accept()
   return TransportTCPPtr();
 }
 
+TransportTCPPtr TransportTCP::createAcceptedTransport(PollSet* poll_set)
+{
+  return boost::make_shared<TransportTCP>(poll_set, flags_);
+}
+
 void TransportTCP::socketUpdate(int events)
 {
   {
@@ -32,12 +32,20 @@
  *  POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include "config.h"
+
 #include "ros/transport/transport_udp.h"
 #include "ros/poll_set.h"
+#include "ros/header.h"
 #include "ros/file_log.h"
 
 #include <ros/assert.h>
 #include <boost/bind.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
 
 #include <fcntl.h>
 #if defined(__APPLE__)
@@ -52,10 +60,153 @@
   // For readv() and writev()
   #include <sys/uio.h>
 #endif
+#if defined(HAVE_RECVMMSG) || defined(HAVE_SENDMMSG)
+  #include <sys/socket.h>
+  #include <netinet/udp.h>
+#endif
 
 namespace ros
 {
 
+int TransportUDP::s_max_batch_datagrams_ = 64;
+bool TransportUDP::s_use_segmentation_offload_ = false;
+
+namespace
+{
+/// Hard cap on s_max_batch_datagrams_, which sizes the per-call arrays on the stack
+const uint32_t s_max_batch_limit = 128;
+/// recvmmsg() slots are sized to fit in this much memory, so large datagrams get fewer of them
+const uint32_t s_max_recv_buffer_bytes = 512 * 1024;
+/// Messages that can be mid-reassembly at once before the oldest is given up on
+const uint32_t s_max_partial_messages = 8;
+/// A message whose id is up to this far behind the last one delivered has been overtaken and is dropped
+const uint8_t s_reorder_window = 16;
+/// Largest message sent or reassembled; a partial message is allocated whole, so fragments from the network must not
+/// be able to claim more than this
+const uint32_t s_max_message_size = 16 * 1024 * 1024;
+/// Largest UDP payload the kernel accepts in one (segmentation offloaded) send
+const uint32_t s_max_udp_payload = 65507;
+/// Most segments the kernel accepts in one UDP_SEGMENT send
+const uint32_t s_max_gso_segments = 64;
+
+/// Most parity fragments per group
+const uint32_t s_max_fec_parity = 8;
+/// Most data fragments per parity group
+const uint32_t s_max_fec_group = 64;
+/// A parity fragment starts with the message's fragment count and the size of its last fragment, so a message can be
+/// rebuilt even if its DATA0 or last fragment was lost
+const uint32_t s_parity_header_size = 2 * sizeof(uint16_t);
+
+uint32_t batchDatagrams()
+{
+  return std::min((uint32_t)std::max(TransportUDP::s_max_batch_datagrams_, 1), s_max_batch_limit);
+}
+
+/**
+ * \brief GF(2^8) arithmetic (polynomial 0x11d) for the parity fragments
+ */
+class GaloisField
+{
+public:
+  GaloisField()
+  {
+    uint32_t x = 1;
+    for (uint32_t i = 0; i < 255; ++i)
+    {
+      exp_[i] = x;
+      exp_[i + 255] = x;
+      log_[x] = i;
+      x <<= 1;
+      if (x & 0x100)
+      {
+        x ^= 0x11d;
+      }
+    }
+    log_[0] = 0;
+  }
+
+  uint8_t mul(uint8_t a, uint8_t b) const
+  {
+    return (a && b) ? exp_[log_[a] + log_[b]] : 0;
+  }
+
+  uint8_t div(uint8_t a, uint8_t b) const
+  {
+    return a ? exp_[log_[a] + 255 - log_[b]] : 0;
+  }
+
+  /**
+   * \brief dst += c * src
+   */
+  void mulAdd(uint8_t* dst, const uint8_t* src, uint32_t size, uint8_t c) const
+  {
+    if (c == 1)
+    {
+      uint32_t i = 0;
+      for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t))
+      {
+        uint64_t a, b;
+        memcpy(&a, dst + i, sizeof(a));
+        memcpy(&b, src + i, sizeof(b));
+        a ^= b;
+        memcpy(dst + i, &a, sizeof(a));
+      }
+      for (; i < size; ++i)
+      {
+        dst[i] ^= src[i];
+      }
+    }
+    else if (c != 0)
+    {
+      uint8_t table[256];
+      for (uint32_t x = 0; x < 256; ++x)
+      {
+        table[x] = mul(c, x);
+      }
+      for (uint32_t i = 0; i < size; ++i)
+      {
+        dst[i] ^= table[src[i]];
+      }
+    }
+  }
+
+private:
+  uint8_t exp_[510];
+  uint8_t log_[256];
+};
+
+const GaloisField& galoisField()
+{
+  static GaloisField gf;
+  return gf;
+}
+
+/**
+ * \brief Coefficient of the index'th data fragment of a group in that group's parity'th parity fragment.
+ *
+ * The coefficients form a Cauchy matrix 1 / (x_p + y_i), x_p = parity and y_i = s_max_fec_parity + index, with each
+ * column scaled so the first row is all ones.  Every square submatrix of it is invertible, so any k parity fragments
+ * can stand in for any k lost data fragments, and with a single parity fragment the code is a plain XOR.
+ */
+uint8_t parityCoefficient(uint32_t parity, uint32_t index)
+{
+  uint8_t y = s_max_fec_parity + index;
+  return galoisField().div(y, parity ^ y);
+}
+
+/// Fragments are dealt round-robin into groups, so a burst of losses is spread across them
+uint32_t parityGroups(uint32_t num_blocks, uint32_t group_blocks)
+{
+  return (num_blocks + group_blocks - 1) / group_blocks;
+}
+
+/// Most data fragments a message of up to s_max_message_size is split into
+uint32_t maxMessageBlocks(uint32_t payload_size)
+{
+  return (s_max_message_size + payload_size - 1) / payload_size;
+}
+}
+
 TransportUDP::TransportUDP(PollSet* poll_set, int flags, int max_datagram_size)
 : sock_(-1)
 , closed_(false)
@@ -68,27 +219,25 @@ TransportUDP::TransportUDP(PollSet* poll_set, int flags, int max_datagram_size)
 , flags_(flags)
 , connection_id_(0)
 , current_message_id_(0)
-, total_blocks_(0)
-, last_block_(0)
 , max_datagram_size_(max_datagram_size)
-, data_filled_(0)
-, reorder_buffer_(0)
-, reorder_bytes_(0)
+, gso_segments_(1)
+, gro_(false)
+, fec_parity_(0)
+, fec_group_(0)
+, recv_slot_size_(0)
+, recv_slots_(0)
+, ready_offset_(0)
+, last_delivered_id_(0)
+, delivered_any_(false)
 {
   // This may eventually be machine dependent
   if (max_datagram_size_ == 0)
     max_datagram_size_ = 1500;
-  reorder_buffer_ = new uint8_t[max_datagram_size_];
-  reorder_start_ = reorder_buffer_;
-  data_buffer_ = new uint8_t[max_datagram_size_];
-  data_start_ = data_buffer_;
 }
 
 TransportUDP::~TransportUDP()
 {
   ROS_ASSERT_MSG(sock_ == ROS_INVALID_SOCKET, "TransportUDP socket [%d] was never closed", sock_);
-  delete [] reorder_buffer_;
-  delete [] data_buffer_;
 }
 
 bool TransportUDP::setSocket(int sock)
@@ -136,6 +285,43 @@ void TransportUDP::socketUpdate(int events)
 
 }
 
+void TransportUDP::setFec(uint32_t parity_blocks, uint32_t group_blocks)
+{
+  if (parity_blocks == 0 || group_blocks == 0 || max_datagram_size_ <= sizeof(TransportUDPHeader) + s_parity_header_size)
+  {
+    fec_parity_ = 0;
+    fec_group_ = 0;
+    return;
+  }
+
+  fec_parity_ = std::min(parity_blocks, s_max_fec_parity);
+  fec_group_ = std::min(group_blocks, s_max_fec_group);
+  ROSCPP_LOG_DEBUG("UDP socket [%d] using %d parity fragments per %d data fragments", sock_, fec_parity_, fec_group_);
+}
+
+void TransportUDP::parseHeader(const Header& header)
+{
+  std::string parity, group;
+  if (header.getValue("fec_parity", parity) && header.getValue("fec_group", group))
+  {
+    try
+    {
+      setFec(boost::lexical_cast<uint32_t>(parity), boost::lexical_cast<uint32_t>(group));
+    }
+    catch (boost::bad_lexical_cast&)
+    {
+      ROSCPP_LOG_DEBUG("Ignoring malformed error correction parameters [%s/%s]", parity.c_str(), group.c_str());
+    }
+  }
+}
+
+uint32_t TransportUDP::payloadSize() const
+{
+  // With error correction on, data fragments leave room for the parity sub-header so parity fragments fit the same
+  // datagram size
+  return max_datagram_size_ - sizeof(TransportUDPHeader) - (fec_parity_ ? s_parity_header_size : 0);
+}
+
 std::string TransportUDP::getTransportInfo()
 {
   std::stringstream str;
@@ -290,6 +476,36 @@ bool TransportUDP::initializeSocket()
   getsockname(sock_, (sockaddr *)&local_address_, &len);
   local_port_ = ntohs(local_address_.sin_port);
 
+#if defined(UDP_SEGMENT) && defined(HAVE_SENDMMSG)
+  // Segments are sent whole, header included, so several of them must fit in one maximum sized UDP payload
+  if (s_use_segmentation_offload_ && max_datagram_size_ * 2 <= s_max_udp_payload)
+  {
+    int gso_size = 0;
+    if (setsockopt(sock_, SOL_UDP, UDP_SEGMENT, &gso_size, sizeof(gso_size)) == 0)
+    {
+      gso_segments_ = std::min(s_max_udp_payload / max_datagram_size_, s_max_gso_segments);
+    }
+    else
+    {
+      ROSCPP_LOG_DEBUG("UDP segmentation offload not supported on socket [%d]: [%s]", sock_, last_socket_error_string());
+    }
+  }
+#endif
+#if defined(UDP_GRO) && defined(HAVE_RECVMMSG)
+  if (s_use_segmentation_offload_)
+  {
+    int gro = 1;
+    if (setsockopt(sock_, SOL_UDP, UDP_GRO, &gro, sizeof(gro)) == 0)
+    {
+      gro_ = true;
+    }
+    else
+    {
+      ROSCPP_LOG_DEBUG("UDP receive offload not supported on socket [%d]: [%s]", sock_, last_socket_error_string());
+    }
+  }
+#endif
+
   ROS_ASSERT(poll_set_ || (flags_ & SYNCHRONOUS));
   if (poll_set_)
   {
@@ -360,169 +576,570 @@ int32_t TransportUDP::read(uint8_t* buffer, uint32_t size)
 
   while (bytes_read < size)
   {
-    TransportUDPHeader header;
-
-    // Get the data either from the reorder buffer or the socket
-    // copy_bytes will contain the read size.
-    // from_previous is true if the data belongs to the previous UDP datagram.
-    uint32_t copy_bytes = 0;
-    bool from_previous = false;
-    if (reorder_bytes_)
+    if (ready_.empty())
     {
-      if (reorder_start_ != reorder_buffer_)
+      // Only refill once everything handed out so far is gone, since ready messages may point into recv_buffer_
+      int32_t received = receiveDatagrams();
+      if (received < 0)
+      {
+        return -1;
+      }
+      else if (received == 0)
       {
-        from_previous = true;
+        break;
       }
 
-      copy_bytes = std::min(size - bytes_read, reorder_bytes_);
-      header = reorder_header_;
-      memcpy(buffer + bytes_read, reorder_start_, copy_bytes);
-      reorder_bytes_ -= copy_bytes;
-      reorder_start_ += copy_bytes;
+      continue;
     }
-    else
+
+    ReadyMessage& message = ready_.front();
+    uint32_t copy_bytes = std::min(size - bytes_read, message.size_ - ready_offset_);
+    memcpy(buffer + bytes_read, message.data_ + ready_offset_, copy_bytes);
+    bytes_read += copy_bytes;
+    ready_offset_ += copy_bytes;
+
+    if (ready_offset_ == message.size_)
     {
-      if (data_filled_ == 0)
+      ready_.pop_front();
+      ready_offset_ = 0;
+
+      if (bytes_read < size)
       {
+        // Every read is for (the rest of) one message; one that comes up short means we've lost sync with the
+        // sender, so have the caller start over at the next message
+        ROS_DEBUG("Message ended %d bytes short of a %d byte read", size - bytes_read, size);
+        return -1;
+      }
+    }
+  }
+
+  return bytes_read;
+}
+
+int32_t TransportUDP::receiveDatagrams()
+{
+  if (recv_buffer_.empty())
+  {
+    // With GRO on, one receive can hold a whole train of coalesced datagrams
+    recv_slot_size_ = gro_ ? 65536 : max_datagram_size_;
+#if defined(HAVE_RECVMMSG)
+    recv_slots_ = std::max(std::min(batchDatagrams(), s_max_recv_buffer_bytes / recv_slot_size_), 1U);
+#else
+    recv_slots_ = 1;
+#endif
+    recv_buffer_.resize(recv_slots_ * recv_slot_size_);
+  }
+
+  uint32_t num_datagrams = 0;
+  uint32_t datagram_sizes[s_max_batch_limit];
+  uint32_t segment_sizes[s_max_batch_limit];
+
 #if defined(WIN32)
-    	SSIZE_T num_bytes = 0;
-        DWORD received_bytes = 0;
-        DWORD flags = 0;
-        WSABUF iov[2];
-        iov[0].buf = reinterpret_cast<char*>(&header);
-        iov[0].len = sizeof(header);
-        iov[1].buf = reinterpret_cast<char*>(data_buffer_);
-        iov[1].len = max_datagram_size_ - sizeof(header);
-		int rc  = WSARecv(sock_, iov, 2, &received_bytes, &flags, NULL, NULL);
-		if ( rc == SOCKET_ERROR) {
-		  num_bytes = -1;
-		} else {
-			num_bytes = received_bytes;
-		}
+  SSIZE_T num_bytes = 0;
+  DWORD received_bytes = 0;
+  DWORD flags = 0;
+  WSABUF iov[1];
+  iov[0].buf = reinterpret_cast<char*>(&recv_buffer_[0]);
+  iov[0].len = recv_slot_size_;
+  int rc  = WSARecv(sock_, iov, 1, &received_bytes, &flags, NULL, NULL);
+  if ( rc == SOCKET_ERROR) {
+    num_bytes = -1;
+  } else {
+    num_bytes = received_bytes;
+  }
+  if (num_bytes >= 0)
+  {
+    datagram_sizes[0] = num_bytes;
+    segment_sizes[0] = 0;
+    num_datagrams = 1;
+  }
+  int result = num_bytes < 0 ? -1 : 1;
+#elif defined(HAVE_RECVMMSG)
+  mmsghdr msgs[s_max_batch_limit];
+  struct iovec iov[s_max_batch_limit];
+#if defined(UDP_GRO)
+  union
+  {
+    char buf[CMSG_SPACE(sizeof(int))];
+    cmsghdr align;
+  } control[s_max_batch_limit];
+#endif
+  memset(msgs, 0, sizeof(msgs[0]) * recv_slots_);
+  for (uint32_t i = 0; i < recv_slots_; ++i)
+  {
+    iov[i].iov_base = &recv_buffer_[i * recv_slot_size_];
+    iov[i].iov_len = recv_slot_size_;
+    msgs[i].msg_hdr.msg_iov = &iov[i];
+    msgs[i].msg_hdr.msg_iovlen = 1;
+#if defined(UDP_GRO)
+    if (gro_)
+    {
+      msgs[i].msg_hdr.msg_control = control[i].buf;
+      msgs[i].msg_hdr.msg_controllen = sizeof(control[i].buf);
+    }
+#endif
+  }
+
+  // MSG_WAITFORONE keeps a SYNCHRONOUS (blocking) socket from waiting for a full batch
+  int result = recvmmsg(sock_, msgs, recv_slots_, MSG_WAITFORONE, NULL);
+  for (int i = 0; i < result; ++i)
+  {
+    datagram_sizes[i] = msgs[i].msg_len;
+    segment_sizes[i] = 0;
+#if defined(UDP_GRO)
+    for (cmsghdr* cmsg = CMSG_FIRSTHDR(&msgs[i].msg_hdr); cmsg; cmsg = CMSG_NXTHDR(&msgs[i].msg_hdr, cmsg))
+    {
+      if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO)
+      {
+        int gso_size;
+        memcpy(&gso_size, CMSG_DATA(cmsg), sizeof(gso_size));
+        segment_sizes[i] = gso_size;
+      }
+    }
+#endif
+  }
+  num_datagrams = std::max(result, 0);
 #else
-        ssize_t num_bytes;
-        struct iovec iov[2];
-        iov[0].iov_base = &header;
-        iov[0].iov_len = sizeof(header);
-        iov[1].iov_base = data_buffer_;
-        iov[1].iov_len = max_datagram_size_ - sizeof(header);
-        // Read a datagram with header
-        num_bytes = readv(sock_, iov, 2);
+  struct iovec iov[1];
+  iov[0].iov_base = &recv_buffer_[0];
+  iov[0].iov_len = recv_slot_size_;
+  ssize_t num_bytes = readv(sock_, iov, 1);
+  if (num_bytes >= 0)
+  {
+    datagram_sizes[0] = num_bytes;
+    segment_sizes[0] = 0;
+    num_datagrams = 1;
+  }
+  int result = num_bytes < 0 ? -1 : 1;
 #endif
-        if (num_bytes < 0)
-        {
-          if ( last_socket_error_is_would_block() )
-          {
-            num_bytes = 0;
-            break;
-          }
-          else
-          {
-            ROSCPP_LOG_DEBUG("readv() failed with error [%s]",  last_socket_error_string());
-            close();
-            break;
-          }
-        }
-        else if (num_bytes == 0)
-        {
-          ROSCPP_LOG_DEBUG("Socket [%d] received 0/%d bytes, closing", sock_, size);
-          close();
-          return -1;
-        }
-        else if (num_bytes < (unsigned) sizeof(header))
+
+  if (result < 0)
+  {
+    if (last_socket_error_is_would_block())
+    {
+      return 0;
+    }
+
+    ROSCPP_LOG_DEBUG("recvmmsg() failed with error [%s]", last_socket_error_string());
+    close();
+    return -1;
+  }
+
+  for (uint32_t i = 0; i < num_datagrams; ++i)
+  {
+    const uint8_t* data = &recv_buffer_[i * recv_slot_size_];
+    uint32_t size = datagram_sizes[i];
+
+    if (size == 0)
+    {
+      ROSCPP_LOG_DEBUG("Socket [%d] received 0 byte datagram, closing", sock_);
+      close();
+      return -1;
+    }
+
+    // A GRO receive is a run of datagrams of segment_sizes[i] bytes each, the last one possibly shorter
+    uint32_t segment_size = segment_sizes[i] ? segment_sizes[i] : size;
+    for (uint32_t offset = 0; offset < size; offset += segment_size)
+    {
+      if (!processDatagram(data + offset, std::min(segment_size, size - offset)))
+      {
+        return -1;
+      }
+    }
+  }
+
+  return num_datagrams;
+}
+
+bool TransportUDP::processDatagram(const uint8_t* data, uint32_t size)
+{
+  if (size < sizeof(TransportUDPHeader))
+  {
+    ROS_ERROR("Socket [%d] received short header (%d bytes)", sock_, int(size));
+    close();
+    return false;
+  }
+
+  TransportUDPHeader header;
+  memcpy(&header, data, sizeof(header));
+  const uint8_t* payload = data + sizeof(header);
+  uint32_t payload_size = size - sizeof(header);
+  const uint32_t max_payload_size = payloadSize();
+
+  uint16_t block;
+  uint16_t parity_total_blocks = 0;
+  uint16_t parity_last_block_size = 0;
+  switch (header.op_)
+  {
+    case ROS_UDP_DATA0:
+      if (header.block_ == 0)
+      {
+        ROS_DEBUG("Received message [%d] with no blocks", header.message_id_);
+        return true;
+      }
+      if (header.block_ == 1 && !fec_parity_)
+      {
+        // Unfragmented, which is the common case: hand it straight out of the receive buffer
+        deliverMessage(header.message_id_, payload, payload_size, 0);
+        return true;
+      }
+      block = 0;
+      break;
+    case ROS_UDP_DATAN:
+      block = header.block_;
+      break;
+    case ROS_UDP_PARITY:
+      if (fec_parity_ && payload_size == s_parity_header_size + max_payload_size)
+      {
+        block = header.block_;
+        memcpy(&parity_total_blocks, payload, sizeof(uint16_t));
+        memcpy(&parity_last_block_size, payload + sizeof(uint16_t), sizeof(uint16_t));
+        payload += s_parity_header_size;
+        payload_size -= s_parity_header_size;
+        if (parity_total_blocks && parity_last_block_size && parity_last_block_size <= max_payload_size
+            && block < parityGroups(parity_total_blocks, fec_group_) * fec_parity_)
         {
-          ROS_ERROR("Socket [%d] received short header (%d bytes): %s", sock_, int(num_bytes),  last_socket_error_string());
-          close();
-          return -1;
+          break;
         }
-
-		num_bytes -= sizeof(header);
-        data_filled_ = num_bytes;
-        data_start_ = data_buffer_;
       }
-      else
+      ROS_DEBUG("Dropping malformed or unexpected parity fragment %d of message [%d]", header.block_, header.message_id_);
+      return true;
+    default:
+      ROS_ERROR("Unexpected UDP header OP [%d]", header.op_);
+      return true;
+  }
+
+  uint32_t claimed_blocks = (header.op_ == ROS_UDP_DATA0) ? header.block_ : (header.op_ == ROS_UDP_DATAN) ? block + 1 : parity_total_blocks;
+  if (claimed_blocks > maxMessageBlocks(max_payload_size))
+  {
+    ROS_DEBUG("Dropping block %d of message [%d], which would make it larger than %d bytes", block, header.message_id_, s_max_message_size);
+    return true;
+  }
+
+  if (delivered_any_ && (uint8_t)(last_delivered_id_ - header.message_id_) < s_reorder_window)
+  {
+    ROS_DEBUG("Dropping block %d of message [%d], which has already been overtaken", block, header.message_id_);
+    return true;
+  }
+
+  if (payload_size > max_payload_size)
+  {
+    ROS_DEBUG("Dropping block %d of message [%d]: %d bytes is more than the %d byte maximum", block, header.message_id_, payload_size, max_payload_size);
+    return true;
+  }
+
+  std::vector<PartialMessage>::iterator it = partials_.begin();
+  for (; it != partials_.end() && it->message_id_ != header.message_id_; ++it)
+  {
+  }
+
+  if (it == partials_.end())
+  {
+    if (partials_.size() >= s_max_partial_messages)
+    {
+      ROS_DEBUG("Giving up on message [%d] (%d of %d blocks received)", partials_.front().message_id_, partials_.front().blocks_received_, partials_.front().total_blocks_);
+      partials_.erase(partials_.begin());
+    }
+
+    partials_.push_back(PartialMessage());
+    it = partials_.end() - 1;
+    it->message_id_ = header.message_id_;
+    it->total_blocks_ = 0;
+    it->blocks_received_ = 0;
+    it->last_block_size_ = 0;
+    it->parity_received_ = 0;
+  }
+
+  PartialMessage& partial = *it;
+  uint16_t total_blocks = (header.op_ == ROS_UDP_DATA0) ? header.block_ : parity_total_blocks;
+  if (total_blocks && !partial.total_blocks_)
+  {
+    partial.total_blocks_ = total_blocks;
+    if (partial.block_sizes_.size() > partial.total_blocks_)
+    {
+      ROS_DEBUG("Message [%d] has %d blocks, but block %d was received", header.message_id_, partial.total_blocks_, (int)partial.block_sizes_.size() - 1);
+      partials_.erase(it);
+      return true;
+    }
+    partial.block_sizes_.resize(partial.total_blocks_, 0);
+    partial.data_.resize((size_t)partial.total_blocks_ * max_payload_size);
+    if (fec_parity_)
+    {
+      uint32_t num_parity = parityGroups(partial.total_blocks_, fec_group_) * fec_parity_;
+      partial.parity_have_.resize(num_parity, 0);
+      partial.parity_.resize((size_t)num_parity * max_payload_size);
+    }
+  }
+  else if (total_blocks && total_blocks != partial.total_blocks_)
+  {
+    ROS_DEBUG("Message [%d] has %d blocks, but block %d says %d", header.message_id_, partial.total_blocks_, block, total_blocks);
+    return true;
+  }
+  else if (header.op_ == ROS_UDP_DATAN && partial.total_blocks_ && block >= partial.total_blocks_)
+  {
+    ROS_DEBUG("Message [%d] has %d blocks, but block %d was received", header.message_id_, partial.total_blocks_, block);
+    return true;
+  }
+  else if (header.op_ == ROS_UDP_DATAN && block >= partial.block_sizes_.size())
+  {
+    partial.block_sizes_.resize(block + 1, 0);
+    partial.data_.resize((size_t)(block + 1) * max_payload_size);
+  }
+
+  if (header.op_ == ROS_UDP_PARITY)
+  {
+    if (partial.parity_have_[block])
+    {
+      return true;
+    }
+
+    memcpy(&partial.parity_[(size_t)block * max_payload_size], payload, payload_size);
+    partial.parity_have_[block] = 1;
+    partial.last_block_size_ = parity_last_block_size;
+    ++partial.parity_received_;
+  }
+  else
+  {
+    if (partial.block_sizes_[block] || payload_size == 0)
+    {
+      // Duplicate, or an empty block that no sender would produce
+      return true;
+    }
+
+    memcpy(&partial.data_[(size_t)block * max_payload_size], payload, payload_size);
+    partial.block_sizes_[block] = payload_size;
+    ++partial.blocks_received_;
+  }
+
+  if (partial.total_blocks_ == 0 || partial.blocks_received_ + partial.parity_received_ < partial.total_blocks_)
+  {
+    return true;
+  }
+
+  if (partial.blocks_received_ < partial.total_blocks_ && !recoverMessage(partial))
+  {
+    return true;
+  }
+
+  // Every block but the last has to be full, or the offsets they were copied to are wrong
+  for (uint16_t i = 0; i + 1 < partial.total_blocks_; ++i)
+  {
+    if (partial.block_sizes_[i] != max_payload_size)
+    {
+      ROS_DEBUG("Dropping message [%d]: block %d is %d bytes, expected %d", header.message_id_, i, partial.block_sizes_[i], max_payload_size);
+      partials_.erase(it);
+      return true;
+    }
+  }
+
+  std::vector<uint8_t> storage;
+  storage.swap(partial.data_);
+  uint32_t message_size = (partial.total_blocks_ - 1) * max_payload_size + partial.block_sizes_.back();
+  uint8_t message_id = partial.message_id_;
+  partials_.erase(it);
+
+  deliverMessage(message_id, &storage[0], message_size, &storage);
+  return true;
+}
+
+bool TransportUDP::recoverMessage(PartialMessage& partial)
+{
+  if (!fec_parity_ || !partial.parity_received_)
+  {
+    return false;
+  }
+
+  const GaloisField& gf = galoisField();
+  const uint32_t payload_size = payloadSize();
+  const uint32_t num_blocks = partial.total_blocks_;
+  const uint32_t num_groups = parityGroups(num_blocks, fec_group_);
+
+  // Only start once every group can be rebuilt
+  for (uint32_t g = 0; g < num_groups; ++g)
+  {
+    uint32_t missing = 0;
+    for (uint32_t b = g; b < num_blocks; b += num_groups)
+    {
+      missing += partial.block_sizes_[b] == 0;
+    }
+
+    uint32_t parity = 0;
+    for (uint32_t p = 0; p < fec_parity_; ++p)
+    {
+      parity += partial.parity_have_[g * fec_parity_ + p];
+    }
+
+    if (missing > parity)
+    {
+      return false;
+    }
+  }
+
+  std::vector<uint8_t> syndromes;
+  for (uint32_t g = 0; g < num_groups; ++g)
+  {
+    uint32_t missing[s_max_fec_parity];
+    uint32_t rows[s_max_fec_parity];
+    uint32_t num_missing = 0;
+    for (uint32_t b = g, i = 0; b < num_blocks && num_missing < s_max_fec_parity; b += num_groups, ++i)
+    {
+      if (partial.block_sizes_[b] == 0)
       {
-        from_previous = true;
+        missing[num_missing++] = i;
       }
+    }
 
-      copy_bytes = std::min(size - bytes_read, data_filled_);
-      // Copy from the data buffer, whether it has data left in it from a previous datagram or
-      // was just filled by readv()
-      memcpy(buffer + bytes_read, data_start_, copy_bytes);
-      data_filled_ -= copy_bytes;
-      data_start_ += copy_bytes;
+    if (num_missing == 0)
+    {
+      continue;
     }
 
+    for (uint32_t p = 0, r = 0; p < fec_parity_ && r < num_missing; ++p)
+    {
+      if (partial.parity_have_[g * fec_parity_ + p])
+      {
+        rows[r++] = p;
+      }
+    }
 
-    if (from_previous)
+    // Strip the known fragments out of each parity fragment we use, leaving sum(coefficient * missing fragment)
+    syndromes.resize((size_t)num_missing * payload_size);
+    for (uint32_t r = 0; r < num_missing; ++r)
     {
-      // We are simply reading data from the last UDP datagram, nothing to
-      // parse
-      bytes_read += copy_bytes;
+      uint8_t* syndrome = &syndromes[(size_t)r * payload_size];
+      memcpy(syndrome, &partial.parity_[(size_t)(g * fec_parity_ + rows[r]) * payload_size], payload_size);
+      for (uint32_t b = g, i = 0; b < num_blocks; b += num_groups, ++i)
+      {
+        if (partial.block_sizes_[b])
+        {
+          gf.mulAdd(syndrome, &partial.data_[(size_t)b * payload_size], payload_size, parityCoefficient(rows[r], i));
+        }
+      }
     }
-    else
+
+    // Invert the num_missing x num_missing system by Gauss-Jordan elimination
+    uint8_t a[s_max_fec_parity][s_max_fec_parity];
+    uint8_t inv[s_max_fec_parity][s_max_fec_parity];
+    for (uint32_t r = 0; r < num_missing; ++r)
     {
-      // This datagram is new, process header
-      switch (header.op_)
-      {
-        case ROS_UDP_DATA0:
-          if (current_message_id_)
-          {
-            ROS_DEBUG("Received new message [%d:%d], while still working on [%d] (block %d of %d)", header.message_id_, header.block_, current_message_id_, last_block_ + 1, total_blocks_);
-            reorder_header_ = header;
-
-            // Copy the entire data buffer to the reorder buffer, as we will
-            // need to replay this UDP datagram in the next call.
-            reorder_bytes_ = data_filled_ + (data_start_ - data_buffer_);
-            memcpy(reorder_buffer_, data_buffer_, reorder_bytes_);
-            reorder_start_ = reorder_buffer_;
-            current_message_id_ = 0;
-            total_blocks_ = 0;
-            last_block_ = 0;
-
-            data_filled_ = 0;
-            data_start_ = data_buffer_;
-            return -1;
-          }
-          total_blocks_ = header.block_;
-          last_block_ = 0;
-          current_message_id_ = header.message_id_;
-          break;
-        case ROS_UDP_DATAN:
-          if (header.message_id_ != current_message_id_)
-          {
-            ROS_DEBUG("Message Id mismatch: %d != %d", header.message_id_, current_message_id_);
-            data_filled_ = 0; // discard datagram
-            return 0;
-          }
-          if (header.block_ != last_block_ + 1)
-          {
-            ROS_DEBUG("Expected block %d, received %d", last_block_ + 1, header.block_);
-            data_filled_ = 0; // discard datagram
-            return 0;
-          }
-          last_block_ = header.block_;
+      for (uint32_t c = 0; c < num_missing; ++c)
+      {
+        a[r][c] = parityCoefficient(rows[r], missing[c]);
+        inv[r][c] = (r == c);
+      }
+    }
 
-          break;
-        default:
-          ROS_ERROR("Unexpected UDP header OP [%d]", header.op_);
-          return -1;
+    for (uint32_t c = 0; c < num_missing; ++c)
+    {
+      uint32_t pivot = c;
+      while (pivot < num_missing && a[pivot][c] == 0)
+      {
+        ++pivot;
       }
+      if (pivot == num_missing)
+      {
+        ROS_DEBUG("Parity fragments of message [%d] are singular", partial.message_id_);
+        return false;
+      }
+      std::swap(a[c], a[pivot]);
+      std::swap(inv[c], inv[pivot]);
 
-      bytes_read += copy_bytes;
+      uint8_t scale = gf.div(1, a[c][c]);
+      for (uint32_t k = 0; k < num_missing; ++k)
+      {
+        a[c][k] = gf.mul(a[c][k], scale);
+        inv[c][k] = gf.mul(inv[c][k], scale);
+      }
 
-      if (last_block_ == (total_blocks_ - 1))
+      for (uint32_t r = 0; r < num_missing; ++r)
       {
-        current_message_id_ = 0;
-        break;
+        uint8_t factor = a[r][c];
+        if (r == c || factor == 0)
+        {
+          continue;
+        }
+        for (uint32_t k = 0; k < num_missing; ++k)
+        {
+          a[r][k] ^= gf.mul(factor, a[c][k]);
+          inv[r][k] ^= gf.mul(factor, inv[c][k]);
+        }
       }
     }
+
+    for (uint32_t c = 0; c < num_missing; ++c)
+    {
+      uint32_t b = g + missing[c] * num_groups;
+      uint8_t* block = &partial.data_[(size_t)b * payload_size];
+      memset(block, 0, payload_size);
+      for (uint32_t r = 0; r < num_missing; ++r)
+      {
+        gf.mulAdd(block, &syndromes[(size_t)r * payload_size], payload_size, inv[c][r]);
+      }
+
+      partial.block_sizes_[b] = (b + 1 == num_blocks) ? partial.last_block_size_ : payload_size;
+    }
   }
 
-  return bytes_read;
+  ROS_DEBUG("Rebuilt %d lost fragments of message [%d]", num_blocks - partial.blocks_received_, partial.message_id_);
+  partial.blocks_received_ = num_blocks;
+  return true;
+}
+
+void TransportUDP::deliverMessage(uint8_t message_id, const uint8_t* data, uint32_t size, std::vector<uint8_t>* storage)
+{
+  if (delivered_any_ && (uint8_t)(last_delivered_id_ - message_id) < s_reorder_window)
+  {
+    ROS_DEBUG("Dropping message [%d], which arrived after message [%d]", message_id, last_delivered_id_);
+    return;
+  }
+
+  last_delivered_id_ = message_id;
+  delivered_any_ = true;
+
+  // Anything older still being reassembled would now be delivered out of order, so stop waiting for it
+  for (std::vector<PartialMessage>::iterator it = partials_.begin(); it != partials_.end();)
+  {
+    if ((uint8_t)(message_id - it->message_id_) < s_reorder_window)
+    {
+      ROS_DEBUG("Giving up on message [%d], overtaken by message [%d]", it->message_id_, message_id);
+      it = partials_.erase(it);
+    }
+    else
+    {
+      ++it;
+    }
+  }
+
+  ready_.push_back(ReadyMessage());
+  ReadyMessage& ready = ready_.back();
+  ready.size_ = size;
+  if (storage)
+  {
+    ready.storage_.swap(*storage);
+    ready.data_ = &ready.storage_[0];
+  }
+  else
+  {
+    ready.data_ = data;
+  }
 }
 
 int32_t TransportUDP::write(uint8_t* buffer, uint32_t size)
+{
+  ROS_ASSERT((int32_t)size > 0);
+
+  WriteBuffer message;
+  message.data = buffer;
+  message.size = size;
+  return sendMessages(&message, 1);
+}
+
+int32_t TransportUDP::writev(const WriteBuffer* buffers, uint32_t count)
+{
+  return sendMessages(buffers, count);
+}
+
+int32_t TransportUDP::sendMessages(const WriteBuffer* buffers, uint32_t count)
 {
   {
     boost::mutex::scoped_lock lock(close_mutex_);
@@ -534,30 +1151,238 @@ int32_t TransportUDP::write(uint8_t* buffer, uint32_t size)
     }
   }
 
-  ROS_ASSERT((int32_t)size > 0);
+  const uint32_t max_payload_size = payloadSize();
+  const uint32_t batch = batchDatagrams();
 
-  const uint32_t max_payload_size = max_datagram_size_ - sizeof(TransportUDPHeader);
+  TransportUDPHeader headers[s_max_batch_limit];
+  uint8_t* payloads[s_max_batch_limit];
+  uint32_t payload_sizes[s_max_batch_limit];
+  uint32_t num_fragments = 0;
 
+  // Bytes of the messages fully sent so far, and of those whose last fragment is waiting in the current batch
   uint32_t bytes_sent = 0;
-  uint32_t this_block = 0;
-  if (++current_message_id_ == 0)
-    ++current_message_id_;
-  while (bytes_sent < size)
+  uint32_t bytes_batched = 0;
+
+  for (uint32_t i = 0; i < count; ++i)
   {
-    TransportUDPHeader header;
-    header.connection_id_ = connection_id_;
-    header.message_id_ = current_message_id_;
-    if (this_block == 0)
+    uint8_t* buffer = buffers[i].data;
+    uint32_t size = buffers[i].size;
+    if (size == 0)
     {
-      header.op_ = ROS_UDP_DATA0;
-      header.block_ = (size + max_payload_size - 1) / max_payload_size;
+      continue;
     }
-    else
+
+    if (size > s_max_message_size)
+    {
+      // Receivers would drop every fragment of it; count it as sent so the connection moves on
+      ROS_WARN_ONCE("Dropping a %d byte message on UDPROS connection [%d], which only carries messages of up to %d bytes", size, connection_id_, s_max_message_size);
+      bytes_batched += size;
+      continue;
+    }
+
+    if (++current_message_id_ == 0)
+      ++current_message_id_;
+
+    const uint32_t num_blocks = (size + max_payload_size - 1) / max_payload_size;
+    const uint32_t num_parity = fec_parity_ ? encodeParity(buffer, size, num_blocks) : 0;
+    const uint32_t parity_size = s_parity_header_size + max_payload_size;
+
+    for (uint32_t this_block = 0; this_block < num_blocks + num_parity; ++this_block)
+    {
+      TransportUDPHeader& header = headers[num_fragments];
+      header.connection_id_ = connection_id_;
+      header.message_id_ = current_message_id_;
+      if (this_block == 0)
+      {
+        header.op_ = ROS_UDP_DATA0;
+        header.block_ = num_blocks;
+      }
+      else if (this_block < num_blocks)
+      {
+        header.op_ = ROS_UDP_DATAN;
+        header.block_ = this_block;
+      }
+      else
+      {
+        header.op_ = ROS_UDP_PARITY;
+        header.block_ = this_block - num_blocks;
+      }
+
+      if (this_block < num_blocks)
+      {
+        uint32_t offset = this_block * max_payload_size;
+        payloads[num_fragments] = buffer + offset;
+        payload_sizes[num_fragments] = std::min(max_payload_size, size - offset);
+      }
+      else
+      {
+        payloads[num_fragments] = &parity_buffer_[(size_t)header.block_ * parity_size];
+        payload_sizes[num_fragments] = parity_size;
+      }
+      ++num_fragments;
+
+      bool last = (this_block + 1 == num_blocks + num_parity);
+      if (last)
+      {
+        bytes_batched += size;
+      }
+
+      // parity_buffer_ only holds one message's parity, so it has to go out before the next message is encoded
+      if (num_fragments == batch || (last && num_parity))
+      {
+        if (!sendFragments(headers, payloads, payload_sizes, num_fragments))
+        {
+          return -1;
+        }
+
+        bytes_sent += bytes_batched;
+        bytes_batched = 0;
+        num_fragments = 0;
+      }
+    }
+  }
+
+  if (num_fragments > 0)
+  {
+    if (!sendFragments(headers, payloads, payload_sizes, num_fragments))
     {
-      header.op_ = ROS_UDP_DATAN;
-      header.block_ = this_block;
+      return -1;
     }
-    ++this_block;
+  }
+
+  // With nothing left to send, this only holds messages that were too large to send
+  bytes_sent += bytes_batched;
+
+  return bytes_sent;
+}
+
+uint32_t TransportUDP::encodeParity(const uint8_t* buffer, uint32_t size, uint32_t num_blocks)
+{
+  const GaloisField& gf = galoisField();
+  const uint32_t payload_size = payloadSize();
+  const uint32_t parity_size = s_parity_header_size + payload_size;
+  const uint32_t num_groups = parityGroups(num_blocks, fec_group_);
+  const uint32_t num_parity = num_groups * fec_parity_;
+  const uint16_t total_blocks = num_blocks;
+  const uint16_t last_block_size = size - (num_blocks - 1) * payload_size;
+
+  parity_buffer_.assign((size_t)num_parity * parity_size, 0);
+
+  for (uint32_t g = 0; g < num_groups; ++g)
+  {
+    for (uint32_t p = 0; p < fec_parity_; ++p)
+    {
+      uint8_t* parity = &parity_buffer_[(size_t)(g * fec_parity_ + p) * parity_size];
+      memcpy(parity, &total_blocks, sizeof(uint16_t));
+      memcpy(parity + sizeof(uint16_t), &last_block_size, sizeof(uint16_t));
+      parity += s_parity_header_size;
+
+      // The last fragment is short; the rest of it counts as zeros
+      for (uint32_t b = g, i = 0; b < num_blocks; b += num_groups, ++i)
+      {
+        uint32_t offset = b * payload_size;
+        gf.mulAdd(parity, buffer + offset, std::min(payload_size, size - offset), parityCoefficient(p, i));
+      }
+    }
+  }
+
+  return num_parity;
+}
+
+bool TransportUDP::sendFragments(const TransportUDPHeader* headers, uint8_t* const* payloads, const uint32_t* payload_sizes, uint32_t count)
+{
+#if defined(HAVE_SENDMMSG)
+  struct iovec iov[2 * s_max_batch_limit];
+  for (uint32_t i = 0; i < count; ++i)
+  {
+    iov[2 * i].iov_base = const_cast<TransportUDPHeader*>(&headers[i]);
+    iov[2 * i].iov_len = sizeof(TransportUDPHeader);
+    iov[2 * i + 1].iov_base = payloads[i];
+    iov[2 * i + 1].iov_len = payload_sizes[i];
+  }
+
+  mmsghdr msgs[s_max_batch_limit];
+  uint32_t msg_fragments[s_max_batch_limit];
+#if defined(UDP_SEGMENT)
+  union
+  {
+    char buf[CMSG_SPACE(sizeof(uint16_t))];
+    cmsghdr align;
+  } control[s_max_batch_limit];
+#endif
+
+  uint32_t start = 0;
+  while (start < count)
+  {
+    uint32_t num_msgs = 0;
+    for (uint32_t i = start; i < count; ++num_msgs)
+    {
+      // With segmentation offload, a run of equally sized data (or parity) fragments of one message, plus possibly a
+      // final shorter one, goes to the kernel as one buffer, which it splits back into datagrams of the first one's size
+      uint8_t next_op = (headers[i].op_ == ROS_UDP_PARITY) ? ROS_UDP_PARITY : ROS_UDP_DATAN;
+      uint32_t n = 1;
+      while (i + n < count && n < gso_segments_
+             && payload_sizes[i + n - 1] == payload_sizes[i]
+             && headers[i + n].op_ == next_op
+             && headers[i + n].message_id_ == headers[i].message_id_)
+      {
+        ++n;
+      }
+
+      mmsghdr& msg = msgs[num_msgs];
+      memset(&msg, 0, sizeof(msg));
+      msg.msg_hdr.msg_iov = &iov[2 * i];
+      msg.msg_hdr.msg_iovlen = 2 * n;
+#if defined(UDP_SEGMENT)
+      if (n > 1)
+      {
+        msg.msg_hdr.msg_control = control[num_msgs].buf;
+        msg.msg_hdr.msg_controllen = sizeof(control[num_msgs].buf);
+        cmsghdr* cmsg = CMSG_FIRSTHDR(&msg.msg_hdr);
+        cmsg->cmsg_level = SOL_UDP;
+        cmsg->cmsg_type = UDP_SEGMENT;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+        uint16_t gso_size = sizeof(TransportUDPHeader) + payload_sizes[i];
+        memcpy(CMSG_DATA(cmsg), &gso_size, sizeof(gso_size));
+      }
+#endif
+      msg_fragments[num_msgs] = n;
+      i += n;
+    }
+
+    int num_sent = sendmmsg(sock_, msgs, num_msgs, 0);
+    if (num_sent < 0)
+    {
+      if (last_socket_error_is_would_block())
+      {
+        // As with a single datagram, spin until the socket takes it
+        continue;
+      }
+      else if (gso_segments_ > 1 && (errno == EIO || errno == EINVAL))
+      {
+        // Typically a max_datagram_size_ larger than the path MTU, or a device that can't segment; fall back to
+        // one datagram per fragment for good
+        ROSCPP_LOG_DEBUG("UDP segmentation offload failed on socket [%d] with error [%s], disabling it", sock_, last_socket_error_string());
+        gso_segments_ = 1;
+        continue;
+      }
+
+      ROSCPP_LOG_DEBUG("sendmmsg() failed with error [%s]", last_socket_error_string());
+      close();
+      return false;
+    }
+
+    for (int i = 0; i < num_sent; ++i)
+    {
+      start += msg_fragments[i];
+    }
+  }
+
+  return true;
+#else
+  for (uint32_t i = 0; i < count;)
+  {
+    TransportUDPHeader header = headers[i];
 #if defined(WIN32)
     WSABUF iov[2];
 	DWORD sent_bytes;
@@ -566,8 +1391,8 @@ int32_t TransportUDP::write(uint8_t* buffer, uint32_t size)
 	int rc;
 	iov[0].buf = reinterpret_cast<char*>(&header);
 	iov[0].len = sizeof(header);
-	iov[1].buf = reinterpret_cast<char*>(buffer + bytes_sent);
-	iov[1].len = std::min(max_payload_size, size - bytes_sent);
+	iov[1].buf = reinterpret_cast<char*>(payloads[i]);
+	iov[1].len = payload_sizes[i];
 	rc = WSASend(sock_, iov, 2, &sent_bytes, flags, NULL, NULL);
 	num_bytes = sent_bytes;
 	if (rc == SOCKET_ERROR) {
@@ -577,39 +1402,34 @@ int32_t TransportUDP::write(uint8_t* buffer, uint32_t size)
     struct iovec iov[2];
     iov[0].iov_base = &header;
     iov[0].iov_len = sizeof(header);
-    iov[1].iov_base = buffer + bytes_sent;
-    iov[1].iov_len = std::min(max_payload_size, size - bytes_sent);
-    ssize_t num_bytes = writev(sock_, iov, 2);
+    iov[1].iov_base = payloads[i];
+    iov[1].iov_len = payload_sizes[i];
+    ssize_t num_bytes = ::writev(sock_, iov, 2);
 #endif
-    //usleep(100);
     if (num_bytes < 0)
     {
       if( !last_socket_error_is_would_block() ) // Actually EAGAIN or EWOULDBLOCK on posix
       {
         ROSCPP_LOG_DEBUG("writev() failed with error [%s]", last_socket_error_string());
         close();
-        break;
-      }
-      else
-      {
-        num_bytes = 0;
-        --this_block;
+        return false;
       }
+
+      // Spin until the socket takes it
+      continue;
     }
-    else if (num_bytes < (unsigned) sizeof(header))
+    else if (num_bytes < (int)(sizeof(header) + payload_sizes[i]))
     {
       ROSCPP_LOG_DEBUG("Socket [%d] short write (%d bytes), closing", sock_, int(num_bytes));
       close();
-      break;
-    }
-    else
-    {
-      num_bytes -= sizeof(header);
+      return false;
     }
-    bytes_sent += num_bytes;
+
+    ++i;
   }
 
-  return bytes_sent;
+  return true;
+#endif
 }
 
 void TransportUDP::enableRead()
@@ -42,8 +42,8 @@
 #include "ros/this_node.h"
 #include "ros/connection_manager.h"
 #include "ros/file_log.h"
-#include "ros/poll_manager.h"
 #include "ros/transport/transport_tcp.h"
+#include "ros/transport/transport_shm.h"
 #include "ros/timer_manager.h"
 #include "ros/callback_queue.h"
 #include "ros/internal_timer_manager.h"
@@ -96,6 +96,13 @@ bool TransportPublisherLink::initialize(const ConnectionPtr& connection)
     header["callerid"] = this_node::getName();
     header["type"] = parent->datatype();
     header["tcp_nodelay"] = transport_hints_.getTCPNoDelay() ? "1" : "0";
+
+    TransportSHMPtr shm_transport = boost::dynamic_pointer_cast<TransportSHM>(connection_->getTransport());
+    if (shm_transport && shm_transport->createSegment())
+    {
+      header["shm_segment"] = shm_transport->getSegmentName();
+    }
+
     connection_->writeHeader(header, boost::bind(&TransportPublisherLink::onHeaderWritten, this, _1));
   }
   else
@@ -214,7 +221,8 @@ void TransportPublisherLink::onRetryTimer(const ros::SteadyTimerEvent&)
     // For now, since UDP does not have a heartbeat, we do not attempt to retry
     // UDP connections since an error there likely means some invalid operation has
     // happened.
-    if (connection_->getTransport()->getType() == std::string("TCPROS"))
+    const std::string type = connection_->getTransport()->getType();
+    if (type == "TCPROS" || type == "TCPROS-SHM")
     {
       std::string topic = parent ? parent->getName() : "unknown";
 
@@ -225,7 +233,16 @@ void TransportPublisherLink::onRetryTimer(const ros::SteadyTimerEvent&)
 
       ROSCPP_CONN_LOG_DEBUG("Retrying connection to [%s:%d] for topic [%s]", host.c_str(), port, topic.c_str());
 
-      TransportTCPPtr transport(boost::make_shared<TransportTCP>(&PollManager::instance()->getPollSet()));
+      TransportTCPPtr transport;
+      if (boost::dynamic_pointer_cast<TransportSHM>(old_transport))
+      {
+        transport = boost::make_shared<TransportSHM>(ConnectionManager::instance()->selectPollSet());
+      }
+      else
+      {
+        transport = boost::make_shared<TransportTCP>(ConnectionManager::instance()->selectPollSet());
+      }
+
       if (transport->connect(host, port))
       {
         ConnectionPtr connection(boost::make_shared<Connection>());
@@ -295,6 +312,7 @@ void TransportPublisherLink::handleMessage(const SerializedMessage& m, bool ser,
 {
   stats_.bytes_received_ += m.num_bytes;
   stats_.messages_received_++;
+  size_histogram_->record(m.num_bytes);
 
   SubscriptionPtr parent = parent_.lock();
 
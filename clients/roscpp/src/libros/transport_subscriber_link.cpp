@@ -31,6 +31,7 @@
 #include "ros/header.h"
 #include "ros/connection.h"
 #include "ros/transport/transport.h"
+#include "ros/transport/transport_shm.h"
 #include "ros/this_node.h"
 #include "ros/connection_manager.h"
 #include "ros/topic_manager.h"
@@ -38,9 +39,14 @@
 
 #include <boost/bind.hpp>
 
+#include <algorithm>
+
 namespace ros
 {
 
+int TransportSubscriberLink::s_max_write_batch_count_ = 32;
+int TransportSubscriberLink::s_max_write_batch_bytes_ = 1024 * 1024;
+
 TransportSubscriberLink::TransportSubscriberLink()
 : writing_message_(false)
 , header_written_(false)
@@ -112,6 +118,14 @@ bool TransportSubscriberLink::handleHeader(const Header& header)
   m["callerid"] = this_node::getName();
   m["latching"] = pt->isLatching() ? "1" : "0";
   m["topic"] = topic_;
+
+  // The subscriber offered a shared memory ring and TransportSHM managed to map it
+  TransportSHMPtr shm_transport = boost::dynamic_pointer_cast<TransportSHM>(connection_->getTransport());
+  if (shm_transport && shm_transport->isAttached())
+  {
+    m["shm"] = "1";
+  }
+
   connection_->writeHeader(m, boost::bind(&TransportSubscriberLink::onHeaderWritten, this, _1));
 
   pt->addSubscriberLink(shared_from_this());
@@ -137,6 +151,14 @@ void TransportSubscriberLink::onConnectionDropped(const ConnectionPtr& conn)
 void TransportSubscriberLink::onHeaderWritten(const ConnectionPtr& conn)
 {
   (void)conn;
+
+  // Everything after the header goes through the ring, if we agreed to use one
+  TransportSHMPtr shm_transport = boost::dynamic_pointer_cast<TransportSHM>(connection_->getTransport());
+  if (shm_transport && shm_transport->isAttached())
+  {
+    shm_transport->activate();
+  }
+
   header_written_ = true;
   startMessageWrite(true);
 }
@@ -144,14 +166,24 @@ void TransportSubscriberLink::onHeaderWritten(const ConnectionPtr& conn)
 void TransportSubscriberLink::onMessageWritten(const ConnectionPtr& conn)
 {
   (void)conn;
+
+  SteadyTime now = SteadyTime::now();
+  {
+    boost::mutex::scoped_lock lock(outbox_mutex_);
+    for (size_t i = 0; i < writing_enqueue_times_.size(); ++i)
+    {
+      latency_histogram_->record((now - writing_enqueue_times_[i]).toNSec());
+    }
+    writing_enqueue_times_.clear();
+  }
+
   writing_message_ = false;
   startMessageWrite(true);
 }
 
 void TransportSubscriberLink::startMessageWrite(bool immediate_write)
 {
-  boost::shared_array<uint8_t> dummy;
-  SerializedMessage m(dummy, (uint32_t)0);
+  V_WriteBuffer buffers;
 
   {
     boost::mutex::scoped_lock lock(outbox_mutex_);
@@ -160,17 +192,39 @@ void TransportSubscriberLink::startMessageWrite(bool immediate_write)
       return;
     }
 
-    if (!outbox_.empty())
+    // Drain as much of the backlog as the batch limits allow, so a slow subscriber costs one write per batch
+    // rather than one per message
+    uint32_t batch_bytes = 0;
+    while (!outbox_.empty() && (int)buffers.size() < std::max(s_max_write_batch_count_, 1))
     {
-      writing_message_ = true;
-      m = outbox_.front();
+      const SerializedMessage& m = outbox_.front().message;
+      if (!buffers.empty() && batch_bytes + m.num_bytes > (uint32_t)s_max_write_batch_bytes_)
+      {
+        break;
+      }
+
+      if (m.num_bytes > 0)
+      {
+        buffers.push_back(WriteBufferAndSize(m.buf, m.num_bytes));
+        batch_bytes += m.num_bytes;
+        writing_enqueue_times_.push_back(outbox_.front().enqueue_time);
+      }
       outbox_.pop();
     }
+
+    if (!buffers.empty())
+    {
+      writing_message_ = true;
+    }
   }
 
-  if (m.num_bytes > 0)
+  if (buffers.size() == 1)
+  {
+    connection_->write(buffers[0].first, buffers[0].second, boost::bind(&TransportSubscriberLink::onMessageWritten, this, _1), immediate_write);
+  }
+  else if (!buffers.empty())
   {
-    connection_->write(m.buf, m.num_bytes, boost::bind(&TransportSubscriberLink::onMessageWritten, this, _1), immediate_write);
+    connection_->writeBatch(buffers, boost::bind(&TransportSubscriberLink::onMessageWritten, this, _1), immediate_write);
   }
 }
 
@@ -210,7 +264,10 @@ void TransportSubscriberLink::enqueueMessage(const SerializedMessage& m, bool se
       queue_full_ = false;
     }
 
-    outbox_.push(m);
+    OutboxEntry entry;
+    entry.message = m;
+    entry.enqueue_time = SteadyTime::now();
+    outbox_.push(entry);
   }
 
   startMessageWrite(false);
@@ -218,6 +275,7 @@ void TransportSubscriberLink::enqueueMessage(const SerializedMessage& m, bool se
   stats_.messages_sent_++;
   stats_.bytes_sent_ += m.num_bytes;
   stats_.message_data_sent_ += m.num_bytes;
+  size_histogram_->record(m.num_bytes);
 }
 
 std::string TransportSubscriberLink::getTransportType()
@@ -34,6 +34,7 @@ namespace ros
 WallTimer::Impl::Impl()
   : started_(false)
   , timer_handle_(-1)
+  , priority_(0)
 { }
 
 WallTimer::Impl::~Impl()
@@ -51,7 +52,8 @@ void WallTimer::Impl::start()
     {
       tracked_object = tracked_object_.lock();
     }
-    timer_handle_ = TimerManager<WallTime, WallDuration, WallTimerEvent>::global().add(period_, callback_, callback_queue_, tracked_object, oneshot_);
+    timer_handle_ = TimerManager<WallTime, WallDuration, WallTimerEvent>::global().add(period_, callback_, callback_queue_, tracked_object, oneshot_,
+                                                                                       priority_, deadline_);
     started_ = true;
   }
 }
@@ -97,6 +99,8 @@ WallTimer::WallTimer(const WallTimerOptions& ops)
   impl_->tracked_object_ = ops.tracked_object;
   impl_->has_tracked_object_ = (ops.tracked_object != NULL);
   impl_->oneshot_ = ops.oneshot;
+  impl_->priority_ = ops.priority;
+  impl_->deadline_ = ops.deadline;
 }
 
 WallTimer::WallTimer(const WallTimer& rhs)
@@ -0,0 +1,195 @@
+#include "ros/time.h"
+#include "rosbag/bag.h"
+#include "rosbag/chunk_writer.h"
+#include "rosbag/view.h"
+#include "std_msgs/String.h"
+
+#include <signal.h>
+#include <sys/resource.h>
+
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "boost/foreach.hpp"
+#include <gtest/gtest.h>
+
+const int message_count = 2000;
+
+std::string messageData(int i) {
+    return std::string(10 + (i % 211) * 7, 'a' + (i % 26));
+}
+
+std::string readFile(std::string const& filename) {
+    std::ifstream file(filename.c_str(), std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+void writeMessages(rosbag::Bag& bag, int begin, int end) {
+    for (int i = begin; i < end; ++i) {
+        std_msgs::String msg;
+        msg.data = messageData(i);
+        bag.write(i % 2 == 0 ? "/even" : "/odd", ros::Time(1000 + i, 0), msg);
+    }
+}
+
+void writeBag(std::string const& filename, rosbag::CompressionType compression, uint32_t threads, bool async_write) {
+    rosbag::Bag bag;
+    bag.setAsyncWrite(async_write);
+    bag.open(filename, rosbag::bagmode::Write);
+    bag.setCompression(compression);
+    bag.setCompressionThreads(threads);
+    bag.setChunkThreshold(16 * 1024);
+    writeMessages(bag, 0, message_count);
+    bag.close();
+}
+
+void checkBag(std::string const& filename, int count) {
+    rosbag::Bag bag;
+    bag.open(filename, rosbag::bagmode::Read);
+
+    rosbag::View view(bag);
+    int i = 0;
+    BOOST_FOREACH(rosbag::MessageInstance const m, view)
+    {
+        std_msgs::String::ConstPtr s = m.instantiate<std_msgs::String>();
+        ASSERT_TRUE(s);
+        EXPECT_EQ(messageData(i), s->data);
+        ++i;
+    }
+    EXPECT_EQ(count, i);
+}
+
+TEST(rosbag_storage, chunk_writer_unaligned_appends)
+{
+    std::string filename = "/tmp/chunk_writer_unaligned.bin";
+    std::string expected(1234, 'h');
+    {
+        std::ofstream file(filename.c_str(), std::ios::binary);
+        file << expected;
+    }
+
+    {
+        rosbag::ChunkWriter writer(filename, expected.size(), 2);
+        for (int i = 0; i < 200; ++i) {
+            std::string piece(i * 97 % 9000 + 1, 'A' + i % 26);
+            writer.write(piece.data(), piece.size());
+            expected += piece;
+            if (i % 3 == 0)
+                writer.submit();
+            if (i % 50 == 0)
+                writer.sync();
+        }
+        EXPECT_EQ(expected.size(), writer.getOffset());
+        writer.sync();
+    }
+
+    EXPECT_TRUE(readFile(filename) == expected);
+}
+
+// A write cut short by the file size limit is finished in waitOldest(), which has to report the error
+// and leave everything before the limit in place
+TEST(rosbag_storage, chunk_writer_short_write)
+{
+    std::string filename = "/tmp/chunk_writer_short.bin";
+    std::ofstream(filename.c_str(), std::ios::binary | std::ios::trunc).close();
+
+    size_t const limit = 3 * rosbag::ChunkWriter::BUFFER_ALIGNMENT;
+    std::string expected(8 * rosbag::ChunkWriter::BUFFER_ALIGNMENT, 's');
+    for (size_t i = 0; i < expected.size(); ++i)
+        expected[i] = 'a' + i % 26;
+
+    void (*old_handler)(int) = signal(SIGXFSZ, SIG_IGN);
+    struct rlimit old_limit;
+    getrlimit(RLIMIT_FSIZE, &old_limit);
+    struct rlimit new_limit = old_limit;
+    new_limit.rlim_cur = limit;
+    setrlimit(RLIMIT_FSIZE, &new_limit);
+
+    {
+        rosbag::ChunkWriter writer(filename, 0, 2);
+        writer.write(expected.data(), expected.size());
+        writer.submit();
+        EXPECT_THROW(writer.sync(), rosbag::BagIOException);
+    }
+
+    setrlimit(RLIMIT_FSIZE, &old_limit);
+    signal(SIGXFSZ, old_handler);
+
+    EXPECT_TRUE(readFile(filename) == expected.substr(0, limit));
+}
+
+TEST(rosbag_storage, async_write_matches_stdio)
+{
+    for (int c = 0; c < 3; ++c) {
+        for (uint32_t threads = 0; threads < 3; threads += 2) {
+            rosbag::CompressionType compression = rosbag::CompressionType(c);
+            writeBag("/tmp/async_write_stdio.bag", compression, threads, false);
+            writeBag("/tmp/async_write_async.bag", compression, threads, true);
+
+            EXPECT_TRUE(readFile("/tmp/async_write_stdio.bag") == readFile("/tmp/async_write_async.bag"))
+                << "compression " << c << ", threads " << threads;
+            checkBag("/tmp/async_write_async.bag", message_count);
+        }
+    }
+}
+
+TEST(rosbag_storage, async_write_read_back_and_append)
+{
+    std::string filename = "/tmp/async_write_append.bag";
+    {
+        rosbag::Bag bag;
+        bag.setAsyncWrite(true);
+        bag.open(filename, rosbag::bagmode::Write | rosbag::bagmode::Read);
+        bag.setChunkThreshold(8 * 1024);
+        writeMessages(bag, 0, message_count / 2);
+
+        // Finish the chunk being assembled; the chunks still with the writer are flushed before they're read back
+        bag.setChunkThreshold(8 * 1024);
+        rosbag::View view(bag);
+        EXPECT_EQ(message_count / 2, (int) view.size());
+        int i = 0;
+        BOOST_FOREACH(rosbag::MessageInstance const m, view)
+        {
+            EXPECT_EQ(messageData(i), m.instantiate<std_msgs::String>()->data);
+            ++i;
+        }
+
+        writeMessages(bag, message_count / 2, 3 * message_count / 4);
+    }
+
+    {
+        rosbag::Bag bag;
+        bag.setAsyncWrite(true);
+        bag.open(filename, rosbag::bagmode::Append);
+        bag.setCompression(rosbag::compression::LZ4);
+        writeMessages(bag, 3 * message_count / 4, message_count);
+    }
+
+    checkBag(filename, message_count);
+}
+
+TEST(rosbag_storage, async_write_encryptor_after_write)
+{
+    std::string filename = "/tmp/async_write_encryptor.bag";
+    {
+        rosbag::Bag bag;
+        bag.setAsyncWrite(true);
+        bag.open(filename, rosbag::bagmode::Write);
+        writeMessages(bag, 0, 1);
+
+        // The message is already in a chunk by the time the encryptor would apply
+        EXPECT_THROW(bag.setEncryptorPlugin("rosbag/AesCbcEncryptor", ""), rosbag::BagException);
+        writeMessages(bag, 1, 10);
+    }
+
+    checkBag(filename, 10);
+}
+
+int main(int argc, char **argv) {
+    ros::Time::init();
+
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,105 @@
+#include "ros/time.h"
+#include "rosbag/bag.h"
+#include "rosbag/view.h"
+#include "std_msgs/String.h"
+
+#include <fstream>
+#include <iterator>
+#include <string>
+
+#include "boost/foreach.hpp"
+#include <gtest/gtest.h>
+
+// Enough data for a few dozen chunks with a small chunk threshold
+const int message_count = 2000;
+
+std::string messageData(int i) {
+    std::string data(100 + (i % 37) * 11, 'a' + (i % 26));
+    for (size_t k = 0; k < data.size(); k += 7)
+        data[k] = (char) ((i * 31 + k * 17) & 0x7f);
+    return data;
+}
+
+void writeBag(std::string const& filename, rosbag::CompressionType compression, uint32_t threads) {
+    rosbag::Bag bag;
+    bag.setCompression(compression);
+    bag.setChunkThreshold(16 * 1024);
+    bag.setCompressionThreads(threads);
+    bag.open(filename, rosbag::bagmode::Write);
+
+    for (int i = 0; i < message_count; ++i) {
+        std_msgs::String msg;
+        msg.data = messageData(i);
+        bag.write(i % 2 ? "/odd" : "/even", ros::Time(1000 + i, 0), msg);
+    }
+
+    bag.close();
+}
+
+std::string readFile(std::string const& filename) {
+    std::ifstream f(filename.c_str(), std::ios::binary);
+    return std::string((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+}
+
+void checkBag(std::string const& filename) {
+    rosbag::Bag bag(filename, rosbag::bagmode::Read);
+    rosbag::View view(bag);
+
+    int i = 0;
+    BOOST_FOREACH(rosbag::MessageInstance const m, view)
+    {
+        std_msgs::String::ConstPtr s = m.instantiate<std_msgs::String>();
+        ASSERT_TRUE(s);
+        EXPECT_EQ(messageData(i), s->data);
+        EXPECT_EQ(ros::Time(1000 + i, 0), m.getTime());
+        ++i;
+    }
+    EXPECT_EQ(message_count, i);
+}
+
+TEST(rosbag_storage, background_compression_matches_inline)
+{
+    for (int c = 0; c < 3; ++c) {
+        rosbag::CompressionType compression = rosbag::CompressionType(c);
+
+        writeBag("/tmp/background_compression_inline.bag", compression, 0);
+        writeBag("/tmp/background_compression_threads.bag", compression, 3);
+
+        // Background compression must not change a single byte of the file
+        EXPECT_EQ(readFile("/tmp/background_compression_inline.bag"),
+                  readFile("/tmp/background_compression_threads.bag")) << "compression " << c;
+
+        checkBag("/tmp/background_compression_threads.bag");
+    }
+}
+
+TEST(rosbag_storage, background_compression_switching_compression)
+{
+    rosbag::Bag bag;
+    bag.setCompression(rosbag::compression::LZ4);
+    bag.setChunkThreshold(16 * 1024);
+    bag.setCompressionThreads(2);
+    bag.open("/tmp/background_compression_switch.bag", rosbag::bagmode::Write);
+
+    for (int i = 0; i < message_count; ++i) {
+        // Chunks still being compressed must be written before the ones that follow
+        if (i == message_count / 3)
+            bag.setCompression(rosbag::compression::Uncompressed);
+        if (i == 2 * message_count / 3)
+            bag.setCompression(rosbag::compression::BZ2);
+
+        std_msgs::String msg;
+        msg.data = messageData(i);
+        bag.write(i % 2 ? "/odd" : "/even", ros::Time(1000 + i, 0), msg);
+    }
+    bag.close();
+
+    checkBag("/tmp/background_compression_switch.bag");
+}
+
+int main(int argc, char **argv) {
+    ros::Time::init();
+
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,130 @@
+#include "ros/time.h"
+#include "rosbag/bag.h"
+#include "rosbag/view.h"
+#include "std_msgs/String.h"
+
+#include <string>
+#include <vector>
+
+#include "boost/foreach.hpp"
+#include <gtest/gtest.h>
+
+const int message_count = 3000;
+
+std::string messageData(int i) {
+    std::string data(50 + (i % 29) * 13, 'a' + (i % 26));
+    for (size_t k = 0; k < data.size(); k += 5)
+        data[k] = (char) ((i * 7 + k) & 0x7f);
+    return data;
+}
+
+std::string topicName(int i) {
+    return i % 3 == 0 ? "/a" : (i % 3 == 1 ? "/b" : "/c");
+}
+
+std::string bagName(rosbag::CompressionType compression) {
+    return "/tmp/chunk_read_ahead_" + std::to_string((int) compression) + ".bag";
+}
+
+void writeBag(rosbag::CompressionType compression) {
+    rosbag::Bag bag;
+    bag.setCompression(compression);
+    bag.setChunkThreshold(8 * 1024);
+    bag.open(bagName(compression), rosbag::bagmode::Write);
+
+    for (int i = 0; i < message_count; ++i) {
+        std_msgs::String msg;
+        msg.data = messageData(i);
+        bag.write(topicName(i), ros::Time(1000 + i, 0), msg);
+    }
+
+    bag.close();
+}
+
+// Read every message of a view, returning its index in the original sequence
+std::vector<int> readView(rosbag::View& view) {
+    std::vector<int> seen;
+    BOOST_FOREACH(rosbag::MessageInstance const m, view)
+    {
+        int i = m.getTime().sec - 1000;
+        std_msgs::String::ConstPtr s = m.instantiate<std_msgs::String>();
+        EXPECT_TRUE(s);
+        if (s) {
+            EXPECT_EQ(messageData(i), s->data);
+        }
+        EXPECT_EQ(topicName(i), m.getTopic());
+        seen.push_back(i);
+    }
+    return seen;
+}
+
+TEST(rosbag_storage, read_ahead_full_view)
+{
+    for (int c = 0; c < 3; ++c) {
+        rosbag::CompressionType compression = rosbag::CompressionType(c);
+        writeBag(compression);
+
+        rosbag::Bag bag;
+        bag.open(bagName(compression), rosbag::bagmode::Read);
+        bag.setDecompressionThreads(3);
+        bag.setReadAheadChunks(3);
+
+        rosbag::View view(bag);
+        std::vector<int> seen = readView(view);
+        ASSERT_EQ(message_count, (int) seen.size());
+        for (int i = 0; i < message_count; ++i)
+            EXPECT_EQ(i, seen[i]);
+    }
+}
+
+TEST(rosbag_storage, read_ahead_topic_and_time_query)
+{
+    writeBag(rosbag::compression::LZ4);
+
+    rosbag::Bag bag;
+    bag.open(bagName(rosbag::compression::LZ4), rosbag::bagmode::Read);
+    bag.setDecompressionThreads(2);
+
+    rosbag::View view(bag, rosbag::TopicQuery("/b"), ros::Time(1500, 0), ros::Time(2500, 0));
+    std::vector<int> seen = readView(view);
+    ASSERT_FALSE(seen.empty());
+    EXPECT_EQ(502, seen.front());
+    for (size_t k = 1; k < seen.size(); ++k)
+        EXPECT_EQ(seen[k - 1] + 3, seen[k]);
+    EXPECT_EQ(1498, seen.back());
+}
+
+TEST(rosbag_storage, read_ahead_interleaved_views)
+{
+    writeBag(rosbag::compression::BZ2);
+
+    rosbag::Bag bag;
+    bag.open(bagName(rosbag::compression::BZ2), rosbag::bagmode::Read);
+    bag.setDecompressionThreads(2);
+    bag.setReadAheadChunks(1);
+
+    // Two iterators far apart keep evicting each other's chunks from the cache
+    rosbag::View first(bag, ros::TIME_MIN, ros::Time(1000 + message_count / 2, 0));
+    rosbag::View second(bag, ros::Time(1000 + message_count / 2 + 1, 0), ros::TIME_MAX);
+    rosbag::View::iterator a = first.begin();
+    rosbag::View::iterator b = second.begin();
+    int count = 0;
+    while (a != first.end() && b != second.end()) {
+        int i = a->getTime().sec - 1000;
+        int j = b->getTime().sec - 1000;
+        EXPECT_EQ(messageData(i), a->instantiate<std_msgs::String>()->data);
+        EXPECT_EQ(messageData(j), b->instantiate<std_msgs::String>()->data);
+        EXPECT_EQ(i + message_count / 2 + 1, j);
+        ++a;
+        ++b;
+        ++count;
+    }
+    EXPECT_EQ(message_count / 2 - 1, count);
+}
+
+int main(int argc, char **argv) {
+    ros::Time::init();
+
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
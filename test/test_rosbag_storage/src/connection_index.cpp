@@ -0,0 +1,130 @@
+#include "ros/time.h"
+#include "rosbag/bag.h"
+#include "rosbag/view.h"
+#include "std_msgs/String.h"
+
+#include <string>
+
+#include "boost/foreach.hpp"
+#include "boost/lexical_cast.hpp"
+#include <gtest/gtest.h>
+
+const int message_count = 3000;
+const std::string bag_name = "/tmp/connection_index.bag";
+
+// Times jump back and forth and repeat, so chunks overlap in time and many messages share a stamp
+ros::Time messageTime(int i) {
+    return ros::Time(1000 + (i * 7) % 500, 0);
+}
+
+void writeMessage(rosbag::Bag& bag, int i, ros::Time const& time) {
+    std_msgs::String msg;
+    msg.data = boost::lexical_cast<std::string>(i);
+    bag.write(i % 2 == 0 ? "/even" : "/odd", time, msg);
+}
+
+int messageIndex(rosbag::MessageInstance const& m) {
+    std_msgs::String::ConstPtr s = m.instantiate<std_msgs::String>();
+    return s ? boost::lexical_cast<int>(s->data) : -1;
+}
+
+// Expect each topic in time order, with messages that share a time in the order they were written
+void checkTimeOrder(rosbag::Bag const& bag, std::string const& topic, int expected_count) {
+    rosbag::View view(bag, rosbag::TopicQuery(topic));
+    ros::Time last_time;
+    int last_index = -1;
+    int count = 0;
+    BOOST_FOREACH(rosbag::MessageInstance const m, view)
+    {
+        int i = messageIndex(m);
+        EXPECT_EQ(messageTime(i), m.getTime());
+        EXPECT_LE(last_time, m.getTime());
+        if (m.getTime() == last_time) {
+            EXPECT_LT(last_index, i);
+        }
+
+        last_time = m.getTime();
+        last_index = i;
+        ++count;
+    }
+    EXPECT_EQ(expected_count, count);
+}
+
+TEST(rosbag_storage, out_of_order_writes_read_back_in_time_order)
+{
+    for (int async_write = 0; async_write < 2; ++async_write) {
+        rosbag::Bag out;
+        out.setAsyncWrite(async_write);
+        out.setChunkThreshold(2 * 1024);
+        out.open(bag_name, rosbag::bagmode::Write);
+        for (int i = 0; i < message_count; ++i)
+            writeMessage(out, i, messageTime(i));
+        out.close();
+
+        rosbag::Bag bag;
+        bag.open(bag_name, rosbag::bagmode::Read);
+        checkTimeOrder(bag, "/even", message_count / 2);
+        checkTimeOrder(bag, "/odd", message_count / 2);
+    }
+}
+
+TEST(rosbag_storage, out_of_order_writes_seen_by_open_view)
+{
+    for (int async_write = 0; async_write < 2; ++async_write) {
+        rosbag::Bag bag;
+        bag.setAsyncWrite(async_write);
+        bag.setChunkThreshold(2 * 1024);
+        bag.open(bag_name, rosbag::bagmode::Write | rosbag::bagmode::Read);
+        for (int i = 0; i < message_count; ++i)
+            writeMessage(bag, i, messageTime(i));
+
+        // Finish the open chunk so all of its messages are indexed
+        bag.setChunkThreshold(1);
+        checkTimeOrder(bag, "/even", message_count / 2);
+        checkTimeOrder(bag, "/odd", message_count / 2);
+    }
+}
+
+TEST(rosbag_storage, iterator_keeps_its_place_across_writes)
+{
+    rosbag::Bag bag;
+    bag.setChunkThreshold(1);
+    bag.open(bag_name, rosbag::bagmode::Write | rosbag::bagmode::Read);
+
+    rosbag::View view(bag, rosbag::TopicQuery("/even"));
+
+    writeMessage(bag, 1000, ros::Time(1001, 0));
+    rosbag::View::iterator iter = view.begin();
+    ASSERT_EQ(1000, messageIndex(*iter));
+
+    // Earlier messages, newest first, each go in front of the iterator's message; the index
+    // grows well past its first allocation on the way
+    for (int i = 998; i >= 0; i -= 2)
+        writeMessage(bag, i, ros::Time(i + 1, 0));
+    for (int i = 1002; i < 2000; i += 2)
+        writeMessage(bag, i, ros::Time(i + 1, 0));
+
+    rosbag::View::iterator copy = iter;
+    EXPECT_TRUE(copy == iter);
+
+    for (int i = 1000; i < 2000; i += 2, ++iter) {
+        ASSERT_TRUE(iter != view.end());
+        EXPECT_EQ(i, messageIndex(*iter));
+    }
+    EXPECT_TRUE(iter == view.end());
+
+    int expected = 0;
+    BOOST_FOREACH(rosbag::MessageInstance const m, view)
+    {
+        EXPECT_EQ(expected, messageIndex(m));
+        expected += 2;
+    }
+    EXPECT_EQ(2000, expected);
+}
+
+int main(int argc, char **argv) {
+    ros::Time::init();
+
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
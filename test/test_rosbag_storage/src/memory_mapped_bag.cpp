@@ -0,0 +1,131 @@
+#include "ros/time.h"
+#include "rosbag/bag.h"
+#include "rosbag/view.h"
+#include "std_msgs/String.h"
+
+#include <string>
+#include <vector>
+
+#include "boost/foreach.hpp"
+#include <gtest/gtest.h>
+
+const int message_count = 2000;
+const std::string bag_name = "/tmp/memory_mapped_bag.bag";
+
+std::string messageData(int i) {
+    return std::string(20 + (i % 37) * 11, 'a' + (i % 26));
+}
+
+std::string topicName(int i) {
+    return i % 2 == 0 ? "/even" : "/odd";
+}
+
+// Write the first half of the messages uncompressed and the rest with the given compression
+void writeBag(rosbag::CompressionType second_half) {
+    rosbag::Bag bag;
+    bag.setChunkThreshold(4 * 1024);
+    bag.open(bag_name, rosbag::bagmode::Write);
+
+    for (int i = 0; i < message_count; ++i) {
+        if (i == message_count / 2)
+            bag.setCompression(second_half);
+
+        std_msgs::String msg;
+        msg.data = messageData(i);
+        bag.write(topicName(i), ros::Time(1000 + i, 0), msg);
+    }
+
+    bag.close();
+}
+
+void checkMessage(rosbag::MessageInstance const& m) {
+    int i = m.getTime().sec - 1000;
+    std_msgs::String::ConstPtr s = m.instantiate<std_msgs::String>();
+    ASSERT_TRUE(s);
+    EXPECT_EQ(messageData(i), s->data);
+    EXPECT_EQ(topicName(i), m.getTopic());
+    EXPECT_EQ(messageData(i).size() + 4, m.size());
+}
+
+TEST(rosbag_storage, memory_mapped_uncompressed)
+{
+    writeBag(rosbag::compression::Uncompressed);
+
+    rosbag::Bag bag;
+    bag.setMemoryMapped(true);
+    bag.open(bag_name, rosbag::bagmode::Read);
+    EXPECT_TRUE(bag.isMemoryMapped());
+
+    rosbag::View view(bag);
+    int count = 0;
+    BOOST_FOREACH(rosbag::MessageInstance const m, view)
+    {
+        EXPECT_EQ(1000 + count, (int) m.getTime().sec);
+        checkMessage(m);
+        ++count;
+    }
+    EXPECT_EQ(message_count, count);
+
+    bag.close();
+    EXPECT_FALSE(bag.isMemoryMapped());
+}
+
+TEST(rosbag_storage, memory_mapped_mixed_compression)
+{
+    for (int c = 1; c < 3; ++c) {
+        writeBag(rosbag::CompressionType(c));
+
+        for (int threads = 0; threads < 3; threads += 2) {
+            rosbag::Bag bag;
+            bag.open(bag_name, rosbag::bagmode::Read);
+            bag.setMemoryMapped(true);
+            bag.setDecompressionThreads(threads);
+            EXPECT_TRUE(bag.isMemoryMapped());
+
+            // Two views across the switch from uncompressed to compressed chunks
+            rosbag::View even(bag, rosbag::TopicQuery("/even"));
+            rosbag::View odd(bag, rosbag::TopicQuery("/odd"));
+            rosbag::View::iterator a = even.begin();
+            rosbag::View::iterator b = odd.begin();
+            int count = 0;
+            while (a != even.end() && b != odd.end()) {
+                checkMessage(*a);
+                checkMessage(*b);
+                EXPECT_EQ(a->getTime().sec + 1, b->getTime().sec);
+                ++a;
+                ++b;
+                ++count;
+            }
+            EXPECT_EQ(message_count / 2, count);
+        }
+    }
+}
+
+TEST(rosbag_storage, memory_mapped_toggle_while_reading)
+{
+    writeBag(rosbag::compression::Uncompressed);
+
+    rosbag::Bag bag;
+    bag.open(bag_name, rosbag::bagmode::Read);
+    EXPECT_FALSE(bag.isMemoryMapped());
+
+    rosbag::View view(bag);
+    int count = 0;
+    for (rosbag::View::iterator i = view.begin(); i != view.end(); ++i, ++count) {
+        if (count == message_count / 3)
+            bag.setMemoryMapped(true);
+        else if (count == 2 * message_count / 3)
+            bag.setMemoryMapped(false);
+
+        EXPECT_EQ(count >= message_count / 3 && count < 2 * message_count / 3, bag.isMemoryMapped());
+        checkMessage(*i);
+    }
+    EXPECT_EQ(message_count, count);
+}
+
+int main(int argc, char **argv) {
+    ros::Time::init();
+
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
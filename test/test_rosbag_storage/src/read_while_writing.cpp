@@ -0,0 +1,69 @@
+#include "ros/time.h"
+#include "rosbag/bag.h"
+#include "rosbag/view.h"
+#include "std_msgs/String.h"
+
+#include <string>
+
+#include "boost/foreach.hpp"
+#include <gtest/gtest.h>
+
+const int message_count = 40;
+const std::string bag_name = "/tmp/read_while_writing.bag";
+
+std::string messageData(int i) {
+    return std::string(10 + i, 'a' + (i % 26));
+}
+
+void writeMessages(rosbag::Bag& bag, int begin, int end) {
+    for (int i = begin; i < end; ++i) {
+        std_msgs::String msg;
+        msg.data = messageData(i);
+        bag.write("/chatter", ros::Time(1000 + i, 0), msg);
+    }
+}
+
+void checkMessages(rosbag::Bag const& bag, int expected_count) {
+    rosbag::View view(bag);
+    int count = 0;
+    BOOST_FOREACH(rosbag::MessageInstance const m, view)
+    {
+        std_msgs::String::ConstPtr s = m.instantiate<std_msgs::String>();
+        ASSERT_TRUE(s);
+        EXPECT_EQ(messageData(count), s->data);
+        ++count;
+    }
+    EXPECT_EQ(expected_count, count);
+}
+
+// Setters that change how chunks are written stop the open chunk early; both that chunk and
+// the one opened after it must read back while the bag is still being written
+TEST(rosbag_storage, read_chunks_stopped_by_setters)
+{
+    rosbag::Bag bag;
+    bag.open(bag_name, rosbag::bagmode::Write | rosbag::bagmode::Read);
+
+    writeMessages(bag, 0, message_count / 4);
+    bag.setChunkThreshold(1024 * 1024);
+    checkMessages(bag, message_count / 4);
+
+    writeMessages(bag, message_count / 4, message_count / 2);
+    checkMessages(bag, message_count / 2);
+
+    bag.setChunkThreshold(768 * 1024);
+    writeMessages(bag, message_count / 2, message_count);
+    checkMessages(bag, message_count);
+
+    bag.close();
+
+    rosbag::Bag in;
+    in.open(bag_name, rosbag::bagmode::Read);
+    checkMessages(in, message_count);
+}
+
+int main(int argc, char **argv) {
+    ros::Time::init();
+
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,154 @@
+/*
+ * Measures how long an urgent callback waits in a CallbackQueue that is also busy with bulk work, comparing the FIFO
+ * CallbackQueue with PriorityCallbackQueue.
+ */
+
+#include <ros/callback_queue.h>
+#include <ros/priority_callback_queue.h>
+#include <ros/time.h>
+
+#include <boost/bind.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/thread.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+// Bulk callbacks that keep the spinner threads busy
+class WorkCallback : public ros::CallbackInterface
+{
+public:
+  WorkCallback(double work_time)
+  : work_time_(work_time)
+  {}
+
+  virtual CallResult call()
+  {
+    ros::SteadyTime end = ros::SteadyTime::now() + ros::WallDuration(work_time_);
+    while (ros::SteadyTime::now() < end)
+    {
+    }
+
+    return Success;
+  }
+
+private:
+  double work_time_;
+};
+
+// Urgent callbacks that record how long they waited to be called
+class LatencyCallback : public ros::CallbackInterface
+{
+public:
+  LatencyCallback(boost::mutex* mutex, std::vector<double>* latencies)
+  : mutex_(mutex)
+  , latencies_(latencies)
+  , queued_(ros::SteadyTime::now())
+  {}
+
+  virtual CallResult call()
+  {
+    double latency = (ros::SteadyTime::now() - queued_).toSec();
+
+    boost::mutex::scoped_lock lock(*mutex_);
+    latencies_->push_back(latency);
+    return Success;
+  }
+
+  virtual int32_t getPriority() { return 10; }
+
+private:
+  boost::mutex* mutex_;
+  std::vector<double>* latencies_;
+  ros::SteadyTime queued_;
+};
+
+void spinThread(ros::CallbackQueue* queue, volatile bool* done)
+{
+  while (!*done)
+  {
+    queue->callOne(ros::WallDuration(0.01));
+  }
+}
+
+double percentile(const std::vector<double>& sorted, double p)
+{
+  if (sorted.empty())
+  {
+    return 0.0;
+  }
+
+  size_t index = std::min(sorted.size() - 1, (size_t)(p * (double)sorted.size()));
+  return sorted[index];
+}
+
+/*
+ * Every period, queue burst bulk callbacks of work_time each followed by one urgent callback.  The bulk work takes
+ * longer than a period to drain, so the queue stays loaded for the whole run.
+ */
+void run(const char* name, ros::CallbackQueue& queue, uint32_t threads, uint32_t burst, double work_time, double period, double run_time)
+{
+  boost::mutex mutex;
+  std::vector<double> latencies;
+  volatile bool done = false;
+
+  boost::thread_group tg;
+  for (uint32_t i = 0; i < threads; ++i)
+  {
+    tg.create_thread(boost::bind(spinThread, &queue, &done));
+  }
+
+  ros::SteadyTime start = ros::SteadyTime::now();
+  ros::SteadyTime next = start;
+  while (ros::SteadyTime::now() - start < ros::WallDuration(run_time))
+  {
+    for (uint32_t i = 0; i < burst; ++i)
+    {
+      queue.addCallback(boost::make_shared<WorkCallback>(work_time), 1);
+    }
+    queue.addCallback(boost::make_shared<LatencyCallback>(&mutex, &latencies), 2);
+
+    next += ros::WallDuration(period);
+    ros::SteadyTime now = ros::SteadyTime::now();
+    if (next > now)
+    {
+      (next - now).sleep();
+    }
+  }
+
+  // Whatever is still queued was never going to be called in time, leave it out
+  done = true;
+  tg.join_all();
+  queue.clear();
+
+  boost::mutex::scoped_lock lock(mutex);
+  std::sort(latencies.begin(), latencies.end());
+  printf("%-10s %u threads: urgent callbacks called %4u, latency p50 %9.3f ms, p99 %9.3f ms, max %9.3f ms\n",
+         name, threads, (uint32_t)latencies.size(), percentile(latencies, 0.5) * 1e3, percentile(latencies, 0.99) * 1e3,
+         latencies.empty() ? 0.0 : latencies.back() * 1e3);
+}
+
+int main(int, char **)
+{
+  const uint32_t thread_counts[] = { 1, 4 };
+
+  for (size_t i = 0; i < sizeof(thread_counts) / sizeof(thread_counts[0]); ++i)
+  {
+    uint32_t threads = thread_counts[i];
+    // Enough bulk work to keep all threads busy for slightly more than the period
+    uint32_t burst = 60 * threads;
+
+    {
+      ros::CallbackQueue queue;
+      run("fifo", queue, threads, burst, 0.0002, 0.01, 3.0);
+    }
+
+    {
+      ros::PriorityCallbackQueue queue;
+      run("priority", queue, threads, burst, 0.0002, 0.01, 3.0);
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,112 @@
+/*
+ * Measures the cost of PollSet::update() as the number of watched sockets grows, both when nothing is ready and
+ * when a single socket is ready, along with the cost of toggling events on a socket (as Connection does on every
+ * partial write).
+ */
+
+#include <ros/poll_set.h>
+#include <ros/io.h>
+#include <ros/time.h>
+
+#include <boost/bind.hpp>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <vector>
+
+ros::WallTime t;
+
+inline void tic()
+{
+  t = ros::WallTime::now();
+}
+
+inline double toc()
+{
+  return (ros::WallTime::now() - t).toSec();
+}
+
+void onSocketEvents(int fd, int events)
+{
+  if (events & POLLIN)
+  {
+    char b;
+    while (::read(fd, &b, 1) > 0)
+    {
+    }
+  }
+}
+
+void run(size_t num_sockets, int num_iter)
+{
+  ros::PollSet ps;
+  std::vector<int> fds(num_sockets * 2);
+
+  for (size_t i = 0; i < num_sockets; ++i)
+  {
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, &fds[i * 2]) != 0)
+    {
+      perror("socketpair");
+      return;
+    }
+
+    ros::set_non_blocking(fds[i * 2]);
+    ps.addSocket(fds[i * 2], boost::bind(onSocketEvents, fds[i * 2], _1));
+    ps.addEvents(fds[i * 2], POLLIN);
+  }
+
+  tic();
+  for (int i = 0; i < num_iter; ++i)
+  {
+    ps.update(0);
+  }
+  double idle = toc() / (double)num_iter;
+
+  int ready_fd = fds[(num_sockets - 1) * 2];
+  int write_fd = fds[(num_sockets - 1) * 2 + 1];
+  tic();
+  for (int i = 0; i < num_iter; ++i)
+  {
+    char b = 0;
+    if (::write(write_fd, &b, 1) != 1)
+    {
+      perror("write");
+      break;
+    }
+    ps.update(0);
+  }
+  double one_ready = toc() / (double)num_iter;
+
+  tic();
+  for (int i = 0; i < num_iter; ++i)
+  {
+    ps.addEvents(ready_fd, POLLOUT);
+    ps.delEvents(ready_fd, POLLOUT);
+  }
+  double toggle = toc() / (double)num_iter;
+
+  printf("%6d sockets: idle update %.3f us, one ready %.3f us, add/del events %.3f us\n",
+         (int)num_sockets, idle * 1e6, one_ready * 1e6, toggle * 1e6);
+
+  for (size_t i = 0; i < num_sockets; ++i)
+  {
+    ps.delSocket(fds[i * 2]);
+    ::close(fds[i * 2]);
+    ::close(fds[i * 2 + 1]);
+  }
+}
+
+int main(int, char **)
+{
+  const int NUM_ITER = 1000;
+  const size_t counts[] = { 10, 50, 100, 500, 1000, 2000 };
+
+  for (size_t i = 0; i < sizeof(counts) / sizeof(counts[0]); ++i)
+  {
+    run(counts[i], NUM_ITER);
+  }
+
+  return 0;
+}
@@ -0,0 +1,138 @@
+/*
+ * Measures service calls/sec for small request/response pairs, comparing a new connection per call, pooled
+ * keep-alive connections, a persistent connection, and a persistent connection with pipelined asynchronous calls.
+ * Needs a running master; the service is advertised by this process.
+ */
+
+#include <ros/ros.h>
+#include <ros/callback_queue.h>
+#include <test_roscpp/TestStringString.h>
+
+#include <cstdio>
+#include <deque>
+#include <vector>
+
+ros::WallTime t;
+
+inline void tic()
+{
+  t = ros::WallTime::now();
+}
+
+inline double toc()
+{
+  return (ros::WallTime::now() - t).toSec();
+}
+
+bool echo(test_roscpp::TestStringString::Request& req, test_roscpp::TestStringString::Response& res)
+{
+  res.str = req.str;
+  return true;
+}
+
+void report(const char* name, size_t calls, double elapsed)
+{
+  printf("%-32s %7d calls in %.3f s: %9.0f calls/s\n", name, (int)calls, elapsed, (double)calls / elapsed);
+}
+
+void runBlocking(const char* name, ros::ServiceClientOptions& ops, size_t calls)
+{
+  ros::NodeHandle nh;
+  ros::ServiceClient client = nh.serviceClient(ops);
+
+  test_roscpp::TestStringString srv;
+  srv.request.str = "ping";
+
+  tic();
+  for (size_t i = 0; i < calls; ++i)
+  {
+    if (!client.call(srv))
+    {
+      ROS_ERROR("%s: call %d failed", name, (int)i);
+      return;
+    }
+  }
+  report(name, calls, toc());
+}
+
+void runAsync(const char* name, ros::ServiceClientOptions& ops, size_t calls, size_t in_flight)
+{
+  ros::NodeHandle nh;
+  ros::ServiceClient client = nh.serviceClient(ops);
+
+  test_roscpp::TestStringString::Request req;
+  req.str = "ping";
+  std::vector<test_roscpp::TestStringString::Response> res(in_flight);
+  std::deque<boost::shared_future<bool> > futures;
+
+  tic();
+  for (size_t i = 0; i < calls; ++i)
+  {
+    if (futures.size() == in_flight)
+    {
+      if (!futures.front().get())
+      {
+        ROS_ERROR("%s: call failed", name);
+        return;
+      }
+      futures.pop_front();
+    }
+    futures.push_back(client.callAsync(req, res[i % in_flight]));
+  }
+
+  while (!futures.empty())
+  {
+    futures.front().wait();
+    futures.pop_front();
+  }
+  report(name, calls, toc());
+}
+
+int main(int argc, char** argv)
+{
+  ros::init(argc, argv, "service_calls", ros::init_options::AnonymousName);
+
+  ros::NodeHandle nh;
+  ros::CallbackQueue server_queue;
+  ros::AdvertiseServiceOptions adv;
+  adv.init<test_roscpp::TestStringString::Request, test_roscpp::TestStringString::Response>("~echo", echo);
+  adv.callback_queue = &server_queue;
+  ros::ServiceServer server = nh.advertiseService(adv);
+
+  ros::AsyncSpinner spinner(1, &server_queue);
+  spinner.start();
+
+  std::string service = server.getService();
+  if (!ros::service::waitForService(service, ros::Duration(5.0)))
+  {
+    ROS_ERROR("Service [%s] never became available", service.c_str());
+    return 1;
+  }
+
+  const size_t calls = 2000;
+
+  ros::ServiceClientOptions ops;
+  ops.init<test_roscpp::TestStringString>(service, false, ros::M_string());
+  runBlocking("connection per call", ops, calls);
+
+  ops.pooled = true;
+  runBlocking("pooled", ops, calls);
+
+  ops.pooled = false;
+  ops.persistent = true;
+  runBlocking("persistent", ops, calls);
+
+  runAsync("persistent, async, depth 1", ops, calls * 10, 32);
+
+  const uint32_t depths[] = { 4, 16, 64 };
+  for (size_t i = 0; i < sizeof(depths) / sizeof(depths[0]); ++i)
+  {
+    char name[64];
+    snprintf(name, sizeof(name), "persistent, async, depth %u", depths[i]);
+    ops.pipeline_depth = depths[i];
+    runAsync(name, ops, calls * 10, depths[i] * 2);
+  }
+
+  spinner.stop();
+  return 0;
+}
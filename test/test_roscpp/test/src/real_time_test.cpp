@@ -43,8 +43,14 @@
 #include <time.h>
 #include <stdlib.h>
 #include "ros/ros.h"
+#include "ros/preallocated_callback_queue.h"
 #include <rosgraph_msgs/Clock.h>
 
+#include <boost/thread/thread.hpp>
+
+#include <algorithm>
+#include <vector>
+
 int g_argc;
 char** g_argv;
 
@@ -102,6 +108,96 @@ TEST_F(RosTimeTest, RealTimeTest)
   SUCCEED();
 }
 
+class JitterRecorder
+{
+public:
+  JitterRecorder(size_t count)
+  : count_(count)
+  {
+    lateness_.reserve(count);
+    dispatch_.reserve(count);
+  }
+
+  void onTimer(const ros::SteadyTimerEvent& event)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    if (lateness_.size() < count_)
+    {
+      // How late the callback ran, and how much of that it spent waiting in the callback queue
+      lateness_.push_back((event.current_real - event.current_expected).toSec());
+      dispatch_.push_back((event.current_real - event.current_expired).toSec());
+    }
+  }
+
+  bool done()
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    return lateness_.size() >= count_;
+  }
+
+  size_t count_;
+  boost::mutex mutex_;
+  std::vector<double> lateness_;
+  std::vector<double> dispatch_;
+};
+
+double percentile(std::vector<double> values, double p)
+{
+  std::sort(values.begin(), values.end());
+  return values[std::min(values.size() - 1, (size_t)(p * (double)values.size()))];
+}
+
+TEST(RTSpinner, TimerJitter)
+{
+  ros::PreallocatedCallbackQueue queue(64);
+  ros::NodeHandle nh;
+  nh.setCallbackQueue(&queue);
+
+  ros::RTSpinnerOptions ops;
+  ops.priority = 50;
+  ops.cpus.push_back(std::max(boost::thread::hardware_concurrency(), 1U) - 1);
+
+  ros::RTSpinner spinner(ops, &queue);
+  try
+  {
+    spinner.start();
+  }
+  catch (std::runtime_error& e)
+  {
+    // Without CAP_SYS_NICE or an rtprio limit we can't use SCHED_FIFO, measure with normal scheduling instead
+    ROS_WARN("%s, measuring without SCHED_FIFO", e.what());
+    ops.priority = 0;
+    spinner = ros::RTSpinner(ops, &queue);
+    spinner.start();
+  }
+
+  // 2 seconds of a 1 kHz timer
+  JitterRecorder recorder(2000);
+  ros::SteadyTimer timer = nh.createSteadyTimer(ros::WallDuration(0.001), &JitterRecorder::onTimer, &recorder);
+
+  ros::SteadyTime start = ros::SteadyTime::now();
+  while (!recorder.done() && ros::SteadyTime::now() - start < ros::WallDuration(10.0))
+  {
+    ros::WallDuration(0.01).sleep();
+  }
+  timer.stop();
+  spinner.stop();
+
+  boost::mutex::scoped_lock lock(recorder.mutex_);
+  ASSERT_EQ(recorder.lateness_.size(), recorder.count_);
+
+  double lateness_p50 = percentile(recorder.lateness_, 0.5);
+  double lateness_p99 = percentile(recorder.lateness_, 0.99);
+  double lateness_max = percentile(recorder.lateness_, 1.0);
+  double dispatch_p99 = percentile(recorder.dispatch_, 0.99);
+  ROS_INFO("1 kHz timer with SCHED_FIFO priority %d: lateness p50 %.1f us, p99 %.1f us, max %.1f us; queue dispatch p99 %.1f us",
+           ops.priority, lateness_p50 * 1e6, lateness_p99 * 1e6, lateness_max * 1e6, dispatch_p99 * 1e6);
+  RecordProperty("lateness_p99_us", (int)(lateness_p99 * 1e6));
+  RecordProperty("lateness_max_us", (int)(lateness_max * 1e6));
+
+  // Loose enough for a loaded machine without SCHED_FIFO, it's mostly here to report the numbers
+  EXPECT_LT(lateness_p99, 0.01);
+}
 
 int main(int argc, char** argv)
 {
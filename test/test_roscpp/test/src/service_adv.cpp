@@ -34,6 +34,7 @@
  */
 
 #include "ros/ros.h"
+#include "ros/callback_queue.h"
 #include <test_roscpp/TestStringString.h>
 
 bool caseFlip(test_roscpp::TestStringString::Request  &req,
@@ -73,6 +74,15 @@ bool caseFlipUnadvertise(test_roscpp::TestStringString::Request  &req,
   return true;
 }
 
+bool caseFlipSlow(test_roscpp::TestStringString::Request  &req,
+                     test_roscpp::TestStringString::Response &res)
+{
+  caseFlip(req, res);
+
+  ros::Duration(0.2).sleep();
+  return true;
+}
+
 
 int
 main(int argc, char** argv)
@@ -80,10 +90,29 @@ main(int argc, char** argv)
   ros::init(argc, argv, "service_adv");
   ros::NodeHandle nh;
 
-  ros::ServiceServer srv1, srv2, srv3;
+  ros::ServiceServer srv1, srv2, srv3, srv4, srv5;
   srv1 = nh.advertiseService("service_adv", caseFlip);
   srv2 = nh.advertiseService("service_adv_long", caseFlipLongRunning);
   srv3 = nh.advertiseService<test_roscpp::TestStringString::Request, test_roscpp::TestStringString::Response>("service_adv_unadv_in_callback", boost::bind(caseFlipUnadvertise, _1, _2, boost::ref(srv3)));
+
+  // Served from its own queue by several threads, so that up to four calls run at once
+  ros::CallbackQueue concurrent_queue;
+  ros::AdvertiseServiceOptions ops;
+  ops.init<test_roscpp::TestStringString::Request, test_roscpp::TestStringString::Response>("service_adv_concurrent", caseFlipSlow);
+  ops.callback_queue = &concurrent_queue;
+  ops.max_concurrent_calls = 4;
+  srv4 = nh.advertiseService(ops);
+
+  // One call at a time and no backlog: a request arriving while another is handled is rejected
+  ros::AdvertiseServiceOptions no_backlog_ops;
+  no_backlog_ops.init<test_roscpp::TestStringString::Request, test_roscpp::TestStringString::Response>("service_adv_no_backlog", caseFlipSlow);
+  no_backlog_ops.callback_queue = &concurrent_queue;
+  no_backlog_ops.max_concurrent_calls = 1;
+  no_backlog_ops.max_backlog = 0;
+  srv5 = nh.advertiseService(no_backlog_ops);
+  ros::AsyncSpinner concurrent_spinner(4, &concurrent_queue);
+  concurrent_spinner.start();
+
   ros::spin();
 }
 
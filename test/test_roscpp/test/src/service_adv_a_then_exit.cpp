@@ -0,0 +1,32 @@
+/*
+ * Advertise a service answering "A" until another node has taken it over, then go away
+ */
+
+#include "ros/ros.h"
+#include <test_roscpp/TestStringString.h>
+
+bool srvCallback(test_roscpp::TestStringString::Request &,
+                 test_roscpp::TestStringString::Response &res)
+{
+  res.str = "A";
+  return true;
+}
+
+int main(int argc, char** argv)
+{
+  ros::init(argc, argv, "service_adv_a_then_exit");
+  ros::NodeHandle nh;
+
+  ros::ServiceServer srv = nh.advertiseService("service_adv", srvCallback);
+
+  int param;
+  while (ros::ok() && !nh.getParam("service_adv_b_ready", param))
+  {
+    ros::spinOnce();
+    ros::Duration(0.01).sleep();
+  }
+
+  // From here on connections to this node are turned away, and they are refused outright once it has exited
+  srv.shutdown();
+  nh.setParam("service_adv_a_exited", 1);
+}
@@ -34,6 +34,7 @@
  */
 
 #include <string>
+#include <sstream>
 
 #include <gtest/gtest.h>
 
@@ -42,6 +43,7 @@
 #include "ros/service.h"
 #include "ros/connection.h"
 #include "ros/service_client.h"
+#include "ros/callback_queue.h"
 #include <test_roscpp/TestStringString.h>
 #include <test_roscpp/BadTestStringString.h>
 
@@ -165,6 +167,221 @@ TEST(SrvCall, callSrvPersistentHandle)
   ASSERT_STREQ(res.str.c_str(), "CASE_flip");
 }
 
+TEST(SrvCall, callSrvAsync)
+{
+  test_roscpp::TestStringString::Request req;
+  std::vector<test_roscpp::TestStringString::Response> res(100);
+
+  req.str = std::string("case_FLIP");
+
+  ASSERT_TRUE(ros::service::waitForService("service_adv"));
+
+  ros::NodeHandle nh;
+  ros::ServiceClient handle = nh.serviceClient<test_roscpp::TestStringString>("service_adv", true);
+
+  ros::Time start = ros::Time::now();
+
+  std::vector<boost::shared_future<bool> > futures;
+  for (size_t i = 0; i < res.size(); ++i)
+  {
+    futures.push_back(handle.callAsync(req, res[i]));
+  }
+
+  for (size_t i = 0; i < futures.size(); ++i)
+  {
+    ASSERT_TRUE(futures[i].get());
+    ASSERT_STREQ(res[i].str.c_str(), "CASE_flip");
+  }
+
+  ros::Time end = ros::Time::now();
+  ros::Duration d = end - start;
+  printf("100 async calls took %f secs\n", d.toSec());
+}
+
+void onAsyncResponse(int* count, bool success, const test_roscpp::TestStringString::Response& res)
+{
+  EXPECT_TRUE(success);
+  EXPECT_STREQ(res.str.c_str(), "CASE_flip");
+  ++*count;
+}
+
+TEST(SrvCall, callSrvAsyncCallback)
+{
+  test_roscpp::TestStringString::Request req;
+
+  req.str = std::string("case_FLIP");
+
+  ASSERT_TRUE(ros::service::waitForService("service_adv"));
+
+  ros::NodeHandle nh;
+  ros::ServiceClient handle = nh.serviceClient<test_roscpp::TestStringString>("service_adv", false);
+  ros::CallbackQueue queue;
+
+  int count = 0;
+  for (int i = 0; i < 10; ++i)
+  {
+    handle.callAsync<test_roscpp::TestStringString>(req, boost::bind(onAsyncResponse, &count, _1, _2), &queue);
+  }
+
+  ros::WallTime timeout = ros::WallTime::now() + ros::WallDuration(10);
+  while (count < 10 && ros::WallTime::now() < timeout)
+  {
+    queue.callAvailable(ros::WallDuration(0.1));
+  }
+
+  ASSERT_EQ(count, 10);
+}
+
+TEST(SrvCall, callSrvAsyncWithWrongType)
+{
+  test_roscpp::BadTestStringString::Request req;
+  test_roscpp::BadTestStringString::Response res;
+
+  ASSERT_TRUE(ros::service::waitForService("service_adv"));
+
+  ros::NodeHandle nh;
+  ros::ServiceClient handle = nh.serviceClient<test_roscpp::TestStringString>("service_adv", false);
+  ASSERT_FALSE(handle.callAsync(req, res).get());
+}
+
+TEST(SrvCall, callSrvPooledHandle)
+{
+  test_roscpp::TestStringString::Request req;
+  test_roscpp::TestStringString::Response res;
+
+  req.str = std::string("case_FLIP");
+
+  ASSERT_TRUE(ros::service::waitForService("service_adv"));
+
+  ros::NodeHandle nh;
+  ros::ServiceClientOptions ops;
+  ops.init<test_roscpp::TestStringString>("service_adv", false, ros::M_string());
+  ops.pooled = true;
+  ros::ServiceClient handle = nh.serviceClient(ops);
+
+  for (int i = 0; i < 100; ++i)
+  {
+    ASSERT_TRUE(handle.call(req, res));
+    ASSERT_STREQ(res.str.c_str(), "CASE_flip");
+  }
+}
+
+TEST(SrvCall, callSrvPipelined)
+{
+  test_roscpp::TestStringString::Request req;
+  std::vector<test_roscpp::TestStringString::Response> res(100);
+
+  ASSERT_TRUE(ros::service::waitForService("service_adv"));
+
+  ros::NodeHandle nh;
+  ros::ServiceClientOptions ops;
+  ops.init<test_roscpp::TestStringString>("service_adv", true, ros::M_string());
+  ops.pipeline_depth = 16;
+  ros::ServiceClient handle = nh.serviceClient(ops);
+
+  std::vector<boost::shared_future<bool> > futures;
+  for (size_t i = 0; i < res.size(); ++i)
+  {
+    // Distinct requests, so out of order responses would show up as mismatches
+    std::stringstream ss;
+    ss << "case_" << i;
+    req.str = ss.str();
+    futures.push_back(handle.callAsync(req, res[i]));
+  }
+
+  for (size_t i = 0; i < futures.size(); ++i)
+  {
+    std::stringstream ss;
+    ss << "CASE_" << i;
+    ASSERT_TRUE(futures[i].get());
+    ASSERT_EQ(res[i].str, ss.str());
+  }
+}
+
+TEST(SrvCall, callSrvConcurrentHandlers)
+{
+  test_roscpp::TestStringString::Request req;
+  std::vector<test_roscpp::TestStringString::Response> res(8);
+
+  ASSERT_TRUE(ros::service::waitForService("service_adv_concurrent"));
+
+  ros::NodeHandle nh;
+  ros::ServiceClientOptions ops;
+  ops.init<test_roscpp::TestStringString>("service_adv_concurrent", true, ros::M_string());
+  ops.pipeline_depth = 8;
+  ros::ServiceClient handle = nh.serviceClient(ops);
+
+  ros::WallTime start = ros::WallTime::now();
+  std::vector<boost::shared_future<bool> > futures;
+  for (size_t i = 0; i < res.size(); ++i)
+  {
+    std::stringstream ss;
+    ss << "case_" << i;
+    req.str = ss.str();
+    futures.push_back(handle.callAsync(req, res[i]));
+  }
+
+  for (size_t i = 0; i < futures.size(); ++i)
+  {
+    std::stringstream ss;
+    ss << "CASE_" << i;
+    ASSERT_TRUE(futures[i].get());
+    ASSERT_EQ(res[i].str, ss.str());
+  }
+
+  // Each call sleeps for 0.2s; serially the batch would take 1.6s
+  EXPECT_LT((ros::WallTime::now() - start).toSec(), 1.2);
+}
+
+TEST(SrvCall, callSrvNoBacklog)
+{
+  test_roscpp::TestStringString::Request req;
+  std::vector<test_roscpp::TestStringString::Response> res(3);
+
+  ASSERT_TRUE(ros::service::waitForService("service_adv_no_backlog"));
+
+  // Separate clients get separate links, so their requests really overlap on the server
+  ros::NodeHandle nh;
+  ros::ServiceClient busy = nh.serviceClient<test_roscpp::TestStringString>("service_adv_no_backlog", true);
+  ros::ServiceClient rejected = nh.serviceClient<test_roscpp::TestStringString>("service_adv_no_backlog", true);
+  ASSERT_TRUE(busy.isValid());
+  ASSERT_TRUE(rejected.isValid());
+
+  // The handler takes 0.2s, so the second request arrives while the only slot is held
+  req.str = "case_0";
+  boost::shared_future<bool> first = busy.callAsync(req, res[0]);
+  ros::WallDuration(0.05).sleep();
+  req.str = "case_1";
+  ASSERT_FALSE(rejected.call(req, res[1]));
+
+  ASSERT_TRUE(first.get());
+  ASSERT_EQ(res[0].str, "CASE_0");
+
+  // Pipelined requests on one link are read one at a time, each only once the previous response is
+  // written; the slot is free by then, so none of them is rejected
+  ros::ServiceClientOptions ops;
+  ops.init<test_roscpp::TestStringString>("service_adv_no_backlog", true, ros::M_string());
+  ops.pipeline_depth = 3;
+  ros::ServiceClient pipelined = nh.serviceClient(ops);
+
+  std::vector<boost::shared_future<bool> > futures;
+  for (size_t i = 0; i < res.size(); ++i)
+  {
+    std::stringstream ss;
+    ss << "case_" << i;
+    req.str = ss.str();
+    futures.push_back(pipelined.callAsync(req, res[i]));
+  }
+
+  for (size_t i = 0; i < futures.size(); ++i)
+  {
+    std::stringstream ss;
+    ss << "CASE_" << i;
+    ASSERT_TRUE(futures[i].get());
+    ASSERT_EQ(res[i].str, ss.str());
+  }
+}
+
 TEST(SrvCall, callSrvLongRunning)
 {
   test_roscpp::TestStringString::Request req;
@@ -0,0 +1,46 @@
+/*
+ * Call a service whose server is replaced by one on another port, expecting the first call after that to reach it
+ */
+
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "ros/ros.h"
+#include "ros/service.h"
+#include <test_roscpp/TestStringString.h>
+
+TEST(SrvCall, callRestartedServer)
+{
+  test_roscpp::TestStringString::Request req;
+  test_roscpp::TestStringString::Response res;
+
+  req.str = "nothing";
+  ros::NodeHandle nh;
+
+  ASSERT_TRUE(ros::service::waitForService("service_adv", ros::Duration(10)));
+  ASSERT_TRUE(ros::service::call("service_adv", req, res));
+  ASSERT_STREQ(res.str.c_str(), "A");
+
+  // Well within the lookup cache's lifetime, so the next call starts out at the first server's address
+  nh.setParam("service_adv_a_called", 1);
+  int param;
+  while(!nh.getParam("service_adv_a_exited", param))
+    ros::Duration(0.01).sleep();
+
+  bool call_result = ros::service::call("service_adv", req, res);
+  ASSERT_TRUE(call_result);
+
+  ASSERT_STREQ(res.str.c_str(), "B");
+}
+
+int
+main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+
+  ros::init(argc, argv, "service_call_restarted");
+  ros::NodeHandle nh;
+
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,29 @@
+/*
+ * Advertise a service answering "B", on a port of its own, once the client has called the node answering "A"
+ */
+
+#include "ros/ros.h"
+#include <test_roscpp/TestStringString.h>
+
+bool srvCallback(test_roscpp::TestStringString::Request &,
+                 test_roscpp::TestStringString::Response &res)
+{
+  res.str = "B";
+  return true;
+}
+
+int main(int argc, char** argv)
+{
+  ros::init(argc, argv, "service_wait_call_adv_b");
+  ros::NodeHandle nh;
+
+  int param;
+  while (ros::ok() && !nh.getParam("service_adv_a_called", param))
+  {
+    ros::Duration(0.01).sleep();
+  }
+
+  ros::ServiceServer srv = nh.advertiseService("service_adv", srvCallback);
+  nh.setParam("service_adv_b_ready", 1);
+  ros::spin();
+}
@@ -32,6 +32,7 @@
 #include <ros/ros.h>
 
 #include <test_roscpp/TestWithHeader.h>
+#include <rosgraph_msgs/TopicStatistics.h>
 
 void callback(const test_roscpp::TestWithHeaderConstPtr&)
 {
@@ -61,6 +62,43 @@ TEST(TopicStatistics, empty_timestamp_crash_check)
   SUCCEED();
 }
 
+rosgraph_msgs::TopicStatistics g_stats;
+int g_stats_received = 0;
+
+void statisticsCallback(const rosgraph_msgs::TopicStatisticsConstPtr& msg)
+{
+  if (msg->topic == ros::names::resolve("test_with_timestamp"))
+  {
+    g_stats = *msg;
+    ++g_stats_received;
+  }
+}
+
+TEST(TopicStatistics, published)
+{
+  ros::NodeHandle nh;
+
+  ros::Subscriber stats_sub = nh.subscribe("/statistics", 10, statisticsCallback);
+  ros::Publisher pub = nh.advertise<test_roscpp::TestWithHeader>("test_with_timestamp", 0);
+  ros::Subscriber sub = nh.subscribe("test_with_timestamp", 0, callback);
+
+  ros::Time start = ros::Time::now();
+  while (g_stats_received < 2 && (ros::Time::now() - start) < ros::Duration(10.0))
+  {
+    test_roscpp::TestWithHeader msg;
+    msg.header.stamp = ros::Time::now();
+    pub.publish(msg);
+    ros::spinOnce();
+    ros::WallDuration(0.01).sleep();
+  }
+
+  ASSERT_GE(g_stats_received, 2);
+  EXPECT_GT(g_stats.delivered_msgs, 0);
+  EXPECT_GT(g_stats.period_mean, ros::Duration(0.005));
+  EXPECT_LT(g_stats.period_mean, ros::Duration(0.1));
+  EXPECT_GE(g_stats.period_max, g_stats.period_mean);
+}
+
 int main(int argc, char **argv)
 {
   testing::InitGoogleTest(&argc, argv);
@@ -109,7 +109,7 @@ class Subscriptions : public testing::Test
       dt.fromSec(atof(g_argv[3]));
       if (transport == "tcp")
         reliable = true;
-      else if (transport == "udp")
+      else if (transport == "udp" || transport == "udp_fec")
         reliable = false;
       else
       {
@@ -129,6 +129,8 @@ TEST_F(Subscriptions, pubSubNFast)
     hints.reliable();
   else
     hints.unreliable();
+  if (transport == "udp_fec")
+    hints.udpFec(2);
 
   ros::Subscriber sub = n.subscribe("roscpp/pubsub_test", msgs_expected, &Subscriptions::MsgCallback, (Subscriptions *)this, hints);
   
@@ -0,0 +1,135 @@
+/*
+ * Copyright (c) 2009, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+
+/*
+ * Test BufferPool reuse and accounting
+ */
+
+#include <gtest/gtest.h>
+#include "ros/buffer_pool.h"
+
+#include <boost/make_shared.hpp>
+
+using namespace ros;
+
+TEST(BufferPool, reuse)
+{
+  BufferPoolPtr pool = boost::make_shared<BufferPool>();
+
+  uint8_t* data = 0;
+  {
+    boost::shared_array<uint8_t> buffer = pool->allocate(1000);
+    data = buffer.get();
+    memset(data, 0, 1000);
+  }
+
+  BufferPool::Stats stats = pool->getStats();
+  EXPECT_EQ(stats.allocations_, 1u);
+  EXPECT_EQ(stats.heap_allocations_, 1u);
+  EXPECT_EQ(stats.released_, 1u);
+  EXPECT_EQ(stats.cached_bytes_, 1024u);
+
+  // Same size class, so we should get the same block back
+  boost::shared_array<uint8_t> buffer = pool->allocate(600);
+  EXPECT_EQ(buffer.get(), data);
+
+  stats = pool->getStats();
+  EXPECT_EQ(stats.allocations_, 2u);
+  EXPECT_EQ(stats.pool_hits_, 1u);
+  EXPECT_EQ(stats.heap_allocations_, 1u);
+  EXPECT_EQ(stats.cached_bytes_, 0u);
+
+  // Different size class
+  boost::shared_array<uint8_t> buffer2 = pool->allocate(4);
+  EXPECT_NE(buffer2.get(), data);
+  EXPECT_EQ(pool->getStats().heap_allocations_, 2u);
+}
+
+TEST(BufferPool, maxCachedBytes)
+{
+  BufferPoolPtr pool = boost::make_shared<BufferPool>();
+  pool->setMaxCachedBytes(2048);
+
+  {
+    boost::shared_array<uint8_t> buffer1 = pool->allocate(1024);
+    boost::shared_array<uint8_t> buffer2 = pool->allocate(1024);
+    boost::shared_array<uint8_t> buffer3 = pool->allocate(1024);
+  }
+
+  BufferPool::Stats stats = pool->getStats();
+  EXPECT_EQ(stats.released_, 2u);
+  EXPECT_EQ(stats.discarded_, 1u);
+  EXPECT_EQ(stats.cached_bytes_, 2048u);
+
+  pool->setMaxCachedBytes(0);
+  EXPECT_EQ(pool->getStats().cached_bytes_, 0u);
+
+  {
+    boost::shared_array<uint8_t> buffer = pool->allocate(1024);
+  }
+
+  stats = pool->getStats();
+  EXPECT_EQ(stats.discarded_, 2u);
+  EXPECT_EQ(stats.cached_bytes_, 0u);
+}
+
+TEST(BufferPool, outlivesOwner)
+{
+  boost::shared_array<uint8_t> buffer;
+  {
+    BufferPoolPtr pool = boost::make_shared<BufferPool>();
+    buffer = pool->allocate(100);
+  }
+
+  // The buffer keeps its pool alive, so this is still safe to release
+  buffer[99] = 1;
+  buffer.reset();
+}
+
+TEST(BufferPool, oversized)
+{
+  BufferPoolPtr pool = boost::make_shared<BufferPool>();
+
+  {
+    boost::shared_array<uint8_t> buffer = pool->allocate(100 * 1024 * 1024);
+    buffer[100 * 1024 * 1024 - 1] = 1;
+  }
+
+  BufferPool::Stats stats = pool->getStats();
+  EXPECT_EQ(stats.heap_allocations_, 1u);
+  EXPECT_EQ(stats.heap_bytes_, 100u * 1024 * 1024);
+  EXPECT_EQ(stats.released_, 0u);
+  EXPECT_EQ(stats.cached_bytes_, 0u);
+}
+
+int
+main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
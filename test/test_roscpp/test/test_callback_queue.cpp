@@ -35,6 +35,9 @@
 
 #include <gtest/gtest.h>
 #include <ros/callback_queue.h>
+#include <ros/sharded_callback_queue.h>
+#include <ros/priority_callback_queue.h>
+#include <ros/preallocated_callback_queue.h>
 #include <ros/console.h>
 #include <ros/timer.h>
 
@@ -266,9 +269,8 @@ void callAvailableThread(CallbackQueue* queue, bool& done)
   }
 }
 
-size_t runThreadedTest(const CountingCallbackPtr& cb, const boost::function<void(CallbackQueue*, bool&)>& threadFunc)
+size_t runThreadedTest(CallbackQueue& queue, const CountingCallbackPtr& cb, const boost::function<void(CallbackQueue*, bool&)>& threadFunc)
 {
-  CallbackQueue queue;
   boost::thread_group tg;
   bool done = false;
 
@@ -296,6 +298,12 @@ size_t runThreadedTest(const CountingCallbackPtr& cb, const boost::function<void
   return i;
 }
 
+size_t runThreadedTest(const CountingCallbackPtr& cb, const boost::function<void(CallbackQueue*, bool&)>& threadFunc)
+{
+  CallbackQueue queue;
+  return runThreadedTest(queue, cb, threadFunc);
+}
+
 TEST(CallbackQueue, threadedCallAvailable)
 {
   CountingCallbackPtr cb(boost::make_shared<CountingCallback>());
@@ -474,6 +482,577 @@ TEST(CallbackQueue, raceConditionCallback)
   t.join();
 }
 
+TEST(ShardedCallbackQueue, singleCallback)
+{
+  CountingCallbackPtr cb(boost::make_shared<CountingCallback>());
+  ShardedCallbackQueue queue(4);
+  queue.addCallback(cb, 1);
+  EXPECT_EQ(queue.callOne(), CallbackQueue::Called);
+
+  EXPECT_EQ(cb->count, 1U);
+
+  queue.addCallback(cb, 1);
+  queue.callAvailable();
+
+  EXPECT_EQ(cb->count, 2U);
+
+  EXPECT_EQ(queue.callOne(), CallbackQueue::Empty);
+  EXPECT_EQ(cb->count, 2U);
+  EXPECT_TRUE(queue.isEmpty());
+}
+
+TEST(ShardedCallbackQueue, multipleIDsCallAvailable)
+{
+  CountingCallbackPtr cb(boost::make_shared<CountingCallback>());
+  ShardedCallbackQueue queue(4);
+  for (uint32_t i = 0; i < 1000; ++i)
+  {
+    queue.addCallback(cb, i % 37);
+  }
+
+  EXPECT_FALSE(queue.isEmpty());
+  queue.callAvailable();
+
+  EXPECT_EQ(cb->count, 1000U);
+  EXPECT_TRUE(queue.isEmpty());
+}
+
+class OrderCallback : public CallbackInterface
+{
+public:
+  OrderCallback(std::vector<uint32_t>* order, uint32_t value)
+  : order(order)
+  , value(value)
+  {}
+
+  virtual CallResult call()
+  {
+    order->push_back(value);
+    return Success;
+  }
+
+  std::vector<uint32_t>* order;
+  uint32_t value;
+};
+
+TEST(ShardedCallbackQueue, orderingWithinID)
+{
+  ShardedCallbackQueue queue(4);
+  std::vector<uint32_t> order;
+  for (uint32_t i = 0; i < 100; ++i)
+  {
+    queue.addCallback(boost::make_shared<OrderCallback>(&order, i), 5);
+  }
+
+  for (uint32_t i = 0; i < 100; ++i)
+  {
+    queue.callOne();
+  }
+
+  ASSERT_EQ(order.size(), 100U);
+  for (uint32_t i = 0; i < 100; ++i)
+  {
+    EXPECT_EQ(order[i], i);
+  }
+}
+
+TEST(ShardedCallbackQueue, remove)
+{
+  CountingCallbackPtr cb1(boost::make_shared<CountingCallback>());
+  CountingCallbackPtr cb2(boost::make_shared<CountingCallback>());
+  ShardedCallbackQueue queue(4);
+  queue.addCallback(cb1, 1);
+  queue.addCallback(cb2, 2);
+  queue.removeByID(1);
+  queue.callAvailable();
+
+  EXPECT_EQ(cb1->count, 0U);
+  EXPECT_EQ(cb2->count, 1U);
+  EXPECT_TRUE(queue.isEmpty());
+}
+
+TEST(ShardedCallbackQueue, removeSelf)
+{
+  ShardedCallbackQueue queue(4);
+  SelfRemovingCallbackPtr cb1(boost::make_shared<SelfRemovingCallback>(&queue, 1));
+  CountingCallbackPtr cb2(boost::make_shared<CountingCallback>());
+  queue.addCallback(cb1, 1);
+  queue.addCallback(cb2, 1);
+  queue.addCallback(cb2, 1);
+
+  queue.callOne();
+
+  queue.addCallback(cb2, 1);
+
+  queue.callAvailable();
+
+  EXPECT_EQ(cb1->count, 1U);
+  EXPECT_EQ(cb2->count, 1U);
+}
+
+TEST(ShardedCallbackQueue, recursive)
+{
+  ShardedCallbackQueue queue(4);
+  RecursiveCallbackPtr cb(boost::make_shared<RecursiveCallback>(&queue, false));
+  queue.addCallback(cb, 1);
+  queue.addCallback(cb, 1);
+  queue.addCallback(cb, 1);
+  queue.callOne();
+
+  EXPECT_EQ(cb->count, 3U);
+}
+
+TEST(ShardedCallbackQueue, disable)
+{
+  CountingCallbackPtr cb(boost::make_shared<CountingCallback>());
+  ShardedCallbackQueue queue(4);
+  queue.disable();
+  queue.addCallback(cb, 1);
+  EXPECT_EQ(queue.callOne(), CallbackQueue::Disabled);
+
+  queue.enable();
+  EXPECT_EQ(queue.callOne(), CallbackQueue::Empty);
+  queue.addCallback(cb, 1);
+  EXPECT_EQ(queue.callOne(), CallbackQueue::Called);
+  EXPECT_EQ(cb->count, 1U);
+}
+
+TEST(ShardedCallbackQueue, threadedCallAvailable)
+{
+  CountingCallbackPtr cb(boost::make_shared<CountingCallback>());
+  ShardedCallbackQueue queue(4);
+  size_t i = runThreadedTest(queue, cb, callAvailableThread);
+  ROS_INFO_STREAM(i);
+  EXPECT_EQ(cb->count, i);
+}
+
+TEST(ShardedCallbackQueue, threadedCallOne)
+{
+  CountingCallbackPtr cb(boost::make_shared<CountingCallback>());
+  ShardedCallbackQueue queue(4);
+  size_t i = runThreadedTest(queue, cb, callOneThread);
+  ROS_INFO_STREAM(i);
+  EXPECT_EQ(cb->count, i);
+}
+
+class PriorityOrderCallback : public OrderCallback
+{
+public:
+  PriorityOrderCallback(std::vector<uint32_t>* order, uint32_t value, int32_t priority, WallDuration deadline = WallDuration())
+  : OrderCallback(order, value)
+  , priority(priority)
+  , deadline(deadline)
+  {}
+
+  virtual int32_t getPriority() { return priority; }
+  virtual WallDuration getDeadline() { return deadline; }
+
+  int32_t priority;
+  WallDuration deadline;
+};
+
+TEST(PriorityCallbackQueue, singleCallback)
+{
+  CountingCallbackPtr cb(boost::make_shared<CountingCallback>());
+  PriorityCallbackQueue queue;
+  queue.addCallback(cb, 1);
+  EXPECT_EQ(queue.callOne(), CallbackQueue::Called);
+
+  EXPECT_EQ(cb->count, 1U);
+
+  queue.addCallback(cb, 1);
+  queue.callAvailable();
+
+  EXPECT_EQ(cb->count, 2U);
+
+  EXPECT_EQ(queue.callOne(), CallbackQueue::Empty);
+  EXPECT_EQ(cb->count, 2U);
+  EXPECT_TRUE(queue.isEmpty());
+}
+
+TEST(PriorityCallbackQueue, priorityOrder)
+{
+  PriorityCallbackQueue queue;
+  std::vector<uint32_t> order;
+  queue.addCallback(boost::make_shared<PriorityOrderCallback>(&order, 3, -5), 1);
+  queue.addCallback(boost::make_shared<PriorityOrderCallback>(&order, 2, 0), 2);
+  queue.addCallback(boost::make_shared<PriorityOrderCallback>(&order, 0, 10), 3);
+  queue.addCallback(boost::make_shared<PriorityOrderCallback>(&order, 1, 5), 4);
+
+  queue.callAvailable();
+
+  ASSERT_EQ(order.size(), 4U);
+  for (uint32_t i = 0; i < 4; ++i)
+  {
+    EXPECT_EQ(order[i], i);
+  }
+}
+
+TEST(PriorityCallbackQueue, deadlineOrder)
+{
+  PriorityCallbackQueue queue;
+  std::vector<uint32_t> order;
+  queue.addCallback(boost::make_shared<PriorityOrderCallback>(&order, 3, 0), 1);
+  queue.addCallback(boost::make_shared<PriorityOrderCallback>(&order, 2, 0, WallDuration(0.3)), 1);
+  queue.addCallback(boost::make_shared<PriorityOrderCallback>(&order, 0, 0, WallDuration(0.1)), 1);
+  queue.addCallback(boost::make_shared<PriorityOrderCallback>(&order, 1, 0, WallDuration(0.2)), 1);
+  // Priority still wins over deadline
+  queue.addCallback(boost::make_shared<PriorityOrderCallback>(&order, 4, -1, WallDuration(0.01)), 1);
+
+  for (uint32_t i = 0; i < 5; ++i)
+  {
+    EXPECT_EQ(queue.callOne(), CallbackQueue::Called);
+  }
+
+  ASSERT_EQ(order.size(), 5U);
+  for (uint32_t i = 0; i < 5; ++i)
+  {
+    EXPECT_EQ(order[i], i);
+  }
+}
+
+TEST(PriorityCallbackQueue, orderingWithinPriority)
+{
+  PriorityCallbackQueue queue;
+  std::vector<uint32_t> order;
+  for (uint32_t i = 0; i < 100; ++i)
+  {
+    queue.addCallback(boost::make_shared<OrderCallback>(&order, i), i % 7);
+  }
+
+  queue.callAvailable();
+
+  ASSERT_EQ(order.size(), 100U);
+  for (uint32_t i = 0; i < 100; ++i)
+  {
+    EXPECT_EQ(order[i], i);
+  }
+}
+
+class UrgentAddingCallback : public OrderCallback
+{
+public:
+  UrgentAddingCallback(std::vector<uint32_t>* order, uint32_t value, CallbackQueueInterface* queue)
+  : OrderCallback(order, value)
+  , queue(queue)
+  {}
+
+  virtual CallResult call()
+  {
+    queue->addCallback(boost::make_shared<PriorityOrderCallback>(order, 100, 10), 2);
+    return OrderCallback::call();
+  }
+
+  CallbackQueueInterface* queue;
+};
+
+TEST(PriorityCallbackQueue, urgentCallbackAddedDuringCallAvailable)
+{
+  PriorityCallbackQueue queue;
+  std::vector<uint32_t> order;
+  queue.addCallback(boost::make_shared<UrgentAddingCallback>(&order, 0, &queue), 1);
+  queue.addCallback(boost::make_shared<OrderCallback>(&order, 1), 1);
+  queue.addCallback(boost::make_shared<OrderCallback>(&order, 2), 1);
+
+  queue.callAvailable();
+
+  // The urgent callback jumps ahead of the ones already queued, and the last one is left for the next call
+  ASSERT_EQ(order.size(), 3U);
+  EXPECT_EQ(order[0], 0U);
+  EXPECT_EQ(order[1], 100U);
+  EXPECT_EQ(order[2], 1U);
+
+  queue.callAvailable();
+  ASSERT_EQ(order.size(), 4U);
+  EXPECT_EQ(order[3], 2U);
+  EXPECT_TRUE(queue.isEmpty());
+}
+
+class TryAgainCallback : public PriorityOrderCallback
+{
+public:
+  TryAgainCallback(std::vector<uint32_t>* order, uint32_t value, int32_t priority)
+  : PriorityOrderCallback(order, value, priority)
+  , tried(false)
+  {}
+
+  virtual CallResult call()
+  {
+    if (!tried)
+    {
+      tried = true;
+      return TryAgain;
+    }
+
+    return OrderCallback::call();
+  }
+
+  bool tried;
+};
+
+TEST(PriorityCallbackQueue, tryAgainKeepsPriority)
+{
+  PriorityCallbackQueue queue;
+  std::vector<uint32_t> order;
+  queue.addCallback(boost::make_shared<TryAgainCallback>(&order, 0, 5), 1);
+  queue.addCallback(boost::make_shared<PriorityOrderCallback>(&order, 1, 5), 2);
+  queue.addCallback(boost::make_shared<PriorityOrderCallback>(&order, 2, 0), 3);
+
+  EXPECT_EQ(queue.callOne(), CallbackQueue::TryAgain);
+  queue.callAvailable();
+
+  // Requeued behind its peer, but still ahead of the lower priority callback
+  ASSERT_EQ(order.size(), 3U);
+  EXPECT_EQ(order[0], 1U);
+  EXPECT_EQ(order[1], 0U);
+  EXPECT_EQ(order[2], 2U);
+}
+
+TEST(PriorityCallbackQueue, remove)
+{
+  CountingCallbackPtr cb1(boost::make_shared<CountingCallback>());
+  CountingCallbackPtr cb2(boost::make_shared<CountingCallback>());
+  PriorityCallbackQueue queue;
+  queue.addCallback(cb1, 1);
+  queue.addCallback(cb2, 2);
+  queue.addCallback(cb1, 1);
+  queue.removeByID(1);
+  queue.callAvailable();
+
+  EXPECT_EQ(cb1->count, 0U);
+  EXPECT_EQ(cb2->count, 1U);
+  EXPECT_TRUE(queue.isEmpty());
+}
+
+TEST(PriorityCallbackQueue, removeSelf)
+{
+  PriorityCallbackQueue queue;
+  SelfRemovingCallbackPtr cb1(boost::make_shared<SelfRemovingCallback>(&queue, 1));
+  CountingCallbackPtr cb2(boost::make_shared<CountingCallback>());
+  queue.addCallback(cb1, 1);
+  queue.addCallback(cb2, 1);
+  queue.addCallback(cb2, 1);
+
+  queue.callOne();
+
+  queue.addCallback(cb2, 1);
+
+  queue.callAvailable();
+
+  EXPECT_EQ(cb1->count, 1U);
+  EXPECT_EQ(cb2->count, 1U);
+}
+
+TEST(PriorityCallbackQueue, recursive)
+{
+  PriorityCallbackQueue queue;
+  RecursiveCallbackPtr cb(boost::make_shared<RecursiveCallback>(&queue, false));
+  queue.addCallback(cb, 1);
+  queue.addCallback(cb, 1);
+  queue.addCallback(cb, 1);
+  queue.callOne();
+
+  EXPECT_EQ(cb->count, 3U);
+}
+
+TEST(PriorityCallbackQueue, disable)
+{
+  CountingCallbackPtr cb(boost::make_shared<CountingCallback>());
+  PriorityCallbackQueue queue;
+  queue.disable();
+  queue.addCallback(cb, 1);
+  EXPECT_EQ(queue.callOne(), CallbackQueue::Disabled);
+
+  queue.enable();
+  EXPECT_EQ(queue.callOne(), CallbackQueue::Empty);
+  queue.addCallback(cb, 1);
+  EXPECT_EQ(queue.callOne(), CallbackQueue::Called);
+  EXPECT_EQ(cb->count, 1U);
+}
+
+TEST(PriorityCallbackQueue, threadedCallAvailable)
+{
+  CountingCallbackPtr cb(boost::make_shared<CountingCallback>());
+  PriorityCallbackQueue queue;
+  size_t i = runThreadedTest(queue, cb, callAvailableThread);
+  ROS_INFO_STREAM(i);
+  EXPECT_EQ(cb->count, i);
+}
+
+TEST(PriorityCallbackQueue, threadedCallOne)
+{
+  CountingCallbackPtr cb(boost::make_shared<CountingCallback>());
+  PriorityCallbackQueue queue;
+  size_t i = runThreadedTest(queue, cb, callOneThread);
+  ROS_INFO_STREAM(i);
+  EXPECT_EQ(cb->count, i);
+}
+
+TEST(PreallocatedCallbackQueue, singleCallback)
+{
+  CountingCallbackPtr cb(boost::make_shared<CountingCallback>());
+  PreallocatedCallbackQueue queue(16);
+  queue.addCallback(cb, 1);
+  EXPECT_EQ(queue.callOne(), CallbackQueue::Called);
+
+  EXPECT_EQ(cb->count, 1U);
+
+  queue.addCallback(cb, 1);
+  queue.callAvailable();
+
+  EXPECT_EQ(cb->count, 2U);
+
+  EXPECT_EQ(queue.callOne(), CallbackQueue::Empty);
+  EXPECT_EQ(cb->count, 2U);
+  EXPECT_TRUE(queue.isEmpty());
+}
+
+TEST(PreallocatedCallbackQueue, grow)
+{
+  PreallocatedCallbackQueue queue(4);
+  std::vector<uint32_t> order;
+  for (uint32_t i = 0; i < 10; ++i)
+  {
+    queue.addCallback(boost::make_shared<OrderCallback>(&order, i), i % 3);
+  }
+
+  EXPECT_EQ(queue.getCapacity(), 16U);
+  queue.callAvailable();
+
+  ASSERT_EQ(order.size(), 10U);
+  for (uint32_t i = 0; i < 10; ++i)
+  {
+    EXPECT_EQ(order[i], i);
+  }
+  EXPECT_TRUE(queue.isEmpty());
+}
+
+// Counts heap allocations made while g_count_allocations is set
+boost::atomic<bool> g_count_allocations(false);
+boost::atomic<size_t> g_allocations(0);
+
+void* operator new(size_t size)
+{
+  if (g_count_allocations.load())
+  {
+    ++g_allocations;
+  }
+
+  void* p = malloc(size);
+  if (!p)
+  {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+// Kept out of line, otherwise gcc inlines it next to the default operator new and warns about the mismatched free()
+__attribute__((noinline)) void operator delete(void* p) throw()
+{
+  free(p);
+}
+
+TEST(PreallocatedCallbackQueue, noAllocations)
+{
+  CountingCallbackPtr cb(boost::make_shared<CountingCallback>());
+  PreallocatedCallbackQueue queue(16);
+
+  // The first call sets up the thread-local storage and the removal id
+  queue.addCallback(cb, 1);
+  queue.callOne();
+
+  g_allocations = 0;
+  g_count_allocations = true;
+  for (uint32_t i = 0; i < 1000; ++i)
+  {
+    queue.addCallback(cb, 1);
+    queue.addCallback(cb, 1);
+    queue.callOne();
+    queue.callAvailable();
+  }
+  g_count_allocations = false;
+
+  EXPECT_EQ(g_allocations.load(), 0U);
+  EXPECT_EQ(cb->count, 2001U);
+}
+
+TEST(PreallocatedCallbackQueue, remove)
+{
+  CountingCallbackPtr cb1(boost::make_shared<CountingCallback>());
+  CountingCallbackPtr cb2(boost::make_shared<CountingCallback>());
+  PreallocatedCallbackQueue queue(16);
+  queue.addCallback(cb1, 1);
+  queue.addCallback(cb2, 2);
+  queue.addCallback(cb1, 1);
+  queue.removeByID(1);
+  queue.callAvailable();
+
+  EXPECT_EQ(cb1->count, 0U);
+  EXPECT_EQ(cb2->count, 1U);
+  EXPECT_TRUE(queue.isEmpty());
+}
+
+TEST(PreallocatedCallbackQueue, removeSelf)
+{
+  PreallocatedCallbackQueue queue(16);
+  SelfRemovingCallbackPtr cb1(boost::make_shared<SelfRemovingCallback>(&queue, 1));
+  CountingCallbackPtr cb2(boost::make_shared<CountingCallback>());
+  queue.addCallback(cb1, 1);
+  queue.addCallback(cb2, 1);
+  queue.addCallback(cb2, 1);
+
+  queue.callOne();
+
+  queue.addCallback(cb2, 1);
+
+  queue.callAvailable();
+
+  EXPECT_EQ(cb1->count, 1U);
+  EXPECT_EQ(cb2->count, 1U);
+}
+
+TEST(PreallocatedCallbackQueue, recursive)
+{
+  PreallocatedCallbackQueue queue(16);
+  RecursiveCallbackPtr cb(boost::make_shared<RecursiveCallback>(&queue, false));
+  queue.addCallback(cb, 1);
+  queue.addCallback(cb, 1);
+  queue.addCallback(cb, 1);
+  queue.callOne();
+
+  EXPECT_EQ(cb->count, 3U);
+}
+
+TEST(PreallocatedCallbackQueue, recursiveCallAvailable)
+{
+  PreallocatedCallbackQueue queue(16);
+  RecursiveCallbackPtr cb(boost::make_shared<RecursiveCallback>(&queue, true));
+  queue.addCallback(cb, 1);
+  queue.addCallback(cb, 1);
+  queue.addCallback(cb, 1);
+  queue.callAvailable();
+
+  EXPECT_EQ(cb->count, 3U);
+}
+
+TEST(PreallocatedCallbackQueue, threadedCallAvailable)
+{
+  CountingCallbackPtr cb(boost::make_shared<CountingCallback>());
+  PreallocatedCallbackQueue queue;
+  size_t i = runThreadedTest(queue, cb, callAvailableThread);
+  ROS_INFO_STREAM(i);
+  EXPECT_EQ(cb->count, i);
+}
+
+TEST(PreallocatedCallbackQueue, threadedCallOne)
+{
+  CountingCallbackPtr cb(boost::make_shared<CountingCallback>());
+  PreallocatedCallbackQueue queue;
+  size_t i = runThreadedTest(queue, cb, callOneThread);
+  ROS_INFO_STREAM(i);
+  EXPECT_EQ(cb->count, i);
+}
+
 int main(int argc, char** argv)
 {
   testing::InitGoogleTest(&argc, argv);
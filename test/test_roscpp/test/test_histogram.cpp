@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2009, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+
+/*
+ * Test Histogram bucketing and percentiles
+ */
+
+#include <gtest/gtest.h>
+#include "ros/histogram.h"
+
+#include "xmlrpcpp/XmlRpcValue.h"
+
+#include <boost/thread.hpp>
+
+using namespace ros;
+
+TEST(Histogram, buckets)
+{
+  // Small values are exact
+  for (uint64_t v = 0; v < Histogram::SUB_BUCKETS; ++v)
+  {
+    EXPECT_EQ(Histogram::getBucketIndex(v), v);
+    EXPECT_EQ(Histogram::getBucketUpperBound(v), v);
+  }
+
+  // Every value lands in a bucket whose upper bound is within 12.5% above it, and indices never go backwards
+  uint32_t last_index = 0;
+  for (uint64_t v = 1; v < (1ULL << 41); v = v * 3 / 2 + 1)
+  {
+    uint32_t index = Histogram::getBucketIndex(v);
+    EXPECT_GE(index, last_index);
+    EXPECT_LT(index, Histogram::NUM_BUCKETS);
+    uint64_t upper = Histogram::getBucketUpperBound(index);
+    EXPECT_GE(upper, v);
+    EXPECT_LE(upper - v, v / 8);
+    EXPECT_EQ(Histogram::getBucketIndex(upper), index);
+    last_index = index;
+  }
+
+  EXPECT_EQ(Histogram::getBucketIndex(~0ULL), Histogram::NUM_BUCKETS - 1);
+}
+
+TEST(Histogram, percentiles)
+{
+  Histogram h;
+  Histogram::Snapshot s = h.getSnapshot();
+  EXPECT_EQ(s.count_, 0u);
+  EXPECT_EQ(s.getPercentile(0.5), 0u);
+  EXPECT_EQ(s.getMean(), 0.0);
+
+  for (uint64_t v = 1; v <= 1000; ++v)
+  {
+    h.record(v * 1000);
+  }
+  // One big outlier
+  h.record(1000000000);
+
+  s = h.getSnapshot();
+  EXPECT_EQ(s.count_, 1001u);
+  EXPECT_EQ(s.max_, 1000000000u);
+  EXPECT_NEAR(s.getPercentile(0.5), 500000, 500000 / 8);
+  EXPECT_NEAR(s.getPercentile(0.99), 990000, 990000 / 8);
+  EXPECT_EQ(s.getPercentile(1.0), 1000000000u);
+  EXPECT_NEAR(s.getMean(), (500500000.0 + 1000000000.0) / 1001, 1.0);
+
+  XmlRpc::XmlRpcValue stats;
+  h.getStats(stats);
+  ASSERT_EQ(stats.size(), 7);
+  EXPECT_EQ((int)stats[0], 1001);
+  EXPECT_EQ((double)stats[6], 1000000000.0);
+
+  h.reset();
+  EXPECT_EQ(h.getSnapshot().count_, 0u);
+  EXPECT_EQ(h.getSnapshot().max_, 0u);
+}
+
+void recordValues(Histogram* h, uint64_t value, int count)
+{
+  for (int i = 0; i < count; ++i)
+  {
+    h->record(value);
+  }
+}
+
+TEST(Histogram, concurrentRecord)
+{
+  Histogram h;
+  boost::thread_group threads;
+  for (int i = 0; i < 4; ++i)
+  {
+    threads.create_thread(boost::bind(recordValues, &h, 100 * (i + 1), 100000));
+  }
+  threads.join_all();
+
+  Histogram::Snapshot s = h.getSnapshot();
+  EXPECT_EQ(s.count_, 400000u);
+  EXPECT_EQ(s.sum_, 100000u * (100 + 200 + 300 + 400));
+  EXPECT_EQ(s.max_, 400u);
+}
+
+int
+main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -39,6 +39,9 @@
 
 #include <fcntl.h>
 
+#include <algorithm>
+#include <atomic>
+
 #include <boost/bind.hpp>
 #include <boost/thread.hpp>
 
@@ -238,6 +241,25 @@ TEST_F(Poller, multiAddDel)
   ASSERT_TRUE(poll_set_.delSocket(sh.socket_));
 }
 
+TEST_F(Poller, numSockets)
+{
+  // the internal signal pipe is always tracked
+  size_t base = poll_set_.getNumSockets();
+  ASSERT_GE(base, 1u);
+
+  SocketHelper sh0(sockets_[0]);
+  SocketHelper sh1(sockets_[1]);
+  ASSERT_TRUE(poll_set_.addSocket(sh0.socket_, boost::bind(&SocketHelper::processEvents, &sh0, _1)));
+  ASSERT_EQ(poll_set_.getNumSockets(), base + 1);
+  ASSERT_TRUE(poll_set_.addSocket(sh1.socket_, boost::bind(&SocketHelper::processEvents, &sh1, _1)));
+  ASSERT_EQ(poll_set_.getNumSockets(), base + 2);
+
+  ASSERT_TRUE(poll_set_.delSocket(sh0.socket_));
+  ASSERT_EQ(poll_set_.getNumSockets(), base + 1);
+  ASSERT_TRUE(poll_set_.delSocket(sh1.socket_));
+  ASSERT_EQ(poll_set_.getNumSockets(), base);
+}
+
 void addThread(PollSet* ps, SocketHelper* sh, boost::barrier* barrier)
 {
   barrier->wait();
@@ -389,8 +411,84 @@ TEST_F(Poller, signal)
   boost::thread t(boost::bind(&Poller::waitThenSignal, this));
   poll_set_.update(-1);
 
-  // wait for poll_set_.signal_mutex_ to be unlocked after invoking signal()
-  usleep(50000);
+  // wait for the signalling thread to return from signal()
+  t.join();
+}
+
+TEST_F(Poller, signalDrained)
+{
+  poll_set_.update(0);
+
+  // Several signals before an update are consumed by that single update, so the next one blocks until its timeout
+  poll_set_.signal();
+  poll_set_.signal();
+  poll_set_.signal();
+  poll_set_.update(0);
+
+  ros::WallTime start = ros::WallTime::now();
+  poll_set_.update(100);
+  ASSERT_GE((ros::WallTime::now() - start).toSec(), 0.09);
+}
+
+// Like a publisher: queue some work, then signal() so the poll thread picks it up.  Each round is started by the
+// poll thread, so both signalling threads race each other, and nothing else signals until both have been picked up
+void queueThenSignal(PollSet* poll_set, std::atomic<int>* round, std::atomic<bool>* queued, std::atomic<bool>* stop)
+{
+  int seen = 0;
+  while (!stop->load())
+  {
+    if (round->load() == seen)
+    {
+      boost::this_thread::yield();
+      continue;
+    }
+
+    ++seen;
+    queued->store(true);
+    poll_set->signal();
+  }
+}
+
+TEST_F(Poller, signalNeverLost)
+{
+  poll_set_.update(0);
+
+  // Two threads signalling at once, while the poll thread drains, must never leave queued work waiting for a timeout
+  std::atomic<int> round(0);
+  std::atomic<bool> queued[2];
+  std::atomic<bool> stop(false);
+  boost::thread_group threads;
+  for (int i = 0; i < 2; ++i)
+  {
+    queued[i].store(false);
+    threads.create_thread(boost::bind(queueThenSignal, &poll_set_, &round, &queued[i], &stop));
+  }
+
+  double slowest = 0.0;
+  for (int r = 1; r <= 5000 && slowest < 0.5; ++r)
+  {
+    round.store(r);
+
+    int picked_up = 0;
+    while (picked_up < 2 && slowest < 0.5)
+    {
+      ros::WallTime start = ros::WallTime::now();
+      poll_set_.update(1000);
+      slowest = std::max(slowest, (ros::WallTime::now() - start).toSec());
+
+      for (int i = 0; i < 2; ++i)
+      {
+        if (queued[i].exchange(false))
+        {
+          ++picked_up;
+        }
+      }
+    }
+  }
+  stop.store(true);
+  threads.join_all();
+
+  ASSERT_LT(slowest, 0.5);
 }
 
 
@@ -35,6 +35,7 @@
 
 #include <gtest/gtest.h>
 #include "ros/subscription_queue.h"
+#include "ros/lock_free_subscription_queue.h"
 #include "ros/message_deserializer.h"
 #include "ros/callback_queue_interface.h"
 #include "ros/subscription_callback_helper.h"
@@ -281,6 +282,232 @@ TEST(SubscriptionQueue, nonConcurrentOrdering)
   ASSERT_EQ(helper->calls_, 2);
 }
 
+TEST(SubscriptionQueue, latencyHistogram)
+{
+  SubscriptionQueue queue("blah", 0, false);
+  FakeSubHelperPtr helper(boost::make_shared<FakeSubHelper>());
+  MessageDeserializerPtr des(boost::make_shared<MessageDeserializer>(helper, SerializedMessage(), boost::shared_ptr<M_string>()));
+  HistogramPtr histogram(boost::make_shared<Histogram>());
+
+  queue.push(helper, des, false, VoidConstWPtr(), true, ros::Time(), 0, histogram);
+  queue.push(helper, des, false, VoidConstWPtr(), true);
+  boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+  queue.call();
+  queue.call();
+
+  // Only the first push asked for its dwell time to be recorded
+  Histogram::Snapshot s = histogram->getSnapshot();
+  ASSERT_EQ(s.count_, 1u);
+  ASSERT_GE(s.max_, 10000000u);
+}
+
+TEST(LockFreeSubscriptionQueue, queueSize)
+{
+  LockFreeSubscriptionQueue queue("blah", 1, false);
+
+  FakeSubHelperPtr helper(boost::make_shared<FakeSubHelper>());
+  MessageDeserializerPtr des(boost::make_shared<MessageDeserializer>(helper, SerializedMessage(), boost::shared_ptr<M_string>()));
+
+  ASSERT_FALSE(queue.full());
+
+  queue.push(helper, des, false, VoidConstWPtr(), true);
+
+  ASSERT_TRUE(queue.full());
+
+  ASSERT_EQ(queue.call(), CallbackInterface::Success);
+
+  ASSERT_FALSE(queue.full());
+
+  bool was_full = false;
+  queue.push(helper, des, false, VoidConstWPtr(), true, ros::Time(), &was_full);
+  ASSERT_FALSE(was_full);
+  queue.push(helper, des, false, VoidConstWPtr(), true, ros::Time(), &was_full);
+  ASSERT_TRUE(was_full);
+
+  ASSERT_TRUE(queue.full());
+
+  ASSERT_EQ(queue.call(), CallbackInterface::Success);
+  ASSERT_EQ(queue.call(), CallbackInterface::Invalid);
+
+  ASSERT_EQ(helper->calls_, 2);
+}
+
+TEST(LockFreeSubscriptionQueue, dropsOldest)
+{
+  LockFreeSubscriptionQueue queue("blah", 3, false);
+
+  std::vector<FakeSubHelperPtr> helpers;
+  for (int i = 0; i < 5; ++i)
+  {
+    FakeSubHelperPtr helper(boost::make_shared<FakeSubHelper>());
+    MessageDeserializerPtr des(boost::make_shared<MessageDeserializer>(helper, SerializedMessage(), boost::shared_ptr<M_string>()));
+    queue.push(helper, des, false, VoidConstWPtr(), true);
+    helpers.push_back(helper);
+  }
+
+  while (queue.call() == CallbackInterface::Success)
+  {
+  }
+
+  ASSERT_EQ(helpers[0]->calls_, 0);
+  ASSERT_EQ(helpers[1]->calls_, 0);
+  ASSERT_EQ(helpers[2]->calls_, 1);
+  ASSERT_EQ(helpers[3]->calls_, 1);
+  ASSERT_EQ(helpers[4]->calls_, 1);
+}
+
+TEST(LockFreeSubscriptionQueue, expiredTrackedObject)
+{
+  LockFreeSubscriptionQueue queue("blah", 1, false);
+
+  FakeSubHelperPtr helper(boost::make_shared<FakeSubHelper>());
+  MessageDeserializerPtr des(boost::make_shared<MessageDeserializer>(helper, SerializedMessage(), boost::shared_ptr<M_string>()));
+
+  VoidConstWPtr tracked;
+  {
+    VoidConstPtr obj(boost::make_shared<int>(0));
+    tracked = obj;
+  }
+
+  queue.push(helper, des, true, tracked, true);
+  ASSERT_EQ(queue.call(), CallbackInterface::Invalid);
+  ASSERT_EQ(helper->calls_, 0);
+}
+
+TEST(LockFreeSubscriptionQueue, clearCall)
+{
+  LockFreeSubscriptionQueue queue("blah", 1, false);
+
+  FakeSubHelperPtr helper(boost::make_shared<FakeSubHelper>());
+  MessageDeserializerPtr des(boost::make_shared<MessageDeserializer>(helper, SerializedMessage(), boost::shared_ptr<M_string>()));
+
+  queue.push(helper, des, false, VoidConstWPtr(), true);
+  queue.clear();
+  ASSERT_EQ(queue.call(), CallbackInterface::Invalid);
+
+  queue.push(helper, des, false, VoidConstWPtr(), true);
+  ASSERT_EQ(queue.call(), CallbackInterface::Success);
+}
+
+TEST(LockFreeSubscriptionQueue, clearInCallback)
+{
+  LockFreeSubscriptionQueue queue("blah", 1, false);
+
+  FakeSubHelperPtr helper(boost::make_shared<FakeSubHelper>());
+  MessageDeserializerPtr des(boost::make_shared<MessageDeserializer>(helper, SerializedMessage(), boost::shared_ptr<M_string>()));
+
+  helper->cb_ = boost::bind(clearInCallbackCallback, boost::ref(queue));
+  queue.push(helper, des, false, VoidConstWPtr(), true);
+  queue.call();
+}
+
+TEST(LockFreeSubscriptionQueue, clearWhileThreadIsBlocking)
+{
+  LockFreeSubscriptionQueue queue("blah", 1, false);
+
+  FakeSubHelperPtr helper(boost::make_shared<FakeSubHelper>());
+  MessageDeserializerPtr des(boost::make_shared<MessageDeserializer>(helper, SerializedMessage(), boost::shared_ptr<M_string>()));
+
+  bool done = false;
+  boost::barrier barrier(2);
+  helper->cb_ = boost::bind(clearWhileThreadIsBlockingCallback, &done, &barrier);
+  queue.push(helper, des, false, VoidConstWPtr(), true);
+  boost::thread t(callThread, boost::ref(queue));
+  barrier.wait();
+
+  queue.clear();
+
+  ASSERT_TRUE(done);
+}
+
+TEST(LockFreeSubscriptionQueue, concurrentCallbacks)
+{
+  LockFreeSubscriptionQueue queue("blah", 2, true);
+  FakeSubHelperPtr helper(boost::make_shared<FakeSubHelper>());
+  MessageDeserializerPtr des(boost::make_shared<MessageDeserializer>(helper, SerializedMessage(), boost::shared_ptr<M_string>()));
+
+  boost::barrier bar(2);
+  helper->cb_ = boost::bind(waitForBarrier, &bar);
+  queue.push(helper, des, false, VoidConstWPtr(), true);
+  queue.push(helper, des, false, VoidConstWPtr(), true);
+  boost::thread t1(callThread, boost::ref(queue));
+  boost::thread t2(callThread, boost::ref(queue));
+  t1.join();
+  t2.join();
+
+  ASSERT_EQ(helper->calls_, 2);
+}
+
+TEST(LockFreeSubscriptionQueue, nonConcurrentOrdering)
+{
+  LockFreeSubscriptionQueue queue("blah", 2, false);
+  FakeSubHelperPtr helper(boost::make_shared<FakeSubHelper>());
+  MessageDeserializerPtr des(boost::make_shared<MessageDeserializer>(helper, SerializedMessage(), boost::shared_ptr<M_string>()));
+
+  helper->cb_ = waitForASecond;
+  queue.push(helper, des, false, VoidConstWPtr(), true);
+  queue.push(helper, des, false, VoidConstWPtr(), true);
+  boost::thread t1(callThread, boost::ref(queue));
+  boost::thread t2(callThread, boost::ref(queue));
+  t1.join();
+  t2.join();
+
+  ASSERT_EQ(helper->calls_, 1);
+  queue.call();
+  ASSERT_EQ(helper->calls_, 2);
+}
+
+void pushThread(SubscriptionQueue& queue, const FakeSubHelperPtr& helper, const MessageDeserializerPtr& des, int count)
+{
+  for (int i = 0; i < count; ++i)
+  {
+    queue.push(helper, des, false, VoidConstWPtr(), true);
+  }
+}
+
+void drainThread(SubscriptionQueue& queue, volatile bool* done)
+{
+  while (!*done)
+  {
+    queue.call();
+  }
+}
+
+TEST(LockFreeSubscriptionQueue, multipleProducers)
+{
+  LockFreeSubscriptionQueue queue("blah", 16, true);
+  FakeSubHelperPtr helper(boost::make_shared<FakeSubHelper>());
+  MessageDeserializerPtr des(boost::make_shared<MessageDeserializer>(helper, SerializedMessage(), boost::shared_ptr<M_string>()));
+
+  const int per_thread = 10000;
+  volatile bool done = false;
+  boost::thread_group consumers;
+  for (int i = 0; i < 2; ++i)
+  {
+    consumers.create_thread(boost::bind(drainThread, boost::ref(queue), &done));
+  }
+
+  boost::thread_group producers;
+  for (int i = 0; i < 4; ++i)
+  {
+    producers.create_thread(boost::bind(pushThread, boost::ref(queue), helper, des, per_thread));
+  }
+  producers.join_all();
+
+  done = true;
+  consumers.join_all();
+
+  while (queue.call() == CallbackInterface::Success)
+  {
+  }
+
+  // Some messages may have been dropped, but never more than were pushed, and the queue ends up empty
+  ASSERT_GT(helper->calls_, 0);
+  ASSERT_LE(helper->calls_, 4 * per_thread);
+  ASSERT_FALSE(queue.full());
+  ASSERT_EQ(queue.call(), CallbackInterface::Invalid);
+}
+
 int main(int argc, char** argv)
 {
   testing::InitGoogleTest(&argc, argv);
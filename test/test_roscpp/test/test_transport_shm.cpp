@@ -0,0 +1,303 @@
+/*
+ * Copyright (c) 2008, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Author: Josh Faust */
+
+/*
+ * Test version macros
+ */
+#include <gtest/gtest.h>
+#include "ros/poll_set.h"
+#include "ros/header.h"
+#include "ros/transport/transport_shm.h"
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+#include <vector>
+
+using namespace ros;
+
+class SharedMemory : public testing::Test
+{
+public:
+  SharedMemory()
+  {
+  }
+
+  ~SharedMemory()
+  {
+  }
+
+
+protected:
+
+  void connectionReceived(const TransportTCPPtr& transport)
+  {
+    transports_[2] = boost::dynamic_pointer_cast<TransportSHM>(transport);
+  }
+
+  void pollThread()
+  {
+    while (continue_)
+    {
+      poll_set_.update(10);
+    }
+  }
+
+  void onReadable(const TransportPtr& transport)
+  {
+    uint8_t buf[1000];
+    int32_t bytes_read = 0;
+    while ((bytes_read = transport->read(buf, sizeof(buf))) > 0)
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      received_.insert(received_.end(), buf, buf + bytes_read);
+    }
+  }
+
+  void onWriteable(const TransportPtr& transport)
+  {
+    while (write_offset_ < to_send_.size())
+    {
+      int32_t written = transport->write(&to_send_[write_offset_], to_send_.size() - write_offset_);
+      ASSERT_GE(written, 0);
+      if (written == 0)
+      {
+        return;
+      }
+
+      write_offset_ += written;
+    }
+
+    transport->disableWrite();
+  }
+
+  void onDisconnect(const TransportPtr& transport, int index)
+  {
+    (void)transport;
+    disconnected_[index] = true;
+  }
+
+  void parseHeader(const TransportSHMPtr& transport, const M_string& values)
+  {
+    boost::shared_array<uint8_t> buffer;
+    uint32_t len;
+    Header::write(values, buffer, len);
+
+    Header header;
+    std::string error;
+    ASSERT_TRUE(header.parse(buffer, len, error));
+    transport->parseHeader(header);
+  }
+
+  void negotiate()
+  {
+    ASSERT_TRUE(transports_[1]->createSegment());
+
+    M_string request;
+    request["shm_segment"] = transports_[1]->getSegmentName();
+    parseHeader(transports_[2], request);
+    ASSERT_TRUE(transports_[2]->isAttached());
+
+    M_string reply;
+    reply["shm"] = "1";
+    parseHeader(transports_[1], reply);
+    transports_[2]->activate();
+  }
+
+  virtual void SetUp()
+  {
+    disconnected_[0] = false;
+    disconnected_[1] = false;
+    disconnected_[2] = false;
+    write_offset_ = 0;
+
+    // Smallest possible ring, so the transfers below wrap around it many times
+    TransportSHM::s_ring_size_ = 0;
+
+    transports_[0] = boost::make_shared<TransportSHM>(&poll_set_);
+    transports_[1] = boost::make_shared<TransportSHM>(&poll_set_);
+
+    if (!transports_[0]->listen(0, 100, boost::bind(&SharedMemory::connectionReceived, this, _1)))
+    {
+      FAIL();
+    }
+
+    if (!transports_[1]->connect("localhost", transports_[0]->getServerPort()))
+    {
+      FAIL();
+    }
+
+    continue_ = true;
+    poll_thread_ = boost::thread(boost::bind(&SharedMemory::pollThread, this));
+
+    int count = 0;
+    while (!transports_[2] && count++ < 100)
+    {
+      boost::this_thread::sleep(boost::posix_time::milliseconds(50));
+    }
+
+    if (!transports_[2])
+    {
+      FAIL();
+    }
+
+    transports_[1]->setReadCallback(boost::bind(&SharedMemory::onReadable, this, _1));
+    transports_[2]->setWriteCallback(boost::bind(&SharedMemory::onWriteable, this, _1));
+    transports_[1]->setDisconnectCallback(boost::bind(&SharedMemory::onDisconnect, this, _1, 1));
+    transports_[2]->setDisconnectCallback(boost::bind(&SharedMemory::onDisconnect, this, _1, 2));
+  }
+
+  virtual void TearDown()
+  {
+    for (int i = 0; i < 3; ++i)
+    {
+      if (transports_[i])
+      {
+        transports_[i]->close();
+      }
+    }
+
+    continue_ = false;
+    poll_thread_.join();
+  }
+
+  void send(size_t size)
+  {
+    to_send_.resize(size);
+    for (size_t i = 0; i < size; ++i)
+    {
+      to_send_[i] = (uint8_t)(i * 7);
+    }
+
+    transports_[1]->enableRead();
+    transports_[2]->enableWrite();
+
+    for (int i = 0; i < 500; ++i)
+    {
+      {
+        boost::mutex::scoped_lock lock(mutex_);
+        if (received_.size() >= size)
+        {
+          break;
+        }
+      }
+
+      boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+    }
+  }
+
+  TransportSHMPtr transports_[3];
+  bool disconnected_[3];
+
+  std::vector<uint8_t> to_send_;
+  size_t write_offset_;
+  std::vector<uint8_t> received_;
+  boost::mutex mutex_;
+
+  PollSet poll_set_;
+
+  boost::thread poll_thread_;
+  volatile bool continue_;
+};
+
+TEST_F(SharedMemory, negotiate)
+{
+  negotiate();
+
+  ASSERT_TRUE(transports_[1]->isActive());
+  ASSERT_TRUE(transports_[2]->isActive());
+  ASSERT_STREQ(transports_[1]->getType(), "TCPROS-SHM");
+  ASSERT_STREQ(transports_[2]->getType(), "TCPROS-SHM");
+}
+
+TEST_F(SharedMemory, transfer)
+{
+  negotiate();
+
+  // Many times the size of the ring, so the writer has to wait for the reader to make space
+  send(4 * 1024 * 1024 + 13);
+
+  boost::mutex::scoped_lock lock(mutex_);
+  ASSERT_EQ(received_.size(), to_send_.size());
+  ASSERT_TRUE(received_ == to_send_);
+}
+
+TEST_F(SharedMemory, fallbackToTCP)
+{
+  ASSERT_TRUE(transports_[1]->createSegment());
+
+  // A publisher that doesn't know about shared memory just ignores the offer
+  M_string reply;
+  reply["callerid"] = "/test";
+  parseHeader(transports_[1], reply);
+  transports_[2]->activate();
+
+  ASSERT_FALSE(transports_[1]->isActive());
+  ASSERT_FALSE(transports_[2]->isActive());
+  ASSERT_STREQ(transports_[1]->getType(), "TCPROS");
+
+  send(100000);
+
+  boost::mutex::scoped_lock lock(mutex_);
+  ASSERT_TRUE(received_ == to_send_);
+}
+
+TEST_F(SharedMemory, disconnectWriter)
+{
+  negotiate();
+
+  transports_[1]->enableRead();
+  transports_[2]->close();
+  ASSERT_TRUE(disconnected_[2]);
+
+  boost::this_thread::sleep(boost::posix_time::milliseconds(100));
+  ASSERT_TRUE(disconnected_[1]);
+}
+
+TEST_F(SharedMemory, disconnectReader)
+{
+  negotiate();
+
+  transports_[1]->close();
+  ASSERT_TRUE(disconnected_[1]);
+
+  boost::this_thread::sleep(boost::posix_time::milliseconds(100));
+  ASSERT_TRUE(disconnected_[2]);
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+
+  signal(SIGPIPE, SIG_IGN);
+
+  return RUN_ALL_TESTS();
+}
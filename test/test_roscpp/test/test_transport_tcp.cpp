@@ -118,6 +118,43 @@ TEST_F(Synchronous, writeThenReadPartial)
   ASSERT_STREQ((const char*)buf, msg.substr(0, 1).c_str());
 }
 
+TEST_F(Synchronous, writevThenRead)
+{
+  std::string msgs[3] = { "te", "", "st" };
+  Transport::WriteBuffer buffers[3];
+  for (int i = 0; i < 3; ++i)
+  {
+    buffers[i].data = (uint8_t*)msgs[i].c_str();
+    buffers[i].size = msgs[i].length();
+  }
+
+  int32_t written = transports_[1]->writev(buffers, 3);
+  ASSERT_EQ(written, 4);
+
+  uint8_t buf[5];
+  memset(buf, 0, sizeof(buf));
+  int32_t read = 0;
+  while (read < 4)
+  {
+    int32_t ret = transports_[2]->read(buf + read, 4 - read);
+    ASSERT_GT(ret, 0);
+    read += ret;
+  }
+  ASSERT_STREQ((const char*)buf, "test");
+}
+
+TEST_F(Synchronous, writevAfterClose)
+{
+  transports_[1]->close();
+
+  std::string msg = "test";
+  Transport::WriteBuffer buffer;
+  buffer.data = (uint8_t*)msg.c_str();
+  buffer.size = msg.length();
+  int32_t written = transports_[1]->writev(&buffer, 1);
+  ASSERT_EQ(written, -1);
+}
+
 void readThread(TransportTCPPtr transport, uint8_t* buf, uint32_t size, volatile int32_t* read_out, volatile bool* done_read)
 {
   while (*read_out < (int32_t)size)
@@ -0,0 +1,437 @@
+/*
+ * Test UDPROS fragmentation: a sender's datagrams are captured on a plain socket, then replayed to the receiver
+ * in whatever order (and with whatever losses) a test wants
+ */
+
+#include <gtest/gtest.h>
+#include "ros/poll_set.h"
+#include "ros/transport/transport_udp.h"
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace ros;
+
+typedef std::vector<std::string> V_string;
+
+class Fragments : public testing::Test
+{
+protected:
+  virtual void SetUp()
+  {
+    capture_sock_ = bindLoopback();
+    inject_sock_ = socket(AF_INET, SOCK_DGRAM, 0);
+    ASSERT_GE(capture_sock_, 0);
+    ASSERT_GE(inject_sock_, 0);
+  }
+
+  virtual void TearDown()
+  {
+    if (sender_)
+    {
+      sender_->close();
+    }
+    if (receiver_)
+    {
+      receiver_->close();
+    }
+    ::close(capture_sock_);
+    ::close(inject_sock_);
+  }
+
+  static int bindLoopback()
+  {
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    if (sock >= 0 && bind(sock, (sockaddr*)&addr, sizeof(addr)) != 0)
+    {
+      ::close(sock);
+      return -1;
+    }
+    return sock;
+  }
+
+  static int localPort(int sock)
+  {
+    sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+    getsockname(sock, (sockaddr*)&addr, &len);
+    return ntohs(addr.sin_port);
+  }
+
+  /// Set up a sender and receiver for datagrams of at most max_datagram_size bytes
+  void connect(int max_datagram_size, uint32_t fec_parity = 0, uint32_t fec_group = 0)
+  {
+    receiver_ = boost::make_shared<TransportUDP>(&poll_set_, 0, max_datagram_size);
+    ASSERT_TRUE(receiver_->createIncoming(0, true));
+    receiver_->setFec(fec_parity, fec_group);
+
+    sender_ = boost::make_shared<TransportUDP>(&poll_set_, 0, max_datagram_size);
+    ASSERT_TRUE(sender_->connect("127.0.0.1", localPort(capture_sock_), 1));
+    sender_->setFec(fec_parity, fec_group);
+
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(receiver_->getServerPort());
+    ASSERT_EQ(::connect(inject_sock_, (sockaddr*)&addr, sizeof(addr)), 0);
+  }
+
+  /// Send message, returning the datagrams it went out as, in the order they were sent
+  V_string send(const std::string& message)
+  {
+    V_string datagrams;
+    int32_t sent = sender_->write((uint8_t*)message.data(), message.size());
+    EXPECT_EQ(sent, (int32_t)message.size());
+
+    // Loopback delivers synchronously, so everything sent is already waiting
+    char buf[65536];
+    ssize_t size;
+    while ((size = recv(capture_sock_, buf, sizeof(buf), MSG_DONTWAIT)) > 0)
+    {
+      datagrams.push_back(std::string(buf, size));
+    }
+    return datagrams;
+  }
+
+  void inject(const std::string& datagram)
+  {
+    ASSERT_EQ(::send(inject_sock_, datagram.data(), datagram.size(), 0), (ssize_t)datagram.size());
+  }
+
+  void inject(const V_string& datagrams)
+  {
+    for (size_t i = 0; i < datagrams.size(); ++i)
+    {
+      inject(datagrams[i]);
+    }
+  }
+
+  /// Read the next message, assumed to be size bytes long; empty if none is ready
+  std::string read(uint32_t size)
+  {
+    std::vector<uint8_t> buf(size);
+    int32_t bytes = receiver_->read(&buf[0], size);
+    EXPECT_GE(bytes, 0);
+    if (bytes <= 0)
+    {
+      return std::string();
+    }
+    return std::string((const char*)&buf[0], bytes);
+  }
+
+  /// Drop the datagrams at the given indexes (into the order they were sent in) and shuffle the rest
+  static V_string lose(const V_string& datagrams, const std::vector<size_t>& lost, uint32_t seed)
+  {
+    V_string kept;
+    for (size_t i = 0; i < datagrams.size(); ++i)
+    {
+      if (std::find(lost.begin(), lost.end(), i) == lost.end())
+      {
+        kept.push_back(datagrams[i]);
+      }
+    }
+
+    std::mt19937 gen(seed);
+    std::shuffle(kept.begin(), kept.end(), gen);
+    return kept;
+  }
+
+  static std::string makeMessage(uint32_t size, uint32_t seed)
+  {
+    std::mt19937 gen(seed);
+    std::string message(size, 0);
+    for (uint32_t i = 0; i < size; ++i)
+    {
+      message[i] = (char)gen();
+    }
+    return message;
+  }
+
+  PollSet poll_set_;
+  TransportUDPPtr sender_;
+  TransportUDPPtr receiver_;
+  int capture_sock_;
+  int inject_sock_;
+};
+
+TEST_F(Fragments, shuffled)
+{
+  connect(64);
+
+  for (uint32_t seed = 0; seed < 20; ++seed)
+  {
+    std::string message = makeMessage(1000, seed);
+    V_string datagrams = send(message);
+    ASSERT_EQ(datagrams.size(), 18U);
+
+    std::mt19937 gen(seed);
+    std::shuffle(datagrams.begin(), datagrams.end(), gen);
+    inject(datagrams);
+
+    ASSERT_EQ(read(message.size()), message);
+    ASSERT_EQ(read(1), "");
+  }
+}
+
+TEST_F(Fragments, interleaved)
+{
+  connect(64);
+
+  std::string messages[3] = { makeMessage(500, 1), makeMessage(600, 2), makeMessage(700, 3) };
+  V_string datagrams[3];
+  for (int m = 0; m < 3; ++m)
+  {
+    datagrams[m] = send(messages[m]);
+    std::mt19937 gen(m);
+    std::shuffle(datagrams[m].begin(), datagrams[m].end(), gen);
+  }
+
+  // Round-robin between the messages; the shortest, oldest one completes first, so they stay in order
+  for (size_t i = 0; i < datagrams[2].size(); ++i)
+  {
+    for (int m = 0; m < 3; ++m)
+    {
+      if (i < datagrams[m].size())
+      {
+        inject(datagrams[m][i]);
+      }
+    }
+  }
+
+  for (int m = 0; m < 3; ++m)
+  {
+    ASSERT_EQ(read(messages[m].size()), messages[m]);
+  }
+  ASSERT_EQ(read(1), "");
+}
+
+TEST_F(Fragments, tooManyPartialMessages)
+{
+  connect(64);
+
+  // Nine messages, each missing its last fragment: the ninth pushes the first out of the reassembly table
+  std::string messages[9];
+  std::string last[9];
+  for (int m = 0; m < 9; ++m)
+  {
+    messages[m] = makeMessage(300, m);
+    V_string datagrams = send(messages[m]);
+    last[m] = datagrams.back();
+    datagrams.pop_back();
+    inject(datagrams);
+  }
+  ASSERT_EQ(read(1), "");
+
+  // The first message starts over with just its last fragment, so it can't be completed
+  inject(last[0]);
+  ASSERT_EQ(read(messages[0].size()), "");
+
+  // Which in turn pushed out the second; the rest are still there
+  for (int m = 2; m < 9; ++m)
+  {
+    inject(last[m]);
+    ASSERT_EQ(read(messages[m].size()), messages[m]);
+  }
+  inject(last[1]);
+  ASSERT_EQ(read(1), "");
+}
+
+TEST_F(Fragments, overtaken)
+{
+  connect(64);
+
+  std::string old_message = makeMessage(300, 1);
+  V_string old_datagrams = send(old_message);
+  std::string old_last = old_datagrams.back();
+  old_datagrams.pop_back();
+  inject(old_datagrams);
+
+  std::string new_message = makeMessage(300, 2);
+  inject(send(new_message));
+  ASSERT_EQ(read(new_message.size()), new_message);
+
+  // Delivering it now would put it out of order
+  inject(old_last);
+  ASSERT_EQ(read(1), "");
+
+  // A whole message that arrives after a newer one is dropped as well
+  std::string late_message = makeMessage(300, 3);
+  V_string late_datagrams = send(late_message);
+  std::string newest_message = makeMessage(300, 4);
+  inject(send(newest_message));
+  inject(late_datagrams);
+  ASSERT_EQ(read(newest_message.size()), newest_message);
+  ASSERT_EQ(read(1), "");
+
+  // Newer messages keep coming through, including once their ids wrap around past the dropped ones
+  for (int i = 0; i < 300; ++i)
+  {
+    std::string message = makeMessage(100 + i % 7, i);
+    inject(send(message));
+    ASSERT_EQ(read(message.size()), message);
+  }
+}
+
+// With error correction on, data fragments carry 64 - 8 (header) - 4 (parity sub-header) = 52 bytes, so a 1000 byte
+// message goes out as 20 data fragments (the last one short) followed by its parity fragments
+TEST_F(Fragments, recoverLostFragments)
+{
+  connect(64, 3, 64);
+
+  // Up to 3 losses in the one group: the first fragment (which says how many there are), the short last one, parity
+  // fragments, and everything in between
+  size_t cases[][3] = { {0, 0, 0}, {19, 19, 19}, {0, 19, 19}, {0, 1, 2}, {17, 18, 19}, {5, 11, 19},
+                        {0, 20, 21}, {19, 22, 22}, {7, 8, 21}, {20, 21, 22} };
+  uint32_t seed = 0;
+  for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); ++c, ++seed)
+  {
+    std::string message = makeMessage(1000, seed);
+    V_string datagrams = send(message);
+    ASSERT_EQ(datagrams.size(), 23U);
+
+    inject(lose(datagrams, std::vector<size_t>(cases[c], cases[c] + 3), seed));
+    ASSERT_EQ(read(message.size()), message) << "lost " << cases[c][0] << ", " << cases[c][1] << ", " << cases[c][2];
+    ASSERT_EQ(read(1), "");
+  }
+
+  // And any 3 at random
+  for (int i = 0; i < 50; ++i, ++seed)
+  {
+    std::string message = makeMessage(1000 - i, seed);
+    V_string datagrams = send(message);
+
+    std::vector<size_t> lost;
+    for (size_t d = 0; d < datagrams.size(); ++d)
+    {
+      lost.push_back(d);
+    }
+    std::mt19937 gen(seed);
+    std::shuffle(lost.begin(), lost.end(), gen);
+    lost.resize(3);
+
+    inject(lose(datagrams, lost, seed));
+    ASSERT_EQ(read(message.size()), message) << "lost " << lost[0] << ", " << lost[1] << ", " << lost[2];
+  }
+}
+
+TEST_F(Fragments, recoverLostFragmentsInEveryGroup)
+{
+  // 20 data fragments dealt round-robin into 3 groups (fragment N is in group N % 3), each with 2 parity fragments
+  connect(64, 2, 8);
+
+  size_t cases[][6] = { {0, 3, 1, 4, 2, 5}, {10, 11, 12, 13, 14, 15}, {14, 15, 16, 17, 18, 19}, {0, 19, 20, 22, 24, 24} };
+  for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); ++c)
+  {
+    std::string message = makeMessage(1000, c);
+    V_string datagrams = send(message);
+    ASSERT_EQ(datagrams.size(), 26U);
+
+    inject(lose(datagrams, std::vector<size_t>(cases[c], cases[c] + 6), c));
+    ASSERT_EQ(read(message.size()), message) << "case " << c;
+  }
+}
+
+TEST_F(Fragments, tooManyLostFragments)
+{
+  connect(64, 2, 64);
+
+  // More losses than parity fragments, counting lost parity fragments too
+  size_t cases[][3] = { {0, 1, 2}, {3, 10, 19}, {5, 6, 20}, {0, 20, 21} };
+  for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); ++c)
+  {
+    std::string message = makeMessage(1000, c);
+    V_string datagrams = send(message);
+    ASSERT_EQ(datagrams.size(), 22U);
+
+    inject(lose(datagrams, std::vector<size_t>(cases[c], cases[c] + 3), c));
+    ASSERT_EQ(read(1), "") << "case " << c;
+  }
+
+  // The transport carries on with the next message
+  std::string message = makeMessage(1000, 100);
+  size_t lost[] = { 4, 9 };
+  inject(lose(send(message), std::vector<size_t>(lost, lost + 2), 100));
+  ASSERT_EQ(read(message.size()), message);
+}
+
+TEST_F(Fragments, blockBeyondLargestMessage)
+{
+  // 1500 byte datagrams carry 1492 bytes each, so no message up to 16 MB has a fragment numbered past 11244
+  connect(1500);
+
+  // A full reassembly table, each message missing its last fragment
+  std::string messages[8];
+  std::string last[8];
+  TransportUDPHeader header;
+  for (int m = 0; m < 8; ++m)
+  {
+    messages[m] = makeMessage(3000, m);
+    V_string datagrams = send(messages[m]);
+    ASSERT_EQ(datagrams.size(), 3U);
+    last[m] = datagrams.back();
+    datagrams.pop_back();
+    inject(datagrams);
+    memcpy(&header, datagrams[0].data(), sizeof(header));
+  }
+
+  // Fragments of a message that would be too large are dropped, rather than getting room for the whole message and
+  // pushing the oldest partial message out
+  header.op_ = ROS_UDP_DATAN;
+  header.message_id_ = 100;
+  header.block_ = 60000;
+  inject(std::string((const char*)&header, sizeof(header)) + makeMessage(100, 100));
+  header.op_ = ROS_UDP_DATA0;
+  header.message_id_ = 101;
+  header.block_ = 11246;
+  inject(std::string((const char*)&header, sizeof(header)) + makeMessage(1492, 101));
+
+  for (int m = 0; m < 8; ++m)
+  {
+    inject(last[m]);
+    ASSERT_EQ(read(messages[m].size()), messages[m]);
+  }
+  ASSERT_EQ(read(1), "");
+}
+
+TEST_F(Fragments, messageLargerThanLargest)
+{
+  connect(1500);
+
+  // Too large to be reassembled, so it isn't sent at all; it still counts as written so the connection moves on
+  std::string huge(16 * 1024 * 1024 + 1, 'x');
+  ASSERT_TRUE(send(huge).empty());
+
+  std::string message = makeMessage(3000, 0);
+  inject(send(message));
+  ASSERT_EQ(read(message.size()), message);
+}
+
+TEST_F(Fragments, writeFailureClosesTransport)
+{
+  // Datagrams beyond the largest UDP payload make the send fail, which closes the transport
+  connect(70000);
+
+  std::string message = makeMessage(66000, 0);
+  ASSERT_EQ(sender_->write((uint8_t*)message.data(), message.size()), -1);
+  ASSERT_EQ(sender_->write((uint8_t*)message.data(), message.size()), -1);
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+
+  return RUN_ALL_TESTS();
+}
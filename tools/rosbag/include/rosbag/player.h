@@ -94,6 +94,8 @@ struct ROSBAG_DECL PlayerOptions
     bool     wait_for_subscribers;
     std::string rate_control_topic;
     float    rate_control_max_delay;
+    uint32_t decompression_threads;
+    bool     memory_mapped;
     ros::Duration skip_empty;
 
     std::vector<std::string> bags;
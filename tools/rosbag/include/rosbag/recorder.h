@@ -100,6 +100,8 @@ struct ROSBAG_DECL RecorderOptions
     bool            snapshot;
     bool            verbose;
     CompressionType compression;
+    uint32_t        compression_threads;
+    bool            async_write;
     std::string     prefix;
     std::string     name;
     boost::regex    exclude_regex;
@@ -65,6 +65,8 @@ rosbag::PlayerOptions parseOptions(int argc, char** argv) {
       ("wait-for-subscribers", "wait for at least one subscriber on each topic before publishing")
       ("rate-control-topic", po::value<std::string>(), "watch the given topic, and if the last publish was more than <rate-control-max-delay> ago, wait until the topic publishes again to continue playback")
       ("rate-control-max-delay", po::value<float>()->default_value(1.0f), "maximum time difference from <rate-control-topic> before pausing")
+      ("decompression-threads", po::value<int>()->default_value(0), "decompress upcoming chunks on N background threads (Default: 0, decompress inline)")
+      ("mmap", "read uncompressed chunks through a memory mapping of the bag files")
       ;
 
     po::positional_options_description p;
@@ -149,6 +151,17 @@ rosbag::PlayerOptions parseOptions(int argc, char** argv) {
     if (vm.count("rate-control-max-delay"))
       opts.rate_control_max_delay = vm["rate-control-max-delay"].as<float>();
 
+    if (vm.count("decompression-threads"))
+    {
+      int threads = vm["decompression-threads"].as<int>();
+      if (threads < 0)
+        throw ros::Exception("Number of decompression threads must be 0 or positive");
+      opts.decompression_threads = threads;
+    }
+
+    if (vm.count("mmap"))
+      opts.memory_mapped = true;
+
     if (vm.count("bags"))
     {
       std::vector<std::string> bags = vm["bags"].as< std::vector<std::string> >();
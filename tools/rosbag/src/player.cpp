@@ -90,6 +90,8 @@ PlayerOptions::PlayerOptions() :
     wait_for_subscribers(false),
     rate_control_topic(""),
     rate_control_max_delay(1.0f),
+    decompression_threads(0),
+    memory_mapped(false),
     skip_empty(ros::DURATION_MAX)
 {
 }
@@ -136,6 +138,8 @@ void Player::publish() {
         {
             shared_ptr<Bag> bag(boost::make_shared<Bag>());
             bag->open(filename, bagmode::Read);//以read方式打开
+            bag->setDecompressionThreads(options_.decompression_threads);
+            bag->setMemoryMapped(options_.memory_mapped);
             bags_.push_back(bag);
         }
         catch (BagUnindexedException ex) {
@@ -61,6 +61,8 @@ rosbag::RecorderOptions parseOptions(int argc, char** argv) {
       ("min-space,L", po::value<std::string>()->default_value("1G"), "Minimum allowed space on recording device (use G,M,k multipliers)")
       ("bz2,j", "use BZ2 compression")
       ("lz4", "use LZ4 compression")
+      ("compression-threads", po::value<int>()->default_value(0), "Compress chunks on N background threads (Default: 0, compress inline)")
+      ("async-write", "Write chunks with asynchronous, direct I/O (io_uring or a writer thread)")
       ("split", po::value<int>()->implicit_value(0), "Split the bag file and continue recording when maximum size or maximum duration reached.")
       ("max-splits", po::value<int>(), "Keep a maximum of N bag files, when reaching the maximum erase the oldest one to keep a constant number of files.")
       ("topic", po::value< std::vector<std::string> >(), "topic to record")
@@ -197,6 +199,17 @@ rosbag::RecorderOptions parseOptions(int argc, char** argv) {
     {
       opts.compression = rosbag::compression::LZ4;
     }
+    if (vm.count("compression-threads"))
+    {
+      int threads = vm["compression-threads"].as<int>();
+      if (threads < 0)
+        throw ros::Exception("Number of compression threads must be 0 or positive");
+      opts.compression_threads = threads;
+    }
+    if (vm.count("async-write"))
+    {
+      opts.async_write = true;
+    }
     if (vm.count("duration"))
     {
       std::string duration_str = vm["duration"].as<std::string>();
@@ -100,6 +100,8 @@ RecorderOptions::RecorderOptions() :
     snapshot(false),
     verbose(false),
     compression(compression::Uncompressed),
+    compression_threads(0),
+    async_write(false),
     prefix(""),
     name(""),
     exclude_regex(),
@@ -387,6 +389,8 @@ void Recorder::snapshotTrigger(std_msgs::Empty::ConstPtr trigger) {
 
 void Recorder::startWriting() {
     bag_.setCompression(options_.compression);//压缩模式
+    bag_.setCompressionThreads(options_.compression_threads);
+    bag_.setAsyncWrite(options_.async_write);
     bag_.setChunkThreshold(options_.chunk_size);//chunksize上限
 
     updateFilenames();//构造文件名称
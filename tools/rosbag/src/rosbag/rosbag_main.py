@@ -93,6 +93,8 @@ def record_cmd(argv):
     parser.add_option(      "--node",          dest="node",          default=None,  type='string',action="store", help="record all topics subscribed to by a specific node")
     parser.add_option("-j", "--bz2",           dest="compression",   default=None,  action="store_const", const='bz2', help="use BZ2 compression")
     parser.add_option("--lz4",                 dest="compression",                  action="store_const", const='lz4', help="use LZ4 compression")
+    parser.add_option("--compression-threads", dest="compression_threads", default=0, type='int', action="store", help="compress chunks on N background threads (Default: %default, compress inline)", metavar="N")
+    parser.add_option("--async-write",         dest="async_write",   default=False, action="store_true", help="write chunks with asynchronous, direct I/O (io_uring or a writer thread)")
     parser.add_option("--tcpnodelay",          dest="tcpnodelay",                   action="store_true",          help="Use the TCP_NODELAY transport hint when subscribing to topics.")
     parser.add_option("--udp",                 dest="udp",                          action="store_true",          help="Use the UDP transport hint when subscribing to topics.")
 
@@ -120,6 +122,8 @@ def record_cmd(argv):
     if options.all:           cmd.extend(["--all"])
     if options.regex:         cmd.extend(["--regex"])
     if options.compression:   cmd.extend(["--%s" % options.compression])
+    if options.compression_threads: cmd.extend(["--compression-threads", str(options.compression_threads)])
+    if options.async_write:   cmd.extend(["--async-write"])
     if options.split:
         if not options.duration and not options.size:
             parser.error("Split specified without giving a maximum duration or size")
@@ -233,6 +237,8 @@ def play_cmd(argv):
     parser.add_option("--wait-for-subscribers",  dest="wait_for_subscribers", default=False, action="store_true", help="wait for at least one subscriber on each topic before publishing")
     parser.add_option("--rate-control-topic", dest="rate_control_topic", default='', type='str', help="watch the given topic, and if the last publish was more than <rate-control-max-delay> ago, wait until the topic publishes again to continue playback")
     parser.add_option("--rate-control-max-delay", dest="rate_control_max_delay", default=1.0, type='float', help="maximum time difference from <rate-control-topic> before pausing")
+    parser.add_option("--mmap", dest="mmap", default=False, action="store_true", help="read uncompressed chunks through a memory mapping of the bag files")
+    parser.add_option("--decompression-threads", dest="decompression_threads", default=0, type='int', help="decompress upcoming chunks on N background threads (Default: %default, decompress inline)", metavar="N")
 
     (options, args) = parser.parse_args(argv)
 
@@ -257,6 +263,7 @@ def play_cmd(argv):
     if options.keep_alive: cmd.extend(["--keep-alive"])
     if options.try_future: cmd.extend(["--try-future-version"])
     if options.wait_for_subscribers: cmd.extend(["--wait-for-subscribers"])
+    if options.mmap:       cmd.extend(["--mmap"])
 
     if options.clock:
         cmd.extend(["--clock", "--hz", str(options.freq)])
@@ -287,6 +294,8 @@ def play_cmd(argv):
 
     if options.rate_control_max_delay:
         cmd.extend(['--rate-control-max-delay', str(options.rate_control_max_delay)])
+    if options.decompression_threads:
+        cmd.extend(['--decompression-threads', str(options.decompression_threads)])
 
     old_handler = signal.signal(
         signal.SIGTERM,
@@ -38,6 +38,9 @@
 #include "rosbag/macros.h"
 
 #include "rosbag/buffer.h"
+#include "rosbag/chunk_cache.h"
+#include "rosbag/chunk_compressor.h"
+#include "rosbag/chunk_writer.h"
 #include "rosbag/chunked_file.h"
 #include "rosbag/constants.h"
 #include "rosbag/encryptor.h"
@@ -57,6 +60,7 @@
 #include <queue>
 #include <set>
 #include <stdexcept>
+#include <vector>
 
 #include <boost/config.hpp>
 #include <boost/format.hpp>
@@ -146,6 +150,54 @@ public:
     void            setChunkThreshold(uint32_t chunk_threshold);  //!< Set the threshold for creating new chunks
     uint32_t        getChunkThreshold() const;                    //!< Get the threshold for creating new chunks
 
+    //! Set the number of threads used to compress chunks in the background
+    /*!
+     * \param threads Number of compression worker threads; 0 (the default) compresses inline in write()
+     *
+     * With threads > 0 and compression enabled, each finished chunk is handed to a pool of workers and written
+     * to the file, in order, by later calls to write() or by close().  The file format is unchanged.  Messages
+     * in chunks that haven't been written out yet are not visible to a View on this bag.
+     */
+    void            setCompressionThreads(uint32_t threads);
+    uint32_t        getCompressionThreads() const;                //!< Get the number of background compression threads
+
+    //! Write chunks with asynchronous, direct I/O
+    /*!
+     * \param async_write true to hand finished chunks to a ChunkWriter instead of streaming them through stdio
+     *
+     * Each chunk is assembled in memory and written in one go, header first and followed by its index records,
+     * through io_uring (or a writer thread) and O_DIRECT where available, so write() doesn't block on the disk.
+     * Combine with setCompressionThreads() to also compress off the calling thread.  As with background
+     * compression, messages in the chunk being assembled are not visible to a View on this bag until the chunk
+     * is finished.  Encrypted bags keep writing through stdio.  Not supported on Windows.
+     */
+    void            setAsyncWrite(bool async_write);
+    bool            getAsyncWrite() const;                        //!< Get whether chunks are written asynchronously
+
+    //! Set the number of threads used to decompress chunks ahead of reading
+    /*!
+     * \param threads Number of decompression worker threads; 0 (the default) decompresses each chunk when it's read
+     *
+     * With threads > 0, iterating a View reads the next getReadAheadChunks() chunks the View will visit and
+     * decompresses them in the background, keeping the most recently used chunks in memory.
+     */
+    void            setDecompressionThreads(uint32_t threads);
+    uint32_t        getDecompressionThreads() const;              //!< Get the number of background decompression threads
+    void            setReadAheadChunks(uint32_t chunks);          //!< Set how many chunks to decompress ahead of the one being read
+    uint32_t        getReadAheadChunks() const;                   //!< Get how many chunks to decompress ahead of the one being read
+
+    //! Read uncompressed chunks straight from a memory mapping of the file
+    /*!
+     * \param mapped true to map bags opened for reading (applies immediately if the bag is already open)
+     *
+     * Messages in uncompressed chunks are then deserialized in place from the mapped pages instead of being
+     * copied out of the file first, and iterating a View asks the kernel to page in the next
+     * getReadAheadChunks() chunks.  Compressed and encrypted chunks are read as usual.  Falls back to
+     * regular reads if the file can't be mapped.
+     */
+    void            setMemoryMapped(bool mapped);
+    bool            isMemoryMapped() const;                       //!< Return true if the open bag is being read through a mapping
+
     //! Set encryptor of the bag file
     //设置加密机
     /*!
@@ -236,6 +288,13 @@ private:
     void startReadingVersion102();
     void startReadingVersion200();
 
+    // Indexes
+
+    bool isIndexingMessages() const;
+    static void insertIndexEntry(std::vector<IndexEntry>& index, IndexEntry const& entry);
+    static void mergeIndexEntries(std::vector<IndexEntry>& index, std::vector<IndexEntry> const& entries, uint64_t chunk_pos);
+    static void sortIndexes(std::map<uint32_t, std::vector<IndexEntry> >& indexes);
+
     // Writing
     
     void writeVersion();
@@ -244,12 +303,22 @@ private:
     void appendConnectionRecordToBuffer(Buffer& buf, ConnectionInfo const* connection_info);
     template<class T>
     void writeMessageDataRecord(uint32_t conn_id, ros::Time const& time, T const& msg);
-    void writeIndexRecords();
+    void writeIndexRecords(std::map<uint32_t, std::vector<IndexEntry> > const& indexes);
+    void appendIndexRecordsToBuffer(Buffer& buf, std::map<uint32_t, std::vector<IndexEntry> > const& indexes);
     void writeConnectionRecords();
     void writeChunkInfoRecords();
     void startWritingChunk(ros::Time time);
     void writeChunkHeader(CompressionType compression, uint32_t compressed_size, uint32_t uncompressed_size);
+    void appendChunkHeaderToBuffer(Buffer& buf, CompressionType compression, uint32_t compressed_size, uint32_t uncompressed_size);
     void stopWritingChunk();
+    bool isAssemblingChunks() const;
+    bool isCompressingInBackground() const;
+    bool isWritingAsync() const;
+    void queueAssembledChunk();
+    void writeCompressedChunks(size_t max_pending);
+    void writeCompressedChunk(OutgoingChunk& chunk);
+    void startChunkWriter();
+    void stopChunkWriter();
 
     // Reading
 
@@ -257,6 +326,7 @@ private:
     void readFileHeaderRecord();
     void readConnectionRecord();
     void readChunkHeader(ChunkHeader& chunk_header) const;
+    void parseChunkHeader(ros::Header& header, ChunkHeader& chunk_header) const;
     void readChunkInfoRecord();
     void readConnectionIndexRecord200();
 
@@ -274,6 +344,12 @@ private:
     void     decompressRawChunk(ChunkHeader const& chunk_header) const;
     void     decompressBz2Chunk(ChunkHeader const& chunk_header) const;
     void     decompressLz4Chunk(ChunkHeader const& chunk_header) const;
+    bool     isReadingAhead() const;
+    void     prefetchChunks(std::vector<uint64_t> const& chunk_positions) const;
+    CachedChunkPtr readCachedChunk(uint64_t chunk_pos) const;
+    void     mapFile();
+    uint64_t readMappedChunkHeader(uint64_t chunk_pos, ChunkHeader& chunk_header) const;
+    bool     mapChunk(uint64_t chunk_pos) const;
     uint32_t getChunkOffset() const;
 
     // Record header I/O
@@ -340,8 +416,8 @@ private:
 
     std::vector<ChunkInfo>                         chunks_;
 
-    std::map<uint32_t, std::multiset<IndexEntry> > connection_indexes_;//由connectionid索引这个消息
-    std::map<uint32_t, std::multiset<IndexEntry> > curr_chunk_connection_indexes_;
+    std::map<uint32_t, std::vector<IndexEntry> >   connection_indexes_;//由connectionid索引这个消息，按时间排序
+    std::map<uint32_t, std::vector<IndexEntry> >   curr_chunk_connection_indexes_;  //!< in the order written; sorted when the chunk is stopped
 
     mutable Buffer   header_buffer_;           //!< reusable buffer in which to assemble the record header before writing to file
     mutable Buffer   record_buffer_;           //!< reusable buffer in which to assemble the record data before writing to file
@@ -355,6 +431,22 @@ private:
 
     mutable uint64_t decompressed_chunk_;      //!< position of decompressed chunk
 
+    uint32_t                            compression_threads_;
+    boost::shared_ptr<ChunkCompressor>  chunk_compressor_;   //!< background compression workers, if compression_threads_ > 0
+
+    bool                                async_write_;
+    boost::shared_ptr<ChunkWriter>      chunk_writer_;       //!< writes assembled chunks, once the first one is finished
+
+    uint32_t                            decompression_threads_;
+    uint32_t                            read_ahead_chunks_;
+    boost::shared_ptr<ChunkCache>       chunk_cache_;        //!< decompressed chunks, if decompression_threads_ > 0
+    mutable CachedChunkPtr              current_chunk_;      //!< cached chunk current_buffer_ points into
+
+    bool             memory_mapped_;           //!< map the file when it's opened for reading
+    mutable Buffer   mapped_buffer_;           //!< points at the data of an uncompressed chunk in the mapping
+    mutable uint64_t mapped_chunk_;            //!< position of the chunk mapped_buffer_ points at
+    bool             encrypted_;               //!< chunks are encrypted, so can't be used straight from the mapping
+
     // Encryptor plugin loader
     pluginlib::ClassLoader<rosbag::EncryptorBase> encryptor_loader_;
     // Active encryptor
@@ -603,7 +695,8 @@ void Bag::doWrite(std::string const& topic, ros::Time const& time, T const& msg,
             connections_[conn_id] = connection_info;//添加查找索引
             // No need to encrypt connection records in chunks
             //连接信息写入chunkdata，但是只是在第一次接收到这条消息的时候，但是为什么这么做呢？
-            writeConnectionRecord(connection_info, false);
+            if (!isAssemblingChunks())
+                writeConnectionRecord(connection_info, false);
             appendConnectionRecordToBuffer(outgoing_chunk_buffer_, connection_info);
         }
 
@@ -614,12 +707,12 @@ void Bag::doWrite(std::string const& topic, ros::Time const& time, T const& msg,
         index_entry.chunk_pos = curr_chunk_info_.pos;//当前消息所在的chunk位置的偏移
         index_entry.offset    = getChunkOffset();//当前消息所在chunk中的相对偏移
 		//按照连接的id将消息的索引进行收集，最后写入文件的最后
-        std::multiset<IndexEntry>& chunk_connection_index = curr_chunk_connection_indexes_[connection_info->id];
-        //将数据按照connection_info的id来存储，存储使用set，重载的<号可以自动排序
-        chunk_connection_index.insert(chunk_connection_index.end(), index_entry);
+        //将数据按照connection_info的id来存储，chunk结束时再按时间排序
+        curr_chunk_connection_indexes_[connection_info->id].push_back(index_entry);
 
-        std::multiset<IndexEntry>& connection_index = connection_indexes_[connection_info->id];
-        connection_index.insert(connection_index.end(), index_entry);
+        // Chunks assembled in memory are indexed once their position in the file is known
+        if (!isAssemblingChunks() && isIndexingMessages())
+            insertIndexEntry(connection_indexes_[connection_info->id], index_entry);
 
         // Increment the connection count
         //增加这个在这个chunk中连接数量
@@ -632,14 +725,8 @@ void Bag::doWrite(std::string const& topic, ros::Time const& time, T const& msg,
         // Check if we want to stop this chunk
         uint32_t chunk_size = getChunkOffset();
         CONSOLE_BRIDGE_logDebug("  curr_chunk_size=%d (threshold=%d)", chunk_size, chunk_threshold_);
-        if (chunk_size > chunk_threshold_) {
-            // Empty the outgoing chunk
+        if (chunk_size > chunk_threshold_)
             stopWritingChunk();
-            outgoing_chunk_buffer_.setSize(0);
-
-            // We no longer have a valid curr_chunk_info
-            curr_chunk_info_.pos = -1;
-        }
     }
 }
 
@@ -666,14 +753,17 @@ void Bag::writeMessageDataRecord(uint32_t conn_id, ros::Time const& time, T cons
     // have indirectly moved our file-pointer if it was a
     // MessageInstance for our own bag
     seek(0, std::ios::end);
-    file_size_ = file_.getOffset();
+    file_size_ = chunk_writer_ ? chunk_writer_->getOffset() : file_.getOffset();
 
     CONSOLE_BRIDGE_logDebug("Writing MSG_DATA [%llu:%d]: conn=%d sec=%d nsec=%d data_len=%d",
               (unsigned long long) file_.getOffset(), getChunkOffset(), conn_id, time.sec, time.nsec, msg_ser_len);
 
-    writeHeader(header);//写入头
-    writeDataLength(msg_ser_len);//写入数据长度
-    write((char*) record_buffer_.getData(), msg_ser_len);//写入数据
+    // An assembled chunk only lives in outgoing_chunk_buffer_ until it's compressed and written out
+    if (!isAssemblingChunks()) {
+        writeHeader(header);//写入头
+        writeDataLength(msg_ser_len);//写入数据长度
+        write((char*) record_buffer_.getData(), msg_ser_len);//写入数据
+    }
     
     // todo: use better abstraction than appendHeaderToBuffer
     appendHeaderToBuffer(outgoing_chunk_buffer_, header);
@@ -53,15 +53,20 @@ public:
     void setSize(uint32_t size);
     void swap(Buffer& other);
 
+    //! Point the buffer at memory it doesn't own, e.g. a mapped file.  The next setSize() drops it.
+    void setData(uint8_t* data, uint32_t size);
+
 private:
     Buffer(const Buffer&);
     Buffer& operator=(const Buffer&);
     void ensureCapacity(uint32_t capacity);
+    void release();
 
 private:
     uint8_t* buffer_;
     uint32_t capacity_;
     uint32_t size_;
+    bool     owned_;     //!< false while pointing at memory set with setData()
 };
 
 inline void swap(Buffer& a, Buffer& b) {
@@ -0,0 +1,122 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2008, Willow Garage, Inc.
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of Willow Garage, Inc. nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+********************************************************************/
+
+#ifndef ROSBAG_CHUNK_CACHE_H
+#define ROSBAG_CHUNK_CACHE_H
+
+#include <deque>
+#include <list>
+#include <map>
+#include <stdint.h>
+#include <string>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+#include "rosbag/buffer.h"
+#include "rosbag/macros.h"
+#include "rosbag/stream.h"
+#include "rosbag/structures.h"
+
+namespace rosbag {
+
+//! A chunk read from the file, decompressed by a ChunkCache worker
+struct ROSBAG_STORAGE_DECL CachedChunk
+{
+    CachedChunk() : pos(0), compression(compression::Uncompressed), uncompressed_size(0), done(false) { }
+
+    uint64_t        pos;            //!< absolute byte offset of the chunk record in the bag file
+    CompressionType compression;    //!< compression of the chunk data
+    uint32_t        uncompressed_size;  //!< size of the chunk data once decompressed
+
+    Buffer          compressed;     //!< chunk data as read (and decrypted) from the file
+    Buffer          decompressed;   //!< decompressed chunk data, valid once done is set
+
+    bool            done;           //!< set by the worker once decompressed (or error) is valid
+    std::string     error;          //!< set if decompression failed
+};
+typedef boost::shared_ptr<CachedChunk> CachedChunkPtr;
+
+//! ChunkCache decompresses chunks on a pool of worker threads and keeps the most recently used ones
+/*!
+ * The reader queues chunks it expects to need soon with insert() and picks them up with get(), which
+ * waits for the decompression to finish.  Once more than capacity chunks are cached, the least recently
+ * used finished chunk is dropped.
+ */
+class ROSBAG_STORAGE_DECL ChunkCache
+{
+public:
+    ChunkCache(uint32_t thread_count, uint32_t capacity);
+    ~ChunkCache();
+
+    //! Return true if the chunk at pos is cached or being decompressed
+    bool contains(uint64_t pos) const;
+
+    //! Queue a chunk for decompression and add it to the cache
+    void insert(CachedChunkPtr const& chunk);
+
+    //! Return the chunk at pos, waiting for it to be decompressed, or an empty pointer if it isn't cached
+    CachedChunkPtr get(uint64_t pos);
+
+    uint32_t getThreadCount() const;  //!< number of worker threads
+    uint32_t getCapacity()    const;  //!< number of chunks kept
+
+private:
+    ChunkCache(const ChunkCache&);
+    ChunkCache& operator=(const ChunkCache&);
+
+    void workerThread();
+    void evict();
+
+private:
+    typedef std::list<CachedChunkPtr> L_CachedChunk;
+
+    boost::thread_group          threads_;
+    uint32_t                     thread_count_;
+    uint32_t                     capacity_;
+
+    mutable boost::mutex         mutex_;
+    boost::condition_variable    work_condition_;   //!< signalled when a chunk is queued or on shutdown
+    boost::condition_variable    done_condition_;   //!< signalled when a worker finishes a chunk
+    std::deque<CachedChunkPtr>   work_;             //!< chunks not yet picked up by a worker
+    L_CachedChunk                lru_;              //!< cached chunks, most recently used first
+    std::map<uint64_t, L_CachedChunk::iterator> chunks_;  //!< chunk position -> entry in lru_
+    bool                         shutting_down_;
+};
+
+} // namespace rosbag
+
+#endif
@@ -0,0 +1,118 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2008, Willow Garage, Inc.
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of Willow Garage, Inc. nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+********************************************************************/
+
+#ifndef ROSBAG_CHUNK_COMPRESSOR_H
+#define ROSBAG_CHUNK_COMPRESSOR_H
+
+#include <deque>
+#include <map>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+#include "rosbag/buffer.h"
+#include "rosbag/macros.h"
+#include "rosbag/stream.h"
+#include "rosbag/structures.h"
+
+namespace rosbag {
+
+//! A finished chunk that has been assembled in memory and is waiting to be compressed and written out
+struct ROSBAG_STORAGE_DECL OutgoingChunk
+{
+    OutgoingChunk() : compression(compression::Uncompressed), compressed_size(0), done(false) { }
+
+    CompressionType compression;      //!< compression to apply to the chunk data
+    ChunkInfo       info;             //!< chunk info; pos is filled in when the chunk is written
+    std::map<uint32_t, std::vector<IndexEntry> > connection_indexes;  //!< per-connection index of the chunk
+
+    Buffer          uncompressed;     //!< the chunk's connection and message data records
+    Buffer          compressed;       //!< compressed data, valid once done is set
+    uint32_t        compressed_size;  //!< number of valid bytes in compressed
+
+    bool            done;             //!< set by the worker once compressed (or error) is valid
+    std::string     error;            //!< set if compression failed
+};
+typedef boost::shared_ptr<OutgoingChunk> OutgoingChunkPtr;
+
+//! ChunkCompressor compresses chunks on a pool of worker threads and hands them back in submission order
+/*!
+ * The caller pushes each finished chunk and later pops them to write them to the file.  Compression runs
+ * concurrently, but pop() only ever returns the oldest outstanding chunk, so the order of chunks in the file
+ * matches the order they were written to the bag.
+ */
+class ROSBAG_STORAGE_DECL ChunkCompressor
+{
+public:
+    explicit ChunkCompressor(uint32_t thread_count);
+    ~ChunkCompressor();
+
+    //! Queue a chunk for compression
+    void push(OutgoingChunkPtr const& chunk);
+
+    //! Remove and return the oldest chunk once it's compressed
+    /*!
+     * \param block If true, wait for the oldest chunk to be compressed; otherwise return an empty pointer if it isn't yet
+     */
+    OutgoingChunkPtr pop(bool block);
+
+    uint32_t getThreadCount() const;  //!< number of worker threads
+    size_t   getPendingCount() const; //!< number of chunks pushed but not yet popped
+
+private:
+    ChunkCompressor(const ChunkCompressor&);
+    ChunkCompressor& operator=(const ChunkCompressor&);
+
+    void workerThread();
+
+private:
+    boost::thread_group          threads_;
+    uint32_t                     thread_count_;
+
+    mutable boost::mutex         mutex_;
+    boost::condition_variable    work_condition_;   //!< signalled when a chunk is pushed or on shutdown
+    boost::condition_variable    done_condition_;   //!< signalled when a worker finishes a chunk
+    std::deque<OutgoingChunkPtr> work_;             //!< chunks not yet picked up by a worker
+    std::deque<OutgoingChunkPtr> pending_;          //!< all chunks not yet popped, in submission order
+    bool                         shutting_down_;
+};
+
+} // namespace rosbag
+
+#endif
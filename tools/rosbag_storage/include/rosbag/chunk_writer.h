@@ -0,0 +1,124 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2008, Willow Garage, Inc.
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of Willow Garage, Inc. nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+********************************************************************/
+
+#ifndef ROSBAG_CHUNK_WRITER_H
+#define ROSBAG_CHUNK_WRITER_H
+
+#include <deque>
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+#include "rosbag/macros.h"
+
+namespace rosbag {
+
+//! ChunkWriter appends to the end of a bag file with asynchronous, direct I/O
+/*!
+ * Records are assembled in a block-aligned buffer with write(), and submit() hands the whole blocks
+ * assembled so far to the kernel through io_uring, or to a dedicated pwrite thread where io_uring isn't
+ * available.  The trailing partial block stays in memory and is carried over into the next buffer, so
+ * every write is block-aligned and no block is written twice while writes are in flight.  The file is
+ * opened with O_DIRECT if the file system supports it, keeping recorded data out of the page cache.
+ *
+ * Everything before the starting offset must already be written to the file; nothing else may write past
+ * it until the writer has been sync()ed.
+ */
+class ROSBAG_STORAGE_DECL ChunkWriter
+{
+public:
+    /*!
+     * \param filename    The file to append to
+     * \param offset      Where to start appending
+     * \param max_pending Number of submitted buffers that may be in flight before submit() waits for one
+     */
+    ChunkWriter(std::string const& filename, uint64_t offset, uint32_t max_pending = 4);
+    ~ChunkWriter();
+
+    void     write(void const* data, size_t size);  //!< append data to the buffer being assembled
+    void     submit();                              //!< start writing the whole blocks assembled so far
+    void     sync();                                //!< wait for all writes, then write the trailing partial block
+
+    uint64_t getOffset() const;                     //!< return the file offset just past the appended data
+    bool     isDirect() const;                      //!< return true if the file was opened with O_DIRECT
+    bool     isUsingIoUring() const;                //!< return true if writes go through io_uring
+
+    static bool isSupported();                      //!< return false on platforms without positional writes
+
+    static const size_t BUFFER_ALIGNMENT = 4096;    //!< alignment of buffers, offsets and lengths
+
+private:
+    struct PendingWrite;
+    struct Ring;
+
+    ChunkWriter(const ChunkWriter&);
+    ChunkWriter& operator=(const ChunkWriter&);
+
+    void          reserve(size_t capacity);
+    PendingWrite* takeBuffer(size_t capacity);
+    void          start(PendingWrite* pending);
+    void          waitOldest();
+    size_t        writeBlock() const;            //!< granularity a write may start or resume at
+    void          writeThread();
+
+private:
+    int                         fd_;
+    bool                        direct_;
+    uint32_t                    max_pending_;
+
+    PendingWrite*               current_;        //!< buffer being assembled, starting at a block boundary
+    bool                        synced_;         //!< nothing has been appended since the last sync()
+
+    std::deque<PendingWrite*>   pending_;        //!< submitted writes, in submission order
+    std::vector<PendingWrite*>  free_;           //!< finished writes whose buffers can be reused
+
+    boost::scoped_ptr<Ring>     ring_;           //!< io_uring, if the kernel supports it
+
+    // Fallback writer thread
+    boost::thread               thread_;
+    boost::mutex                mutex_;
+    boost::condition_variable   condition_;
+    std::deque<PendingWrite*>   work_;           //!< writes not yet picked up by the thread
+    bool                        shutting_down_;
+};
+
+} // namespace rosbag
+
+#endif
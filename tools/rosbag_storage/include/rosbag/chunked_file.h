@@ -82,8 +82,17 @@ public:
     bool        truncate(uint64_t length);
     void        seek(uint64_t offset, int origin = std::ios_base::beg); //!< seek to given offset from origin
     void        decompress(CompressionType compression, uint8_t* dest, unsigned int dest_len, uint8_t* source, unsigned int source_len);
+    unsigned int compress(CompressionType compression, uint8_t* dest, unsigned int dest_len, uint8_t* source, unsigned int source_len);
     void        swap(ChunkedFile& other);
 
+    // Memory mapping of files opened for reading
+    bool        map();                                                  //!< map the whole file read-only; returns false if it can't be mapped
+    void        unmap();                                                //!< release the mapping
+    bool        isMapped()             const;                           //!< return true if the file is mapped
+    uint64_t    getMappedSize()        const;                           //!< return the number of bytes mapped
+    uint8_t*    getMappedData(uint64_t offset) const;                   //!< return a pointer to offset in the mapping
+    void        adviseWillNeed(uint64_t offset, uint64_t size) const;   //!< hint that the mapped range will be read soon
+
 private:
     //不可复制、赋值
     ChunkedFile(const ChunkedFile&);
@@ -99,6 +108,8 @@ private:
     uint64_t    compressed_in_;  //!< number of bytes written to current compressed stream，已经写到当前压缩流中的字节数量
     char*       unused_;         //!< extra data read by compressed stream，被压缩流读取的额外数据
     int         nUnused_;        //!< number of bytes of extra data read by compressed stream，被压缩流读取的字节数量
+    uint8_t*    mapped_;         //!< read-only mapping of the whole file, or NULL
+    uint64_t    mapped_size_;    //!< size of the mapping
 
     boost::shared_ptr<StreamFactory> stream_factory_;//流工厂
 
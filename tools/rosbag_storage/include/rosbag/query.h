@@ -109,13 +109,13 @@ struct ROSBAG_STORAGE_DECL BagQuery
 
 struct ROSBAG_STORAGE_DECL MessageRange
 {
-    MessageRange(std::multiset<IndexEntry>::const_iterator const& _begin,
-                 std::multiset<IndexEntry>::const_iterator const& _end,
+    MessageRange(std::vector<IndexEntry>::const_iterator const& _begin,
+                 std::vector<IndexEntry>::const_iterator const& _end,
                  ConnectionInfo const* _connection_info,
                  BagQuery const* _bag_query);
 
-    std::multiset<IndexEntry>::const_iterator begin;//第一个消息
-    std::multiset<IndexEntry>::const_iterator end;//最后一个消息
+    std::vector<IndexEntry>::const_iterator begin;//第一个消息
+    std::vector<IndexEntry>::const_iterator end;//最后一个消息
     ConnectionInfo const* connection_info;
     BagQuery const* bag_query;           //!< pointer to vector of queries in View
 };
@@ -123,9 +123,9 @@ struct ROSBAG_STORAGE_DECL MessageRange
 //! The actual iterator data structure
 struct ROSBAG_STORAGE_DECL ViewIterHelper
 {
-    ViewIterHelper(std::multiset<IndexEntry>::const_iterator _iter, MessageRange const* _range);
+    ViewIterHelper(std::vector<IndexEntry>::const_iterator _iter, MessageRange const* _range);
 
-    std::multiset<IndexEntry>::const_iterator iter;
+    std::vector<IndexEntry>::const_iterator iter;
     MessageRange const* range;  //!< pointer to vector of ranges in View
 };
 
@@ -82,6 +82,16 @@ public:
 
     virtual void decompress(uint8_t* dest, unsigned int dest_len, uint8_t* source, unsigned int source_len) = 0;
 
+    //! Compress source into dest in one shot, without touching the file; returns the compressed size
+    /*!
+     * Only reads the stream's settings, so it's safe to call from several threads at once.
+     * Throws BagException if dest_len is too small (see getCompressBound).
+     */
+    virtual unsigned int compress(uint8_t* dest, unsigned int dest_len, uint8_t* source, unsigned int source_len) = 0;
+
+    //! Upper bound on the compressed size of source_len bytes for any of the supported compressions
+    static unsigned int getCompressBound(unsigned int source_len);
+
     virtual void startWrite();
     virtual void stopWrite();
 
@@ -134,6 +144,7 @@ public:
     void read(void* ptr, size_t size);
 
     void decompress(uint8_t* dest, unsigned int dest_len, uint8_t* source, unsigned int source_len);
+    unsigned int compress(uint8_t* dest, unsigned int dest_len, uint8_t* source, unsigned int source_len);
 };
 
 /*!
@@ -155,6 +166,7 @@ public:
     void stopRead();
 
     void decompress(uint8_t* dest, unsigned int dest_len, uint8_t* source, unsigned int source_len);
+    unsigned int compress(uint8_t* dest, unsigned int dest_len, uint8_t* source, unsigned int source_len);
 
 private:
     int     verbosity_;        //!< level of debugging output (0-4; 0 default). 0 is silent, 4 is max verbose debugging output
@@ -184,6 +196,7 @@ public:
     void stopRead();
 
     void decompress(uint8_t* dest, unsigned int dest_len, uint8_t* source, unsigned int source_len);
+    unsigned int compress(uint8_t* dest, unsigned int dest_len, uint8_t* source, unsigned int source_len);
 
 private:
     LZ4Stream(const LZ4Stream&);
@@ -75,7 +75,7 @@ public:
         friend class boost::iterator_core_access;
 
 		void populate();
-		void populateSeek(std::multiset<IndexEntry>::const_iterator iter);
+		void populateSeek(IndexEntry entry, MessageRange const* range);
 
         bool equal(iterator const& other) const;
 
@@ -83,11 +83,17 @@ public:
 
         MessageInstance& dereference() const;
 
+        void prefetch() const;
+
+        bool isAt(IndexEntry const& entry, MessageRange const* range) const;
+
     private:
         View* view_;
         std::vector<ViewIterHelper> iters_;
+        IndexEntry entry_;  //!< copy of the entry iters_.back() points at, still valid once a write has moved the index
         uint32_t view_revision_;//view版本？
         mutable MessageInstance* message_instance_;
+        mutable uint64_t prefetch_chunk_pos_;  //!< chunk for which the read-ahead was last issued
     };
 
     typedef iterator const_iterator;
@@ -37,6 +37,7 @@
 #endif
 #include <signal.h>
 #include <assert.h>
+#include <algorithm>
 #include <iomanip>
 
 #include <boost/foreach.hpp>
@@ -51,7 +52,6 @@ using std::map;
 using std::priority_queue;
 using std::string;
 using std::vector;
-using std::multiset;
 using boost::format;
 using boost::shared_ptr;
 using ros::M_string;
@@ -103,6 +103,16 @@ void Bag::init() {
     curr_chunk_data_pos_ = 0;
     current_buffer_ = 0;
     decompressed_chunk_ = 0;
+    compression_threads_ = 0;
+    chunk_compressor_.reset();
+    async_write_ = false;
+    chunk_writer_.reset();
+    decompression_threads_ = 0;
+    read_ahead_chunks_ = 4;
+    chunk_cache_.reset();
+    current_chunk_.reset();
+    memory_mapped_ = false;
+    mapped_chunk_ = 0;
     setEncryptorPlugin(std::string("rosbag/NoEncryptor"));
 }
 
@@ -137,6 +147,9 @@ void Bag::openRead(string const& filename) {
     default:
         throw BagException((format("Unsupported bag file version: %1%.%2%") % getMajorVersion() % getMinorVersion()).str());//不能识别版本号抛出异常
     }
+
+    if (memory_mapped_)
+        mapFile();
 }
 
 void Bag::openWrite(string const& filename) {
@@ -203,6 +216,7 @@ uint32_t Bag::getChunkThreshold() const { return chunk_threshold_; }
 void Bag::setChunkThreshold(uint32_t chunk_threshold) {
     if (isOpen() && chunk_open_)
         stopWritingChunk();
+    writeCompressedChunks(0);
 
     chunk_threshold_ = chunk_threshold;
 }
@@ -212,6 +226,7 @@ CompressionType Bag::getCompression() const { return compression_; }
 void Bag::setCompression(CompressionType compression) {
     if (isOpen() && chunk_open_)
         stopWritingChunk();
+    writeCompressedChunks(0);
 
     if (!(compression == compression::Uncompressed ||
           compression == compression::BZ2 ||
@@ -223,12 +238,94 @@ void Bag::setCompression(CompressionType compression) {
     compression_ = compression;
 }
 
+uint32_t Bag::getCompressionThreads() const { return compression_threads_; }
+
+void Bag::setCompressionThreads(uint32_t threads) {
+    if (isOpen() && chunk_open_)
+        stopWritingChunk();
+    writeCompressedChunks(0);
+
+    compression_threads_ = threads;
+    if (compression_threads_ > 0)
+        chunk_compressor_ = boost::make_shared<ChunkCompressor>(compression_threads_);
+    else
+        chunk_compressor_.reset();
+}
+
+bool Bag::getAsyncWrite() const { return async_write_; }
+
+void Bag::setAsyncWrite(bool async_write) {
+    if (async_write && !ChunkWriter::isSupported())
+        throw BagException("Asynchronous writing is not supported on this platform");
+
+    if (isOpen() && chunk_open_)
+        stopWritingChunk();
+    writeCompressedChunks(0);
+    stopChunkWriter();
+
+    async_write_ = async_write;
+}
+
+uint32_t Bag::getDecompressionThreads() const { return decompression_threads_; }
+uint32_t Bag::getReadAheadChunks()      const { return read_ahead_chunks_;     }
+
+void Bag::setDecompressionThreads(uint32_t threads) {
+    decompression_threads_ = threads;
+    current_chunk_.reset();
+    current_buffer_ = 0;
+
+    // Keep the chunk being read and the one before it on top of the read-ahead window
+    if (decompression_threads_ > 0)
+        chunk_cache_ = boost::make_shared<ChunkCache>(decompression_threads_, read_ahead_chunks_ + 2);
+    else
+        chunk_cache_.reset();
+}
+
+void Bag::setReadAheadChunks(uint32_t chunks) {
+    read_ahead_chunks_ = chunks;
+    setDecompressionThreads(decompression_threads_);
+}
+
 void Bag::setEncryptorPlugin(std::string const& plugin_name, std::string const& plugin_param) {
-    if (!chunks_.empty()) {
+    // A chunk being assembled for the async writer has no header in the file yet, so it can't be finished
+    // on the stdio path an encrypted bag switches to
+    if (isOpen() && chunk_open_ && isWritingAsync())
+        stopWritingChunk();
+    writeCompressedChunks(0);
+
+    if (!chunks_.empty() || (chunk_compressor_ && chunk_compressor_->getPendingCount() > 0)) {
         throw BagException("Cannot set encryption plugin after chunks are written");
     }
     encryptor_ = encryptor_loader_.createInstance(plugin_name);
     encryptor_->initialize(*this, plugin_param);
+    encrypted_ = plugin_name != "rosbag/NoEncryptor";
+}
+
+void Bag::setMemoryMapped(bool mapped) {
+    memory_mapped_ = mapped;
+
+    if (!isOpen() || mode_ != bagmode::Read)
+        return;
+
+    if (memory_mapped_)
+        mapFile();
+    else {
+        if (current_buffer_ == &mapped_buffer_)
+            current_buffer_ = 0;
+        mapped_chunk_ = 0;
+        file_.unmap();
+    }
+}
+
+bool Bag::isMemoryMapped() const { return file_.isMapped(); }
+
+void Bag::mapFile() {
+    // Only version 2.0 bags keep messages in chunks that can be read in place
+    if (mode_ != bagmode::Read || version_ != 200 || encrypted_)
+        return;
+
+    if (!file_.map())
+        CONSOLE_BRIDGE_logDebug("Could not map %s, reading it normally", file_.getFileName().c_str());
 }
 
 // Version
@@ -277,6 +374,8 @@ void Bag::startWriting() {
 void Bag::stopWriting() {
     if (chunk_open_)
         stopWritingChunk();//停止当前chunk写入
+    writeCompressedChunks(0);
+    stopChunkWriter();
 
     seek(0, std::ios::end);
 
@@ -308,6 +407,14 @@ void Bag::startReadingVersion200() {
     for (uint32_t i = 0; i < chunk_count_; i++)//chunk_count_从file header中获取,构造chunks_
         readChunkInfoRecord();
 
+    // Size the connection indexes from the chunk infos, so reading them doesn't keep reallocating
+    map<uint32_t, uint32_t> connection_counts;
+    foreach(ChunkInfo const& chunk_info, chunks_)
+        for (map<uint32_t, uint32_t>::const_iterator i = chunk_info.connection_counts.begin(); i != chunk_info.connection_counts.end(); i++)
+            connection_counts[i->first] += i->second;
+    for (map<uint32_t, uint32_t>::const_iterator i = connection_counts.begin(); i != connection_counts.end(); i++)
+        connection_indexes_[i->first].reserve(i->second);
+
     // Read the connection indexes for each chunk
     foreach(ChunkInfo const& chunk_info, chunks_) {
         curr_chunk_info_ = chunk_info;
@@ -326,6 +433,9 @@ void Bag::startReadingVersion200() {
             readConnectionIndexRecord200();
     }
 
+    // Each chunk's entries are in order, but chunks can overlap in time
+    sortIndexes(connection_indexes_);
+
     // At this point we don't have a curr_chunk_info anymore so we reset it
     curr_chunk_info_ = ChunkInfo();
 }
@@ -350,11 +460,12 @@ void Bag::startReadingVersion102() {
     // Read the topic index records, which point to the offsets of each message in the file
     while (file_.getOffset() < filelength)
         readTopicIndexRecord102();
+    sortIndexes(connection_indexes_);
 
     // Read the message definition records (which are the first entry in the topic indexes)
-    for (map<uint32_t, multiset<IndexEntry> >::const_iterator i = connection_indexes_.begin(); i != connection_indexes_.end(); i++) {
-        multiset<IndexEntry> const& index       = i->second;
-        IndexEntry const&           first_entry = *index.begin();
+    for (map<uint32_t, vector<IndexEntry> >::const_iterator i = connection_indexes_.begin(); i != connection_indexes_.end(); i++) {
+        vector<IndexEntry> const& index       = i->second;
+        IndexEntry const&         first_entry = *index.begin();
 
         CONSOLE_BRIDGE_logDebug("Reading message definition for connection %d at %llu", i->first, (unsigned long long) first_entry.chunk_pos);
 
@@ -442,7 +553,9 @@ void Bag::readFileHeaderRecord() {
 }
 
 uint32_t Bag::getChunkOffset() const {
-    if (compression_ == compression::Uncompressed)
+    if (isAssemblingChunks())
+        return outgoing_chunk_buffer_.getSize();
+    else if (compression_ == compression::Uncompressed)
         return file_.getOffset() - curr_chunk_data_pos_;//当前文件偏移量减去当前chunk的起始位置
     else
         return file_.getCompressedBytesIn();
@@ -455,6 +568,13 @@ void Bag::startWritingChunk(Time time) {
     curr_chunk_info_.start_time = time;//chunk的起始时间
     curr_chunk_info_.end_time   = time;//chunk的停止时间
 
+    if (isAssemblingChunks()) {
+        // The chunk is assembled in outgoing_chunk_buffer_; its position isn't known until it's written out
+        curr_chunk_info_.pos = -1;
+        chunk_open_ = true;
+        return;
+    }
+
     // Write the chunk header, with a place-holder for the data sizes (we'll fill in when the chunk is finished)
     //写入chunk头,有占位符，等待chunk完成时写入，注意此时的chunkinfo并没有写入文件
     writeChunkHeader(compression_, 0, 0);
@@ -471,6 +591,17 @@ void Bag::startWritingChunk(Time time) {
 }
 
 void Bag::stopWritingChunk() {
+    // Entries were appended as messages arrived; the index records are written in time order
+    sortIndexes(curr_chunk_connection_indexes_);
+
+    if (isAssemblingChunks()) {
+        queueAssembledChunk();
+        return;
+    }
+
+    // A read since the last write (possible when a setter stops the chunk) may have moved the file pointer
+    seek(0, std::ios::end);
+
     // Add this chunk to the index
     //存储所有的chunks信息
     chunks_.push_back(curr_chunk_info_);
@@ -494,9 +625,14 @@ void Bag::stopWritingChunk() {
     // Write out the indexes and clear them
     //写出该chunk的索引
     seek(end_of_chunk_pos);//回到chunk的最后位置
-    writeIndexRecords();//写入index record
+    writeIndexRecords(curr_chunk_connection_indexes_);//写入index record
     curr_chunk_connection_indexes_.clear();
 
+    // Empty the outgoing chunk; we no longer have a valid curr_chunk_info.  Doing this here rather than
+    // in doWrite() also covers a chunk stopped early by a setter such as setCompression()
+    outgoing_chunk_buffer_.setSize(0);
+    curr_chunk_info_.pos = -1;
+
     // Clear the connection counts
     curr_chunk_info_.connection_counts.clear();
     
@@ -505,7 +641,142 @@ void Bag::stopWritingChunk() {
     chunk_open_ = false;
 }
 
+bool Bag::isAssemblingChunks() const {
+    return isCompressingInBackground() || isWritingAsync();
+}
+
+bool Bag::isCompressingInBackground() const {
+    return chunk_compressor_ && compression_ != compression::Uncompressed;
+}
+
+bool Bag::isWritingAsync() const {
+    // The encryptor works on the chunk in the file, so encrypted bags stay on the stdio path
+    return async_write_ && !encrypted_;
+}
+
+void Bag::queueAssembledChunk() {
+    OutgoingChunkPtr chunk = boost::make_shared<OutgoingChunk>();
+    chunk->compression = compression_;
+    chunk->info = curr_chunk_info_;
+    chunk->connection_indexes.swap(curr_chunk_connection_indexes_);
+    chunk->uncompressed.swap(outgoing_chunk_buffer_);
+
+    curr_chunk_info_.connection_counts.clear();
+    chunk_open_ = false;
+
+    if (!isCompressingInBackground()) {
+        // Writing asynchronously without compression workers: compress here and write the chunk straight away
+        uint32_t uncompressed_size = chunk->uncompressed.getSize();
+        if (chunk->compression == compression::Uncompressed)
+            chunk->compressed_size = uncompressed_size;
+        else {
+            chunk->compressed.setSize(Stream::getCompressBound(uncompressed_size));
+            chunk->compressed_size = file_.compress(chunk->compression, chunk->compressed.getData(), chunk->compressed.getSize(),
+                                                    chunk->uncompressed.getData(), uncompressed_size);
+        }
+        writeCompressedChunk(*chunk);
+        return;
+    }
+
+    chunk_compressor_->push(chunk);
+
+    // Write out whatever has finished; only wait once too many chunks are in flight, so memory stays bounded
+    writeCompressedChunks(2 * chunk_compressor_->getThreadCount());
+}
+
+// Sequencing stage: chunks come back from the compressor in the order they were queued
+void Bag::writeCompressedChunks(size_t max_pending) {
+    if (!chunk_compressor_)
+        return;
+
+    while (true) {
+        OutgoingChunkPtr chunk = chunk_compressor_->pop(chunk_compressor_->getPendingCount() > max_pending);
+        if (!chunk)
+            break;
+        writeCompressedChunk(*chunk);
+    }
+}
+
+void Bag::writeCompressedChunk(OutgoingChunk& chunk) {
+    if (!chunk.error.empty())
+        throw BagIOException("Error compressing chunk: " + chunk.error);
+
+    uint32_t uncompressed_size = chunk.uncompressed.getSize();
+    Buffer&  data = chunk.compression == compression::Uncompressed ? chunk.uncompressed : chunk.compressed;
+
+    if (isWritingAsync()) {
+        startChunkWriter();
+        chunk.info.pos = chunk_writer_->getOffset();
+
+        // The whole record, header first and followed by its index records, goes out in one submission
+        header_buffer_.setSize(0);
+        appendChunkHeaderToBuffer(header_buffer_, chunk.compression, chunk.compressed_size, uncompressed_size);
+        chunk_writer_->write(header_buffer_.getData(), header_buffer_.getSize());
+        chunk_writer_->write(data.getData(), chunk.compressed_size);
+
+        record_buffer_.setSize(0);
+        appendIndexRecordsToBuffer(record_buffer_, chunk.connection_indexes);
+        chunk_writer_->write(record_buffer_.getData(), record_buffer_.getSize());
+
+        chunk_writer_->submit();
+    }
+    else {
+        seek(0, std::ios::end);
+        chunk.info.pos = file_.getOffset();
+
+        writeChunkHeader(chunk.compression, chunk.compressed_size, uncompressed_size);
+
+        uint64_t chunk_data_pos = file_.getOffset();
+        write((char*) data.getData(), chunk.compressed_size);
+
+        // The encryptor rewrites the data in place and may change its size, in which case the header is patched
+        uint32_t compressed_size = encryptor_->encryptChunk(chunk.compressed_size, chunk_data_pos, file_);
+        if (compressed_size != chunk.compressed_size) {
+            uint64_t end_of_chunk_pos = file_.getOffset();
+            seek(chunk.info.pos);
+            writeChunkHeader(chunk.compression, compressed_size, uncompressed_size);
+            seek(end_of_chunk_pos);
+        }
+
+        writeIndexRecords(chunk.connection_indexes);
+    }
+
+    // Now that the chunk has a position, its messages can be indexed
+    if (isIndexingMessages()) {
+        for (map<uint32_t, vector<IndexEntry> >::const_iterator i = chunk.connection_indexes.begin(); i != chunk.connection_indexes.end(); i++)
+            mergeIndexEntries(connection_indexes_[i->first], i->second, chunk.info.pos);
+    }
+
+    chunks_.push_back(chunk.info);
+    file_size_ = chunk_writer_ ? chunk_writer_->getOffset() : file_.getOffset();
+}
+
+void Bag::startChunkWriter() {
+    if (chunk_writer_)
+        return;
+
+    // Take over at the end of what's been written through stdio (seeking flushes it)
+    seek(0, std::ios::end);
+    chunk_writer_ = boost::make_shared<ChunkWriter>(file_.getFileName(), file_.getOffset());
+}
+
+void Bag::stopChunkWriter() {
+    if (!chunk_writer_)
+        return;
+
+    chunk_writer_->sync();
+    chunk_writer_.reset();
+}
+
 void Bag::writeChunkHeader(CompressionType compression, uint32_t compressed_size, uint32_t uncompressed_size) {
+    CONSOLE_BRIDGE_logDebug("Writing CHUNK [%llu]", (unsigned long long) file_.getOffset());
+
+    header_buffer_.setSize(0);
+    appendChunkHeaderToBuffer(header_buffer_, compression, compressed_size, uncompressed_size);
+    write((char*) header_buffer_.getData(), header_buffer_.getSize());
+}
+
+void Bag::appendChunkHeaderToBuffer(Buffer& buf, CompressionType compression, uint32_t compressed_size, uint32_t uncompressed_size) {
     ChunkHeader chunk_header;
     //设置chunk的 信息
     switch (compression) {
@@ -517,23 +788,27 @@ void Bag::writeChunkHeader(CompressionType compression, uint32_t compressed_size
     chunk_header.compressed_size   = compressed_size;//压缩后的大小
     chunk_header.uncompressed_size = uncompressed_size;//未压缩的大小
 
-    CONSOLE_BRIDGE_logDebug("Writing CHUNK [%llu]: compression=%s compressed=%d uncompressed=%d",
-              (unsigned long long) file_.getOffset(), chunk_header.compression.c_str(), chunk_header.compressed_size, chunk_header.uncompressed_size);
+    CONSOLE_BRIDGE_logDebug("CHUNK header: compression=%s compressed=%d uncompressed=%d",
+              chunk_header.compression.c_str(), chunk_header.compressed_size, chunk_header.uncompressed_size);
 	//构造chunk_header的消息，此时的uncompression_size未知
     M_string header;
     header[OP_FIELD_NAME]          = toHeaderString(&OP_CHUNK);
     header[COMPRESSION_FIELD_NAME] = chunk_header.compression;
     header[SIZE_FIELD_NAME]        = toHeaderString(&chunk_header.uncompressed_size);
-    writeHeader(header);//写入header
+    appendHeaderToBuffer(buf, header);//写入header
 
-    writeDataLength(chunk_header.compressed_size);//写入数据长度
+    appendDataLengthToBuffer(buf, chunk_header.compressed_size);//写入数据长度
 }
 
 void Bag::readChunkHeader(ChunkHeader& chunk_header) const {
     ros::Header header;
     if (!readHeader(header) || !readDataLength(chunk_header.compressed_size))
         throw BagFormatException("Error reading CHUNK record");
-        
+
+    parseChunkHeader(header, chunk_header);
+}
+
+void Bag::parseChunkHeader(ros::Header& header, ChunkHeader& chunk_header) const {
     M_string& fields = *header.getValues();
 
     if (!isOp(fields, OP_CHUNK))
@@ -547,10 +822,16 @@ void Bag::readChunkHeader(ChunkHeader& chunk_header) const {
 
 // Index records
 
-void Bag::writeIndexRecords() {
-    for (map<uint32_t, multiset<IndexEntry> >::const_iterator i = curr_chunk_connection_indexes_.begin(); i != curr_chunk_connection_indexes_.end(); i++) {
-        uint32_t                    connection_id = i->first;
-        multiset<IndexEntry> const& index         = i->second;
+void Bag::writeIndexRecords(map<uint32_t, vector<IndexEntry> > const& indexes) {
+    record_buffer_.setSize(0);
+    appendIndexRecordsToBuffer(record_buffer_, indexes);
+    write((char*) record_buffer_.getData(), record_buffer_.getSize());
+}
+
+void Bag::appendIndexRecordsToBuffer(Buffer& buf, map<uint32_t, vector<IndexEntry> > const& indexes) {
+    for (map<uint32_t, vector<IndexEntry> >::const_iterator i = indexes.begin(); i != indexes.end(); i++) {
+        uint32_t                  connection_id = i->first;
+        vector<IndexEntry> const& index         = i->second;
 
         // Write the index record header
 		//写入索引recorder的head，按照连接的id来写入多个index record
@@ -560,24 +841,67 @@ void Bag::writeIndexRecords() {
         header[CONNECTION_FIELD_NAME] = toHeaderString(&connection_id);
         header[VER_FIELD_NAME]        = toHeaderString(&INDEX_VERSION);
         header[COUNT_FIELD_NAME]      = toHeaderString(&index_size);
-        writeHeader(header);
+        appendHeaderToBuffer(buf, header);
 
-        writeDataLength(index_size * 12);//秒、纳秒、
+        appendDataLengthToBuffer(buf, index_size * 12);//秒、纳秒、
 
         CONSOLE_BRIDGE_logDebug("Writing INDEX_DATA: connection=%d ver=%d count=%d", connection_id, INDEX_VERSION, index_size);
 
         // Write the index record data (pairs of timestamp and position in file)
 		//将每个数据都写入数据段
+        uint32_t offset = buf.getSize();
+        buf.setSize(offset + index_size * 12);
         foreach(IndexEntry const& e, index) {
-            write((char*) &e.time.sec,  4);
-            write((char*) &e.time.nsec, 4);
-            write((char*) &e.offset,    4);//在chunk中的偏移吧
+            memcpy(buf.getData() + offset,     &e.time.sec,  4);
+            memcpy(buf.getData() + offset + 4, &e.time.nsec, 4);
+            memcpy(buf.getData() + offset + 8, &e.offset,    4);//在chunk中的偏移吧
+            offset += 12;
 
             CONSOLE_BRIDGE_logDebug("  - %d.%d: %d", e.time.sec, e.time.nsec, e.offset);
         }
     }
 }
 
+bool Bag::isIndexingMessages() const {
+    // Only a View reads the index of the whole bag, so a bag that is only being written doesn't keep one
+    return (mode_ & bagmode::Read) == bagmode::Read;
+}
+
+void Bag::insertIndexEntry(vector<IndexEntry>& index, IndexEntry const& entry) {
+    // Messages nearly always arrive in time order, which makes this an append.  An earlier one goes after
+    // any entries with the same time, so those stay in the order they were written.
+    if (index.empty() || !(entry < index.back()))
+        index.push_back(entry);
+    else
+        index.insert(std::upper_bound(index.begin(), index.end(), entry), entry);
+}
+
+void Bag::mergeIndexEntries(vector<IndexEntry>& index, vector<IndexEntry> const& entries, uint64_t chunk_pos) {
+    size_t chunk_start = index.size();
+    index.insert(index.end(), entries.begin(), entries.end());
+    for (size_t i = chunk_start; i < index.size(); i++)
+        index[i].chunk_pos = chunk_pos;
+
+    // entries is sorted, so only a chunk that starts before the end of the index needs merging
+    if (chunk_start > 0 && chunk_start < index.size() && index[chunk_start] < index[chunk_start - 1])
+        std::inplace_merge(index.begin(), index.begin() + chunk_start, index.end());
+}
+
+void Bag::sortIndexes(map<uint32_t, vector<IndexEntry> >& indexes) {
+    for (map<uint32_t, vector<IndexEntry> >::iterator i = indexes.begin(); i != indexes.end(); i++) {
+        vector<IndexEntry>& index = i->second;
+
+        // Indexes are built from runs that are almost always in order already, so check before sorting.
+        // The sort is stable so entries with the same time stay in the order they were written.
+        for (size_t j = 1; j < index.size(); j++) {
+            if (index[j] < index[j - 1]) {
+                std::stable_sort(index.begin(), index.end());
+                break;
+            }
+        }
+    }
+}
+
 void Bag::readTopicIndexRecord102() {
     ros::Header header;
     uint32_t data_size;
@@ -616,7 +940,8 @@ void Bag::readTopicIndexRecord102() {
     else
     	connection_id = topic_conn_id_iter->second;
 
-    multiset<IndexEntry>& connection_index = connection_indexes_[connection_id];
+    vector<IndexEntry>& connection_index = connection_indexes_[connection_id];
+    connection_index.reserve(connection_index.size() + count);
 
     for (uint32_t i = 0; i < count; i++) {
         IndexEntry index_entry;
@@ -635,7 +960,7 @@ void Bag::readTopicIndexRecord102() {
           CONSOLE_BRIDGE_logError("Index entry for topic %s contains invalid time.", topic.c_str());
         } else
         {
-          connection_index.insert(connection_index.end(), index_entry);
+          connection_index.push_back(index_entry);
         }
     }
 }
@@ -664,7 +989,7 @@ void Bag::readConnectionIndexRecord200() {
 
     uint64_t chunk_pos = curr_chunk_info_.pos;
 
-    multiset<IndexEntry>& connection_index = connection_indexes_[connection_id];
+    vector<IndexEntry>& connection_index = connection_indexes_[connection_id];
 
     for (uint32_t i = 0; i < count; i++) {
         IndexEntry index_entry;
@@ -683,7 +1008,7 @@ void Bag::readConnectionIndexRecord200() {
           CONSOLE_BRIDGE_logError("Index entry for topic %s contains invalid time.  This message will not be loaded.", connections_[connection_id]->topic.c_str());
         } else
         {
-          connection_index.insert(connection_index.end(), index_entry);//构建connection_index
+          connection_index.push_back(index_entry);//构建connection_index
         }
     }
 }
@@ -817,6 +1142,35 @@ void Bag::decompressChunk(uint64_t chunk_pos) const {
         return;
     }
 
+    // Reading back a bag that's being written: get everything handed to the writer into the file
+    if (chunk_writer_)
+        chunk_writer_->sync();
+
+    // Uncompressed chunks are used straight from the mapping; compressed ones fall through
+    if (file_.isMapped()) {
+        bool decompressed = decompressed_chunk_ == chunk_pos || (current_chunk_ && current_chunk_->pos == chunk_pos);
+        if (mapped_chunk_ == chunk_pos || (!decompressed && mapChunk(chunk_pos))) {
+            current_buffer_ = &mapped_buffer_;
+            return;
+        }
+    }
+
+    if (isReadingAhead()) {
+        if (!current_chunk_ || current_chunk_->pos != chunk_pos) {
+            CachedChunkPtr chunk = chunk_cache_->get(chunk_pos);
+            if (!chunk) {
+                chunk_cache_->insert(readCachedChunk(chunk_pos));
+                chunk = chunk_cache_->get(chunk_pos);
+            }
+            if (!chunk->error.empty())
+                throw BagFormatException("Error decompressing chunk: " + chunk->error);
+
+            current_chunk_ = chunk;
+        }
+        current_buffer_ = &current_chunk_->decompressed;
+        return;
+    }
+
     current_buffer_ = &decompress_buffer_;
 
     if (decompressed_chunk_ == chunk_pos)
@@ -842,6 +1196,97 @@ void Bag::decompressChunk(uint64_t chunk_pos) const {
     decompressed_chunk_ = chunk_pos;
 }
 
+bool Bag::isReadingAhead() const {
+    return chunk_cache_ && version_ == 200;
+}
+
+void Bag::prefetchChunks(vector<uint64_t> const& chunk_positions) const {
+    foreach(uint64_t chunk_pos, chunk_positions) {
+        if (chunk_pos == curr_chunk_info_.pos)
+            continue;
+
+        if (file_.isMapped()) {
+            ChunkHeader chunk_header;
+            uint64_t data_pos = readMappedChunkHeader(chunk_pos, chunk_header);
+            file_.adviseWillNeed(data_pos, chunk_header.compressed_size);
+
+            if (chunk_header.compression == COMPRESSION_NONE)
+                continue;
+        }
+
+        if (!isReadingAhead() || chunk_cache_->contains(chunk_pos))
+            continue;
+
+        chunk_cache_->insert(readCachedChunk(chunk_pos));
+    }
+}
+
+// Parse a chunk header out of the mapping and return the position of the chunk data
+uint64_t Bag::readMappedChunkHeader(uint64_t chunk_pos, ChunkHeader& chunk_header) const {
+    if (chunk_pos + 8 >= file_.getMappedSize())
+        throw BagFormatException((format("Chunk at %1% is outside the file") % chunk_pos).str());
+
+    uint64_t available = file_.getMappedSize() - chunk_pos;
+
+    Buffer header_buffer;
+    header_buffer.setData(file_.getMappedData(chunk_pos), (uint32_t) std::min<uint64_t>(available, UINT_MAX));
+
+    uint32_t header_len;
+    memcpy(&header_len, header_buffer.getData(), 4);
+    if ((uint64_t) header_len + 8 > available)
+        throw BagFormatException("Error reading CHUNK record");
+
+    ros::Header header;
+    uint32_t bytes_read;
+    readHeaderFromBuffer(header_buffer, 0, header, chunk_header.compressed_size, bytes_read);
+    parseChunkHeader(header, chunk_header);
+
+    if (bytes_read + (uint64_t) chunk_header.compressed_size > available)
+        throw BagFormatException("CHUNK record extends past the end of the file");
+
+    return chunk_pos + bytes_read;
+}
+
+// Point mapped_buffer_ at an uncompressed chunk; returns false if the chunk needs decompressing
+bool Bag::mapChunk(uint64_t chunk_pos) const {
+    ChunkHeader chunk_header;
+    uint64_t data_pos = readMappedChunkHeader(chunk_pos, chunk_header);
+    if (chunk_header.compression != COMPRESSION_NONE)
+        return false;
+
+    mapped_buffer_.setData(file_.getMappedData(data_pos), chunk_header.compressed_size);
+    mapped_chunk_ = chunk_pos;
+    return true;
+}
+
+// Read (and decrypt) a chunk on this thread; it's decompressed by the cache's workers
+CachedChunkPtr Bag::readCachedChunk(uint64_t chunk_pos) const {
+    if (chunk_writer_)
+        chunk_writer_->sync();
+
+    seek(chunk_pos);
+
+    ChunkHeader chunk_header;
+    readChunkHeader(chunk_header);
+
+    CachedChunkPtr chunk = boost::make_shared<CachedChunk>();
+    chunk->pos = chunk_pos;
+    chunk->uncompressed_size = chunk_header.uncompressed_size;
+
+    if (chunk_header.compression == COMPRESSION_NONE)
+        chunk->compression = compression::Uncompressed;
+    else if (chunk_header.compression == COMPRESSION_BZ2)
+        chunk->compression = compression::BZ2;
+    else if (chunk_header.compression == COMPRESSION_LZ4)
+        chunk->compression = compression::LZ4;
+    else
+        throw BagFormatException("Unknown compression: " + chunk_header.compression);
+
+    encryptor_->decryptChunk(chunk_header, chunk->compressed, file_);
+
+    return chunk;
+}
+
 void Bag::readMessageDataRecord102(uint64_t offset, ros::Header& header) const {
     CONSOLE_BRIDGE_logDebug("readMessageDataRecord: offset=%llu", (unsigned long long) offset);
 
@@ -1222,6 +1667,18 @@ void Bag::swap(Bag& other) {
     swap(current_buffer_, other.current_buffer_);
     swap(decompressed_chunk_, other.decompressed_chunk_);
     swap(encryptor_, other.encryptor_);
+    swap(compression_threads_, other.compression_threads_);
+    swap(chunk_compressor_, other.chunk_compressor_);
+    swap(async_write_, other.async_write_);
+    swap(chunk_writer_, other.chunk_writer_);
+    swap(decompression_threads_, other.decompression_threads_);
+    swap(read_ahead_chunks_, other.read_ahead_chunks_);
+    swap(chunk_cache_, other.chunk_cache_);
+    swap(current_chunk_, other.current_chunk_);
+    swap(memory_mapped_, other.memory_mapped_);
+    swap(mapped_buffer_, other.mapped_buffer_);
+    swap(mapped_chunk_, other.mapped_chunk_);
+    swap(encrypted_, other.encrypted_);
 }
 
 bool Bag::isOpen() const { return file_.isOpen(); }
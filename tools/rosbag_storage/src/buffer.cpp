@@ -42,10 +42,10 @@
 
 namespace rosbag {
 
-Buffer::Buffer() : buffer_(NULL), capacity_(0), size_(0) { }
+Buffer::Buffer() : buffer_(NULL), capacity_(0), size_(0), owned_(true) { }
 
 Buffer::~Buffer() {
-    free(buffer_);
+    release();
 }
 
 uint8_t* Buffer::getData()           { return buffer_;   }
@@ -53,6 +53,9 @@ uint32_t Buffer::getCapacity() const { return capacity_; }
 uint32_t Buffer::getSize()     const { return size_;     }
 
 void Buffer::setSize(uint32_t size) {
+    if (!owned_)
+        release();
+
     size_ = size;
     ensureCapacity(size);
 }
@@ -72,11 +75,31 @@ void Buffer::ensureCapacity(uint32_t capacity) {
     assert(buffer_);
 }
 
+void Buffer::setData(uint8_t* data, uint32_t size) {
+    release();
+
+    buffer_   = data;
+    capacity_ = size;
+    size_     = size;
+    owned_    = false;
+}
+
+void Buffer::release() {
+    if (owned_)
+        free(buffer_);
+
+    buffer_   = NULL;
+    capacity_ = 0;
+    size_     = 0;
+    owned_    = true;
+}
+
 void Buffer::swap(Buffer& other) {
     using std::swap;
     swap(buffer_, other.buffer_);
     swap(capacity_, other.capacity_);
     swap(size_, other.size_);
+    swap(owned_, other.owned_);
 }
 
 } // namespace rosbag
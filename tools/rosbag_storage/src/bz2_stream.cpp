@@ -171,4 +171,19 @@ void BZ2Stream::decompress(uint8_t* dest, unsigned int dest_len, uint8_t* source
     }
 }
 
+unsigned int BZ2Stream::compress(uint8_t* dest, unsigned int dest_len, uint8_t* source, unsigned int source_len) {
+    int result = BZ2_bzBuffToBuffCompress((char*) dest, &dest_len, (char*) source, source_len, block_size_100k_, verbosity_, work_factor_);
+
+    switch (result) {
+    case BZ_OK:               break;
+    case BZ_CONFIG_ERROR:     throw BagException("library has been mis-compiled"); break;
+    case BZ_PARAM_ERROR:      throw BagException("dest is NULL or destLen is NULL or blockSize100k < 1 or blockSize100k > 9 or verbosity < 0 or verbosity > 4 or workFactor < 0 or workFactor > 250"); break;
+    case BZ_MEM_ERROR:        throw BagException("insufficient memory is available"); break;
+    case BZ_OUTBUFF_FULL:     throw BagException("size of the compressed data exceeds *destLen"); break;
+    default:                  throw BagException("Unhandled return code");
+    }
+
+    return dest_len;
+}
+
 } // namespace rosbag
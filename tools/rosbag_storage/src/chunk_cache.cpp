@@ -0,0 +1,165 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2008, Willow Garage, Inc.
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of Willow Garage, Inc. nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+********************************************************************/
+
+#include "rosbag/chunk_cache.h"
+
+#include <boost/bind.hpp>
+
+#include "console_bridge/console.h"
+
+namespace rosbag {
+
+ChunkCache::ChunkCache(uint32_t thread_count, uint32_t capacity) :
+    thread_count_(thread_count),
+    capacity_(capacity),
+    shutting_down_(false)
+{
+    if (thread_count_ == 0)
+        thread_count_ = 1;
+    if (capacity_ == 0)
+        capacity_ = 1;
+
+    for (uint32_t i = 0; i < thread_count_; i++)
+        threads_.create_thread(boost::bind(&ChunkCache::workerThread, this));
+}
+
+ChunkCache::~ChunkCache() {
+    {
+        boost::mutex::scoped_lock lock(mutex_);
+        shutting_down_ = true;
+    }
+    work_condition_.notify_all();
+    threads_.join_all();
+}
+
+uint32_t ChunkCache::getThreadCount() const { return thread_count_; }
+uint32_t ChunkCache::getCapacity()    const { return capacity_;     }
+
+bool ChunkCache::contains(uint64_t pos) const {
+    boost::mutex::scoped_lock lock(mutex_);
+    return chunks_.find(pos) != chunks_.end();
+}
+
+void ChunkCache::insert(CachedChunkPtr const& chunk) {
+    {
+        boost::mutex::scoped_lock lock(mutex_);
+        if (chunks_.find(chunk->pos) != chunks_.end())
+            return;
+
+        lru_.push_front(chunk);
+        chunks_[chunk->pos] = lru_.begin();
+        work_.push_back(chunk);
+
+        evict();
+    }
+    work_condition_.notify_one();
+}
+
+CachedChunkPtr ChunkCache::get(uint64_t pos) {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    std::map<uint64_t, L_CachedChunk::iterator>::iterator i = chunks_.find(pos);
+    if (i == chunks_.end())
+        return CachedChunkPtr();
+
+    // Mark as most recently used
+    lru_.splice(lru_.begin(), lru_, i->second);
+
+    CachedChunkPtr chunk = *i->second;
+    while (!chunk->done)
+        done_condition_.wait(lock);
+
+    return chunk;
+}
+
+void ChunkCache::evict() {
+    // Drop finished chunks from the least recently used end; chunks still queued or in flight are kept since
+    // they were asked for recently.  Callers hold their own reference to any chunk they're using.
+    L_CachedChunk::iterator i = lru_.end();
+    while (lru_.size() > capacity_ && i != lru_.begin()) {
+        --i;
+        if (!(*i)->done)
+            continue;
+
+        chunks_.erase((*i)->pos);
+        i = lru_.erase(i);
+    }
+}
+
+void ChunkCache::workerThread() {
+    StreamFactory stream_factory(NULL);
+
+    while (true) {
+        CachedChunkPtr chunk;
+        {
+            boost::mutex::scoped_lock lock(mutex_);
+            while (work_.empty() && !shutting_down_)
+                work_condition_.wait(lock);
+
+            if (work_.empty())
+                return;
+
+            chunk = work_.front();
+            work_.pop_front();
+        }
+
+        try {
+            if (chunk->compression == compression::Uncompressed) {
+                chunk->decompressed.swap(chunk->compressed);
+            }
+            else {
+                chunk->decompressed.setSize(chunk->uncompressed_size);
+                stream_factory.getStream(chunk->compression)->decompress(chunk->decompressed.getData(), chunk->decompressed.getSize(),
+                                                                         chunk->compressed.getData(), chunk->compressed.getSize());
+
+                // Free the compressed copy; only the decompressed data is kept in the cache
+                Buffer empty;
+                chunk->compressed.swap(empty);
+            }
+
+            CONSOLE_BRIDGE_logDebug("Decompressed chunk [%llu]: uncompressed=%d", (unsigned long long) chunk->pos, chunk->uncompressed_size);
+        }
+        catch (BagException const& ex) {
+            chunk->error = ex.what();
+        }
+
+        {
+            boost::mutex::scoped_lock lock(mutex_);
+            chunk->done = true;
+        }
+        done_condition_.notify_all();
+    }
+}
+
+} // namespace rosbag
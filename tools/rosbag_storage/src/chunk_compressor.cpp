@@ -0,0 +1,135 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2008, Willow Garage, Inc.
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of Willow Garage, Inc. nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+********************************************************************/
+
+#include "rosbag/chunk_compressor.h"
+
+#include <boost/bind.hpp>
+
+#include "console_bridge/console.h"
+
+namespace rosbag {
+
+ChunkCompressor::ChunkCompressor(uint32_t thread_count) :
+    thread_count_(thread_count),
+    shutting_down_(false)
+{
+    if (thread_count_ == 0)
+        thread_count_ = 1;
+
+    for (uint32_t i = 0; i < thread_count_; i++)
+        threads_.create_thread(boost::bind(&ChunkCompressor::workerThread, this));
+}
+
+ChunkCompressor::~ChunkCompressor() {
+    {
+        boost::mutex::scoped_lock lock(mutex_);
+        shutting_down_ = true;
+    }
+    work_condition_.notify_all();
+    threads_.join_all();
+}
+
+uint32_t ChunkCompressor::getThreadCount() const { return thread_count_; }
+
+size_t ChunkCompressor::getPendingCount() const {
+    boost::mutex::scoped_lock lock(mutex_);
+    return pending_.size();
+}
+
+void ChunkCompressor::push(OutgoingChunkPtr const& chunk) {
+    {
+        boost::mutex::scoped_lock lock(mutex_);
+        pending_.push_back(chunk);
+        work_.push_back(chunk);
+    }
+    work_condition_.notify_one();
+}
+
+OutgoingChunkPtr ChunkCompressor::pop(bool block) {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    // Only the oldest chunk may leave, even if a later one finished first
+    while (!pending_.empty() && !pending_.front()->done) {
+        if (!block)
+            return OutgoingChunkPtr();
+        done_condition_.wait(lock);
+    }
+
+    if (pending_.empty())
+        return OutgoingChunkPtr();
+
+    OutgoingChunkPtr chunk = pending_.front();
+    pending_.pop_front();
+    return chunk;
+}
+
+void ChunkCompressor::workerThread() {
+    // Each worker has its own streams; compress() keeps no state between calls but this avoids sharing them anyway
+    StreamFactory stream_factory(NULL);
+
+    while (true) {
+        OutgoingChunkPtr chunk;
+        {
+            boost::mutex::scoped_lock lock(mutex_);
+            while (work_.empty() && !shutting_down_)
+                work_condition_.wait(lock);
+
+            if (work_.empty())
+                return;
+
+            chunk = work_.front();
+            work_.pop_front();
+        }
+
+        try {
+            uint32_t uncompressed_size = chunk->uncompressed.getSize();
+            chunk->compressed.setSize(Stream::getCompressBound(uncompressed_size));
+            chunk->compressed_size = stream_factory.getStream(chunk->compression)->compress(
+                chunk->compressed.getData(), chunk->compressed.getSize(), chunk->uncompressed.getData(), uncompressed_size);
+
+            CONSOLE_BRIDGE_logDebug("Compressed chunk: compressed=%d uncompressed=%d", chunk->compressed_size, uncompressed_size);
+        }
+        catch (BagException const& ex) {
+            chunk->error = ex.what();
+        }
+
+        {
+            boost::mutex::scoped_lock lock(mutex_);
+            chunk->done = true;
+        }
+        done_condition_.notify_all();
+    }
+}
+
+} // namespace rosbag
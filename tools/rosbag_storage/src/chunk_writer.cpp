@@ -0,0 +1,519 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2008, Willow Garage, Inc.
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of Willow Garage, Inc. nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+********************************************************************/
+
+#include "rosbag/chunk_writer.h"
+#include "rosbag/exceptions.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include <boost/bind.hpp>
+#include <boost/format.hpp>
+
+#include "console_bridge/console.h"
+
+#ifndef _WIN32
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <sys/syscall.h>
+#    include <sys/uio.h>
+#    include <unistd.h>
+#    if defined(ROSBAG_HAVE_IO_URING) && defined(__NR_io_uring_setup)
+#        include <linux/io_uring.h>
+#        define ROSBAG_USE_IO_URING
+#    endif
+#endif
+
+using std::string;
+using boost::format;
+
+namespace rosbag {
+
+const size_t ChunkWriter::BUFFER_ALIGNMENT;
+
+#ifndef _WIN32
+
+//! A block-aligned buffer, first being assembled and then being written at offset
+struct ChunkWriter::PendingWrite
+{
+    PendingWrite() : data(NULL), capacity(0), size(0), offset(0), written(0), error(0), done(false) { }
+    ~PendingWrite() { free(data); }
+
+    uint8_t*     data;
+    size_t       capacity;
+    size_t       size;      //!< number of valid bytes in data
+    uint64_t     offset;    //!< block-aligned file offset of data
+    struct iovec iov;
+
+    size_t       written;   //!< bytes written, once done
+    int          error;     //!< errno of a failed write, once done
+    bool         done;
+};
+
+namespace {
+
+//! Write all of data at offset, returning 0 or an errno value
+/*!
+ * With direct I/O every write has to start at a block boundary, so after a short write the rest is
+ * written again from the last whole block written; block is 1 for buffered I/O.
+ */
+int writeAll(int fd, uint8_t const* data, size_t size, uint64_t offset, size_t block) {
+    while (size > 0) {
+        ssize_t n = pwrite(fd, data, size, offset);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return errno;
+        }
+        n -= n % block;
+        if (n == 0)
+            return EIO;
+
+        data   += n;
+        size   -= n;
+        offset += n;
+    }
+    return 0;
+}
+
+} // namespace
+
+#ifdef ROSBAG_USE_IO_URING
+
+//! A minimal io_uring submission/completion ring, driven through the raw system calls
+struct ChunkWriter::Ring
+{
+    Ring() : fd(-1), sq_ring(NULL), sq_ring_size(0), cq_ring(NULL), cq_ring_size(0), sqes(NULL), sqes_size(0) { }
+
+    ~Ring() {
+        if (sqes)
+            munmap(sqes, sqes_size);
+        if (cq_ring)
+            munmap(cq_ring, cq_ring_size);
+        if (sq_ring)
+            munmap(sq_ring, sq_ring_size);
+        if (fd >= 0)
+            close(fd);
+    }
+
+    bool setup(unsigned entries) {
+        struct io_uring_params params;
+        memset(&params, 0, sizeof(params));
+
+        fd = syscall(__NR_io_uring_setup, entries, &params);
+        if (fd < 0)
+            return false;
+
+        sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+        sqes_size    = params.sq_entries * sizeof(struct io_uring_sqe);
+
+        sq_ring = map(sq_ring_size, IORING_OFF_SQ_RING);
+        cq_ring = map(cq_ring_size, IORING_OFF_CQ_RING);
+        sqes    = (struct io_uring_sqe*) map(sqes_size, IORING_OFF_SQES);
+        if (!sq_ring || !cq_ring || !sqes)
+            return false;
+
+        sq_tail  = (unsigned*) (sq_ring + params.sq_off.tail);
+        sq_mask  = *(unsigned*) (sq_ring + params.sq_off.ring_mask);
+        sq_array = (unsigned*) (sq_ring + params.sq_off.array);
+        cq_head  = (unsigned*) (cq_ring + params.cq_off.head);
+        cq_tail  = (unsigned*) (cq_ring + params.cq_off.tail);
+        cq_mask  = *(unsigned*) (cq_ring + params.cq_off.ring_mask);
+        cqes     = (struct io_uring_cqe*) (cq_ring + params.cq_off.cqes);
+        return true;
+    }
+
+    uint8_t* map(size_t size, off_t offset) {
+        void* ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, offset);
+        return ptr == MAP_FAILED ? NULL : (uint8_t*) ptr;
+    }
+
+    void submit(int file, PendingWrite* pending) {
+        // We're the only producer, and never have more writes in flight than the ring has entries
+        unsigned tail  = *sq_tail;
+        unsigned index = tail & sq_mask;
+
+        struct io_uring_sqe* sqe = &sqes[index];
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode    = IORING_OP_WRITEV;
+        sqe->fd        = file;
+        sqe->addr      = (uint64_t) (uintptr_t) &pending->iov;
+        sqe->len       = 1;
+        sqe->off       = pending->offset;
+        sqe->user_data = (uint64_t) (uintptr_t) pending;
+
+        sq_array[index] = index;
+        __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+        enter(1, 0, 0);
+    }
+
+    //! Mark finished writes as done, first waiting for at least one if wait is set
+    void reap(bool wait) {
+        if (wait)
+            enter(0, 1, IORING_ENTER_GETEVENTS);
+
+        unsigned head = *cq_head;
+        while (head != __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE)) {
+            struct io_uring_cqe* cqe = &cqes[head & cq_mask];
+
+            PendingWrite* pending = (PendingWrite*) (uintptr_t) cqe->user_data;
+            if (cqe->res < 0)
+                pending->error = -cqe->res;
+            else
+                pending->written = cqe->res;
+            pending->done = true;
+
+            head++;
+        }
+        __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+    }
+
+    void enter(unsigned to_submit, unsigned min_complete, unsigned flags) {
+        while (syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0) < 0) {
+            if (errno != EINTR)
+                throw BagIOException((format("Error submitting write: %1%") % strerror(errno)).str());
+        }
+    }
+
+    int                  fd;
+    uint8_t*             sq_ring;
+    size_t               sq_ring_size;
+    uint8_t*             cq_ring;
+    size_t               cq_ring_size;
+    struct io_uring_sqe* sqes;
+    size_t               sqes_size;
+
+    unsigned*            sq_tail;
+    unsigned             sq_mask;
+    unsigned*            sq_array;
+    unsigned*            cq_head;
+    unsigned*            cq_tail;
+    unsigned             cq_mask;
+    struct io_uring_cqe* cqes;
+};
+
+#else
+
+struct ChunkWriter::Ring
+{
+    void submit(int, PendingWrite*) { }
+    void reap(bool) { }
+};
+
+#endif // ROSBAG_USE_IO_URING
+
+ChunkWriter::ChunkWriter(string const& filename, uint64_t offset, uint32_t max_pending) :
+    fd_(-1),
+    direct_(false),
+    max_pending_(std::max<uint32_t>(max_pending, 1)),
+    current_(NULL),
+    synced_(true),
+    shutting_down_(false)
+{
+#ifdef O_DIRECT
+    fd_ = open(filename.c_str(), O_RDWR | O_DIRECT);
+    direct_ = fd_ >= 0;
+#endif
+    // Not every file system supports direct I/O (e.g. tmpfs)
+    if (fd_ < 0)
+        fd_ = open(filename.c_str(), O_RDWR);
+    if (fd_ < 0)
+        throw BagIOException((format("Error opening file: %1%") % filename.c_str()).str());
+
+    // Start with the partial block before offset, so that every write covers whole blocks
+    current_ = takeBuffer(BUFFER_ALIGNMENT);
+    current_->offset = offset - offset % BUFFER_ALIGNMENT;
+    current_->size   = offset - current_->offset;
+    if (current_->size > 0 && pread(fd_, current_->data, BUFFER_ALIGNMENT, current_->offset) < (ssize_t) current_->size) {
+        delete current_;
+        close(fd_);
+        throw BagIOException((format("Error reading file: %1%") % filename.c_str()).str());
+    }
+
+#ifdef ROSBAG_USE_IO_URING
+    ring_.reset(new Ring);
+    if (!ring_->setup(max_pending_ + 1)) {
+        CONSOLE_BRIDGE_logDebug("io_uring unavailable (%s), writing on a thread", strerror(errno));
+        ring_.reset();
+    }
+#endif
+    if (!ring_)
+        thread_ = boost::thread(boost::bind(&ChunkWriter::writeThread, this));
+
+    CONSOLE_BRIDGE_logDebug("Writing %s from %llu: direct=%d io_uring=%d", filename.c_str(), (unsigned long long) offset, direct_, isUsingIoUring());
+}
+
+ChunkWriter::~ChunkWriter() {
+    // Errors can't be reported from here; sync() first to see them
+    while (!pending_.empty()) {
+        PendingWrite* oldest = pending_.front();
+        try {
+            waitOldest();
+        }
+        catch (BagException const& ex) {
+            CONSOLE_BRIDGE_logError("%s", ex.what());
+
+            // If we couldn't even wait for it, abandon the write.  Its buffer is leaked rather than freed,
+            // as the kernel may still be reading from it.
+            if (!pending_.empty() && pending_.front() == oldest)
+                pending_.pop_front();
+        }
+    }
+
+    if (thread_.joinable()) {
+        {
+            boost::mutex::scoped_lock lock(mutex_);
+            shutting_down_ = true;
+        }
+        condition_.notify_all();
+        thread_.join();
+    }
+    ring_.reset();
+
+    delete current_;
+    for (size_t i = 0; i < free_.size(); i++)
+        delete free_[i];
+
+    close(fd_);
+}
+
+void ChunkWriter::write(void const* data, size_t size) {
+    reserve(current_->size + size);
+
+    memcpy(current_->data + current_->size, data, size);
+    current_->size += size;
+    synced_ = false;
+}
+
+void ChunkWriter::submit() {
+    size_t whole = current_->size - current_->size % BUFFER_ALIGNMENT;
+    if (whole == 0)
+        return;
+
+    // Carry the trailing partial block over into the next buffer
+    PendingWrite* next = takeBuffer(current_->capacity);
+    next->offset = current_->offset + whole;
+    next->size   = current_->size - whole;
+    memcpy(next->data, current_->data + whole, next->size);
+
+    PendingWrite* pending = current_;
+    pending->size = whole;
+    current_ = next;
+
+    start(pending);
+
+    while (pending_.size() > max_pending_)
+        waitOldest();
+}
+
+void ChunkWriter::sync() {
+    while (!pending_.empty())
+        waitOldest();
+
+    if (synced_)
+        return;
+
+    if (current_->size > 0) {
+        // Direct writes must cover whole blocks, so pad the last one and trim the file afterwards
+        size_t padded = current_->size + (BUFFER_ALIGNMENT - current_->size % BUFFER_ALIGNMENT) % BUFFER_ALIGNMENT;
+        memset(current_->data + current_->size, 0, padded - current_->size);
+
+        int error = writeAll(fd_, current_->data, padded, current_->offset, writeBlock());
+        if (error == 0 && ftruncate(fd_, getOffset()) != 0)
+            error = errno;
+        if (error != 0)
+            throw BagIOException((format("Error writing to file: %1%") % strerror(error)).str());
+    }
+
+    synced_ = true;
+}
+
+uint64_t ChunkWriter::getOffset()      const { return current_->offset + current_->size; }
+bool     ChunkWriter::isDirect()       const { return direct_;                           }
+bool     ChunkWriter::isUsingIoUring() const { return ring_.get() != NULL;                 }
+
+bool ChunkWriter::isSupported() { return true; }
+
+void ChunkWriter::reserve(size_t capacity) {
+    if (capacity <= current_->capacity)
+        return;
+
+    PendingWrite* larger = takeBuffer(std::max(capacity, 2 * current_->capacity));
+    memcpy(larger->data, current_->data, current_->size);
+    larger->size   = current_->size;
+    larger->offset = current_->offset;
+
+    delete current_;
+    current_ = larger;
+}
+
+// Reuse a finished buffer if one is big enough; otherwise drop one and allocate, so at most
+// max_pending_ + 2 buffers ever exist
+ChunkWriter::PendingWrite* ChunkWriter::takeBuffer(size_t capacity) {
+    PendingWrite* buffer = NULL;
+    for (size_t i = 0; i < free_.size(); i++) {
+        if (free_[i]->capacity >= capacity) {
+            buffer = free_[i];
+            free_.erase(free_.begin() + i);
+            break;
+        }
+    }
+
+    if (buffer == NULL) {
+        if (!free_.empty()) {
+            delete free_.back();
+            free_.pop_back();
+        }
+
+        buffer = new PendingWrite();
+        buffer->capacity = capacity + (BUFFER_ALIGNMENT - capacity % BUFFER_ALIGNMENT) % BUFFER_ALIGNMENT;
+        if (posix_memalign((void**) &buffer->data, BUFFER_ALIGNMENT, buffer->capacity) != 0) {
+            delete buffer;
+            throw BagIOException("Error allocating write buffer");
+        }
+    }
+
+    buffer->size    = 0;
+    buffer->offset  = 0;
+    buffer->written = 0;
+    buffer->error   = 0;
+    buffer->done    = false;
+    return buffer;
+}
+
+void ChunkWriter::start(PendingWrite* pending) {
+    pending->iov.iov_base = pending->data;
+    pending->iov.iov_len  = pending->size;
+    pending_.push_back(pending);
+
+    if (ring_) {
+        ring_->submit(fd_, pending);
+        return;
+    }
+
+    {
+        boost::mutex::scoped_lock lock(mutex_);
+        work_.push_back(pending);
+    }
+    condition_.notify_all();
+}
+
+size_t ChunkWriter::writeBlock() const {
+    return direct_ ? BUFFER_ALIGNMENT : 1;
+}
+
+void ChunkWriter::waitOldest() {
+    PendingWrite* pending = pending_.front();
+
+    if (ring_) {
+        ring_->reap(false);
+        while (!pending->done)
+            ring_->reap(true);
+    }
+    else {
+        boost::mutex::scoped_lock lock(mutex_);
+        while (!pending->done)
+            condition_.wait(lock);
+    }
+    pending_.pop_front();
+
+    // Finish a short write (e.g. on a full disk) here, which also picks up its error.  A direct write
+    // can't resume mid-block, so start over from the last whole block written.
+    int error = pending->error;
+    if (error == 0 && pending->written < pending->size) {
+        size_t resume = pending->written - pending->written % writeBlock();
+        error = writeAll(fd_, pending->data + resume, pending->size - resume, pending->offset + resume, writeBlock());
+    }
+
+    free_.push_back(pending);
+
+    if (error != 0)
+        throw BagIOException((format("Error writing to file: %1%") % strerror(error)).str());
+}
+
+void ChunkWriter::writeThread() {
+    while (true) {
+        PendingWrite* pending;
+        {
+            boost::mutex::scoped_lock lock(mutex_);
+            while (work_.empty() && !shutting_down_)
+                condition_.wait(lock);
+
+            if (work_.empty())
+                return;
+
+            pending = work_.front();
+            work_.pop_front();
+        }
+
+        int error = writeAll(fd_, pending->data, pending->size, pending->offset, writeBlock());
+
+        {
+            boost::mutex::scoped_lock lock(mutex_);
+            pending->error   = error;
+            pending->written = error == 0 ? pending->size : 0;
+            pending->done    = true;
+        }
+        condition_.notify_all();
+    }
+}
+
+#else // _WIN32
+
+struct ChunkWriter::PendingWrite { };
+struct ChunkWriter::Ring { };
+
+ChunkWriter::ChunkWriter(string const&, uint64_t, uint32_t) : fd_(-1), direct_(false), max_pending_(0), current_(NULL), synced_(true), shutting_down_(false) {
+    throw BagException("Asynchronous writing is not supported on this platform");
+}
+
+ChunkWriter::~ChunkWriter() { }
+
+void     ChunkWriter::write(void const*, size_t) { }
+void     ChunkWriter::submit()                   { }
+void     ChunkWriter::sync()                     { }
+uint64_t ChunkWriter::getOffset()      const     { return 0;     }
+bool     ChunkWriter::isDirect()       const     { return false; }
+bool     ChunkWriter::isUsingIoUring() const     { return false; }
+
+bool ChunkWriter::isSupported() { return false; }
+
+#endif // _WIN32
+
+} // namespace rosbag
@@ -34,7 +34,9 @@
 
 #include "rosbag/chunked_file.h"
 
+#include <algorithm>
 #include <iostream>
+#include <limits>
 
 #include <boost/format.hpp>
 #include <boost/make_shared.hpp>
@@ -52,6 +54,10 @@
 #        define fileno _fileno
 #        define ftruncate _chsize
 #    endif
+#else
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <unistd.h>
 #endif
 
 using std::string;
@@ -66,7 +72,9 @@ ChunkedFile::ChunkedFile() :
     offset_(0),
     compressed_in_(0),
     unused_(NULL),
-    nUnused_(0)
+    nUnused_(0),
+    mapped_(NULL),
+    mapped_size_(0)
 {
     stream_factory_ = boost::make_shared<StreamFactory>(this);
 }
@@ -141,6 +149,8 @@ void ChunkedFile::close() {
     // Close any compressed stream by changing to uncompressed mode
     setWriteMode(compression::Uncompressed);
 
+    unmap();
+
     // Close the file
     int success = fclose(file_);
     if (success != 0)
@@ -222,6 +232,80 @@ void ChunkedFile::decompress(CompressionType compression, uint8_t* dest, unsigne
     stream_factory_->getStream(compression)->decompress(dest, dest_len, source, source_len);
 }
 
+unsigned int ChunkedFile::compress(CompressionType compression, uint8_t* dest, unsigned int dest_len, uint8_t* source, unsigned int source_len) {
+    return stream_factory_->getStream(compression)->compress(dest, dest_len, source, source_len);
+}
+
+// Memory mapping
+
+bool ChunkedFile::map() {
+    if (!file_)
+        throw BagIOException("Can't map - file not open");
+
+    if (mapped_)
+        return true;
+
+#ifdef _WIN32
+    return false;
+#else
+    int fd = fileno(file_);
+
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0)
+        throw BagIOException((format("Error reading size of file: %1%") % filename_.c_str()).str());
+
+    // Nothing to map, or too big for the address space
+    uint64_t size = file_stat.st_size;
+    if (size == 0 || size > std::numeric_limits<size_t>::max())
+        return false;
+
+    void* data = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED)
+        return false;
+
+    mapped_      = (uint8_t*) data;
+    mapped_size_ = size;
+    return true;
+#endif
+}
+
+void ChunkedFile::unmap() {
+    if (!mapped_)
+        return;
+
+#ifndef _WIN32
+    munmap(mapped_, mapped_size_);
+#endif
+
+    mapped_      = NULL;
+    mapped_size_ = 0;
+}
+
+bool     ChunkedFile::isMapped()      const { return mapped_ != NULL; }
+uint64_t ChunkedFile::getMappedSize() const { return mapped_size_;    }
+
+uint8_t* ChunkedFile::getMappedData(uint64_t offset) const {
+    if (offset > mapped_size_)
+        throw BagIOException((format("Offset %1% is outside the mapped file") % offset).str());
+
+    return mapped_ + offset;
+}
+
+void ChunkedFile::adviseWillNeed(uint64_t offset, uint64_t size) const {
+    if (!mapped_ || offset >= mapped_size_)
+        return;
+
+#ifndef _WIN32
+    // madvise wants a page-aligned start
+    uint64_t page_size = sysconf(_SC_PAGESIZE);
+    uint64_t start     = offset - offset % page_size;
+    uint64_t end       = std::min(offset + size, mapped_size_);
+
+    // Only a hint - the pages are faulted in on access regardless
+    madvise(mapped_ + start, end - start, MADV_WILLNEED);
+#endif
+}
+
 void ChunkedFile::clearUnused() {
     unused_ = NULL;
     nUnused_ = 0;
@@ -236,6 +320,8 @@ void ChunkedFile::swap(ChunkedFile& other) {
     swap(compressed_in_, other.compressed_in_);
     swap(unused_, other.unused_);
     swap(nUnused_, other.nUnused_);
+    swap(mapped_, other.mapped_);
+    swap(mapped_size_, other.mapped_size_);
 
     swap(stream_factory_, other.stream_factory_);
 
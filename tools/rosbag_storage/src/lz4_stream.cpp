@@ -226,4 +226,19 @@ void LZ4Stream::decompress(uint8_t* dest, unsigned int dest_len, uint8_t* source
     }
 }
 
+unsigned int LZ4Stream::compress(uint8_t* dest, unsigned int dest_len, uint8_t* source, unsigned int source_len) {
+    unsigned int actual_dest_len = dest_len;
+    int ret = roslz4_buffToBuffCompress((char*)source, source_len,
+                                        (char*)dest, &actual_dest_len, block_size_id_);
+    switch(ret) {
+    case ROSLZ4_OK: break;
+    case ROSLZ4_ERROR: throw BagException("ROSLZ4_ERROR: compression error"); break;
+    case ROSLZ4_MEMORY_ERROR: throw BagException("ROSLZ4_MEMORY_ERROR: insufficient memory available"); break;
+    case ROSLZ4_OUTPUT_SMALL: throw BagException("ROSLZ4_OUTPUT_SMALL: output buffer is too small"); break;
+    case ROSLZ4_PARAM_ERROR: throw BagException("ROSLZ4_PARAM_ERROR: bad block size"); break;
+    default: throw BagException("Unhandled return code");
+    }
+    return actual_dest_len;
+}
+
 } // namespace rosbag
@@ -35,7 +35,6 @@
 using std::map;
 using std::string;
 using std::vector;
-using std::multiset;
 
 namespace rosbag {
 
@@ -92,8 +91,8 @@ BagQuery::BagQuery(Bag const* _bag, Query const& _query, uint32_t _bag_revision)
 
 // MessageRange
 
-MessageRange::MessageRange(std::multiset<IndexEntry>::const_iterator const& _begin,
-                           std::multiset<IndexEntry>::const_iterator const& _end,
+MessageRange::MessageRange(std::vector<IndexEntry>::const_iterator const& _begin,
+                           std::vector<IndexEntry>::const_iterator const& _end,
                            ConnectionInfo const* _connection_info,
                            BagQuery const* _bag_query)
 	: begin(_begin), end(_end), connection_info(_connection_info), bag_query(_bag_query)
@@ -102,7 +101,7 @@ MessageRange::MessageRange(std::multiset<IndexEntry>::const_iterator const& _beg
 
 // ViewIterHelper
 
-ViewIterHelper::ViewIterHelper(std::multiset<IndexEntry>::const_iterator _iter, MessageRange const* _range)
+ViewIterHelper::ViewIterHelper(std::vector<IndexEntry>::const_iterator _iter, MessageRange const* _range)
 	: iter(_iter), range(_range)
 {
 }
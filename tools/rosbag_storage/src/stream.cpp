@@ -65,6 +65,11 @@ Stream::Stream(ChunkedFile* file) : file_(file) { }
 
 Stream::~Stream() { }
 
+unsigned int Stream::getCompressBound(unsigned int source_len) {
+    // bzip2 needs 1% + 600 bytes in the worst case, which also covers LZ4's per-block framing
+    return source_len + source_len / 100 + 600;
+}
+
 void Stream::startWrite() { }
 void Stream::stopWrite()  { }
 void Stream::startRead()  { }
@@ -112,4 +112,12 @@ void UncompressedStream::decompress(uint8_t* dest, unsigned int dest_len, uint8_
     memcpy(dest, source, source_len);
 }
 
+unsigned int UncompressedStream::compress(uint8_t* dest, unsigned int dest_len, uint8_t* source, unsigned int source_len) {
+    if (dest_len < source_len)
+        throw BagException("dest_len not large enough");
+
+    memcpy(dest, source, source_len);
+    return source_len;
+}
+
 } // namespace rosbag
@@ -30,7 +30,7 @@
 #include "rosbag/message_instance.h"
 
 #include <boost/foreach.hpp>
-#include <set>
+#include <algorithm>
 #include <assert.h>
 
 #define foreach BOOST_FOREACH
@@ -38,13 +38,12 @@
 using std::map;
 using std::string;
 using std::vector;
-using std::multiset;
 
 namespace rosbag {
 
 // View::iterator
 
-View::iterator::iterator() : view_(NULL), view_revision_(0), message_instance_(NULL) { }
+View::iterator::iterator() : view_(NULL), entry_(), view_revision_(0), message_instance_(NULL), prefetch_chunk_pos_(-1) { }
 
 View::iterator::~iterator()
 {
@@ -52,18 +51,20 @@ View::iterator::~iterator()
     delete message_instance_;
 }
 
-View::iterator::iterator(View* view, bool end) : view_(view), view_revision_(0), message_instance_(NULL) {
+View::iterator::iterator(View* view, bool end) : view_(view), entry_(), view_revision_(0), message_instance_(NULL), prefetch_chunk_pos_(-1) {
     if (view != NULL && !end)
         populate();
 }
 
-View::iterator::iterator(const iterator& i) : view_(i.view_), iters_(i.iters_), view_revision_(i.view_revision_), message_instance_(NULL) { }
+View::iterator::iterator(const iterator& i) : view_(i.view_), iters_(i.iters_), entry_(i.entry_), view_revision_(i.view_revision_), message_instance_(NULL), prefetch_chunk_pos_(-1) { }
 
 View::iterator &View::iterator::operator=(iterator const& i) {
     if (this != &i) {
         view_ = i.view_;
         iters_ = i.iters_;
+        entry_ = i.entry_;
         view_revision_ = i.view_revision_;
+        prefetch_chunk_pos_ = -1;
         if (message_instance_ != NULL) {
             delete message_instance_;
             message_instance_ = NULL;
@@ -81,24 +82,37 @@ void View::iterator::populate() {
             iters_.push_back(ViewIterHelper(range->begin, range));
 
     std::sort(iters_.begin(), iters_.end(), ViewIterHelperCompare());//将多个bag排序
+    if (!iters_.empty())
+        entry_ = *iters_.back().iter;
     view_revision_ = view_->view_revision_;//???
 }
 
-void View::iterator::populateSeek(multiset<IndexEntry>::const_iterator iter) {
+void View::iterator::populateSeek(IndexEntry entry, MessageRange const* range) {
     assert(view_ != NULL);
 
     iters_.clear();
-    foreach(MessageRange const* range, view_->ranges_) {
-        multiset<IndexEntry>::const_iterator start = std::lower_bound(range->begin, range->end, iter->time, IndexEntryCompare());
-        if (start != range->end)
-            iters_.push_back(ViewIterHelper(start, range));
+    foreach(MessageRange const* r, view_->ranges_) {
+        vector<IndexEntry>::const_iterator start = std::lower_bound(r->begin, r->end, entry.time, IndexEntryCompare());
+        if (start != r->end)
+            iters_.push_back(ViewIterHelper(start, r));
     }
 
     std::sort(iters_.begin(), iters_.end(), ViewIterHelperCompare());
-    while (iter != iters_.back().iter)
+    if (!iters_.empty())
+        entry_ = *iters_.back().iter;
+    view_revision_ = view_->view_revision_;
+
+    while (!iters_.empty() && !isAt(entry, range))
         increment();
+}
 
-    view_revision_ = view_->view_revision_;
+//! Whether we're at the given message, compared by value so it holds even if the index has moved since
+bool View::iterator::isAt(IndexEntry const& entry, MessageRange const* range) const {
+    MessageRange const* current = iters_.back().range;
+
+    // Ranges from different queries can share a connection, so the message is what counts, not the range
+    return entry_.chunk_pos == entry.chunk_pos && entry_.offset == entry.offset &&
+           current->bag_query->bag == range->bag_query->bag && current->connection_info == range->connection_info;
 }
 
 bool View::iterator::equal(View::iterator const& other) const {
@@ -111,7 +125,7 @@ bool View::iterator::equal(View::iterator const& other) const {
     if (other.iters_.empty())
         return false;
 
-    return iters_.back().iter == other.iters_.back().iter;
+    return isAt(other.entry_, other.iters_.back().range);
 }
 
 void View::iterator::increment() {
@@ -128,13 +142,14 @@ void View::iterator::increment() {
 
     // Note, updating may have blown away our message-ranges and
     // replaced them in general the ViewIterHelpers are no longer
-    // valid, but the iterator it stores should still be good.
+    // valid, and a write may have moved the index they point into,
+    // so we find our place again from the copy of the current entry.
     if (view_revision_ != view_->view_revision_)
-        populateSeek(iters_.back().iter);
+        populateSeek(entry_, iters_.back().range);
 
     if (view_->reduce_overlap_)
     {
-        std::multiset<IndexEntry>::const_iterator last_iter = iters_.back().iter;
+        std::vector<IndexEntry>::const_iterator last_iter = iters_.back().iter;
     
         while (!iters_.empty() && iters_.back().iter == last_iter)
         {
@@ -153,17 +168,78 @@ void View::iterator::increment() {
       
         std::sort(iters_.begin(), iters_.end(), ViewIterHelperCompare());
     }
+
+    if (!iters_.empty())
+        entry_ = *iters_.back().iter;
 }
 
 MessageInstance& View::iterator::dereference() const {
     ViewIterHelper const& i = iters_.back();
 
     if (message_instance_ == NULL)
-      message_instance_ = view_->newMessageInstance(i.range->connection_info, *(i.iter), *(i.range->bag_query->bag));
+      message_instance_ = view_->newMessageInstance(i.range->connection_info, entry_, *(i.range->bag_query->bag));
+
+    if (entry_.chunk_pos != prefetch_chunk_pos_)
+      prefetch();
 
     return *message_instance_;
 }
 
+//! Ask the bag to start decompressing (or paging in) the chunk we're in and the next few the view will visit
+void View::iterator::prefetch() const {
+    ViewIterHelper const& current = iters_.back();
+    Bag const* bag = current.range->bag_query->bag;
+
+    prefetch_chunk_pos_ = entry_.chunk_pos;
+
+    if (!bag->isReadingAhead() && !bag->isMemoryMapped())
+        return;
+
+    // Looking ahead walks our iterators into the index, which a write to the bag since may have moved
+    view_->update();
+    if (view_revision_ != view_->view_revision_)
+        return;
+
+    uint32_t read_ahead = bag->getReadAheadChunks();
+
+    // Find the earliest upcoming message in each chunk, looking at most read_ahead chunks into each range
+    map<uint64_t, ros::Time> chunk_times;
+    foreach(ViewIterHelper const& h, iters_) {
+        if (h.range->bag_query->bag != bag)
+            continue;
+
+        uint32_t chunks_seen = 0;
+        uint64_t last_chunk_pos = -1;
+        for (vector<IndexEntry>::const_iterator j = h.iter; j != h.range->end; j++) {
+            if (j->chunk_pos == last_chunk_pos)
+                continue;
+            if (chunks_seen++ > read_ahead)
+                break;
+            last_chunk_pos = j->chunk_pos;
+
+            map<uint64_t, ros::Time>::iterator k = chunk_times.find(last_chunk_pos);
+            if (k == chunk_times.end())
+                chunk_times[last_chunk_pos] = j->time;
+            else if (j->time < k->second)
+                k->second = j->time;
+        }
+    }
+
+    // Chunks in the order the view will reach them, starting with the current one
+    vector<std::pair<ros::Time, uint64_t> > upcoming;
+    for (map<uint64_t, ros::Time>::const_iterator k = chunk_times.begin(); k != chunk_times.end(); k++)
+        if (k->first != prefetch_chunk_pos_)
+            upcoming.push_back(std::make_pair(k->second, k->first));
+    std::sort(upcoming.begin(), upcoming.end());
+
+    vector<uint64_t> chunk_positions;
+    chunk_positions.push_back(prefetch_chunk_pos_);
+    for (size_t k = 0; k < upcoming.size() && k < read_ahead; k++)
+        chunk_positions.push_back(upcoming[k].second);
+
+    bag->prefetchChunks(chunk_positions);
+}
+
 
 
 
@@ -212,7 +288,7 @@ ros::Time View::getEndTime()
 
   foreach (rosbag::MessageRange* range, ranges_)
   {
-    std::multiset<IndexEntry>::const_iterator e = range->end;
+    std::vector<IndexEntry>::const_iterator e = range->end;
     e--;
 
     if (e->time > end)
@@ -278,31 +354,17 @@ void View::updateQueries(BagQuery* q) {
         if (!q->query.getQuery()(connection))
             continue;
 
-        map<uint32_t, multiset<IndexEntry> >::const_iterator j = q->bag->connection_indexes_.find(connection->id);
+        map<uint32_t, vector<IndexEntry> >::const_iterator j = q->bag->connection_indexes_.find(connection->id);
 
         // Skip if the bag doesn't have the corresponding index
         if (j == q->bag->connection_indexes_.end())
             continue;
-        multiset<IndexEntry> const& index = j->second;
+        vector<IndexEntry> const& index = j->second;
 
         // lower_bound/upper_bound do a binary search to find the appropriate range of Index Entries given our time range
         //区间搜索
-        IndexEntry start_time_lookup_entry = { q->query.getStartTime(), 0, 0 };
-        IndexEntry end_time_lookup_entry   = { q->query.getEndTime()  , 0, 0 };
-        std::multiset<IndexEntry>::const_iterator begin = index.lower_bound(start_time_lookup_entry);
-        std::multiset<IndexEntry>::const_iterator end   = index.upper_bound(end_time_lookup_entry);
-	    
-        // Make sure we are at the right beginning
-        //检索到正确的起始
-        while (begin != index.begin() && begin->time >= q->query.getStartTime())
-        {
-          begin--;
-          if (begin->time < q->query.getStartTime())
-          {
-            begin++;
-            break;
-          }
-        }
+        std::vector<IndexEntry>::const_iterator begin = std::lower_bound(index.begin(), index.end(), q->query.getStartTime(), IndexEntryCompare());
+        std::vector<IndexEntry>::const_iterator end   = std::upper_bound(index.begin(), index.end(), q->query.getEndTime(), IndexEntryCompare());
 
         if (begin != end)
         {